@@ -1,13 +1,20 @@
 #ifndef KMCCOARSEGRAIN_KMC_COARSEGRAINSYSTEM_HPP
 #define KMCCOARSEGRAIN_KMC_COARSEGRAINSYSTEM_HPP
 
+#include <functional>
+#include <iosfwd>
 #include <map>
 #include <unordered_set>
 #include <unordered_map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "kmc_constants.hpp"
+#include "kmc_memory_usage.hpp"
+#include "kmc_observables.hpp"
+#include "kmc_reservoir_counts.hpp"
+#include "kmc_statistics.hpp"
 
 namespace ugly {
 template <typename... Ts>
@@ -16,11 +23,24 @@ class Graph;
 
 namespace kmccoarsegrain {
 
+class KMC_Site;
 class KMC_Site_Container;
 class KMC_Cluster_Container;
+class KMC_HotSpotDetector;
+class KMC_Reservoirs;
+class KMC_RejectionFree;
+class KMC_RateTree;
+class KMC_RateCache;
+class KMC_CoarseGrainWorker;
+class KMC_Cluster;
+struct CoarseGrainCriteria;
 class KMC_TopologyFeature;
 
 class KMC_Walker;
+class KMC_WalkerStore;
+struct KMC_RateTable;
+struct KMC_CompressedRateTable;
+class KMC_RateProvider;
 
 /**
  * \brief Coarse Grain System allows abstraction of renormalization of sites
@@ -95,9 +115,166 @@ class KMC_CoarseGrainSystem {
    * rates[5][1] = &rateFrom5to1;
    *
    * Where each of the rateFrom variables is a double
+   *
+   * Sites that only appear as neighbors, with no rates off of them, become
+   * drains, see addDrain.
    **/
   void initializeSystem(std::unordered_map<int, std::unordered_map<int, double>> &ratesOfAllSites);
 
+  /**
+   * \brief Initialize the system from rates held in compressed sparse rows
+   *
+   * Pointers to the rates in the table are stored in the same way as with
+   * the nested maps, so the table must outlive the system and must not be
+   * resized. No copy of the rates is made, which keeps the memory needed to
+   * set up systems of millions of sites down. Neighbors without a row in
+   * the table become drains.
+   *
+   * Throws an invalid_argument if the offsets do not match the neighbors
+   * and rates or if a site has no rates off of it.
+   *
+   * \param[in] rate_table rates off of sites 0 to rate_table.size()-1, see
+   * generateRateTable
+   **/
+  void initializeSystem(KMC_RateTable & rate_table);
+
+  /**
+   * \brief Initialize the system with rates that are calculated when needed
+   *
+   * No sites are created up front. A site is created the first time it is
+   * needed, by a walker or by coarse graining, and the rates off of it are
+   * asked of the provider and held in a cache. Once the cache holds more
+   * sites than its capacity the least recently used sites are dropped,
+   * along with their rates and visit counts, unless they are occupied, part
+   * of a cluster, a source or a drain. Only the rates of the sites around
+   * the walkers and of the clusters are then held in memory.
+   *
+   * The provider must outlive the system. Rates can not be changed, and
+   * rejection free kinetics, asynchronous coarse graining and checkpoints
+   * are not supported, a runtime_error is thrown.
+   *
+   * \param[in] rate_provider
+   **/
+  void initializeSystem(const KMC_RateProvider & rate_provider);
+
+  /**
+   * \brief Initialize the system with rates stored once per pair of sites
+   *
+   * Sites are loaded and dropped in the same way as with a
+   * KMC_RateProvider, the rates off a site are rebuilt from the table when
+   * it is loaded. The rebuilt rates are held in the cache in full, one rate
+   * per neighbor, so the compression only shrinks the table. The memory of
+   * the system is bounded by the capacity of the rate cache, as it is with
+   * a provider. The table must outlive the system and must not be changed,
+   * the same modes are not supported.
+   *
+   * \param[in] rate_table see generateCompressedRateTable
+   **/
+  void initializeSystem(const KMC_CompressedRateTable & rate_table);
+
+  /**
+   * \brief Number of sites whose rates are cached when the rates come from
+   * a KMC_RateProvider or a KMC_CompressedRateTable
+   *
+   * By default it is 100000. Must be set before initializeSystem is called.
+   *
+   * \param[in] capacity
+   **/
+  void setRateCacheCapacity(const size_t capacity);
+  size_t getRateCacheCapacity() const { return rate_cache_capacity_; }
+
+  /**
+   * \brief Change a batch of rates
+   *
+   * The new rates are written to the rates passed into initializeSystem. 
+   * Only the sites whose rates are changed are recalculated. Clusters 
+   * containing any of the sites are marked, and their master equation is
+   * solved again, and their resolution chosen again, the next time a walker
+   * hops onto or off of them. Clusters
+   * that no longer satisfy the equilibrium condition are only dissolved if
+   * a cluster review interval has been set.
+   *
+   * \param[in] rates the first int is the id of the site the rate is off
+   * of, the second int is the id of the neighboring site and the double is
+   * the new rate. Each of the rates must already exist.
+   *
+   * Rates can not be changed with rejection free kinetics, a runtime_error
+   * is thrown.
+   *
+   * The times the walkers have already drawn are left as they are, pass the
+   * walkers in as well if any of them are on the sites. With rate tree event
+   * selection the rates of the walkers are held by the system, so a
+   * runtime_error is thrown if there are walkers and they are not passed in.
+   **/
+  void updateRates(const std::unordered_map<int, std::unordered_map<int, double>> & rates);
+
+  /**
+   * \brief Change a batch of rates, rescaling the times of the walkers
+   *
+   * As updateRates without the walkers, but the time each walker on an
+   * affected site or cluster has left before it hops is scaled by the ratio
+   * of the new to the old escape time constant, and the site it hops to is
+   * picked again. Occupied clusters are solved straight away and their
+   * resolution is chosen again.
+   *
+   * The dwell time of each walker in the vector is taken to be the time it
+   * has left. For walkers in a store the time they have left is measured
+   * from the time of the last hop, with rate tree event selection only their
+   * rates are changed.
+   **/
+  void updateRates(
+      const std::unordered_map<int, std::unordered_map<int, double>> & rates,
+      std::vector<std::pair<int,KMC_Walker>> & walkers);
+  void updateRates(
+      const std::unordered_map<int, std::unordered_map<int, double>> & rates,
+      KMC_WalkerStore & walkers);
+
+  /**
+   * \brief Function giving the rate from a site to its neighbor for a value
+   * of a parameter, i.e. the applied field
+   *
+   * The first int is the site the rate is off of, the second int is the
+   * neighboring site and the double is the parameter.
+   **/
+  typedef std::function<double(const int &,const int &,const double &)> RateFamily;
+
+  /**
+   * \brief Register the family of rates used by setRateParameter
+   *
+   * \param[in] rate_family
+   * \param[in] siteIds sites whose rates off of them depend on the
+   * parameter, the family is only evaluated for these sites. If empty it is
+   * evaluated for every site.
+   **/
+  void setRateFamily(
+      RateFamily rate_family,
+      const std::vector<int> & siteIds = std::vector<int>());
+
+  /**
+   * \brief Change all of the rates to those of the family at the parameter
+   *
+   * Before the rates are changed the sites making up each of the clusters are
+   * stored in a catalog under the current parameter. Only the rates that
+   * differ from the current ones are changed, as with updateRates. After the
+   * rates are changed:
+   *
+   * 1. Clusters with changed rates that no longer satisfy the equilibrium
+   * condition are dissolved, unless they are occupied. The others are kept
+   * and only their master equation is solved again.
+   * 2. If a catalog has been stored for the new parameter, the clusters in it
+   * are created again from the sites that are still free, hold no walkers
+   * and still satisfy the equilibrium condition. This saves finding the
+   * clusters again.
+   *
+   * The system must have been initialized and a rate family registered. The
+   * times the walkers have already drawn are left as they are, so with rate
+   * tree event selection a runtime_error is thrown if there are walkers.
+   *
+   * \param[in] parameter
+   **/
+  void setRateParameter(const double & parameter);
+  double getRateParameter() const;
+
   /**
    * \brief Initialize walker dwell times and future hop site id
    *
@@ -111,6 +288,19 @@ class KMC_CoarseGrainSystem {
    **/
   void initializeWalkers(std::vector<std::pair<int,KMC_Walker>>& walkers);
 
+  /**
+   * \brief Initialize every walker in the store
+   *
+   * The handles are used as the ids of the walkers and the dwell time of
+   * each walker is added to its time.
+   *
+   * With rejection free kinetics all of the walkers are placed before any of
+   * their dwell times are drawn, a walker with every neighbor occupied is
+   * given an infinite time. Lazy sampling is not supported with rejection
+   * free kinetics.
+   **/
+  void initializeWalkers(KMC_WalkerStore & walkers);
+
   /**
    * \brief Define the seed for the random number generator
    *
@@ -134,14 +324,119 @@ class KMC_CoarseGrainSystem {
    **/
   void hop(std::pair<const int, KMC_Walker>& walker);
   void hop(const int & walker_id, KMC_Walker& walker);
+
+  /**
+   * \brief Hop a walker held in a store
+   *
+   * The new dwell time of the walker is added to its time.
+   *
+   * With rejection free kinetics the walker must be the one with the
+   * earliest time, and the times of the walkers around the sites it left and
+   * entered are changed as well.
+   **/
+  void hop(KMC_WalkerStore & walkers, const int handle);
   //void hop(KMC_Walker& walker);
 
+  /**
+   * \brief Hop whichever walker in the store is next
+   *
+   * The walker is picked as set by setEventSelection. With rate_tree event
+   * selection walkers can only be hopped with this function, and the time
+   * of each walker in the store is the time of its last event.
+   *
+   * \return handle of the walker that hopped, or constants::unassignedId if
+   * none of the walkers can hop
+   **/
+  int hopNext(KMC_WalkerStore & walkers);
+
+  /// Time of the last event carried out by hopNext
+  double getTime() const { return event_time_; }
+
+  /**
+   * \brief Get the site the walker is located on
+   *
+   * If cluster event skipping is turned on, a walker inside a cluster is not
+   * tied to any of the sites within the cluster. Calling this function will
+   * draw the position of the walker from the probability of occupying each
+   * of the sites in the cluster and record it on the walker. For walkers that
+   * are not in a cluster the site they occupy is simply returned.
+   *
+   * \param[in] walker
+   *
+   * \return the id of the site the walker is on
+   **/
+  int samplePositionOfWalker(KMC_Walker& walker);
+
   /**
    * \brief Remove the walker from the system
    **/
   void removeWalkerFromSystem(std::pair<int,KMC_Walker>& walker);
   void removeWalkerFromSystem(int & walker_id,KMC_Walker& walker);
 
+  /**
+   * \brief Remove the walker from the system and from the store
+   *
+   * With rejection free kinetics the site is freed as of the last hop.
+   **/
+  void removeWalkerFromSystem(KMC_WalkerStore & walkers, const int handle);
+
+  /**
+   * \brief Walkers are injected onto the site at the rate given
+   *
+   * Calling it again for the same site adds to its rate. Must be called
+   * after initializeSystem. The site can not be a drain.
+   *
+   * \param[in] siteId
+   * \param[in] rate number of walkers injected per unit time
+   **/
+  void addSource(const int siteId, const double rate);
+
+  /**
+   * \brief Walkers hopping onto the site are absorbed
+   *
+   * An absorbed walker is given an infinite dwell time, so it is never hopped
+   * again by a simulation that moves the walker with the earliest time, and
+   * KMC_Walker::isAbsorbed returns true. Drains are never occupied and are
+   * never made part of a cluster. The absorbed walkers do not have to be
+   * removed, they can be passed straight back to injectWalker. Must be called
+   * after initializeSystem and before the site is occupied or made part of a
+   * cluster.
+   *
+   * \param[in] siteId
+   **/
+  void addDrain(const int siteId);
+
+  /**
+   * \brief Time until the next walker is injected by any of the sources
+   *
+   * The injections of all the sources together form a single Poisson
+   * process. Throws a runtime_error if no sources have been added.
+   **/
+  double getInjectionDwellTime();
+
+  /**
+   * \brief Place a walker onto one of the sources
+   *
+   * The source is picked in proportion to its rate. The walker may be a new
+   * one or one that has been absorbed, its id can be reused. If the site of
+   * the source is occupied the injection does not take place and is counted
+   * as blocked. The sampling times of an injected walker are measured from
+   * the time it was injected.
+   *
+   * Walkers can not be injected with rejection free kinetics.
+   *
+   * \param[in] walker_id
+   * \param[in,out] walker
+   *
+   * \return true if the walker was injected
+   **/
+  bool injectWalker(const int & walker_id, KMC_Walker & walker);
+
+  /**
+   * \brief Walkers injected by the sources and absorbed by the drains
+   **/
+  KMC_ReservoirCounts getReservoirCounts() const;
+
   /**
    * \brief Determine if the site is part of a cluster
    *
@@ -169,6 +464,169 @@ class KMC_CoarseGrainSystem {
   void setMinCoarseGrainIterationThreshold(int threshold_min);
   int getMinCoarseGrainIterationThreshold();
 
+  /**
+   * \brief The kinetics used to move the walkers
+   *
+   * coarse_grained - sites the walkers oscillate between are coarse grained
+   * into clusters. This is the default.
+   *
+   * exact - every hop between sites is simulated, as in a crude kinetic
+   * Monte Carlo simulation. None of the bookkeeping needed to coarse grain
+   * is carried out. The sites, rates and random number generators are the
+   * same as those used with coarse grained kinetics, so running the same
+   * system both ways measures the speedup gained from coarse graining.
+   *
+   * rejection_free - as exact, but walkers only ever hop onto free
+   * neighbors, so no hops are rejected. The rate each walker leaves at is the
+   * sum of the rates to its free neighbors, and is updated as the neighbors
+   * are occupied and vacated. At high densities of walkers most hops of the
+   * exact kinetics are rejected, these are skipped. The walkers must be held
+   * in a KMC_WalkerStore, hopping a KMC_Walker throws a runtime_error.
+   *
+   * Must be set before initializeSystem is called.
+   **/
+  enum Kinetics {
+    coarse_grained,
+    exact,
+    rejection_free
+  };
+
+  void setKinetics(const Kinetics kinetics);
+  Kinetics getKinetics() const { return kinetics_; }
+
+  /**
+   * \brief How hopNext picks the walker that hops next
+   *
+   * first_reaction - each walker draws its own dwell time and the walker
+   * with the earliest time hops next. This is the default.
+   *
+   * rate_tree - the rates the walkers escape at are kept in a sum tree. Each
+   * event draws a single time step from the total rate of all of the walkers
+   * and picks the walker in proportion to its rate, both in O(log N) of the
+   * number of walkers. The rate of a walker is fixed when it arrives on a
+   * site or cluster, as its dwell time is with first_reaction. Coarse
+   * grained kinetics also needs cluster event skipping, so that walkers
+   * leave clusters at the effective rate of the cluster. Rejection free
+   * kinetics is not supported.
+   *
+   * Must be set before initializeSystem is called.
+   **/
+  enum EventSelection {
+    first_reaction,
+    rate_tree
+  };
+
+  void setEventSelection(const EventSelection event_selection);
+  EventSelection getEventSelection() const { return event_selection_; }
+
+  /**
+   * \brief Sites with at least this many neighbors use a neighbor tree
+   *
+   * The rates to the neighbors of these sites are kept in a sum tree, so
+   * picking the neighbor to hop to and changing a single rate take O(log k)
+   * of the number of neighbors k instead of O(k). Below a few tens of
+   * neighbors the list the other sites use is faster. The default is 64.
+   *
+   * Must be set before initializeSystem is called.
+   **/
+  void setNeighborTreeThreshold(const int degree);
+  int getNeighborTreeThreshold() const { return neighbor_tree_threshold_; }
+
+  /**
+   * \brief Determines what triggers an attempt to coarse grain
+   *
+   * iteration_threshold - coarse graining is attempted each time the 
+   * iteration threshold is passed, at the site the walker hopped to. If no
+   * cluster is formed the threshold is doubled. This is the default.
+   *
+   * hot_spot - each time a walker hops back to the site it just left the
+   * return is counted against that site. Coarse graining is attempted at a
+   * site once the returns to it reach the hot spot threshold, so attempts are
+   * only made where walkers are oscillating. If no cluster is formed twice 
+   * as many returns are needed before the site is tried again.
+   *
+   * Setting the minimum iteration threshold to constants::inf_iterations
+   * turns coarse graining off for both triggers.
+   **/
+  enum Trigger {
+    iteration_threshold,
+    hot_spot
+  };
+
+  void setCoarseGrainTrigger(const Trigger trigger) {
+    coarse_grain_trigger_ = trigger;
+  }
+  Trigger getCoarseGrainTrigger() const { return coarse_grain_trigger_; }
+
+  /**
+   * \brief Number of returns to a site before coarse graining is attempted
+   *
+   * Only used with the hot_spot trigger, by default it is 20.
+   *
+   * \param[in] threshold
+   **/
+  void setHotSpotThreshold(int threshold);
+  int getHotSpotThreshold() const;
+
+  /**
+   * \brief Carry out coarse graining on a background thread
+   *
+   * Normally hop is stalled while the basin of a site is explored, the
+   * equilibrium condition is checked and the master equation of the new
+   * cluster is solved. When turned on, hop still explores the basin, which
+   * is cheap, but queues the basin together with a copy of its rates to a
+   * worker thread for the rest. Clusters that are ready are installed at the
+   * start of the next call to hop. Merging with existing clusters is still
+   * carried out by hop once the worker has checked the sites to merge.
+   *
+   * updateRates waits for the worker and installs its results before
+   * changing any rates. Must be set before initializeSystem is called.
+   *
+   * \param[in] asynchronous
+   **/
+  void setAsynchronousCoarseGraining(bool asynchronous);
+  bool getAsynchronousCoarseGraining() const;
+
+  /**
+   * \brief Wait for the background coarse graining to finish and install
+   * the clusters it has found
+   *
+   * Does nothing if coarse graining is not asynchronous.
+   **/
+  void synchronizeCoarseGraining();
+
+  /**
+   * \brief Determines how often the clusters are reviewed
+   *
+   * Every interval hops each of the clusters that is not occupied is 
+   * checked. A cluster is dissolved back into sites if:
+   *
+   * 1. its sites no longer satisfy the equilibrium condition, i.e. the rates
+   * have been changed. Coarse graining is then attempted from each of its
+   * sites, so the cluster may be split into smaller clusters.
+   * 2. its sites were visited fewer than the minimum cluster visits since the
+   * last review, so the cluster is not accelerating the simulation.
+   *
+   * Clusters are only considered once they have existed for a full interval.
+   * The visits to the sites of a dissolved cluster are kept. By default 
+   * the interval is constants::inf_iterations, and clusters are never
+   * reviewed.
+   *
+   * \param[in] interval
+   **/
+  void setClusterReviewInterval(int interval);
+  int getClusterReviewInterval() const { return cluster_review_interval_; }
+
+  /**
+   * \brief Visits a cluster needs per review interval to be kept
+   *
+   * By default it is 10.
+   *
+   * \param[in] visits
+   **/
+  void setMinClusterVisits(int visits);
+  int getMinClusterVisits() const { return min_cluster_visits_; }
+
 
   /**
    * @brief Return the clusters
@@ -181,6 +639,90 @@ class KMC_CoarseGrainSystem {
 
   std::unordered_map<int,double> getResolutionOfClusters();
   std::unordered_map<int,double> getTimeIncrementOfClusters();
+
+  /**
+   * \brief Return the counters and timings collected since the system was
+   * created or the statistics were last cleared
+   *
+   * These are only collected if the library is built with ENABLE_STATISTICS,
+   * see KMC_Statistics.
+   **/
+  const KMC_Statistics & getStatistics() const { return statistics_; }
+  void clearStatistics() { statistics_.clear(); }
+
+  /**
+   * \brief Coordinate of each site that displacements are measured along
+   *
+   * Once set, each hop updates the observables: the displacement of the
+   * walkers, the walker time and the crossings of the planes. A walker in a
+   * cluster is placed at the mean coordinate of the cluster, see
+   * KMC_Observables. Every site in the system must be given a coordinate.
+   * Must be called after initializeSystem.
+   *
+   * \param[in] coordinates the int is the site id, the double its coordinate
+   **/
+  void setSiteCoordinates(const std::unordered_map<int,double> & coordinates);
+
+  /**
+   * \brief Positions of the planes the crossings of the walkers are counted
+   * at
+   *
+   * \param[in] planes
+   **/
+  void setCrossingPlanes(const std::vector<double> & planes);
+
+  const KMC_Observables & getObservables() const { return observables_; }
+  void clearObservables() { observables_.clear(); }
+
+  /**
+   * \brief Estimate of the memory used by each part of the system
+   *
+   * Copies of sites sent to the background coarse graining worker are not
+   * included.
+   **/
+  KMC_MemoryUsage getMemoryUsage() const;
+
+  /**
+   * \brief Write the complete state of the system and of the walkers
+   *
+   * The checkpoint is binary and is streamed out as it is written, so no
+   * second copy of the system is made. It holds the sites, the clusters with
+   * the remaining dwell times of the walkers inside them, the visit counters,
+   * the iteration counters, the state of every random engine and the
+   * observables. Any background coarse graining is finished first.
+   *
+   * The sample observer and the rate family are functions and are not part
+   * of the checkpoint. Systems with rejection free kinetics or rate_tree
+   * event selection can not be checkpointed.
+   *
+   * \param[in] os binary stream the checkpoint is written to
+   * \param[in] walkers every walker in the system
+   **/
+  void writeCheckpoint(
+      std::ostream & os,
+      const std::vector<std::pair<int,KMC_Walker>> & walkers);
+
+  /**
+   * \brief Restore the system and the walkers from a checkpoint
+   *
+   * Must be called after initializeSystem, with the same sites and
+   * neighbors the checkpointed system was initialized with, and before any
+   * walkers are initialized. The rates the system points to are set to the
+   * values in the checkpoint. The walkers are replaced with those in the
+   * checkpoint and must not be initialized again. Continuing the restored
+   * system gives the same trajectory, bit for bit, as continuing the
+   * original. The sample observer and the rate family have to be set again.
+   *
+   * Throws a runtime_error if the system has already been coarse grained or
+   * the checkpoint does not match the system.
+   *
+   * \param[in] is binary stream holding the checkpoint
+   * \param[out] walkers the walkers as they were when checkpointed
+   **/
+  void readCheckpoint(
+      std::istream & is,
+      std::vector<std::pair<int,KMC_Walker>> & walkers);
+
   /**
    * \brief Determines how fine grained the time is allowed to be
    *
@@ -216,7 +758,64 @@ class KMC_CoarseGrainSystem {
   void setPerformanceRatio(double performance_ratio) { 
     performance_ratio_ = performance_ratio;
   }
+
+  /**
+   * @brief Skip the hops made within clusters
+   *
+   * By default a walker in a cluster moves between the sites of the cluster
+   * in time increments of the cluster resolution, so a visit to a cluster
+   * still costs approximately resolution hops. With event skipping turned on
+   * a single hop moves the walker across the whole of the cluster: the escape
+   * time is sampled in one go and the walker will next hop directly to a site
+   * neighboring the cluster. The position of the walker inside the cluster is
+   * only drawn when it is needed, either when another walker attempts to hop
+   * onto a site in the cluster or when samplePositionOfWalker is called.
+   *
+   * The escape time of a walker depends on the number of walkers in its
+   * cluster. The times of the walkers already in a cluster are rescaled when
+   * another walker enters or leaves it, so more than one walker has to be
+   * held in a KMC_WalkerStore.
+   *
+   * Must be set before initializeSystem is called.
+   *
+   * @param event_skipping
+   */
+  void setClusterEventSkipping(bool event_skipping);
+  bool getClusterEventSkipping() const { return cluster_event_skipping_; }
+
+  /**
+   * @brief Times at which the position of each walker will be sampled
+   *
+   * Providing the sampling times together with a sample observer lets the
+   * system report the position of every walker at exactly those instants. 
+   * The system keeps a clock for each walker by summing the dwell times, 
+   * when a sampling time falls within the dwell time of a walker the 
+   * observer is called. If the walker is in a cluster its site is drawn 
+   * from the probability of occupying the sites in the cluster. 
+   *
+   * Because positions within clusters are only drawn when they are sampled
+   * the clusters no longer need to be resolved to the time resolution. This
+   * allows clusters to be created and to use coarser resolutions than would
+   * otherwise be allowed by setTimeResolution.
+   *
+   * Both must be set before initializeSystem is called.
+   *
+   * @param sampling_times must be positive and in increasing order
+   */
+  void setSamplingTimes(const std::vector<double> & sampling_times);
+
+  /**
+   * @brief Function called each time a walker is sampled
+   *
+   * The observer is called with the sampling time, the id of the walker and
+   * the id of the site the walker occupies at that time. 
+   *
+   * @param observer
+   */
+  void setSampleObserver(std::function<void(double,int,int)> observer);
  private:
+  bool initialized_;
+
   /// Performance ratio
   double performance_ratio_;
 
@@ -249,6 +848,151 @@ class KMC_CoarseGrainSystem {
   /// The iteration threshold is reset to the min value if a cluster is found
   int iteration_threshold_min_;
 
+  /// What triggers an attempt to coarse grain
+  Trigger coarse_grain_trigger_;
+
+  Kinetics kinetics_;
+
+  /// Counts walkers returning to sites for the hot_spot trigger
+  std::unique_ptr<KMC_HotSpotDetector> hot_spot_detector_;
+
+  /// Sources and drains of walkers
+  std::unique_ptr<KMC_Reservoirs> reservoirs_;
+
+  /// Moves the walkers with rejection free kinetics
+  std::unique_ptr<KMC_RejectionFree> rejection_free_;
+
+  EventSelection event_selection_;
+
+  /// Rates of the walkers with rate_tree event selection
+  std::unique_ptr<KMC_RateTree> rate_tree_;
+
+  double event_time_;
+
+  /// Number of sites that are loaded as they are needed, numbered from 0
+  size_t loadable_sites_;
+
+  /// Rates of the loaded sites, only set when the rates are worked out as
+  /// sites are loaded
+  std::unique_ptr<KMC_RateCache> rate_cache_;
+
+  /// Memory of the rates passed to initializeSystem when they are not held
+  /// in a map, 0 when they are
+  size_t rate_source_memory_;
+
+  size_t rate_cache_capacity_;
+
+  /// Number of neighbors from which sites use a neighbor tree
+  int neighbor_tree_threshold_;
+
+  KMC_Statistics statistics_;
+
+  /// Carries out coarse graining in the background if it is asynchronous
+  std::unique_ptr<KMC_CoarseGrainWorker> coarse_grain_worker_;
+
+  /// Sites queued to the worker which have not been installed yet
+  std::unordered_set<int> queued_seed_sites_;
+
+  /// Number of hops between reviews of the clusters
+  int cluster_review_interval_;
+
+  /// Number of hops since the clusters were last reviewed
+  int review_iteration_;
+
+  /// Clusters with fewer visits per review interval are dissolved
+  int min_cluster_visits_;
+
+  /// Visits to the sites of each cluster at the time of the last review
+  std::unordered_map<int,int> cluster_visits_at_review_;
+
+  /// Clusters with rates that have changed since they were last solved
+  std::unordered_set<int> clusters_with_changed_rates_;
+
+  /// Walkers cross clusters in a single hop
+  bool cluster_event_skipping_;
+
+  /// Times at which walkers are reported to the sample observer
+  std::vector<double> sampling_times_;
+
+  std::function<void(double,int,int)> sample_observer_;
+
+  RateFamily rate_family_;
+  /// Sites whose rates depend on the parameter, all of them when empty
+  std::vector<int> rate_family_site_ids_;
+
+  bool rate_parameter_set_;
+  double rate_parameter_;
+
+  /// Sites making up each of the clusters, stored for each rate parameter
+  std::map<double,std::vector<std::vector<int>>> cluster_catalogs_;
+
+  std::unordered_map<int,double> site_coordinates_;
+
+  KMC_Observables observables_;
+
+  /// Coordinate of each walker as last recorded in the observables
+  std::unordered_map<int,double> walker_coordinates_;
+
+  /// Updates the observables once the walker has hopped
+  void recordObservables_(
+      const int & walker_id,
+      const KMC_Walker & walker,
+      const int & previous_siteId,
+      const double & dwell_time);
+
+  /// Coordinate of the site, or the mean coordinate of its cluster
+  double getMeanCoordinate_(const int & siteId);
+
+  /// The time each walker has spent in the system, and the index of the next
+  /// sampling time it has yet to reach
+  std::unordered_map<int,double> walker_clocks_;
+  std::unordered_map<int,size_t> walker_next_sample_;
+
+  /// Determines if positions are being sampled lazily
+  bool lazySampling_() const;
+
+  /// Reports the sampling times that fall within the current dwell time of
+  /// the walker and advances the clock of the walker
+  void sampleWalker_(const int & walker_id, KMC_Walker & walker);
+
+  /// Places the walker on its site and draws its first hop
+  void initializeWalker_(const int & walker_id, KMC_Walker & walker);
+
+  /// Forget everything recorded about the walker
+  void forgetWalker_(const int & walker_id);
+
+  /// Throws if the settings can not be used together
+  void checkSettings_() const;
+
+  /// Stores the site and lets it sample its neighbors from a tree if it has
+  /// enough of them
+  void addSite_(KMC_Site & site, const size_t number_of_neighbors);
+
+  /// Returns an empty site seeded from the system seed if one was set
+  KMC_Site newSite_();
+
+  /// Adds the drains then sets up the kinetics and event selection
+  void finishInitialization_(const std::unordered_set<int> & drain_sites);
+
+  /// Site or cluster the site belongs to, the site is loaded if needed
+  KMC_TopologyFeature * getFeature_(const int & siteId);
+
+  /// Determines if the site is part of the system, whether or not it has
+  /// been loaded
+  bool siteExists_(const int & siteId) const;
+
+  /// Sets up the rate cache and loads sites from it as they are needed
+  void initializeLoadedSites_(
+      std::function<void(const int &, std::vector<int> &, std::vector<double> &)>
+        rate_source,
+      const size_t number_of_sites);
+
+  /// Creates the site from the rates in the rate cache
+  void loadSite_(const int & siteId);
+
+  /// Drops the least recently used sites if the rate cache is full
+  void evictSites_();
+
   std::unordered_map<int, KMC_TopologyFeature *> topology_features_;
   /// Stores smart pointers to all the sites
   std::unique_ptr<KMC_Site_Container> sites_;
@@ -300,7 +1044,95 @@ class KMC_CoarseGrainSystem {
    **/
   int getFavoredClusterId_(std::vector<int> siteIds);
 
+  /// Moves the walker without any of the coarse graining bookkeeping
+  void hopExact_(const int & walker_id, KMC_Walker & walker);
+
+  /// Moves a walker held in the store onto one of its free neighbors
+  void hopRejectionFree_(KMC_WalkerStore & walkers, const int handle);
+
+  /// Moves the walker onto its potential site, coarse graining as needed
+  void hopCoarseGrained_(const int & walker_id, KMC_Walker & walker);
+
+  /// Moves the walker picked from the rate tree
+  void hopRateTree_(
+      KMC_WalkerStore & walkers,
+      const int handle,
+      const double dwell_time);
+
+  /// Rate a walker arriving on the site escapes its site or cluster at
+  double getEscapeRate_(const int & siteId);
+
+  /**
+   * \brief Resets the rate of every walker in the cluster of the site
+   *
+   * The escape rate of a cluster depends on the number of walkers in it, so
+   * the rates of the other occupants are out of date once a walker enters
+   * or leaves. All the walkers in the store are scanned, this is only done
+   * when a walker crosses the boundary of a cluster.
+   **/
+  void updateClusterEscapeRates_(
+      KMC_WalkerStore & walkers,
+      const int & siteId);
+
+  /// Throws if the rates can not be written
+  void checkRates_(
+      const std::unordered_map<int, std::unordered_map<int, double>> & rates);
+  /// Writes the rates, marking the clusters they belong to
+  void writeRates_(
+      const std::unordered_map<int, std::unordered_map<int, double>> & rates);
+  /// Determines if the rates the walker on the site escapes with are changed
+  bool ratesOfSiteChanged_(
+      const std::unordered_map<int, std::unordered_map<int, double>> & rates,
+      const int & siteId) const;
+
+  /**
+   * \brief Determines if the dwell time of the walker was drawn from the
+   * cluster its site is in
+   *
+   * Walkers that were on the sites of a cluster when it was created drew
+   * their dwell time and the site they hop to from the site.
+   **/
+  bool walkerDrewFromCluster_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId);
+  /// Escape time constant the dwell time of the walker was drawn with
+  double getTimeConstantOfWalker_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId);
+  int pickNewSiteIdOfWalker_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId);
+
+  /**
+   * \brief Scales the time left to each walker in the cluster, other than
+   * the walker that hopped
+   *
+   * With cluster event skipping the escape time of a walker is drawn in one
+   * go, so it has to be rescaled when the number of walkers in its cluster
+   * changes.
+   **/
+  void rescaleClusterOccupants_(
+      KMC_WalkerStore & walkers,
+      const int handle,
+      const int & clusterId,
+      const double & ratio,
+      const double & time);
+
   bool coarseGrain_(int siteId);
+  void attemptCoarseGrain_(const int & siteId);
+  void recordCoarseGrainOutcome_(const int & siteId, const bool success);
+  void queueCoarseGrain_(const int & siteId);
+  void installCoarseGrainResults_();
+  CoarseGrainCriteria getCoarseGrainCriteria_() const;
+  int installCluster_(KMC_Cluster & cluster);
+  void reviewClusters_();
+  void updateClusterOfSiteIfRatesChanged_(const int & siteId);
+  bool sitesSatisfyEquilibriumCondition_(const std::vector<int> & siteIds);
+  void dissolveCluster_(const int & clusterId);
+  void coarseGrainHotSpot_(const int & walker_id, const int & siteId, const int & siteToHopToId);
   std::unordered_map<int,int> getClustersOfSites(const std::vector<int> & siteIds);
   int createCluster_(std::vector<int> siteIds,double internal_time_limit);
   void mergeSitesAndClusters_(std::unordered_map<int,int> sites_and_clusters, int clusterId);
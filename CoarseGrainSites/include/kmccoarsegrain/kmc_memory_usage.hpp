@@ -0,0 +1,50 @@
+#ifndef KMCCOARSEGRAIN_KMC_MEMORY_USAGE_HPP
+#define KMCCOARSEGRAIN_KMC_MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Bytes of memory used by each part of the coarse grained system
+ *
+ * The values are estimates calculated from the sizes of the containers, they
+ * do not include overhead added by the memory allocator.
+ **/
+struct KMC_MemoryUsage {
+
+  KMC_MemoryUsage();
+
+  /// Sites and the pointers to their rates, excluding random engines
+  size_t sites;
+  /// Clusters and the copies of the sites they hold, excluding random
+  /// engines
+  size_t clusters;
+  /// Map used to look up the site or cluster a walker is on
+  size_t topology_features;
+  /// Random number engines, each site and each cluster has one
+  size_t random_engines;
+  /// Rates passed to initializeSystem, a map, rate table, rate provider or
+  /// compressed rate table. They are owned by the caller and are not included
+  /// in the total
+  size_t rate_map;
+  /// Rates of the sites loaded from a rate provider or compressed rate table,
+  /// held by the system
+  size_t rate_cache;
+  /// Walker clocks, cluster catalogs, hot spot counts and the other
+  /// bookkeeping of the system
+  size_t scratch;
+
+  /// Memory used by the system, the rate map is not included
+  size_t total() const;
+
+  /**
+   * \brief Write the memory usage as a JSON object
+   **/
+  std::string toJSON() const;
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_MEMORY_USAGE_HPP
@@ -0,0 +1,60 @@
+#ifndef KMCCOARSEGRAIN_KMC_OBSERVABLES_HPP
+#define KMCCOARSEGRAIN_KMC_OBSERVABLES_HPP
+
+#include <unordered_map>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Transport observables accumulated by the coarse grained system
+ *
+ * Displacements are measured along a coordinate assigned to each site, for
+ * example the position of the site along the applied field. A walker inside
+ * a cluster is placed at the mean coordinate of the cluster, weighted by the
+ * probability of occupying each of its sites. Hops within a cluster
+ * therefore do not displace the walker, the contribution of crossing a
+ * cluster is recorded when the walker enters and leaves it.
+ **/
+struct KMC_Observables {
+
+  KMC_Observables();
+
+  /// Net displacement of all of the walkers
+  double displacement;
+
+  /// Sum of the dwell times of all of the recorded hops
+  double walker_time;
+
+  long long hops;
+
+  /// Positions of the planes crossings are counted at
+  std::vector<double> planes;
+
+  /// Net number of times the walkers crossed each plane in the direction of
+  /// increasing coordinate
+  std::vector<long long> crossings;
+
+  /// Displacement of each walker in the system since it was first recorded
+  std::unordered_map<int,double> walker_displacements;
+
+  /**
+   * \brief Mean velocity of the walkers, the displacement divided by the
+   * walker time
+   *
+   * Dividing by the field gives the mobility.
+   **/
+  double getVelocity() const;
+
+  /**
+   * \brief Mean square displacement of the walkers in the system
+   **/
+  double getMeanSquareDisplacement() const;
+
+  /// Set all of the values back to 0, the planes are kept
+  void clear();
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_OBSERVABLES_HPP
@@ -0,0 +1,106 @@
+#ifndef KMCCOARSEGRAIN_KMC_RATE_PROVIDER_HPP
+#define KMCCOARSEGRAIN_KMC_RATE_PROVIDER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+struct KMC_CellGrid;
+struct KMC_RateModel;
+
+/**
+ * \brief Works out the rates off a site when they are asked for
+ *
+ * Only the coordinates and energies of the sites, and a grid of cells used
+ * to find the neighbors, are stored. The rates off a site are calculated
+ * each time they are asked for, so systems with far more rates than fit in
+ * memory can be simulated, see KMC_CoarseGrainSystem::initializeSystem.
+ *
+ * The neighbors and rates of each site are the same as those built by
+ * generateRateTable: every other site within the cutoff, sorted by id, and
+ * sites with no site in reach of the cutoff are connected to their nearest
+ * site in both directions.
+ **/
+class KMC_RateProvider {
+  public:
+    /**
+     * \brief Rate to hop between two sites
+     *
+     * Called with the energy of the destination minus the energy of the
+     * origin, the distance moved along x and the distance between the sites.
+     * The rate must be greater than 0.0.
+     **/
+    typedef std::function<double(double,double,double)> RateFunction;
+
+    /**
+     * \brief Store the sites and find the ones out of reach of all others
+     *
+     * Throws an invalid_argument if the coordinates and energies are not all
+     * the same length or if the cutoff is not greater than 0.
+     *
+     * \param[in] x,y,z coordinates of the sites
+     * \param[in] energies energies of the sites
+     * \param[in] cutoff largest distance between neighboring sites
+     * \param[in] rate_function
+     * \param[in] threads number of threads used to look for sites out of
+     * reach, 0 uses one per core
+     **/
+    KMC_RateProvider(
+        const std::vector<double> & x,
+        const std::vector<double> & y,
+        const std::vector<double> & z,
+        const std::vector<double> & energies,
+        const double cutoff,
+        RateFunction rate_function,
+        unsigned int threads = 0);
+
+    /// Rates are calculated with KMC_RateModel::rate
+    KMC_RateProvider(
+        const std::vector<double> & x,
+        const std::vector<double> & y,
+        const std::vector<double> & z,
+        const std::vector<double> & energies,
+        const double cutoff,
+        const KMC_RateModel & model,
+        unsigned int threads = 0);
+
+    ~KMC_RateProvider();
+
+    /// Number of sites, they are numbered from 0
+    size_t size() const { return energies_.size(); }
+
+    /**
+     * \brief Calculate the rates off the site
+     *
+     * \param[in] siteId
+     * \param[out] neighbors ids of the neighbors of the site in order
+     * \param[out] rates rate to each of the neighbors
+     **/
+    void getRatesOffSite(
+        const int & siteId,
+        std::vector<int> & neighbors,
+        std::vector<double> & rates) const;
+
+    /// Bytes of memory held by the provider
+    size_t getMemoryUsage() const;
+
+  private:
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> z_;
+    std::vector<double> energies_;
+    RateFunction rate_function_;
+    std::unique_ptr<KMC_CellGrid> grid_;
+    /// Nearest sites of the sites with no site in reach of the cutoff
+    std::unordered_map<int,std::vector<int>> extra_neighbors_;
+
+    void initialize_(const double cutoff, unsigned int threads);
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_RATE_PROVIDER_HPP
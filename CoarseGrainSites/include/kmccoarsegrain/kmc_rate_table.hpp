@@ -0,0 +1,196 @@
+#ifndef KMCCOARSEGRAIN_KMC_RATE_TABLE_HPP
+#define KMCCOARSEGRAIN_KMC_RATE_TABLE_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Rates off each site stored in compressed sparse rows
+ *
+ * Sites are numbered from 0. The neighbors of site i and the rates to them
+ * are stored from index offsets[i] up to offsets[i+1]. A neighbor with an id
+ * of size() or more has no row and is treated as a drain.
+ *
+ * This takes far less memory than the nested maps taken by
+ * KMC_CoarseGrainSystem::initializeSystem, the system can point straight at
+ * the rates held in the table.
+ **/
+struct KMC_RateTable {
+  std::vector<size_t> offsets;
+  std::vector<int> neighbors;
+  std::vector<double> rates;
+
+  /// Number of sites with a row in the table
+  size_t size() const { return offsets.empty() ? 0 : offsets.size()-1; }
+
+  /// Bytes of memory held by the table
+  size_t getMemoryUsage() const;
+};
+
+/**
+ * \brief Determines the rate between two sites
+ *
+ * Energies are in eV and distances in the same units as the coordinates of
+ * the sites.
+ **/
+struct KMC_RateModel {
+  enum Type {
+    marcus,
+    miller_abrahams
+  };
+
+  KMC_RateModel();
+
+  Type type;
+  double kT;
+  double reorganization_energy;
+  double transfer_integral;
+  /// Attempt to hop frequency used by Miller-Abrahams rates
+  double attempt_rate;
+  /// Localization length used by Miller-Abrahams rates
+  double localization_length;
+  /// Energy gained per unit distance moved along x
+  double field;
+
+  /**
+   * \brief Rate to hop between two sites
+   *
+   * Rates that are too small to be held by a double are raised to the
+   * smallest positive double, as the system does not accept rates of 0.0.
+   *
+   * \param[in] energy_difference energy of the destination minus the energy
+   * of the origin
+   * \param[in] dx distance moved along x
+   * \param[in] distance distance between the sites
+   **/
+  double rate(double energy_difference, double dx, double distance) const;
+};
+
+/**
+ * \brief Rates that obey detailed balance, stored once per pair of sites
+ *
+ * Rates that obey detailed balance satisfy
+ * k_ji = k_ij exp(-(E_i-E_j)/kT), so only the symmetric prefactor
+ * sqrt(k_ij k_ji) of each pair of sites needs to be stored along with the
+ * energies of the sites. The rate from site i to site j is rebuilt as
+ * prefactor exp(-(E_j-E_i)/(2kT)) when it is asked for.
+ *
+ * The neighbors of site i are stored in order of their ids from
+ * offsets[i] up to offsets[i+1], in both directions, as with KMC_RateTable.
+ * The prefactors of site i with the neighbors that have a larger id than it
+ * are stored from pair_offsets[i] up to pair_offsets[i+1], in the same
+ * order. Compared with a KMC_RateTable this drops one of the two rates
+ * stored for each pair, 8 of every 24 bytes.
+ *
+ * Only the table is smaller. A system initialized with the table rebuilds
+ * the full row of rates in each direction for every site it loads and
+ * holds those rows in its rate cache. Any saving in the memory of the
+ * system itself comes from loading the sites only as they are needed.
+ **/
+struct KMC_CompressedRateTable {
+  std::vector<size_t> offsets;
+  std::vector<int> neighbors;
+  std::vector<size_t> pair_offsets;
+  std::vector<double> prefactors;
+  /// Energies of the sites, including any work done by a field
+  std::vector<double> energies;
+  double kT;
+
+  KMC_CompressedRateTable() : kT(0.0) {}
+
+  /// Number of sites in the table
+  size_t size() const { return energies.size(); }
+
+  /**
+   * \brief Rebuild the rates off the site
+   *
+   * Throws an invalid_argument if the site is not in the table.
+   *
+   * \param[in] siteId
+   * \param[out] neighIds ids of the neighbors of the site in order
+   * \param[out] rates rate to each of the neighbors
+   **/
+  void getRatesOffSite(
+      const int & siteId,
+      std::vector<int> & neighIds,
+      std::vector<double> & rates) const;
+
+  /// Bytes of memory held by the table
+  size_t getMemoryUsage() const;
+};
+
+/**
+ * \brief Stores the rates of the rate table once per pair of sites
+ *
+ * Throws an invalid_argument if the offsets do not match the neighbors and
+ * rates, if a neighbor has no row, if the rate from
+ * a site to its neighbor has no matching rate back, or if a pair of rates
+ * does not obey detailed balance to within the relative tolerance.
+ *
+ * \param[in] rate_table every site must have a row
+ * \param[in] energies energies of the sites, including any work done by a
+ * field
+ * \param[in] kT
+ * \param[in] tolerance largest relative difference allowed between the
+ * ratio of the rates of a pair and the ratio given by detailed balance
+ **/
+KMC_CompressedRateTable compressRateTable(
+    const KMC_RateTable & rate_table,
+    const std::vector<double> & energies,
+    const double kT,
+    const double tolerance = 1.0E-6);
+
+/**
+ * \brief Builds the rates between every pair of sites within the cutoff
+ *
+ * The sites are binned into cells at least as wide as the cutoff, so only
+ * the surrounding cells are searched for neighbors. Sites without a site in
+ * reach of the cutoff are connected to their nearest site, in both
+ * directions, so that every site has a rate off of it. The neighbors in each
+ * row are sorted by id, so the table does not depend on the number of
+ * threads used.
+ *
+ * Throws an invalid_argument if the coordinates and energies are not all the
+ * same length or if the cutoff is not greater than 0.
+ *
+ * \param[in] x,y,z coordinates of the sites
+ * \param[in] energies energies of the sites
+ * \param[in] cutoff largest distance between neighboring sites
+ * \param[in] model used to calculate the rates
+ * \param[in] threads number of threads to use, 0 uses one per core
+ **/
+KMC_RateTable generateRateTable(
+    const std::vector<double> & x,
+    const std::vector<double> & y,
+    const std::vector<double> & z,
+    const std::vector<double> & energies,
+    const double cutoff,
+    const KMC_RateModel & model,
+    unsigned int threads = 0);
+
+/**
+ * \brief Builds the same rates as generateRateTable, stored once per pair
+ *
+ * Both of the rate models obey detailed balance, so the rates are stored as
+ * a KMC_CompressedRateTable without building the full table first. The
+ * energies stored in the table include the work done by the field, and kT
+ * is taken from the model. The rebuilt rates match those of
+ * generateRateTable to within rounding, except for rates so small that
+ * generateRateTable raises them to the smallest positive double.
+ *
+ * Throws an invalid_argument for the same reasons as generateRateTable.
+ **/
+KMC_CompressedRateTable generateCompressedRateTable(
+    const std::vector<double> & x,
+    const std::vector<double> & y,
+    const std::vector<double> & z,
+    const std::vector<double> & energies,
+    const double cutoff,
+    const KMC_RateModel & model,
+    unsigned int threads = 0);
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_RATE_TABLE_HPP
@@ -0,0 +1,34 @@
+#ifndef KMCCOARSEGRAIN_KMC_RESERVOIR_COUNTS_HPP
+#define KMCCOARSEGRAIN_KMC_RESERVOIR_COUNTS_HPP
+
+#include <unordered_map>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Walkers that have entered and left the system through reservoirs
+ *
+ * Sources inject walkers onto sites at a fixed rate, drains absorb the
+ * walkers that hop onto them. The difference between the walkers extracted
+ * over two points in time gives the steady state current.
+ **/
+struct KMC_ReservoirCounts {
+
+  KMC_ReservoirCounts();
+
+  /// Walkers placed in the system by the sources
+  long long injected;
+
+  /// Injections that did not take place as the source site was occupied
+  long long blocked_injections;
+
+  /// Walkers absorbed by all of the drains
+  long long extracted;
+
+  /// Walkers absorbed by each drain, the int is the site id of the drain
+  std::unordered_map<int,long long> extracted_at_drain;
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_RESERVOIR_COUNTS_HPP
@@ -0,0 +1,63 @@
+#ifndef KMCCOARSEGRAIN_KMC_STATISTICS_HPP
+#define KMCCOARSEGRAIN_KMC_STATISTICS_HPP
+
+#include <string>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Counters and timings collected by the coarse grained system
+ *
+ * The statistics are only collected if the library is built with the cmake
+ * option ENABLE_STATISTICS. Otherwise all of the values stay at 0 and
+ * collecting them costs nothing.
+ *
+ * Timings are given in ticks of the time stamp counter on x86, on other
+ * processors they are given in ticks of the steady clock.
+ **/
+struct KMC_Statistics {
+
+  /// Parts of the system that are timed
+  enum Phase {
+    hop,
+    coarse_grain,
+    find_basin,
+    internal_time_limit,
+    cluster_solve,
+    number_of_phases
+  };
+
+  KMC_Statistics();
+
+  /**
+   * \brief Determines if the library was built to collect statistics
+   **/
+  static bool enabled();
+
+  static std::string getPhaseName(const Phase phase);
+
+  /// Set all of the counters and timings back to 0
+  void clear();
+
+  /**
+   * \brief Write the statistics as a JSON object
+   **/
+  std::string toJSON() const;
+
+  long long hops;
+  /// Hops that could not be made because the site was occupied
+  long long rejected_hops;
+  long long cluster_entries;
+  long long cluster_exits;
+  long long coarse_grain_attempts;
+  long long coarse_grain_successes;
+  /// Sites created from the rates of a KMC_RateProvider
+  long long sites_loaded;
+
+  long long phase_calls[number_of_phases];
+  unsigned long long phase_ticks[number_of_phases];
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_STATISTICS_HPP
@@ -0,0 +1,100 @@
+#ifndef KMCCOARSEGRAIN_KMC_SUM_TREE_HPP
+#define KMCCOARSEGRAIN_KMC_SUM_TREE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Binary tree of partial sums over a list of non negative values
+ *
+ * Changing a value and finding the value a cumulative sum falls in both take
+ * O(log N). This is what is needed to pick an event in proportion to its
+ * rate when the rates of only a few events change after each one.
+ *
+ * The values are the leaves of a complete binary tree stored in a single
+ * array, the node at i has children at 2i and 2i+1 and the leaves start at
+ * the capacity. Each node is recomputed from its children rather than
+ * adjusted by the change, so rounding errors do not build up in the sums.
+ **/
+class KMC_SumTree {
+ public:
+  KMC_SumTree() : capacity_(1), nodes_(2,0.0) {}
+
+  /// Number of values that can be stored before the tree grows
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * \brief Set the value at the index, the tree grows to fit the index
+   **/
+  void set(const size_t index, const double value) {
+    assert(value>=0.0 && "Values in the sum tree can not be negative");
+    if(index>=capacity_) grow_(index+1);
+    size_t node = capacity_+index;
+    nodes_[node] = value;
+    for(node /= 2; node > 0; node /= 2){
+      nodes_[node] = nodes_[2*node]+nodes_[2*node+1];
+    }
+  }
+
+  double get(const size_t index) const {
+    return index<capacity_ ? nodes_[capacity_+index] : 0.0;
+  }
+
+  /// Sum of all of the values
+  double total() const { return nodes_[1]; }
+
+  /**
+   * \brief Index of the value the cumulative sum falls within
+   *
+   * \param[in] sum between 0 and the total
+   *
+   * \return the smallest index whose cumulative sum exceeds the sum given,
+   * the index of a value of zero is never returned unless the total is zero
+   **/
+  size_t find(double sum) const {
+    size_t node = 1;
+    while(node<capacity_){
+      // Rounding can leave the sum past the end of the values on the right
+      if(sum<nodes_[2*node] || nodes_[2*node+1]==0.0){
+        node = 2*node;
+      }else{
+        sum -= nodes_[2*node];
+        node = 2*node+1;
+      }
+    }
+    return node-capacity_;
+  }
+
+  /// Set every value to zero
+  void clear() { nodes_.assign(nodes_.size(),0.0); }
+
+  /// Bytes of memory held by the tree
+  size_t getMemoryUsage() const {
+    return sizeof(KMC_SumTree)+nodes_.capacity()*sizeof(double);
+  }
+
+ private:
+  size_t capacity_;
+  std::vector<double> nodes_;
+
+  void grow_(const size_t size) {
+    size_t capacity = capacity_;
+    while(capacity<size) capacity *= 2;
+    std::vector<double> nodes(2*capacity,0.0);
+    for(size_t index = 0; index < capacity_; ++index){
+      nodes[capacity+index] = nodes_[capacity_+index];
+    }
+    for(size_t node = capacity-1; node > 0; --node){
+      nodes[node] = nodes[2*node]+nodes[2*node+1];
+    }
+    capacity_ = capacity;
+    nodes_.swap(nodes);
+  }
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_SUM_TREE_HPP
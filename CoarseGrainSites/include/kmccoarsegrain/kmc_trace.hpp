@@ -0,0 +1,78 @@
+#ifndef KMCCOARSEGRAIN_KMC_TRACE_HPP
+#define KMCCOARSEGRAIN_KMC_TRACE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace kmccoarsegrain {
+/**
+ * \brief Binary tracing of the events carried out by the library
+ *
+ * Tracing is only compiled into the library if it is built with the cmake
+ * option ENABLE_TRACING, otherwise nothing is recorded and the calls that
+ * record events are removed.
+ *
+ * Each thread writes its records to its own ring buffer, without locking.
+ * Once a buffer is full the oldest records are overwritten. The buffers are
+ * meant to be read post-mortem, i.e. when the simulation has finished or
+ * has been stopped. They can also be read or cleared while walkers are
+ * still hopping, or while clusters are found in the background, records
+ * that are being written or overwritten as they are read are left out.
+ **/
+namespace trace {
+
+enum Event : uint32_t {
+  /// time is the dwell time of the walker on the site it hopped to
+  hop,
+  /// The site was occupied, time is the dwell time on the current site
+  rejected_hop,
+  /// site is the seed site
+  coarse_grain,
+  /// site is one of the sites of the cluster
+  cluster_created,
+  cluster_dissolved
+};
+
+struct Record {
+  uint32_t event;
+  /// Id of the walker, unassignedId if the event does not involve a walker
+  int32_t walker;
+  int32_t site;
+  double time;
+};
+
+/// Number of records kept by each thread
+const size_t capacity = 1 << 16;
+
+/**
+ * \brief Determines if the library was built with tracing
+ **/
+bool enabled();
+
+/**
+ * \brief Return the records of all threads
+ *
+ * The records of each thread are given oldest first, one thread after the
+ * other.
+ **/
+std::vector<Record> collect();
+
+/**
+ * \brief Write the records of all threads in binary
+ *
+ * The output starts with the characters KMCTRACE, followed by the size of a
+ * record and the number of records as 64 bit integers. The records follow in
+ * the same order as collect.
+ **/
+void dump(std::ostream & os);
+
+/**
+ * \brief Remove all of the records
+ **/
+void clear();
+
+}
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_TRACE_HPP
@@ -1,6 +1,7 @@
 #ifndef KMCCOARSEGRAIN_KMC_WALKER_HPP
 #define KMCCOARSEGRAIN_KMC_WALKER_HPP
 #include "kmc_constants.hpp"
+#include <limits>
 #include <list>
 #include <map>
 #include <vector>
@@ -54,6 +55,15 @@ class KMC_Walker {
    **/
   void setDwellTime(const double & dwell_time) { dwell_time_ = dwell_time; }
 
+  /**
+   * \brief Determine if the walker has been absorbed by a drain
+   *
+   * Absorbed walkers have an infinite dwell time and never hop again.
+   **/
+  bool isAbsorbed() const {
+    return dwell_time_==std::numeric_limits<double>::infinity();
+  }
+
  private:
   /// The site the walker currently resides on
   int current_site_;
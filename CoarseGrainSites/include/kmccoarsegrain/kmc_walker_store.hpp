@@ -0,0 +1,174 @@
+#ifndef KMCCOARSEGRAIN_KMC_WALKER_STORE_HPP
+#define KMCCOARSEGRAIN_KMC_WALKER_STORE_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include "kmc_constants.hpp"
+#include "kmc_walker.hpp"
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Stores all of the walkers of a simulation
+ *
+ * Each property of the walkers is kept in its own contiguous array, the
+ * arrays are indexed by the handle of the walker. A handle stays the same for
+ * as long as the walker is in the store and is used as the id of the walker
+ * by the coarse grained system. Handles of removed walkers are reused by the
+ * walkers added after them, so adding and removing walkers does not allocate
+ * once the store has grown to its largest size.
+ *
+ * The time of a walker is the time at which it will next hop. The slots of
+ * removed walkers are given an infinite time, as are walkers absorbed by a
+ * drain, so the walker to hop next is simply the one with the earliest time.
+ *
+ * Data of your own is kept in a KMC_WalkerPayload, indexed by the same
+ * handles.
+ **/
+class KMC_WalkerStore {
+ public:
+  KMC_WalkerStore();
+
+  /**
+   * \brief Add a walker to the store
+   *
+   * \param[in] siteId site the walker starts on
+   * \param[in] time time the walker is added at, its dwell time is added to
+   * it when the walker is initialized by the coarse grained system
+   *
+   * \return handle of the walker
+   **/
+  int add(const int siteId, const double time = 0.0);
+
+  /**
+   * \brief Remove the walker, its handle may then be reused
+   *
+   * The walker must first be removed from the coarse grained system. Throws
+   * an invalid_argument if the handle does not belong to a walker.
+   **/
+  void remove(const int handle);
+
+  bool contains(const int handle) const {
+    return handle>=0 && static_cast<size_t>(handle)<in_use_.size() &&
+      in_use_[handle];
+  }
+
+  /// Number of walkers in the store
+  size_t size() const { return size_; }
+
+  /// Number of slots, one past the largest handle that has been used
+  size_t capacity() const { return in_use_.size(); }
+
+  /// Make room for walkers so adding them does not allocate
+  void reserve(const size_t walkers);
+
+  /// Handles of all of the walkers in the store, in increasing order
+  std::vector<int> getHandles() const;
+
+  /**
+   * \brief Handle of the walker with the earliest time
+   *
+   * \return constants::unassignedId if the store is empty or every walker
+   * has been absorbed
+   **/
+  int getEarliest() const;
+
+  int getSite(const int handle) const {
+    assert(contains(handle));
+    return current_site_[handle];
+  }
+
+  int getPotentialSite(const int handle) const {
+    assert(contains(handle));
+    return potential_site_[handle];
+  }
+
+  double getDwellTime(const int handle) const {
+    assert(contains(handle));
+    return dwell_time_[handle];
+  }
+
+  double getTime(const int handle) const {
+    assert(contains(handle));
+    return time_[handle];
+  }
+
+  void setSite(const int handle, const int siteId) {
+    assert(contains(handle));
+    current_site_[handle] = siteId;
+  }
+
+  void setPotentialSite(const int handle, const int siteId) {
+    assert(contains(handle));
+    potential_site_[handle] = siteId;
+  }
+
+  void setDwellTime(const int handle, const double dwell_time) {
+    assert(contains(handle));
+    dwell_time_[handle] = dwell_time;
+  }
+
+  void setTime(const int handle, const double time) {
+    assert(contains(handle));
+    time_[handle] = time;
+  }
+
+  /**
+   * \brief Times of every slot, indexed by handle
+   **/
+  const std::vector<double> & getTimes() const { return time_; }
+
+  /**
+   * \brief Copy of the walker, for the functions that take a KMC_Walker
+   **/
+  KMC_Walker getWalker(const int handle) const;
+
+  /**
+   * \brief Store the site, potential site and dwell time of the walker
+   *
+   * The dwell time is added to the time of the walker.
+   **/
+  void setWalker(const int handle, const KMC_Walker & walker);
+
+ private:
+  std::vector<int> current_site_;
+  std::vector<int> potential_site_;
+  std::vector<double> dwell_time_;
+  std::vector<double> time_;
+  std::vector<char> in_use_;
+
+  /// Handles of removed walkers, the last one is reused first
+  std::vector<int> free_handles_;
+
+  size_t size_;
+};
+
+/**
+ * \brief Side table holding data of your own for each walker
+ *
+ * Indexed by the handles of a KMC_WalkerStore, grows as larger handles are
+ * used. The value of a reused handle is left as it was, reset it when the
+ * walker is added.
+ **/
+template<typename T>
+class KMC_WalkerPayload {
+ public:
+  T & operator[](const int handle) {
+    assert(handle>=0);
+    if(static_cast<size_t>(handle)>=values_.size()) values_.resize(handle+1);
+    return values_[handle];
+  }
+
+  const T & at(const int handle) const { return values_.at(handle); }
+
+  size_t size() const { return values_.size(); }
+
+ private:
+  std::vector<T> values_;
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_WALKER_STORE_HPP
@@ -0,0 +1,113 @@
+#include <cmath>
+#include <thread>
+
+#include "kmc_cell_grid.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_CellGrid buildCellGrid(
+      const double * x,
+      const double * y,
+      const double * z,
+      const size_t number_of_sites,
+      const double cutoff){
+
+    KMC_CellGrid grid;
+    grid.coordinates[0] = x;
+    grid.coordinates[1] = y;
+    grid.coordinates[2] = z;
+    grid.cutoff = cutoff;
+
+    double most_cells = max(1.0,ceil(2.0*cbrt(static_cast<double>(number_of_sites))));
+    size_t number_of_cells = 1;
+    for(int axis = 0; axis < 3; ++axis){
+      const double * position = grid.coordinates[axis];
+      double low = number_of_sites ? *min_element(position,position+number_of_sites) : 0.0;
+      double high = number_of_sites ? *max_element(position,position+number_of_sites) : 0.0;
+      double cells = min(most_cells,max(1.0,floor((high-low)/cutoff)));
+      grid.origin[axis] = low;
+      grid.cells[axis] = static_cast<int>(cells);
+      // Cells are never narrower than the cutoff
+      grid.width[axis] = max(cutoff,(high-low)/cells);
+      number_of_cells *= grid.cells[axis];
+    }
+
+    vector<size_t> cell_of_site(number_of_sites);
+    grid.begin.assign(number_of_cells+1,0);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      size_t cell = grid.cellAlong(0,x[siteId])+
+        static_cast<size_t>(grid.cells[0])*(grid.cellAlong(1,y[siteId])+
+        static_cast<size_t>(grid.cells[1])*grid.cellAlong(2,z[siteId]));
+      cell_of_site[siteId] = cell;
+      ++grid.begin[cell+1];
+    }
+    for(size_t cell = 0; cell < number_of_cells; ++cell){
+      grid.begin[cell+1] += grid.begin[cell];
+    }
+    grid.sites.resize(number_of_sites);
+    vector<size_t> next(grid.begin.begin(),grid.begin.end()-1);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      grid.sites[next[cell_of_site[siteId]]++] = static_cast<int>(siteId);
+    }
+    return grid;
+  }
+
+  vector<pair<int,int>> linkIsolatedSites(
+      const KMC_CellGrid & grid,
+      const vector<size_t> & in_reach){
+
+    const size_t number_of_sites = in_reach.size();
+    vector<pair<int,int>> links;
+    vector<bool> connected(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      connected[siteId] = in_reach[siteId]>0;
+    }
+    const double narrowest = min(grid.width[0],min(grid.width[1],grid.width[2]));
+    const int widest = max(grid.cells[0],max(grid.cells[1],grid.cells[2]));
+    // These are rare so they are found in serial
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      if(connected[siteId]) continue;
+      int nearest = -1;
+      double nearest_distance = 0.0;
+      for(int reach = 1; reach <= widest; ++reach){
+        grid.visitCells(siteId,reach,[&](const int neighId){
+          if(static_cast<size_t>(neighId)==siteId) return;
+          double distance = grid.distanceSquared(siteId,neighId);
+          if(nearest==-1 || distance<nearest_distance){
+            nearest = neighId;
+            nearest_distance = distance;
+          }
+        });
+        // Sites in cells that have not been searched are further away
+        if(nearest!=-1 && sqrt(nearest_distance)<=reach*narrowest) break;
+      }
+      // A lone site has nothing to connect to
+      if(nearest==-1) continue;
+      links.push_back(pair<int,int>(static_cast<int>(siteId),nearest));
+      links.push_back(pair<int,int>(nearest,static_cast<int>(siteId)));
+      connected[siteId] = true;
+      connected[nearest] = true;
+    }
+    return links;
+  }
+
+  void parallelFor(
+      const size_t count,
+      const unsigned int threads,
+      const function<void(size_t,size_t)> & body){
+
+    if(threads<=1 || count<2*static_cast<size_t>(threads)){
+      body(0,count);
+      return;
+    }
+    size_t block = (count+threads-1)/threads;
+    vector<thread> workers;
+    for(size_t begin = 0; begin < count; begin += block){
+      workers.push_back(thread(body,begin,min(count,begin+block)));
+    }
+    for(thread & worker : workers) worker.join();
+  }
+
+}
@@ -0,0 +1,119 @@
+#ifndef KMCCOARSEGRAIN_KMC_CELL_GRID_HPP
+#define KMCCOARSEGRAIN_KMC_CELL_GRID_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Sites binned into a grid of cells at least as wide as the cutoff
+ *
+ * Only the cells surrounding a site have to be searched for the sites within
+ * the cutoff of it. The sites in cell c are stored from begin[c] up to
+ * begin[c+1], in order of their ids. The grid points at the coordinates it
+ * was built from, they must outlive it.
+ **/
+struct KMC_CellGrid {
+  const double * coordinates[3];
+  double cutoff;
+  double origin[3];
+  double width[3];
+  int cells[3];
+  std::vector<size_t> begin;
+  std::vector<int> sites;
+
+  int cellAlong(const int axis, const double position) const {
+    int cell = static_cast<int>((position-origin[axis])/width[axis]);
+    return std::min(cells[axis]-1,std::max(0,cell));
+  }
+
+  double distanceSquared(const size_t siteId, const int neighId) const {
+    double distance = 0.0;
+    for(int axis = 0; axis < 3; ++axis){
+      double difference = coordinates[axis][neighId]-coordinates[axis][siteId];
+      distance += difference*difference;
+    }
+    return distance;
+  }
+
+  /// Calls the visitor with every site in the cells up to reach cells away
+  /// from the cell holding the site
+  template<typename Visitor>
+  void visitCells(const size_t siteId, const int reach, Visitor visitor) const {
+    int center[3];
+    for(int axis = 0; axis < 3; ++axis){
+      center[axis] = cellAlong(axis,coordinates[axis][siteId]);
+    }
+    for(int kz = std::max(0,center[2]-reach);
+        kz <= std::min(cells[2]-1,center[2]+reach); ++kz){
+      for(int ky = std::max(0,center[1]-reach);
+          ky <= std::min(cells[1]-1,center[1]+reach); ++ky){
+        for(int kx = std::max(0,center[0]-reach);
+            kx <= std::min(cells[0]-1,center[0]+reach); ++kx){
+          size_t cell = kx+static_cast<size_t>(cells[0])*(ky+
+              static_cast<size_t>(cells[1])*kz);
+          for(size_t index = begin[cell]; index < begin[cell+1]; ++index){
+            visitor(sites[index]);
+          }
+        }
+      }
+    }
+  }
+
+  /// Calls the visitor with every other site within the cutoff of the site
+  template<typename Visitor>
+  void visitNeighbors(const size_t siteId, Visitor visitor) const {
+    const double cutoff_squared = cutoff*cutoff;
+    visitCells(siteId,1,[&](const int neighId){
+      if(static_cast<size_t>(neighId)==siteId) return;
+      if(distanceSquared(siteId,neighId)<=cutoff_squared) visitor(neighId);
+    });
+  }
+};
+
+/**
+ * \brief Bins the sites into cells
+ *
+ * The number of cells is kept in proportion to the number of sites when the
+ * sites are spread thinly.
+ **/
+KMC_CellGrid buildCellGrid(
+    const double * x,
+    const double * y,
+    const double * z,
+    const size_t number_of_sites,
+    const double cutoff);
+
+/**
+ * \brief Links each site with no other site within the cutoff to its
+ * nearest site
+ *
+ * The links are returned in both directions, the first int is the site the
+ * rate is off of. Sites that have already been linked are not linked again,
+ * so the links do not depend on anything but the order of the site ids.
+ *
+ * \param[in] grid
+ * \param[in] in_reach number of sites within the cutoff of each site
+ **/
+std::vector<std::pair<int,int>> linkIsolatedSites(
+    const KMC_CellGrid & grid,
+    const std::vector<size_t> & in_reach);
+
+/**
+ * \brief Splits the indices from 0 to count into one block per thread
+ *
+ * The body is called with the first index of the block and one past its
+ * last index.
+ **/
+void parallelFor(
+    const size_t count,
+    const unsigned int threads,
+    const std::function<void(size_t,size_t)> & body);
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_CELL_GRID_HPP
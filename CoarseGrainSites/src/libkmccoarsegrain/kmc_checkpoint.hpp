@@ -0,0 +1,238 @@
+#ifndef KMCCOARSEGRAIN_KMC_CHECKPOINT_HPP
+#define KMCCOARSEGRAIN_KMC_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Binary checkpoints of the coarse grained system
+ *
+ * Values are written in the byte order of the machine, a checkpoint is meant
+ * to be restarted on the same kind of machine it was written on.
+ *
+ * Unordered containers are written along with their bucket count. The reader
+ * rebuilds them with the same bucket count and inserts the elements in
+ * reverse, which with the standard library the project is built against
+ * gives back the original iteration order. Iteration order decides the order
+ * floating point sums are taken in, so it is needed for a restarted run to be
+ * bit for bit the same as the original.
+ **/
+namespace checkpoint {
+
+static const char magic[8] = {'K','M','C','C','K','P','T','\0'};
+static const uint32_t version = 1;
+
+/**
+ * \brief Writes values straight to the stream
+ *
+ * Nothing is buffered, so writing a checkpoint does not need a second copy of
+ * the system in memory.
+ **/
+class Writer {
+  public:
+    explicit Writer(std::ostream & os) : os_(os) {}
+
+    void writeHeader() {
+      os_.write(magic,sizeof(magic));
+      write(version);
+    }
+
+    void writeSize(const size_t size) { write(static_cast<uint64_t>(size)); }
+
+    template<typename T>
+    void write(const T & value) {
+      static_assert(std::is_trivially_copyable<T>::value,
+          "Only trivially copyable values can be written directly");
+      os_.write(reinterpret_cast<const char *>(&value),sizeof(T));
+      if(!os_) throw std::runtime_error("Unable to write the checkpoint");
+    }
+
+    void write(const std::string & value) {
+      writeSize(value.size());
+      os_.write(value.data(),static_cast<std::streamsize>(value.size()));
+      if(!os_) throw std::runtime_error("Unable to write the checkpoint");
+    }
+
+    /// The engine is written in its text form, which is its full state
+    void write(const std::mt19937 & engine) {
+      std::ostringstream state;
+      state << engine;
+      write(state.str());
+    }
+
+    template<typename A, typename B>
+    void write(const std::pair<A,B> & value) {
+      write(value.first);
+      write(value.second);
+    }
+
+    template<typename T>
+    void write(const std::vector<T> & values) {
+      writeSize(values.size());
+      for(const T & value : values) write(value);
+    }
+
+    template<typename K, typename V>
+    void write(const std::map<K,V> & values) {
+      writeSize(values.size());
+      for(const std::pair<const K,V> & value : values) write(value);
+    }
+
+    template<typename K, typename V>
+    void write(const std::unordered_map<K,V> & values) {
+      writeSize(values.bucket_count());
+      writeSize(values.size());
+      for(const std::pair<const K,V> & value : values) write(value);
+    }
+
+    template<typename K>
+    void write(const std::unordered_set<K> & values) {
+      writeSize(values.bucket_count());
+      writeSize(values.size());
+      for(const K & value : values) write(value);
+    }
+
+  private:
+    std::ostream & os_;
+};
+
+/**
+ * \brief Reads values written by the Writer
+ *
+ * Throws a runtime_error if the stream ends early or was not written by the
+ * Writer.
+ **/
+class Reader {
+  public:
+    explicit Reader(std::istream & is) : is_(is) {}
+
+    void readHeader() {
+      char header[sizeof(magic)];
+      is_.read(header,sizeof(header));
+      if(!is_ || std::memcmp(header,magic,sizeof(magic))!=0){
+        throw std::runtime_error("The stream does not contain a checkpoint of "
+            "the coarse grained system");
+      }
+      uint32_t checkpoint_version;
+      read(checkpoint_version);
+      if(checkpoint_version!=version){
+        throw std::runtime_error("The checkpoint was written by an "
+            "incompatible version of the library");
+      }
+    }
+
+    size_t readSize() {
+      uint64_t size;
+      read(size);
+      return static_cast<size_t>(size);
+    }
+
+    template<typename T>
+    void read(T & value) {
+      static_assert(std::is_trivially_copyable<T>::value,
+          "Only trivially copyable values can be read directly");
+      is_.read(reinterpret_cast<char *>(&value),sizeof(T));
+      check_();
+    }
+
+    void read(std::string & value) {
+      value.resize(readSize());
+      is_.read(&value[0],static_cast<std::streamsize>(value.size()));
+      check_();
+    }
+
+    void read(std::mt19937 & engine) {
+      std::string text;
+      read(text);
+      std::istringstream state(text);
+      state >> engine;
+      if(!state) throw std::runtime_error("Checkpoint contains a corrupt "
+          "random engine");
+    }
+
+    template<typename A, typename B>
+    void read(std::pair<A,B> & value) {
+      read(value.first);
+      read(value.second);
+    }
+
+    template<typename T>
+    void read(std::vector<T> & values) {
+      values.resize(readSize());
+      for(T & value : values) read(value);
+    }
+
+    template<typename K, typename V>
+    void read(std::map<K,V> & values) {
+      values.clear();
+      size_t size = readSize();
+      for(size_t index = 0; index < size; ++index){
+        std::pair<K,V> value;
+        read(value);
+        values.insert(values.end(),std::move(value));
+      }
+    }
+
+    template<typename K, typename V>
+    void read(std::unordered_map<K,V> & values) {
+      size_t bucket_count = readSize();
+      std::vector<std::pair<K,V>> elements(readSize());
+      for(std::pair<K,V> & element : elements) read(element);
+      rebuild(values,bucket_count,elements);
+    }
+
+    template<typename K>
+    void read(std::unordered_set<K> & values) {
+      size_t bucket_count = readSize();
+      std::vector<K> elements(readSize());
+      for(K & element : elements) read(element);
+      rebuild(values,bucket_count,elements);
+    }
+
+    /**
+     * \brief Fills an unordered container so it iterates over the elements
+     * in the order given
+     *
+     * \param[in] bucket_count the bucket count of the container the elements
+     * were written from
+     **/
+    template<typename Container, typename Element>
+    static void rebuild(
+        Container & container,
+        const size_t bucket_count,
+        std::vector<Element> & elements) {
+
+      container = Container();
+      if(bucket_count>1) container.rehash(bucket_count);
+      for(auto element = elements.rbegin(); element != elements.rend(); ++element){
+        container.insert(std::move(*element));
+      }
+    }
+
+  private:
+    std::istream & is_;
+
+    void check_() {
+      if(!is_) throw std::runtime_error("The checkpoint ended unexpectedly");
+    }
+};
+
+}
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_CHECKPOINT_HPP
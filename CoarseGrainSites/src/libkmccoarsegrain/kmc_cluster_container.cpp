@@ -2,6 +2,8 @@
 #include <unordered_map>
 
 #include "kmc_cluster_container.hpp"
+#include "kmc_checkpoint.hpp"
+#include "kmc_memory.hpp"
 
 using namespace std;
 
@@ -132,5 +134,46 @@ namespace kmccoarsegrain {
     return clusters;
   }
 
-}
+  size_t KMC_Cluster_Container::getMemoryUsage() const {
+    size_t usage = memory::heapUsage(clusters_);
+    for(const pair<const int,KMC_Cluster> & cluster : clusters_){
+      usage += cluster.second.getMemoryUsage()-sizeof(KMC_Cluster);
+    }
+    return usage;
+  }
+
+  size_t KMC_Cluster_Container::getNumberOfSitesInClusters() const {
+    size_t sites = 0;
+    for(const pair<const int,KMC_Cluster> & cluster : clusters_){
+      sites += static_cast<size_t>(cluster.second.getNumberOfSitesInCluster());
+    }
+    return sites;
+  }
 
+
+  void KMC_Cluster_Container::writeCheckpoint(checkpoint::Writer & writer) const {
+    writer.write(KMC_Cluster::getNextClusterId());
+    writer.writeSize(clusters_.bucket_count());
+    writer.writeSize(clusters_.size());
+    for(const pair<const int,KMC_Cluster> & cluster : clusters_){
+      cluster.second.writeCheckpoint(writer);
+    }
+  }
+
+  void KMC_Cluster_Container::readCheckpoint(
+      checkpoint::Reader & reader,
+      KMC_Site_Container & sites) {
+
+    int next_cluster_id;
+    reader.read(next_cluster_id);
+    size_t bucket_count = reader.readSize();
+    vector<pair<int,KMC_Cluster>> clusters(reader.readSize());
+    for(pair<int,KMC_Cluster> & cluster : clusters){
+      cluster.second.readCheckpoint(reader,sites);
+      cluster.first = cluster.second.getId();
+    }
+    checkpoint::Reader::rebuild(clusters_,bucket_count,clusters);
+    KMC_Cluster::reserveClusterIds(next_cluster_id);
+  }
+
+}
@@ -41,6 +41,17 @@ class KMC_Cluster_Container {
     std::unordered_map<int,double> getTimeIncrementOfClusters();
     std::unordered_map<int,std::vector<int>> getSiteIdsOfClusters();
 
+    /// Bytes of memory used by the container and the clusters
+    size_t getMemoryUsage() const;
+    /// Total number of sites held by all of the clusters
+    size_t getNumberOfSitesInClusters() const;
+
+    /// Writes the state of every cluster
+    void writeCheckpoint(checkpoint::Writer & writer) const;
+    /// Replaces the clusters with those in the checkpoint, the sites of the
+    /// clusters are copied from the site container
+    void readCheckpoint(checkpoint::Reader & reader, KMC_Site_Container & sites);
+
   private:
     std::unordered_map<int,KMC_Cluster> clusters_;
 
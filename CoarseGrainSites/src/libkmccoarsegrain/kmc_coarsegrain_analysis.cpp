@@ -0,0 +1,136 @@
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "kmc_coarsegrain_analysis.hpp"
+#include "kmc_graph_library_adapter.hpp"
+#include "log.hpp"
+
+#include "../../../UGLY/include/ugly/pair_hash.hpp"
+#include "../../../UGLY/include/ugly/edge_directed_weighted.hpp"
+#include "../../../UGLY/include/ugly/graph.hpp"
+#include "../../../UGLY/include/ugly/graph_algorithms.hpp"
+#include "../../../UGLY/include/ugly/graph_node.hpp"
+
+using namespace std;
+using namespace ugly;
+using namespace ugly::graphalgorithms;
+
+namespace kmccoarsegrain {
+
+  double getInternalTimeLimit(
+      KMC_Site_Container & sites,
+      const vector<int> & siteIds){
+
+    LOG("Getting the internal time limit of a cluster", 1);
+
+    auto nodes = convertSitesToEmptySharedNodes(siteIds);
+
+    unordered_map<int, weak_ptr<GraphNode<string>>> nodes_weak;
+    for (auto node_iter : nodes) nodes_weak[node_iter.first] = node_iter.second;
+
+    auto edges = convertSitesOutgoingRatesToTimeSharedWeightedEdges<vector<shared_ptr<Edge>>>(
+        sites,
+        siteIds);
+
+    list<weak_ptr<Edge>> edges_weak(edges.begin(), edges.end());
+
+    auto graph_ptr =
+      shared_ptr<Graph<string>>(new Graph<string>(edges_weak, nodes_weak));
+
+    unordered_map<pair<int, int>, double,hash_functions::hash> verticesAndtimes =
+      maxMinimumDistanceBetweenEveryVertex<string>(*graph_ptr);
+
+    double maxtime = 0.0;
+    for (auto verticesAndTime : verticesAndtimes) {
+      if (verticesAndTime.second > maxtime) maxtime = verticesAndTime.second;
+    }
+    return maxtime;
+  }
+
+  double getTimeConstantFromSitesToNeighbors(
+      KMC_Site_Container & sites,
+      const vector<int> & siteIds){
+
+    LOG("Get the minimum time constant", 1);
+    set<int> internalSiteIds(siteIds.begin(), siteIds.end());
+
+    double sumRates = 0.0;
+    for (const int & siteId : siteIds) {
+      vector<int> neighborSiteIds = sites.getSiteIdsOfNeighbors(siteId);
+      for (const int & neighId : neighborSiteIds) {
+        if (!internalSiteIds.count(neighId)) {
+          sumRates+= sites.getRateToNeighborOfSite(siteId,neighId);
+        }
+      }
+    }
+    if (sumRates == 0.0){
+      return 0.0;
+    }
+    return 1.0/sumRates;
+  }
+
+  // Its not worth creating a cluster unless the time is at least cut in half
+  // And it is not allowed if the sample time is smaller than than the simulated
+  // time of the cluster. The cluster has to be updated at a minimum once between
+  // each measurment (time_resolution). If this is not done the noise will not
+  // correctly show up in the data.
+  // The number 25 is the ratio needed between hops within the cluster to hops
+  // outside of the cluster in order to see performance gains.
+  bool sitesSatisfyEquilibriumCondition(
+      KMC_Site_Container & sites,
+      const vector<int> & siteIds,
+      double internal_time_limit,
+      const CoarseGrainCriteria & criteria){
+
+    LOG("Checking if sites satisfy equilibrium condition", 1);
+    double timeConstant = getTimeConstantFromSitesToNeighbors(sites,siteIds);
+    double time_to_traverse_cluster =
+      internal_time_limit*criteria.minimum_coarse_graining_resolution;
+    if(criteria.lazy_sampling){
+      return timeConstant > time_to_traverse_cluster*criteria.performance_ratio;
+    }
+    return timeConstant > time_to_traverse_cluster*criteria.performance_ratio &&
+      time_to_traverse_cluster< criteria.time_resolution;// && ratio>25;
+  }
+
+  void setUpCluster(
+      KMC_Cluster & cluster,
+      vector<KMC_Site> & sites,
+      double internal_time_limit,
+      const CoarseGrainCriteria & criteria){
+
+    cluster.setConvergenceMethod(KMC_Cluster::Method::converge_by_tolerance);
+    cluster.setConvergenceTolerance(0.001);
+    cluster.setEventSkipping(criteria.event_skipping);
+    cluster.addSites(sites);
+    cluster.updateProbabilitiesAndTimeConstant();
+
+    cluster.setResolution(chooseResolution(
+          cluster.getTimeConstant(),
+          internal_time_limit,
+          criteria));
+  }
+
+  double chooseResolution(
+      double cluster_time_const,
+      double internal_time_limit,
+      const CoarseGrainCriteria & criteria){
+
+    // Cut the resolution in half from what it would otherwise be otherwise not worth doing
+    double res = cluster_time_const/(2*internal_time_limit);
+    double allowed_resolution = cluster_time_const/criteria.time_resolution;
+    double chosen_resolution = res;
+
+    // The coarser the resolution is the better, positions only have to be
+    // resolved to the time resolution if they are not sampled lazily
+    if(!criteria.lazy_sampling && allowed_resolution < chosen_resolution){
+      chosen_resolution=allowed_resolution;
+    }
+
+    if(chosen_resolution<2.0) chosen_resolution=2.0;
+    return chosen_resolution;
+  }
+}
@@ -0,0 +1,73 @@
+#ifndef KMCCOARSEGRAIN_KMC_COARSEGRAIN_ANALYSIS_HPP
+#define KMCCOARSEGRAIN_KMC_COARSEGRAIN_ANALYSIS_HPP
+
+#include <vector>
+
+#include "kmc_site_container.hpp"
+#include "topologyfeatures/kmc_cluster.hpp"
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Settings of the coarse grained system used to decide if sites are
+ * worth coarse graining and how the resulting cluster is set up
+ *
+ * A copy is taken so the analysis can be carried out away from the system,
+ * i.e. by the background coarse graining worker.
+ **/
+struct CoarseGrainCriteria {
+  double performance_ratio;
+  double time_resolution;
+  int minimum_coarse_graining_resolution;
+  /// Positions are sampled lazily, clusters need not resolve time_resolution
+  bool lazy_sampling;
+  bool event_skipping;
+};
+
+/**
+ * \brief The longest of the shortest times needed to cross between any two
+ * of the sites
+ **/
+double getInternalTimeLimit(
+    KMC_Site_Container & sites,
+    const std::vector<int> & siteIds);
+
+/**
+ * \brief Time constant calculated from the rates off the sites to sites
+ * that are not in siteIds
+ **/
+double getTimeConstantFromSitesToNeighbors(
+    KMC_Site_Container & sites,
+    const std::vector<int> & siteIds);
+
+/**
+ * \brief Determines if the sites equilibrate fast enough, compared to the
+ * rates off of them, for it to be worth coarse graining them
+ **/
+bool sitesSatisfyEquilibriumCondition(
+    KMC_Site_Container & sites,
+    const std::vector<int> & siteIds,
+    double internal_time_limit,
+    const CoarseGrainCriteria & criteria);
+
+/**
+ * \brief Adds the sites to the cluster, solves the master equation and
+ * chooses the resolution of the cluster
+ **/
+void setUpCluster(
+    KMC_Cluster & cluster,
+    std::vector<KMC_Site> & sites,
+    double internal_time_limit,
+    const CoarseGrainCriteria & criteria);
+
+/**
+ * \brief Resolution of a cluster with the time constant, also used when the
+ * cluster is solved again after its rates change
+ **/
+double chooseResolution(
+    double cluster_time_const,
+    double internal_time_limit,
+    const CoarseGrainCriteria & criteria);
+}
+
+#endif // KMCCOARSEGRAIN_KMC_COARSEGRAIN_ANALYSIS_HPP
@@ -0,0 +1,137 @@
+#include "kmc_coarsegrain_worker.hpp"
+#include "kmc_trace_buffer.hpp"
+#include "../../include/kmccoarsegrain/kmc_constants.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_CoarseGrainWorker::KMC_CoarseGrainWorker() :
+    results_ready_(false),
+    busy_(0),
+    stop_(false),
+    thread_(&KMC_CoarseGrainWorker::run_,this) {}
+
+  KMC_CoarseGrainWorker::~KMC_CoarseGrainWorker(){
+    {
+      lock_guard<mutex> lock(mutex_);
+      stop_ = true;
+    }
+    task_ready_.notify_all();
+    thread_.join();
+  }
+
+  void KMC_CoarseGrainWorker::submit(
+      unique_ptr<CoarseGrainSnapshot> snapshot,
+      const CoarseGrainCriteria & criteria){
+    {
+      lock_guard<mutex> lock(mutex_);
+      Task task;
+      task.snapshot = move(snapshot);
+      task.criteria = criteria;
+      tasks_.push_back(move(task));
+    }
+    task_ready_.notify_one();
+  }
+
+  vector<CoarseGrainResult> KMC_CoarseGrainWorker::collectResults(){
+    vector<CoarseGrainResult> results;
+    if(!results_ready_.load(memory_order_acquire)) return results;
+    lock_guard<mutex> lock(mutex_);
+    results.swap(results_);
+    results_ready_.store(false,memory_order_relaxed);
+    return results;
+  }
+
+  void KMC_CoarseGrainWorker::waitUntilIdle(){
+    unique_lock<mutex> lock(mutex_);
+    idle_.wait(lock,[this]{ return tasks_.empty() && busy_==0; });
+  }
+
+  size_t KMC_CoarseGrainWorker::pending(){
+    lock_guard<mutex> lock(mutex_);
+    return tasks_.size()+busy_;
+  }
+
+  void KMC_CoarseGrainWorker::run_(){
+    while(true){
+      Task task;
+      {
+        unique_lock<mutex> lock(mutex_);
+        task_ready_.wait(lock,[this]{ return stop_ || !tasks_.empty(); });
+        if(stop_) return;
+        task = move(tasks_.front());
+        tasks_.pop_front();
+        ++busy_;
+      }
+
+      CoarseGrainResult result = analyseSeedSite(
+          move(task.snapshot),
+          task.criteria);
+
+      {
+        lock_guard<mutex> lock(mutex_);
+        results_.push_back(move(result));
+        results_ready_.store(true,memory_order_release);
+        --busy_;
+      }
+      idle_.notify_all();
+    }
+  }
+
+  CoarseGrainResult analyseSeedSite(
+      unique_ptr<CoarseGrainSnapshot> snapshot,
+      const CoarseGrainCriteria & criteria){
+
+    const int seed_site_id = snapshot->seed_site_id;
+    KMC_TRACE(coarse_grain,constants::unassignedId,seed_site_id,0.0);
+    CoarseGrainResult result;
+    result.seed_site_id = seed_site_id;
+    result.success = false;
+    result.internal_time_limit = 0.0;
+
+    KMC_Site_Container sites;
+    for(pair<const int,SiteSnapshot> & site_snapshot : snapshot->sites){
+      vector<pair<int,double *>> neigh_rates;
+      for(pair<int,double> & neigh_rate : site_snapshot.second.rates){
+        neigh_rates.push_back(
+            pair<int,double *>(neigh_rate.first,&neigh_rate.second));
+      }
+      KMC_Site site;
+      site.setId(site_snapshot.first);
+      site.setRatesToNeighbors(neigh_rates);
+      site.setClusterId(site_snapshot.second.cluster_id);
+      sites.addKMC_Site(site);
+    }
+    result.basin_site_ids = snapshot->basin_site_ids;
+
+    result.internal_time_limit = getInternalTimeLimit(sites,result.basin_site_ids);
+    if(!sitesSatisfyEquilibriumCondition(
+          sites,
+          result.basin_site_ids,
+          result.internal_time_limit,
+          criteria)){
+      return result;
+    }
+    result.success = true;
+
+    bool free_sites = true;
+    vector<KMC_Site> basin_sites;
+    for(const int & siteId : result.basin_site_ids){
+      result.sites_and_clusters[siteId] = sites.getClusterIdOfSite(siteId);
+      if(sites.partOfCluster(siteId)) free_sites = false;
+      basin_sites.push_back(sites.getKMC_Site(siteId));
+    }
+
+    if(free_sites){
+      result.cluster = unique_ptr<KMC_Cluster>(new KMC_Cluster);
+      setUpCluster(
+          *result.cluster,
+          basin_sites,
+          result.internal_time_limit,
+          criteria);
+      result.snapshot = move(snapshot);
+    }
+    return result;
+  }
+}
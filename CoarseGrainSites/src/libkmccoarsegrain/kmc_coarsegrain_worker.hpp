@@ -0,0 +1,125 @@
+#ifndef KMCCOARSEGRAIN_KMC_COARSEGRAIN_WORKER_HPP
+#define KMCCOARSEGRAIN_KMC_COARSEGRAIN_WORKER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "kmc_coarsegrain_analysis.hpp"
+#include "kmc_site_container.hpp"
+#include "topologyfeatures/kmc_cluster.hpp"
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Rates off a site copied for the worker
+ **/
+struct SiteSnapshot {
+  int cluster_id;
+  std::vector<std::pair<int,double>> rates;
+};
+
+/**
+ * \brief Values the worker needs to analyse the basin of a seed site
+ *
+ * Only the ids and rates of the basin sites are copied, the basin explorer
+ * gives up after a handful of sites so there are never many.
+ **/
+struct CoarseGrainSnapshot {
+  int seed_site_id;
+  std::vector<int> basin_site_ids;
+  std::unordered_map<int,SiteSnapshot> sites;
+};
+
+/**
+ * \brief Outcome of analysing a seed site on the worker
+ **/
+struct CoarseGrainResult {
+  int seed_site_id;
+  /// The basin satisfied the equilibrium condition
+  bool success;
+  std::vector<int> basin_site_ids;
+  /// Cluster id of each basin site at the time the snapshot was taken
+  std::unordered_map<int,int> sites_and_clusters;
+  double internal_time_limit;
+  /// Ready to install cluster, only built if none of the basin sites were
+  /// part of a cluster
+  std::unique_ptr<KMC_Cluster> cluster;
+  /// Rates the cluster points to until it is linked to the owner's sites
+  std::unique_ptr<CoarseGrainSnapshot> snapshot;
+};
+
+/**
+ * \brief Carries out coarse graining analysis on a background thread
+ *
+ * Each task consists of the basin of a seed site, found by the owner, and a
+ * snapshot of the rates of the basin sites. The worker checks the
+ * equilibrium condition and, if the basin consists of free sites only,
+ * builds and solves the cluster. The results are collected by the owner at
+ * a point where it is safe to change the system.
+ **/
+class KMC_CoarseGrainWorker {
+  public:
+    KMC_CoarseGrainWorker();
+    ~KMC_CoarseGrainWorker();
+
+    /**
+     * \brief Queue a seed site to be analysed
+     **/
+    void submit(
+        std::unique_ptr<CoarseGrainSnapshot> snapshot,
+        const CoarseGrainCriteria & criteria);
+
+    /**
+     * \brief Take the results that are ready, does not block
+     *
+     * Does not lock either if there are none, it is called between events.
+     **/
+    std::vector<CoarseGrainResult> collectResults();
+
+    /**
+     * \brief Block until all of the queued tasks have been analysed
+     **/
+    void waitUntilIdle();
+
+    /**
+     * \brief Number of tasks queued or being analysed
+     **/
+    size_t pending();
+
+  private:
+    struct Task {
+      std::unique_ptr<CoarseGrainSnapshot> snapshot;
+      CoarseGrainCriteria criteria;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable task_ready_;
+    std::condition_variable idle_;
+    std::deque<Task> tasks_;
+    std::vector<CoarseGrainResult> results_;
+    std::atomic<bool> results_ready_;
+    size_t busy_;
+    bool stop_;
+    std::thread thread_;
+
+    void run_();
+};
+
+/**
+ * \brief Analyses the basin using only the rates in the snapshot
+ *
+ * If a cluster is built the snapshot is handed over to the result.
+ **/
+CoarseGrainResult analyseSeedSite(
+    std::unique_ptr<CoarseGrainSnapshot> snapshot,
+    const CoarseGrainCriteria & criteria);
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_COARSEGRAIN_WORKER_HPP
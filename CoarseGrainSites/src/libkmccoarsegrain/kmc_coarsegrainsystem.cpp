@@ -1,5 +1,6 @@
 
 #include <algorithm>
+#include <cassert>
 #include <chrono>
 #include <iostream>
 #include <limits>
@@ -9,16 +10,30 @@
 
 #include "../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
 #include "../../include/kmccoarsegrain/kmc_constants.hpp"
+#include "../../include/kmccoarsegrain/kmc_rate_provider.hpp"
+#include "../../include/kmccoarsegrain/kmc_rate_table.hpp"
 #include "../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "../../include/kmccoarsegrain/kmc_walker_store.hpp"
 
 #include "topologyfeatures/kmc_topology_feature.hpp"
 #include "topologyfeatures/kmc_cluster.hpp"
 #include "topologyfeatures/kmc_site.hpp"
 #include "log.hpp"
 #include "kmc_basin_explorer.hpp"
+#include "kmc_checkpoint.hpp"
 #include "kmc_graph_library_adapter.hpp"
 #include "kmc_site_container.hpp"
 #include "kmc_cluster_container.hpp"
+#include "kmc_coarsegrain_analysis.hpp"
+#include "kmc_coarsegrain_worker.hpp"
+#include "kmc_hotspot_detector.hpp"
+#include "kmc_memory.hpp"
+#include "kmc_rate_cache.hpp"
+#include "kmc_rate_tree.hpp"
+#include "kmc_rejection_free.hpp"
+#include "kmc_reservoirs.hpp"
+#include "kmc_statistics_timer.hpp"
+#include "kmc_trace_buffer.hpp"
 
 #include "../../../UGLY/include/ugly/pair_hash.hpp"
 #include "../../../UGLY/include/ugly/edge_directed_weighted.hpp"
@@ -51,6 +66,7 @@ namespace kmccoarsegrain {
    ****************************************************************************/
 
   KMC_CoarseGrainSystem::KMC_CoarseGrainSystem() :
+    initialized_(false),
     performance_ratio_(1.00),
     seed_set_(false),
     seed_(0),
@@ -58,9 +74,25 @@ namespace kmccoarsegrain {
     minimum_coarse_graining_resolution_(2),
     iteration_(0),
     iteration_threshold_(1000),
-    iteration_threshold_min_(1000){
+    iteration_threshold_min_(1000),
+    coarse_grain_trigger_(iteration_threshold),
+    kinetics_(coarse_grained),
+    event_selection_(first_reaction),
+    event_time_(0.0),
+    loadable_sites_(0),
+    rate_source_memory_(0),
+    rate_cache_capacity_(100000),
+    neighbor_tree_threshold_(64),
+    cluster_review_interval_(constants::inf_iterations),
+    review_iteration_(0),
+    min_cluster_visits_(10),
+    cluster_event_skipping_(false),
+    rate_parameter_set_(false),
+    rate_parameter_(0.0){
       sites_ = unique_ptr<KMC_Site_Container>( new KMC_Site_Container );
       clusters_ = unique_ptr<KMC_Cluster_Container>( new KMC_Cluster_Container );
+      hot_spot_detector_ = unique_ptr<KMC_HotSpotDetector>( new KMC_HotSpotDetector );
+      reservoirs_ = unique_ptr<KMC_Reservoirs>( new KMC_Reservoirs );
     }
 
   KMC_CoarseGrainSystem::~KMC_CoarseGrainSystem(){
@@ -86,22 +118,13 @@ namespace kmccoarsegrain {
 
     LOG("Initializeing system", 1);
 
-    if(!time_resolution_set_){
-      throw runtime_error("You must first set the time resolution of the system "
-          "before you can initialize the system.");
-    }
+    checkSettings_();
 
     for (auto it = ratesOfAllSites.begin(); it != ratesOfAllSites.end(); ++it) {
-      KMC_Site site;
+      KMC_Site site = newSite_();
       site.setId(it->first);
-
       site.setRatesToNeighbors(it->second);
-      if (seed_set_) {
-        site.setRandomSeed(seed_);
-        ++seed_;
-      }
-      sites_->addKMC_Site(site);
-      topology_features_[it->first] = &(sites_->getKMC_Site(it->first));
+      addSite_(site,it->second.size());
     }
 
     // Address sites that will act as drains with no rates off of them
@@ -114,16 +137,430 @@ namespace kmccoarsegrain {
       }
     }
 
-    for( const int & drain_site_id : drain_sites ){
-      KMC_Site site;
-      site.setId(drain_site_id);
-      sites_->addKMC_Site(site);
-      topology_features_[drain_site_id] = &(sites_->getKMC_Site(drain_site_id));
+    finishInitialization_(drain_sites);
+  }
+
+  void KMC_CoarseGrainSystem::initializeSystem(KMC_RateTable & rate_table) {
+
+    LOG("Initializeing system from rate table", 1);
+
+    const size_t number_of_sites = rate_table.size();
+    const vector<size_t> & offsets = rate_table.offsets;
+    if(offsets.size()>0 && (offsets.front()!=0 ||
+          offsets.back()!=rate_table.neighbors.size())){
+      throw invalid_argument("The offsets of the rate table must run from 0 "
+          "to the number of neighbors.");
+    }
+    if(rate_table.rates.size()!=rate_table.neighbors.size()){
+      throw invalid_argument("The rate table must have a rate for every "
+          "neighbor.");
+    }
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      if(offsets.at(siteId+1)<=offsets.at(siteId)){
+        throw invalid_argument("Site "+to_string(siteId)+" has no rates off "
+            "of it in the rate table.");
+      }
+    }
+
+    checkSettings_();
+
+    unordered_set<int> drain_sites;
+    vector<pair<int,double *>> neigh_rates;
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      neigh_rates.clear();
+      for(size_t index = offsets[siteId]; index < offsets[siteId+1]; ++index){
+        const int & neighId = rate_table.neighbors[index];
+        neigh_rates.push_back(
+            pair<int,double *>(neighId,&rate_table.rates[index]));
+        if(neighId<0 || static_cast<size_t>(neighId)>=number_of_sites){
+          drain_sites.insert(neighId);
+        }
+      }
+      KMC_Site site = newSite_();
+      site.setId(static_cast<int>(siteId));
+      site.setRatesToNeighbors(neigh_rates);
+      addSite_(site,neigh_rates.size());
+    }
+    rate_source_memory_ = rate_table.getMemoryUsage();
+
+    finishInitialization_(drain_sites);
+  }
+
+  void KMC_CoarseGrainSystem::initializeSystem(
+      const KMC_RateProvider & rate_provider) {
+
+    LOG("Initializeing system from rate provider", 1);
+
+    checkSettings_();
+    if(kinetics_==rejection_free){
+      throw runtime_error("Rejection free kinetics is not supported with "
+          "rates from a rate provider.");
+    }
+    if(coarse_grain_worker_){
+      throw runtime_error("Asynchronous coarse graining is not supported with "
+          "rates from a rate provider.");
+    }
+
+    initializeLoadedSites_(
+        [&rate_provider](
+          const int & siteId,
+          vector<int> & neighbors,
+          vector<double> & rates){
+          rate_provider.getRatesOffSite(siteId,neighbors,rates);
+        },
+        rate_provider.size());
+    rate_source_memory_ = rate_provider.getMemoryUsage();
+  }
+
+  void KMC_CoarseGrainSystem::initializeSystem(
+      const KMC_CompressedRateTable & rate_table) {
+
+    LOG("Initializeing system from compressed rate table", 1);
+
+    checkSettings_();
+    if(kinetics_==rejection_free){
+      throw runtime_error("Rejection free kinetics is not supported with "
+          "rates from a compressed rate table.");
+    }
+    if(coarse_grain_worker_){
+      throw runtime_error("Asynchronous coarse graining is not supported with "
+          "rates from a compressed rate table.");
+    }
+
+    initializeLoadedSites_(
+        [&rate_table](
+          const int & siteId,
+          vector<int> & neighbors,
+          vector<double> & rates){
+          rate_table.getRatesOffSite(siteId,neighbors,rates);
+        },
+        rate_table.size());
+    rate_source_memory_ = rate_table.getMemoryUsage();
+  }
+
+  void KMC_CoarseGrainSystem::initializeLoadedSites_(
+      function<void(const int &, vector<int> &, vector<double> &)> rate_source,
+      const size_t number_of_sites) {
+
+    loadable_sites_ = number_of_sites;
+    rate_cache_ = unique_ptr<KMC_RateCache>(
+        new KMC_RateCache(rate_source,rate_cache_capacity_));
+    sites_->setSiteLoader([this](const int & siteId){ loadSite_(siteId); });
+
+    finishInitialization_(unordered_set<int>());
+  }
+
+  void KMC_CoarseGrainSystem::setRateCacheCapacity(const size_t capacity) {
+    if (initialized_) {
+      throw runtime_error(
+          "The rate cache capacity must be set before initializeSystem is "
+          "called");
+    }
+    if (capacity == 0) {
+      throw invalid_argument("The rate cache must hold at least one site.");
+    }
+    rate_cache_capacity_ = capacity;
+  }
+
+  void KMC_CoarseGrainSystem::updateRates(
+      const unordered_map<int, unordered_map<int, double>> & rates) {
+
+    LOG("Updating rates", 1);
+
+    checkRates_(rates);
+    if(rate_tree_ && rate_tree_->getTotalRate()>0.0){
+      throw runtime_error("The walkers must be passed to updateRates with "
+          "rate tree event selection.");
+    }
+
+    // Results worked out from the old rates are installed first
+    synchronizeCoarseGraining();
+    writeRates_(rates);
+  }
+
+  void KMC_CoarseGrainSystem::updateRates(
+      const unordered_map<int, unordered_map<int, double>> & rates,
+      vector<pair<int,KMC_Walker>> & walkers) {
+
+    LOG("Updating rates and rescaling walkers", 1);
+
+    checkRates_(rates);
+    if(rate_tree_){
+      throw runtime_error("Walkers must be held in a KMC_WalkerStore with "
+          "rate tree event selection.");
+    }
+    synchronizeCoarseGraining();
+
+    vector<double> time_constants;
+    time_constants.reserve(walkers.size());
+    for(pair<int,KMC_Walker> & walker : walkers){
+      time_constants.push_back(getTimeConstantOfWalker_(walker.first,
+            walker.second.getIdOfSiteCurrentlyOccupying(),
+            walker.second.getPotentialSite()));
+    }
+    writeRates_(rates);
+
+    vector<char> changed(walkers.size(),false);
+    for(size_t index = 0; index < walkers.size(); ++index){
+      const int siteId = walkers[index].second.getIdOfSiteCurrentlyOccupying();
+      changed[index] = ratesOfSiteChanged_(rates,siteId);
+    }
+    for(size_t index = 0; index < walkers.size(); ++index){
+      if(!changed[index]) continue;
+      const int & walker_id = walkers[index].first;
+      KMC_Walker & walker = walkers[index].second;
+      const int siteId = walker.getIdOfSiteCurrentlyOccupying();
+      updateClusterOfSiteIfRatesChanged_(siteId);
+      const int potentialSiteId = walker.getPotentialSite();
+      const double ratio = getTimeConstantOfWalker_(walker_id,siteId,
+          potentialSiteId)/time_constants[index];
+      walker.setDwellTime(walker.getDwellTime()*ratio);
+      walker.setPotentialSite(
+          pickNewSiteIdOfWalker_(walker_id,siteId,potentialSiteId));
+    }
+  }
+
+  void KMC_CoarseGrainSystem::updateRates(
+      const unordered_map<int, unordered_map<int, double>> & rates,
+      KMC_WalkerStore & walkers) {
+
+    LOG("Updating rates and rescaling walkers", 1);
+
+    checkRates_(rates);
+    synchronizeCoarseGraining();
+
+    const vector<int> handles = walkers.getHandles();
+    vector<double> time_constants;
+    time_constants.reserve(handles.size());
+    // The walkers have all hopped at or before the current time
+    double time = event_time_;
+    for(const int & handle : handles){
+      time_constants.push_back(getTimeConstantOfWalker_(handle,
+            walkers.getSite(handle),walkers.getPotentialSite(handle)));
+      if(!rate_tree_ && walkers.getTime(handle)<numeric_limits<double>::infinity()){
+        time = max(time,walkers.getTime(handle)-walkers.getDwellTime(handle));
+      }
+    }
+    writeRates_(rates);
+
+    vector<char> changed(handles.size(),false);
+    for(size_t index = 0; index < handles.size(); ++index){
+      changed[index] = ratesOfSiteChanged_(rates,walkers.getSite(handles[index]));
+    }
+    for(size_t index = 0; index < handles.size(); ++index){
+      if(!changed[index]) continue;
+      const int & handle = handles[index];
+      const int siteId = walkers.getSite(handle);
+      const int potentialSiteId = walkers.getPotentialSite(handle);
+      updateClusterOfSiteIfRatesChanged_(siteId);
+      if(rate_tree_){
+        rate_tree_->setRate(handle,getEscapeRate_(siteId));
+        // Without clusters the site hopped to is picked when the event happens
+        if(kinetics_==coarse_grained){
+          walkers.setPotentialSite(handle,
+              pickNewSiteIdOfWalker_(handle,siteId,potentialSiteId));
+        }
+        continue;
+      }
+      const double hop_time = walkers.getTime(handle);
+      if(!(hop_time<numeric_limits<double>::infinity())) continue;
+      const double ratio = getTimeConstantOfWalker_(handle,siteId,
+          potentialSiteId)/time_constants[index];
+      const double new_hop_time = hop_time>time ?
+        time+(hop_time-time)*ratio : hop_time;
+      walkers.setDwellTime(handle,
+          walkers.getDwellTime(handle)+new_hop_time-hop_time);
+      walkers.setTime(handle,new_hop_time);
+      walkers.setPotentialSite(handle,
+          pickNewSiteIdOfWalker_(handle,siteId,potentialSiteId));
+    }
+  }
+
+  void KMC_CoarseGrainSystem::checkRates_(
+      const unordered_map<int, unordered_map<int, double>> & rates) {
+
+    if(kinetics_==rejection_free){
+      throw runtime_error("Rates can not be changed with rejection free "
+          "kinetics.");
+    }
+    if(rate_cache_){
+      throw runtime_error("Rates that are worked out as sites are loaded can "
+          "not be changed.");
+    }
+    for(const auto & site_and_rates : rates){
+      if(sites_->exist(site_and_rates.first)==false){
+        throw invalid_argument("Cannot update the rates of a site that is not "
+            "stored in the coarse grained system.");
+      }
+      KMC_Site & site = sites_->getKMC_Site(site_and_rates.first);
+      for(const pair<const int,double> & neigh_and_rate : site_and_rates.second){
+        if(site.isNeighbor(neigh_and_rate.first)==false){
+          throw invalid_argument("Cannot update the rate between sites that "
+              "are not neighbors.");
+        }
+        if(neigh_and_rate.second<=0.0){
+          throw invalid_argument("Rates must be positive values.");
+        }
+      }
+    }
+  }
+
+  void KMC_CoarseGrainSystem::writeRates_(
+      const unordered_map<int, unordered_map<int, double>> & rates) {
+
+    for(const auto & site_and_rates : rates){
+      const int & siteId = site_and_rates.first;
+      sites_->getKMC_Site(siteId).updateRatesToNeighbors(site_and_rates.second);
+      if(sites_->partOfCluster(siteId)){
+        clusters_with_changed_rates_.insert(sites_->getClusterIdOfSite(siteId));
+      }
+    }
+  }
+
+  bool KMC_CoarseGrainSystem::ratesOfSiteChanged_(
+      const unordered_map<int, unordered_map<int, double>> & rates,
+      const int & siteId) const {
+
+    if(rates.count(siteId)) return true;
+    return sites_->partOfCluster(siteId) &&
+      clusters_with_changed_rates_.count(sites_->getClusterIdOfSite(siteId));
+  }
+
+  bool KMC_CoarseGrainSystem::walkerDrewFromCluster_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId) {
+
+    if(!sites_->partOfCluster(siteId)) return false;
+    KMC_Cluster & cluster =
+      clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId));
+    // Walkers sent off the cluster are no longer tracked by it
+    return cluster.hasEscapeTime(walker_id) ||
+      !cluster.siteIsInCluster(potentialSiteId);
+  }
+
+  double KMC_CoarseGrainSystem::getTimeConstantOfWalker_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId) {
+
+    if(walkerDrewFromCluster_(walker_id,siteId,potentialSiteId)){
+      return clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId))
+        .getEscapeTimeConstant();
+    }
+    return sites_->getKMC_Site(siteId).getTimeConstant();
+  }
+
+  int KMC_CoarseGrainSystem::pickNewSiteIdOfWalker_(
+      const int & walker_id,
+      const int & siteId,
+      const int & potentialSiteId) {
+
+    if(walkerDrewFromCluster_(walker_id,siteId,potentialSiteId)){
+      return clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId))
+        .pickNewSiteId(walker_id);
+    }
+    return sites_->getKMC_Site(siteId).KMC_Site::pickNewSiteId();
+  }
+
+  void KMC_CoarseGrainSystem::setRateFamily(
+      RateFamily rate_family,
+      const vector<int> & siteIds) {
+    rate_family_ = rate_family;
+    rate_family_site_ids_ = siteIds;
+  }
+
+  void KMC_CoarseGrainSystem::setRateParameter(const double & parameter) {
+    if(!rate_family_){
+      throw runtime_error("A rate family must be set before the rate "
+          "parameter can be changed.");
+    }
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before you "
+          "can change the rate parameter.");
+    }
+
+    if(rate_tree_ && rate_tree_->getTotalRate()>0.0){
+      throw runtime_error("The rate parameter can not be changed while there "
+          "are walkers with rate tree event selection.");
+    }
+
+    LOG("Changing the rate parameter", 1);
+    synchronizeCoarseGraining();
+    if(rate_parameter_set_){
+      vector<vector<int>> & catalog = cluster_catalogs_[rate_parameter_];
+      catalog.clear();
+      for(auto & cluster_and_sites : clusters_->getSiteIdsOfClusters()){
+        catalog.push_back(cluster_and_sites.second);
+      }
+    }
+    rate_parameter_set_ = true;
+    rate_parameter_ = parameter;
+
+    // Only the rates that differ are written, so sites and clusters whose
+    // rates do not depend on the parameter are left as they are
+    const vector<int> siteIds = rate_family_site_ids_.empty() ?
+      sites_->getSiteIds() : rate_family_site_ids_;
+    unordered_map<int, unordered_map<int, double>> rates;
+    for(const int & siteId : siteIds){
+      if(!sites_->exist(siteId)){
+        throw invalid_argument("The rates of a site that is not stored in the "
+            "coarse grained system do not depend on the parameter.");
+      }
+      KMC_Site & site = sites_->getKMC_Site(siteId);
+      for(const int & neighId : sites_->getSiteIdsOfNeighbors(siteId)){
+        const double rate = rate_family_(siteId,neighId,parameter);
+        if(rate!=site.getRateToNeighbor(neighId)) rates[siteId][neighId] = rate;
+      }
+    }
+    checkRates_(rates);
+    writeRates_(rates);
+
+    unordered_set<int> changed_clusterIds;
+    for(const auto & site_and_rates : rates){
+      if(sites_->partOfCluster(site_and_rates.first)){
+        changed_clusterIds.insert(sites_->getClusterIdOfSite(site_and_rates.first));
+      }
     }
+    for(const int & clusterId : changed_clusterIds){
+      if(clusters_->isOccupied(clusterId)) continue;
+      if(!sitesSatisfyEquilibriumCondition_(
+            clusters_->getKMC_Cluster(clusterId).getSiteIdsInCluster())){
+        dissolveCluster_(clusterId);
+      }
+    }
+
+    auto catalog = cluster_catalogs_.find(parameter);
+    if(catalog==cluster_catalogs_.end()) return;
+    for(const vector<int> & siteIds : catalog->second){
+      // A new cluster does not track the walkers already on its sites, so
+      // clusters holding walkers are left to be found again
+      bool free_sites = true;
+      for(const int & siteId : siteIds){
+        if(sites_->partOfCluster(siteId) ||
+            sites_->getKMC_Site(siteId).isOccupied()){
+          free_sites = false;
+          break;
+        }
+      }
+      if(!free_sites) continue;
+      double internal_time_limit = getInternalTimeLimit_(siteIds);
+      if(sitesSatisfyEquilibriumCondition_(siteIds,internal_time_limit)){
+        createCluster_(siteIds,internal_time_limit);
+      }
+    }
+  }
+
+  double KMC_CoarseGrainSystem::getRateParameter() const {
+    if(!rate_parameter_set_){
+      throw runtime_error("Cannot get the rate parameter as it has not yet "
+          "been set.");
+    }
+    return rate_parameter_;
   }
 
   int KMC_CoarseGrainSystem::getVisitFrequencyOfSite(int siteId){
-    if(sites_->exist(siteId)==false){
+    if(siteExists_(siteId)==false){
       throw invalid_argument("Site is not stored in the coarse grained system you"
           " cannot retrieve it's visit frequency.");
     }
@@ -140,25 +577,60 @@ namespace kmccoarsegrain {
 
     LOG("Initializeing walkers", 1);
 
-    if (topology_features_.size() == 0) {
+    if (!initialized_) {
       throw runtime_error(
           "You must first initialize the system before you "
           "can initialize the walkers");
     }
+    if(kinetics_==rejection_free || rate_tree_){
+      throw runtime_error("Walkers must be held in a KMC_WalkerStore with "
+          "rejection free kinetics or rate tree event selection.");
+    }
+    if(cluster_event_skipping_ && kinetics_==coarse_grained &&
+        walkers.size()>1){
+      throw runtime_error("Walkers must be held in a KMC_WalkerStore with "
+          "cluster event skipping, the times of walkers sharing a cluster "
+          "are rescaled.");
+    }
 
     for ( size_t index = 0; index<walkers.size(); ++index){
-      int siteId = walkers.at(index).second.getIdOfSiteCurrentlyOccupying();
-      if (siteId == constants::unassignedId) {
-        throw runtime_error(
-            "You must first place the walker on a known site"
-            " before the walker can be initialized.");
+      initializeWalker_(walkers.at(index).first,walkers.at(index).second);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::initializeWalkers(KMC_WalkerStore & walkers) {
+
+    LOG("Initializeing walkers", 1);
+
+    if (!initialized_) {
+      throw runtime_error(
+          "You must first initialize the system before you "
+          "can initialize the walkers");
+    }
+
+    if(kinetics_==rejection_free){
+      if(lazySampling_()){
+        throw runtime_error("Lazy sampling is not supported with rejection "
+            "free kinetics.");
       }
-      topology_features_[siteId]->occupy();
+      rejection_free_->initializeWalkers(walkers);
+      return;
+    }
+    if(rate_tree_ && lazySampling_()){
+      throw runtime_error("Lazy sampling is not supported with rate tree "
+          "event selection.");
+    }
 
-      auto hopTime = topology_features_[siteId]->getDwellTime(walkers.at(index).first);
-      int newId = topology_features_[siteId]->pickNewSiteId(walkers.at(index).first);
-      walkers.at(index).second.setDwellTime(hopTime);
-      walkers.at(index).second.setPotentialSite(newId);
+    for (const int & handle : walkers.getHandles()) {
+      KMC_Walker walker = walkers.getWalker(handle);
+      initializeWalker_(handle,walker);
+      walkers.setWalker(handle,walker);
+      if(rate_tree_){
+        // Walkers all share the time of the last event
+        walkers.setTime(handle,event_time_);
+        walkers.setDwellTime(handle,0.0);
+        rate_tree_->setRate(handle,getEscapeRate_(walkers.getSite(handle)));
+      }
     }
   }
 
@@ -168,8 +640,89 @@ namespace kmccoarsegrain {
     iteration_threshold_ = threshold_min;
   }
 
+  void KMC_CoarseGrainSystem::setKinetics(const Kinetics kinetics) {
+    if (initialized_) {
+      throw runtime_error(
+          "The kinetics must be set before initializeSystem is called");
+    }
+    kinetics_ = kinetics;
+  }
+
+  void KMC_CoarseGrainSystem::setEventSelection(
+      const EventSelection event_selection) {
+    if (initialized_) {
+      throw runtime_error(
+          "The event selection must be set before initializeSystem is called");
+    }
+    event_selection_ = event_selection;
+  }
+
+  void KMC_CoarseGrainSystem::setNeighborTreeThreshold(const int degree) {
+    if (initialized_) {
+      throw runtime_error(
+          "The neighbor tree threshold must be set before initializeSystem is "
+          "called");
+    }
+    if (degree < 1) {
+      throw invalid_argument("The neighbor tree threshold must be at least 1.");
+    }
+    neighbor_tree_threshold_ = degree;
+  }
+
+  void KMC_CoarseGrainSystem::setHotSpotThreshold(int threshold) {
+    if(threshold<=0){
+      throw invalid_argument("The hot spot threshold must be greater than 0.");
+    }
+    hot_spot_detector_->setThreshold(threshold);
+  }
+
+  int KMC_CoarseGrainSystem::getHotSpotThreshold() const {
+    return hot_spot_detector_->getThreshold();
+  }
+
+  void KMC_CoarseGrainSystem::setAsynchronousCoarseGraining(bool asynchronous) {
+    if (initialized_) {
+      throw runtime_error(
+          "Asynchronous coarse graining must be set before initializeSystem "
+          "is called");
+    }
+    if(asynchronous && !coarse_grain_worker_){
+      coarse_grain_worker_ = unique_ptr<KMC_CoarseGrainWorker>( 
+          new KMC_CoarseGrainWorker );
+    }else if(!asynchronous){
+      coarse_grain_worker_.reset();
+    }
+  }
+
+  bool KMC_CoarseGrainSystem::getAsynchronousCoarseGraining() const {
+    return static_cast<bool>(coarse_grain_worker_);
+  }
+
+  void KMC_CoarseGrainSystem::synchronizeCoarseGraining() {
+    if(!coarse_grain_worker_) return;
+    coarse_grain_worker_->waitUntilIdle();
+    installCoarseGrainResults_();
+  }
+
+  void KMC_CoarseGrainSystem::setClusterReviewInterval(int interval) {
+    if(interval<=0){
+      throw invalid_argument("The cluster review interval must be greater "
+          "than 0.");
+    }
+    cluster_review_interval_ = interval;
+    review_iteration_ = 0;
+  }
+
+  void KMC_CoarseGrainSystem::setMinClusterVisits(int visits) {
+    if(visits<0){
+      throw invalid_argument("The minimum number of cluster visits cannot be "
+          "negative.");
+    }
+    min_cluster_visits_ = visits;
+  }
+
   void KMC_CoarseGrainSystem::setRandomSeed(const unsigned long seed) {
-    if (topology_features_.size() != 0) {
+    if (initialized_) {
       throw runtime_error(
           "For the random seed to have an affect, it must be "
           "set before initializeSystem is called");
@@ -178,14 +731,406 @@ namespace kmccoarsegrain {
     seed_set_ = true;
   }
 
+  void KMC_CoarseGrainSystem::setClusterEventSkipping(bool event_skipping) {
+    if (initialized_) {
+      throw runtime_error(
+          "Cluster event skipping must be set before initializeSystem is "
+          "called");
+    }
+    cluster_event_skipping_ = event_skipping;
+  }
+
+  void KMC_CoarseGrainSystem::setSamplingTimes(
+      const vector<double> & sampling_times) {
+    if (initialized_) {
+      throw runtime_error(
+          "The sampling times must be set before initializeSystem is called");
+    }
+    for( size_t index = 0; index < sampling_times.size(); ++index){
+      if(sampling_times.at(index)<0.0){
+        throw invalid_argument("The sampling times must be positive values.");
+      }
+      if(index>0 && sampling_times.at(index)<sampling_times.at(index-1)){
+        throw invalid_argument("The sampling times must be in increasing "
+            "order.");
+      }
+    }
+    sampling_times_ = sampling_times;
+  }
+
+  void KMC_CoarseGrainSystem::setSampleObserver(
+      function<void(double,int,int)> observer) {
+    if (initialized_) {
+      throw runtime_error(
+          "The sample observer must be set before initializeSystem is called");
+    }
+    sample_observer_ = observer;
+  }
+
+  int KMC_CoarseGrainSystem::samplePositionOfWalker(KMC_Walker& walker) {
+    int siteId = walker.getIdOfSiteCurrentlyOccupying();
+    if(cluster_event_skipping_ && sites_->partOfCluster(siteId)){
+      KMC_Cluster & cluster = 
+        clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId));
+      siteId = cluster.samplePositionInCluster();
+      walker.occupySite(siteId);
+    }
+    return siteId;
+  }
+
   void KMC_CoarseGrainSystem::removeWalkerFromSystem(pair<int,KMC_Walker>& walker) {
     removeWalkerFromSystem(walker.first,walker.second);
   }
 
+  void KMC_CoarseGrainSystem::removeWalkerFromSystem(
+      KMC_WalkerStore & walkers,
+      const int handle) {
+    if(!walkers.contains(handle)){
+      throw invalid_argument("Cannot remove walker "+to_string(handle)+
+          " as it is not in the store.");
+    }
+    if(kinetics_==rejection_free){
+      rejection_free_->removeWalker(walkers,handle);
+      forgetWalker_(handle);
+      walkers.remove(handle);
+      return;
+    }
+    if(rate_tree_) rate_tree_->setRate(handle,0.0);
+    int walker_id = handle;
+    KMC_Walker walker = walkers.getWalker(handle);
+    removeWalkerFromSystem(walker_id,walker);
+    walkers.remove(handle);
+    if(rate_tree_) updateClusterEscapeRates_(
+          walkers,
+          walker.getIdOfSiteCurrentlyOccupying());
+  }
+
   void KMC_CoarseGrainSystem::removeWalkerFromSystem(int & walker_id, KMC_Walker& walker) {
     LOG("Walker is being removed from system", 1);
+    if(kinetics_==rejection_free){
+      throw runtime_error("Walkers must be removed from their KMC_WalkerStore "
+          "with rejection free kinetics.");
+    }
     auto siteId = walker.getIdOfSiteCurrentlyOccupying();
-    topology_features_[siteId]->removeWalker(walker_id,siteId);
+    getFeature_(siteId)->removeWalker(walker_id,siteId);
+    forgetWalker_(walker_id);
+  }
+
+  void KMC_CoarseGrainSystem::addSource(const int siteId, const double rate) {
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before you "
+          "can add a source.");
+    }
+    if(!siteExists_(siteId)){
+      throw invalid_argument("Cannot add a source to site "+to_string(siteId)+
+          " as it is not part of the system.");
+    }
+    if(reservoirs_->isDrain(siteId)){
+      throw invalid_argument("Site "+to_string(siteId)+" is a drain, it can "
+          "not also be a source.");
+    }
+    if(!(rate>0.0)){
+      throw invalid_argument("The injection rate must be greater than 0.");
+    }
+    // The injections are only given a seed of their own once there is a
+    // source, so the seeds of the sites and clusters do not change
+    if(!reservoirs_->hasSources() && seed_set_){
+      reservoirs_->setRandomSeed(seed_);
+      ++seed_;
+    }
+    reservoirs_->addSource(siteId,rate);
+  }
+
+  void KMC_CoarseGrainSystem::addDrain(const int siteId) {
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before you "
+          "can add a drain.");
+    }
+    if(!siteExists_(siteId)){
+      throw invalid_argument("Cannot add a drain to site "+to_string(siteId)+
+          " as it is not part of the system.");
+    }
+    if(reservoirs_->isSource(siteId)){
+      throw invalid_argument("Site "+to_string(siteId)+" is a source, it can "
+          "not also be a drain.");
+    }
+    if(reservoirs_->isDrain(siteId)) return;
+    if(sites_->partOfCluster(siteId)){
+      throw runtime_error("Site "+to_string(siteId)+" is part of a cluster, "
+          "it can not be made a drain.");
+    }
+    if(sites_->isOccupied(siteId)){
+      throw runtime_error("Site "+to_string(siteId)+" is occupied, it can not "
+          "be made a drain.");
+    }
+    sites_->getKMC_Site(siteId).setDrain();
+    reservoirs_->addDrain(siteId);
+  }
+
+  double KMC_CoarseGrainSystem::getInjectionDwellTime() {
+    if(!reservoirs_->hasSources()){
+      throw runtime_error("No sources have been added to inject walkers.");
+    }
+    return reservoirs_->getInjectionDwellTime();
+  }
+
+  bool KMC_CoarseGrainSystem::injectWalker(
+      const int & walker_id,
+      KMC_Walker & walker) {
+
+    if(!reservoirs_->hasSources()){
+      throw runtime_error("No sources have been added to inject walkers.");
+    }
+    if(kinetics_==rejection_free || rate_tree_){
+      throw runtime_error("Walkers can not be injected with rejection free "
+          "kinetics or rate tree event selection.");
+    }
+    int siteId = reservoirs_->pickSourceSiteId();
+    KMC_TopologyFeature * feature = getFeature_(siteId);
+    if(feature->isOccupied(siteId)){
+      reservoirs_->recordInjection(false);
+      return false;
+    }
+    // The id may belong to a walker that was absorbed, it is a new walker
+    forgetWalker_(walker_id);
+    feature->occupy(siteId);
+    walker.occupySite(siteId);
+    walker.setDwellTime(feature->getDwellTime(walker_id));
+    walker.setPotentialSite(feature->pickNewSiteId(walker_id));
+    reservoirs_->recordInjection(true);
+    return true;
+  }
+
+  KMC_ReservoirCounts KMC_CoarseGrainSystem::getReservoirCounts() const {
+    KMC_ReservoirCounts counts;
+    counts.injected = reservoirs_->getInjected();
+    counts.blocked_injections = reservoirs_->getBlockedInjections();
+    // Drains count the walkers they absorb as visits
+    for(const int & siteId : reservoirs_->getDrainIds()){
+      long long extracted = sites_->getKMC_Site(siteId).getVisitFrequency();
+      counts.extracted_at_drain[siteId] = extracted;
+      counts.extracted += extracted;
+    }
+    return counts;
+  }
+
+  void KMC_CoarseGrainSystem::setSiteCoordinates(
+      const unordered_map<int,double> & coordinates) {
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before you "
+          "can set the coordinates of the sites.");
+    }
+    vector<int> siteIds = sites_->getSiteIds();
+    if(rate_cache_){
+      siteIds.clear();
+      for(size_t siteId = 0; siteId < loadable_sites_; ++siteId){
+        siteIds.push_back(static_cast<int>(siteId));
+      }
+    }
+    for(const int & siteId : siteIds){
+      if(coordinates.count(siteId)==0){
+        throw invalid_argument("Every site in the system must be given a "
+            "coordinate.");
+      }
+    }
+    site_coordinates_ = coordinates;
+    walker_coordinates_.clear();
+  }
+
+  void KMC_CoarseGrainSystem::setCrossingPlanes(const vector<double> & planes) {
+    observables_.planes = planes;
+    observables_.crossings = vector<long long>(planes.size(),0);
+  }
+
+  KMC_MemoryUsage KMC_CoarseGrainSystem::getMemoryUsage() const {
+    KMC_MemoryUsage usage;
+    // Each site and cluster, and each copy of a site held by a cluster, has
+    // its own random engine
+    size_t site_engines = sites_->size();
+    size_t cluster_engines = clusters_->size()+
+      clusters_->getNumberOfSitesInClusters();
+    usage.random_engines = (site_engines+cluster_engines)*sizeof(mt19937);
+    usage.sites = sites_->getMemoryUsage()-site_engines*sizeof(mt19937);
+    usage.clusters = clusters_->getMemoryUsage()-cluster_engines*sizeof(mt19937);
+    usage.topology_features = memory::heapUsage(topology_features_);
+    usage.rate_map = rate_source_memory_;
+    if(rate_source_memory_==0) usage.rate_map = sites_->getRateMapMemoryUsage();
+    if(rate_cache_) usage.rate_cache = rate_cache_->getMemoryUsage();
+
+    usage.scratch = sizeof(KMC_CoarseGrainSystem);
+    usage.scratch += hot_spot_detector_->getMemoryUsage();
+    usage.scratch += reservoirs_->getMemoryUsage();
+    if(rejection_free_) usage.scratch += rejection_free_->getMemoryUsage();
+    if(rate_tree_) usage.scratch += rate_tree_->getMemoryUsage();
+    usage.scratch += memory::heapUsage(queued_seed_sites_);
+    usage.scratch += memory::heapUsage(cluster_visits_at_review_);
+    usage.scratch += memory::heapUsage(clusters_with_changed_rates_);
+    usage.scratch += memory::heapUsage(sampling_times_);
+    usage.scratch += memory::heapUsage(walker_clocks_);
+    usage.scratch += memory::heapUsage(walker_next_sample_);
+    usage.scratch += memory::heapUsage(site_coordinates_);
+    usage.scratch += memory::heapUsage(walker_coordinates_);
+    usage.scratch += memory::heapUsage(observables_.walker_displacements);
+    usage.scratch += memory::heapUsage(observables_.planes);
+    usage.scratch += memory::heapUsage(observables_.crossings);
+    usage.scratch += memory::heapUsage(rate_family_site_ids_);
+    usage.scratch += memory::heapUsage(cluster_catalogs_);
+    for(const auto & catalog : cluster_catalogs_){
+      usage.scratch += memory::heapUsage(catalog.second);
+      for(const vector<int> & siteIds : catalog.second){
+        usage.scratch += memory::heapUsage(siteIds);
+      }
+    }
+    return usage;
+  }
+
+  void KMC_CoarseGrainSystem::writeCheckpoint(
+      ostream & os,
+      const vector<pair<int,KMC_Walker>> & walkers) {
+
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before it "
+          "can be checkpointed.");
+    }
+    if(kinetics_==rejection_free || rate_tree_){
+      throw runtime_error("Systems with rejection free kinetics or rate tree "
+          "event selection can not be checkpointed.");
+    }
+    if(rate_cache_){
+      throw runtime_error("Systems that load sites as they are needed can not "
+          "be checkpointed.");
+    }
+    synchronizeCoarseGraining();
+
+    checkpoint::Writer writer(os);
+    writer.writeHeader();
+    writer.write(performance_ratio_);
+    writer.write(seed_set_);
+    writer.write(seed_);
+    writer.write(time_resolution_);
+    writer.write(minimum_coarse_graining_resolution_);
+    writer.write(iteration_);
+    writer.write(iteration_threshold_);
+    writer.write(iteration_threshold_min_);
+    writer.write(coarse_grain_trigger_);
+    writer.write(kinetics_);
+    writer.write(cluster_review_interval_);
+    writer.write(review_iteration_);
+    writer.write(min_cluster_visits_);
+    writer.write(cluster_event_skipping_);
+    writer.write(rate_parameter_set_);
+    writer.write(rate_parameter_);
+    writer.write(statistics_);
+    hot_spot_detector_->writeCheckpoint(writer);
+    reservoirs_->writeCheckpoint(writer);
+    writer.write(cluster_visits_at_review_);
+    writer.write(clusters_with_changed_rates_);
+    writer.write(sampling_times_);
+    writer.write(cluster_catalogs_);
+    writer.write(site_coordinates_);
+    writer.write(observables_.displacement);
+    writer.write(observables_.walker_time);
+    writer.write(observables_.hops);
+    writer.write(observables_.planes);
+    writer.write(observables_.crossings);
+    writer.write(observables_.walker_displacements);
+    writer.write(walker_coordinates_);
+    writer.write(walker_clocks_);
+    writer.write(walker_next_sample_);
+    sites_->writeCheckpoint(writer);
+    clusters_->writeCheckpoint(writer);
+
+    writer.writeSize(walkers.size());
+    for(const pair<int,KMC_Walker> & walker : walkers){
+      writer.write(walker.first);
+      writer.write(walker.second.getIdOfSiteCurrentlyOccupying());
+      writer.write(walker.second.getPotentialSite());
+      writer.write(walker.second.getDwellTime());
+    }
+    os.flush();
+  }
+
+  void KMC_CoarseGrainSystem::readCheckpoint(
+      istream & is,
+      vector<pair<int,KMC_Walker>> & walkers) {
+
+    if(!initialized_){
+      throw runtime_error("You must first initialize the system before it "
+          "can be restored from a checkpoint.");
+    }
+    if(clusters_->size()!=0){
+      throw runtime_error("A checkpoint can only be restored into a system "
+          "that has not yet been coarse grained.");
+    }
+    if(rate_cache_){
+      throw runtime_error("Systems that load sites as they are needed can not "
+          "be restored from a checkpoint.");
+    }
+
+    checkpoint::Reader reader(is);
+    reader.readHeader();
+    reader.read(performance_ratio_);
+    reader.read(seed_set_);
+    reader.read(seed_);
+    reader.read(time_resolution_);
+    time_resolution_set_ = true;
+    reader.read(minimum_coarse_graining_resolution_);
+    reader.read(iteration_);
+    reader.read(iteration_threshold_);
+    reader.read(iteration_threshold_min_);
+    reader.read(coarse_grain_trigger_);
+    reader.read(kinetics_);
+    reader.read(cluster_review_interval_);
+    reader.read(review_iteration_);
+    reader.read(min_cluster_visits_);
+    reader.read(cluster_event_skipping_);
+    reader.read(rate_parameter_set_);
+    reader.read(rate_parameter_);
+    reader.read(statistics_);
+    hot_spot_detector_->readCheckpoint(reader);
+    reservoirs_->readCheckpoint(reader);
+    reader.read(cluster_visits_at_review_);
+    reader.read(clusters_with_changed_rates_);
+    reader.read(sampling_times_);
+    reader.read(cluster_catalogs_);
+    reader.read(site_coordinates_);
+    reader.read(observables_.displacement);
+    reader.read(observables_.walker_time);
+    reader.read(observables_.hops);
+    reader.read(observables_.planes);
+    reader.read(observables_.crossings);
+    reader.read(observables_.walker_displacements);
+    reader.read(walker_coordinates_);
+    reader.read(walker_clocks_);
+    reader.read(walker_next_sample_);
+    queued_seed_sites_.clear();
+    sites_->readCheckpoint(reader);
+    clusters_->readCheckpoint(reader,*sites_);
+
+    for(const int & clusterId : clusters_->getClusterIds()){
+      KMC_Cluster & cluster = clusters_->getKMC_Cluster(clusterId);
+      for(const int & siteId : cluster.getSiteIdsInCluster()){
+        topology_features_[siteId] = &cluster;
+      }
+    }
+
+    walkers.clear();
+    size_t number_of_walkers = reader.readSize();
+    for(size_t index = 0; index < number_of_walkers; ++index){
+      int walker_id;
+      int siteId;
+      int potential_siteId;
+      double dwell_time;
+      reader.read(walker_id);
+      reader.read(siteId);
+      reader.read(potential_siteId);
+      reader.read(dwell_time);
+      KMC_Walker walker;
+      walker.occupySite(siteId);
+      walker.setPotentialSite(potential_siteId);
+      walker.setDwellTime(dwell_time);
+      walkers.push_back(pair<int,KMC_Walker>(walker_id,walker));
+    }
   }
 
   int KMC_CoarseGrainSystem::getClusterIdOfSite(int siteId) {
@@ -197,46 +1142,740 @@ namespace kmccoarsegrain {
   }
 
   void KMC_CoarseGrainSystem::hop(const int & walker_id, KMC_Walker & walker) {
-    const int & siteId = walker.getIdOfSiteCurrentlyOccupying();
+    KMC_STATISTICS_TIME(statistics_,hop);
+    KMC_STATISTICS_COUNT(statistics_,hops);
+    // Sites are only dropped between hops, while nothing refers to them
+    if(rate_cache_ && rate_cache_->overCapacity()) evictSites_();
+    if(kinetics_!=coarse_grained || rate_tree_){
+      if(kinetics_==rejection_free){
+        throw runtime_error("Walkers must be held in a KMC_WalkerStore with "
+            "rejection free kinetics.");
+      }
+      if(rate_tree_){
+        throw runtime_error("Walkers can only be hopped by hopNext with rate "
+            "tree event selection.");
+      }
+      hopExact_(walker_id,walker);
+      return;
+    }
+    hopCoarseGrained_(walker_id,walker);
+  }
+
+  void KMC_CoarseGrainSystem::hopCoarseGrained_(
+      const int & walker_id,
+      KMC_Walker & walker) {
+
+    // Clusters found in the background are swapped in between events
+    if(coarse_grain_worker_) installCoarseGrainResults_();
+    if(lazySampling_()) sampleWalker_(walker_id,walker);
+
+    const double dwell_time = walker.getDwellTime();
+    const int siteId = walker.getIdOfSiteCurrentlyOccupying();
     const int & siteToHopToId = walker.getPotentialSite();
-    KMC_TopologyFeature * feature = topology_features_[siteId];
-    KMC_TopologyFeature * feature_to_hop_to = topology_features_[siteToHopToId];
+    if(!clusters_with_changed_rates_.empty()){
+      updateClusterOfSiteIfRatesChanged_(siteId);
+      updateClusterOfSiteIfRatesChanged_(siteToHopToId);
+    }
+    KMC_TopologyFeature * feature = getFeature_(siteId);
+    KMC_TopologyFeature * feature_to_hop_to = getFeature_(siteToHopToId);
 
     if(!feature_to_hop_to->isOccupied(siteToHopToId)){
+#ifdef KMCCOARSEGRAIN_STATISTICS
+      if(feature!=feature_to_hop_to){
+        if(sites_->partOfCluster(siteId)) ++statistics_.cluster_exits;
+        if(sites_->partOfCluster(siteToHopToId)) ++statistics_.cluster_entries;
+      }
+#endif
       feature->vacate(siteId);
       feature_to_hop_to->occupy(siteToHopToId);
 
       walker.occupySite(siteToHopToId);
       walker.setDwellTime(feature_to_hop_to->getDwellTime(walker_id));
       walker.setPotentialSite(feature_to_hop_to->pickNewSiteId(walker_id));
+      KMC_TRACE(hop,walker_id,siteToHopToId,walker.getDwellTime());
     }else{
+      KMC_STATISTICS_COUNT(statistics_,rejected_hops);
       feature->vacate(siteId);
       feature->occupy(siteId);
 
       walker.setDwellTime(feature->getDwellTime(walker_id));
       walker.setPotentialSite(feature->pickNewSiteId(walker_id));
+      KMC_TRACE(rejected_hop,walker_id,siteToHopToId,walker.getDwellTime());
+    }
+    if(!site_coordinates_.empty()){
+      recordObservables_(walker_id,walker,siteId,dwell_time);
+    }
+
+    if(cluster_review_interval_!=constants::inf_iterations &&
+        ++review_iteration_ >= cluster_review_interval_){
+      reviewClusters_();
+      review_iteration_ = 0;
+    }
+
+    if(coarse_grain_trigger_==hot_spot){
+      // Only hops that moved the walker are recorded
+      if(iteration_threshold_min_!=constants::inf_iterations &&
+          walker.getIdOfSiteCurrentlyOccupying()==siteToHopToId){
+        coarseGrainHotSpot_(walker_id,siteId,siteToHopToId);
+      }
+      return;
     }
 
     ++iteration_;
     if(iteration_ > iteration_threshold_){
       if(iteration_threshold_min_!=constants::inf_iterations){
-        if(coarseGrain_(siteToHopToId)){
-          iteration_threshold_ = iteration_threshold_min_;
-        }else{
-          iteration_threshold_*=2;
-        }
+        attemptCoarseGrain_(siteToHopToId);
       }
       iteration_ = 0;
     }
   }
 
+  void KMC_CoarseGrainSystem::hop(KMC_WalkerStore & walkers, const int handle) {
+    if(kinetics_==rejection_free){
+      hopRejectionFree_(walkers,handle);
+      return;
+    }
+    KMC_Walker walker = walkers.getWalker(handle);
+    if(!cluster_event_skipping_ || kinetics_!=coarse_grained){
+      hop(handle,walker);
+      walkers.setWalker(handle,walker);
+      return;
+    }
+
+    // The walkers in a cluster are handed the whole of their escape time
+    // when they enter it, the times of the other occupants are rescaled when
+    // a walker entering or leaving changes the escape time constant
+    const double time = walkers.getTime(handle);
+    unordered_map<int,double> time_constants;
+    for(const int & siteId : {walker.getIdOfSiteCurrentlyOccupying(),
+        walker.getPotentialSite()}){
+      if(sites_->partOfCluster(siteId)){
+        const int clusterId = sites_->getClusterIdOfSite(siteId);
+        time_constants[clusterId] =
+          clusters_->getKMC_Cluster(clusterId).getEscapeTimeConstant();
+      }
+    }
+    hop(handle,walker);
+    walkers.setWalker(handle,walker);
+    for(const pair<const int,double> & cluster_and_time : time_constants){
+      if(!clusters_->exist(cluster_and_time.first)) continue;
+      const double ratio = clusters_->getKMC_Cluster(cluster_and_time.first)
+        .getEscapeTimeConstant()/cluster_and_time.second;
+      if(ratio!=1.0){
+        rescaleClusterOccupants_(walkers,handle,cluster_and_time.first,ratio,time);
+      }
+    }
+  }
+
+  int KMC_CoarseGrainSystem::hopNext(KMC_WalkerStore & walkers) {
+    if(!rate_tree_){
+      int handle = walkers.getEarliest();
+      if(handle==constants::unassignedId) return handle;
+      event_time_ = walkers.getTime(handle);
+      hop(walkers,handle);
+      return handle;
+    }
+    if(rate_tree_->getTotalRate()<=0.0) return constants::unassignedId;
+    event_time_ += rate_tree_->drawTimeStep();
+    int handle = rate_tree_->pickWalker();
+    hopRateTree_(walkers,handle,event_time_-walkers.getTime(handle));
+    return handle;
+  }
+
   /****************************************************************************
    * Internal Private Functions
    ****************************************************************************/
 
+  void KMC_CoarseGrainSystem::initializeWalker_(
+      const int & walker_id,
+      KMC_Walker & walker) {
+
+    int siteId = walker.getIdOfSiteCurrentlyOccupying();
+    if (!siteExists_(siteId)) {
+      throw runtime_error(
+          "You must first place the walker on a known site"
+          " before the walker can be initialized.");
+    }
+    KMC_TopologyFeature * feature = getFeature_(siteId);
+    feature->occupy();
+
+    auto hopTime = feature->getDwellTime(walker_id);
+    int newId = feature->pickNewSiteId(walker_id);
+    walker.setDwellTime(hopTime);
+    walker.setPotentialSite(newId);
+  }
+
+  void KMC_CoarseGrainSystem::hopExact_(
+      const int & walker_id,
+      KMC_Walker & walker) {
+
+    if(lazySampling_()) sampleWalker_(walker_id,walker);
+
+    const double dwell_time = walker.getDwellTime();
+    // No clusters are ever created so every feature is a site
+    const int siteId = walker.getIdOfSiteCurrentlyOccupying();
+    const int & siteToHopToId = walker.getPotentialSite();
+    KMC_Site * site = static_cast<KMC_Site *>(getFeature_(siteId));
+    KMC_Site * site_to_hop_to = 
+      static_cast<KMC_Site *>(getFeature_(siteToHopToId));
+
+    if(!site_to_hop_to->isOccupied()){
+      site->vacate();
+      site_to_hop_to->occupy();
+
+      walker.occupySite(siteToHopToId);
+      walker.setDwellTime(site_to_hop_to->getDwellTime(walker_id));
+      walker.setPotentialSite(site_to_hop_to->KMC_Site::pickNewSiteId());
+      KMC_TRACE(hop,walker_id,siteToHopToId,walker.getDwellTime());
+    }else{
+      KMC_STATISTICS_COUNT(statistics_,rejected_hops);
+      site->vacate();
+      site->occupy();
+
+      walker.setDwellTime(site->getDwellTime(walker_id));
+      walker.setPotentialSite(site->KMC_Site::pickNewSiteId());
+      KMC_TRACE(rejected_hop,walker_id,siteToHopToId,walker.getDwellTime());
+    }
+    if(!site_coordinates_.empty()){
+      recordObservables_(walker_id,walker,siteId,dwell_time);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::hopRejectionFree_(
+      KMC_WalkerStore & walkers,
+      const int handle) {
+
+    KMC_STATISTICS_TIME(statistics_,hop);
+    KMC_STATISTICS_COUNT(statistics_,hops);
+    const int siteId = walkers.getSite(handle);
+    const double dwell_time = rejection_free_->hop(walkers,handle);
+    KMC_TRACE(hop,handle,walkers.getSite(handle),walkers.getDwellTime(handle));
+    if(!site_coordinates_.empty()){
+      KMC_Walker walker;
+      walker.occupySite(walkers.getSite(handle));
+      recordObservables_(handle,walker,siteId,dwell_time);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::hopRateTree_(
+      KMC_WalkerStore & walkers,
+      const int handle,
+      const double dwell_time) {
+
+    KMC_STATISTICS_TIME(statistics_,hop);
+    KMC_STATISTICS_COUNT(statistics_,hops);
+    if(rate_cache_ && rate_cache_->overCapacity()) evictSites_();
+    KMC_Walker walker = walkers.getWalker(handle);
+    if(kinetics_==coarse_grained){
+      const int siteId = walkers.getSite(handle);
+      const int clusterId = sites_->partOfCluster(siteId) ?
+        sites_->getClusterIdOfSite(siteId) : constants::unassignedId;
+      // The observables record the time the walker actually spent
+      walker.setDwellTime(dwell_time);
+      hopCoarseGrained_(handle,walker);
+      walkers.setWalker(handle,walker);
+      const int newSiteId = walkers.getSite(handle);
+      const int newClusterId = sites_->partOfCluster(newSiteId) ?
+        sites_->getClusterIdOfSite(newSiteId) : constants::unassignedId;
+      // The cluster the walker left may have been merged during the hop, so
+      // the rates are reset for whichever cluster its old site is now in
+      if(newClusterId!=clusterId){
+        updateClusterEscapeRates_(walkers,siteId);
+        updateClusterEscapeRates_(walkers,newSiteId);
+      }
+    }else{
+      // The neighbor is picked when the event happens, so no dwell time or
+      // potential site is drawn for the walker
+      const int siteId = walkers.getSite(handle);
+      KMC_Site * site = static_cast<KMC_Site *>(getFeature_(siteId));
+      const int siteToHopToId = site->KMC_Site::pickNewSiteId();
+      KMC_Site * site_to_hop_to =
+        static_cast<KMC_Site *>(getFeature_(siteToHopToId));
+
+      if(!site_to_hop_to->isOccupied()){
+        site->vacate();
+        site_to_hop_to->occupy();
+        walker.occupySite(siteToHopToId);
+        walkers.setSite(handle,siteToHopToId);
+        KMC_TRACE(hop,handle,siteToHopToId,dwell_time);
+      }else{
+        KMC_STATISTICS_COUNT(statistics_,rejected_hops);
+        KMC_TRACE(rejected_hop,handle,siteToHopToId,dwell_time);
+      }
+      if(!site_coordinates_.empty()){
+        recordObservables_(handle,walker,siteId,dwell_time);
+      }
+    }
+    walkers.setTime(handle,event_time_);
+    walkers.setDwellTime(handle,dwell_time);
+    rate_tree_->setRate(handle,getEscapeRate_(walkers.getSite(handle)));
+  }
+
+  double KMC_CoarseGrainSystem::getEscapeRate_(const int & siteId) {
+    if(sites_->partOfCluster(siteId)){
+      return 1.0/clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId))
+        .getEscapeTimeConstant();
+    }
+    return 1.0/sites_->getKMC_Site(siteId).getTimeConstant();
+  }
+
+  void KMC_CoarseGrainSystem::updateClusterEscapeRates_(
+      KMC_WalkerStore & walkers,
+      const int & siteId) {
+
+    if(!sites_->partOfCluster(siteId)) return;
+    const int clusterId = sites_->getClusterIdOfSite(siteId);
+    for(const int handle : walkers.getHandles()){
+      const int walkerSiteId = walkers.getSite(handle);
+      if(sites_->partOfCluster(walkerSiteId) &&
+          sites_->getClusterIdOfSite(walkerSiteId)==clusterId){
+        rate_tree_->setRate(handle,getEscapeRate_(walkerSiteId));
+      }
+    }
+  }
+
+  void KMC_CoarseGrainSystem::rescaleClusterOccupants_(
+      KMC_WalkerStore & walkers,
+      const int handle,
+      const int & clusterId,
+      const double & ratio,
+      const double & time) {
+
+    for(const int other : walkers.getHandles()){
+      if(other==handle) continue;
+      const int siteId = walkers.getSite(other);
+      if(!sites_->partOfCluster(siteId) ||
+          sites_->getClusterIdOfSite(siteId)!=clusterId) continue;
+      const double hop_time = walkers.getTime(other);
+      if(!(hop_time>time) ||
+          !(hop_time<numeric_limits<double>::infinity())) continue;
+      const double new_hop_time = time+(hop_time-time)*ratio;
+      walkers.setDwellTime(other,
+          walkers.getDwellTime(other)+new_hop_time-hop_time);
+      walkers.setTime(other,new_hop_time);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::recordObservables_(
+      const int & walker_id,
+      const KMC_Walker & walker,
+      const int & previous_siteId,
+      const double & dwell_time) {
+
+    observables_.walker_time += dwell_time;
+    ++observables_.hops;
+
+    auto walker_coordinate = walker_coordinates_.find(walker_id);
+    if(walker_coordinate==walker_coordinates_.end()){
+      walker_coordinate = walker_coordinates_.insert(pair<int,double>(
+            walker_id,getMeanCoordinate_(previous_siteId))).first;
+      observables_.walker_displacements[walker_id] = 0.0;
+    }
+
+    const int siteId = walker.getIdOfSiteCurrentlyOccupying();
+    if(siteId==previous_siteId) return;
+    // Hops within a cluster leave the walker at the mean of the cluster
+    if(kinetics_!=exact && sites_->partOfCluster(siteId) &&
+        sites_->getClusterIdOfSite(siteId)==
+        sites_->getClusterIdOfSite(previous_siteId)){
+      return;
+    }
+
+    const double previous_coordinate = walker_coordinate->second;
+    const double coordinate = getMeanCoordinate_(siteId);
+    for(size_t index = 0; index < observables_.planes.size(); ++index){
+      const double & plane = observables_.planes[index];
+      if(previous_coordinate<plane && coordinate>=plane){
+        ++observables_.crossings[index];
+      }else if(coordinate<plane && previous_coordinate>=plane){
+        --observables_.crossings[index];
+      }
+    }
+    const double displacement = coordinate-previous_coordinate;
+    observables_.displacement += displacement;
+    observables_.walker_displacements[walker_id] += displacement;
+    walker_coordinate->second = coordinate;
+  }
+
+  double KMC_CoarseGrainSystem::getMeanCoordinate_(const int & siteId) {
+    if(kinetics_==exact || !sites_->partOfCluster(siteId)){
+      return site_coordinates_[siteId];
+    }
+    KMC_Cluster & cluster = 
+      clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId));
+    double coordinate = 0.0;
+    for(const int & clusterSiteId : cluster.getSiteIdsInCluster()){
+      coordinate += cluster.getProbabilityOfOccupyingInternalSite(clusterSiteId)*
+        site_coordinates_[clusterSiteId];
+    }
+    return coordinate;
+  }
+
+  bool KMC_CoarseGrainSystem::lazySampling_() const {
+    return static_cast<bool>(sample_observer_) && !sampling_times_.empty();
+  }
+
+  void KMC_CoarseGrainSystem::sampleWalker_(
+      const int & walker_id,
+      KMC_Walker & walker) {
+
+    double & clock = walker_clocks_[walker_id];
+    size_t & next_sample = walker_next_sample_[walker_id];
+    const double end_of_dwell = clock + walker.getDwellTime();
+
+    // The walker spends its dwell time on the site it currently occupies
+    while(next_sample<sampling_times_.size() && 
+        sampling_times_.at(next_sample)<end_of_dwell){
+      int siteId = walker.getIdOfSiteCurrentlyOccupying();
+      if(sites_->partOfCluster(siteId)){
+        siteId = clusters_->getKMC_Cluster(sites_->getClusterIdOfSite(siteId))
+          .samplePositionInCluster();
+      }
+      sample_observer_(sampling_times_.at(next_sample),walker_id,siteId);
+      ++next_sample;
+    }
+    clock = end_of_dwell;
+  }
+
+  void KMC_CoarseGrainSystem::checkSettings_() const {
+    if(!time_resolution_set_){
+      throw runtime_error("You must first set the time resolution of the system "
+          "before you can initialize the system.");
+    }
+    if(event_selection_==rate_tree){
+      if(kinetics_==rejection_free){
+        throw runtime_error("Rate tree event selection does not support "
+            "rejection free kinetics.");
+      }
+      if(kinetics_==coarse_grained && !cluster_event_skipping_){
+        throw runtime_error("Rate tree event selection with coarse grained "
+            "kinetics needs cluster event skipping.");
+      }
+    }
+  }
+
+  void KMC_CoarseGrainSystem::addSite_(
+      KMC_Site & site,
+      const size_t number_of_neighbors) {
+
+    if (number_of_neighbors >= static_cast<size_t>(neighbor_tree_threshold_)) {
+      site.setNeighborTree(true);
+    }
+    const int siteId = site.getId();
+    sites_->addKMC_Site(move(site));
+    topology_features_[siteId] = &(sites_->getKMC_Site(siteId));
+  }
+
+  KMC_Site KMC_CoarseGrainSystem::newSite_() {
+    // Seeding an engine costs as much as the rest of loading a site, so the
+    // site is constructed with the seed rather than seeded afterwards
+    if (!seed_set_) return KMC_Site();
+    return KMC_Site(seed_++);
+  }
+
+  void KMC_CoarseGrainSystem::finishInitialization_(
+      const unordered_set<int> & drain_sites) {
+
+    for( const int & drain_site_id : drain_sites ){
+      KMC_Site site;
+      site.setId(drain_site_id);
+      site.setDrain();
+      sites_->addKMC_Site(site);
+      topology_features_[drain_site_id] = &(sites_->getKMC_Site(drain_site_id));
+      reservoirs_->addDrain(drain_site_id);
+    }
+
+    if(kinetics_==rejection_free){
+      rejection_free_ = unique_ptr<KMC_RejectionFree>(
+          new KMC_RejectionFree(*sites_));
+      if(seed_set_){
+        rejection_free_->setRandomSeed(seed_);
+        ++seed_;
+      }
+    }
+
+    if(event_selection_==rate_tree){
+      rate_tree_ = unique_ptr<KMC_RateTree>(new KMC_RateTree);
+      if(seed_set_){
+        rate_tree_->setRandomSeed(seed_);
+        ++seed_;
+      }
+    }
+    initialized_ = true;
+  }
+
+  KMC_TopologyFeature * KMC_CoarseGrainSystem::getFeature_(const int & siteId) {
+    auto feature = topology_features_.find(siteId);
+    if(feature!=topology_features_.end()){
+      if(rate_cache_) rate_cache_->touch(siteId);
+      return feature->second;
+    }
+    // Loading the site adds it to the topology features
+    return &(sites_->getKMC_Site(siteId));
+  }
+
+  bool KMC_CoarseGrainSystem::siteExists_(const int & siteId) const {
+    if(rate_cache_){
+      return siteId>=0 && static_cast<size_t>(siteId)<loadable_sites_;
+    }
+    return sites_->exist(siteId);
+  }
+
+  void KMC_CoarseGrainSystem::loadSite_(const int & siteId) {
+    if(!siteExists_(siteId)) return;
+    KMC_STATISTICS_COUNT(statistics_,sites_loaded);
+    vector<pair<int,double *>> neigh_rates = rate_cache_->load(siteId);
+    KMC_Site site = newSite_();
+    site.setId(siteId);
+    site.setRatesToNeighbors(neigh_rates);
+    addSite_(site,neigh_rates.size());
+  }
+
+  void KMC_CoarseGrainSystem::evictSites_() {
+    vector<int> evicted = rate_cache_->evict([this](const int & siteId){
+      KMC_Site & site = sites_->getKMC_Site(siteId);
+      return !site.isOccupied() && !site.partOfCluster() &&
+        !reservoirs_->isSource(siteId) && !reservoirs_->isDrain(siteId);
+    });
+    for(const int & siteId : evicted){
+      topology_features_.erase(siteId);
+      sites_->erase(siteId);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::forgetWalker_(const int & walker_id) {
+    walker_clocks_.erase(walker_id);
+    hot_spot_detector_->removeWalker(walker_id);
+    walker_next_sample_.erase(walker_id);
+    walker_coordinates_.erase(walker_id);
+    observables_.walker_displacements.erase(walker_id);
+  }
+
+  void KMC_CoarseGrainSystem::coarseGrainHotSpot_(
+      const int & walker_id,
+      const int & siteId,
+      const int & siteToHopToId){
+
+    // Oscillations within a cluster are already accounted for, the hop is
+    // still recorded so the walker's previous site stays current
+    if(sites_->partOfCluster(siteId) && 
+        sites_->getClusterIdOfSite(siteId)==
+        sites_->getClusterIdOfSite(siteToHopToId)){
+      hot_spot_detector_->recordIgnoredHop(walker_id,siteId);
+      return;
+    }
+    if(hot_spot_detector_->recordHop(walker_id,siteId,siteToHopToId)){
+      attemptCoarseGrain_(siteToHopToId);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::attemptCoarseGrain_(const int & siteId){
+    // A drain can never be part of a cluster
+    if(reservoirs_->isDrain(siteId)) return;
+    KMC_STATISTICS_COUNT(statistics_,coarse_grain_attempts);
+    if(coarse_grain_worker_){
+      queueCoarseGrain_(siteId);
+    }else{
+      recordCoarseGrainOutcome_(siteId,coarseGrain_(siteId));
+    }
+  }
+
+  void KMC_CoarseGrainSystem::recordCoarseGrainOutcome_(
+      const int & siteId,
+      const bool success){
+
+    if(success) KMC_STATISTICS_COUNT(statistics_,coarse_grain_successes);
+    if(coarse_grain_trigger_==hot_spot){
+      if(success){
+        hot_spot_detector_->recordSuccess(siteId);
+      }else{
+        hot_spot_detector_->recordFailure(siteId);
+      }
+    }else if(success){
+      iteration_threshold_ = iteration_threshold_min_;
+    }else{
+      iteration_threshold_*=2;
+    }
+  }
+
+  void KMC_CoarseGrainSystem::queueCoarseGrain_(const int & siteId){
+    if(queued_seed_sites_.count(siteId)) return;
+
+    // The explorer gives up after a handful of sites so finding the basin
+    // is cheap, it is the time limit and the solve that are left to the
+    // worker. Seeds without a basin are not queued at all.
+    vector<int> basin_site_ids;
+    {
+      KMC_STATISTICS_TIME(statistics_,find_basin);
+      BasinExplorer basin_explorer;
+      basin_site_ids = basin_explorer.findBasin(*sites_,*clusters_,siteId);
+    }
+    if(basin_site_ids.empty() || reservoirs_->containsDrain(basin_site_ids)){
+      recordCoarseGrainOutcome_(siteId,false);
+      return;
+    }
+    queued_seed_sites_.insert(siteId);
+
+    unique_ptr<CoarseGrainSnapshot> snapshot( new CoarseGrainSnapshot );
+    snapshot->seed_site_id = siteId;
+    for(const int & basin_site_id : basin_site_ids){
+      const KMC_Site & site = sites_->getKMC_Site(basin_site_id);
+      SiteSnapshot & site_snapshot = snapshot->sites[basin_site_id];
+      site_snapshot.cluster_id = site.getClusterId();
+      site_snapshot.rates.reserve(site.getNeighborsAndRatesConst().size());
+      for(const pair<const int,double *> & neigh_rate : 
+          site.getNeighborsAndRatesConst()){
+        site_snapshot.rates.push_back(
+            pair<int,double>(neigh_rate.first,*neigh_rate.second));
+      }
+    }
+    snapshot->basin_site_ids = move(basin_site_ids);
+
+    coarse_grain_worker_->submit(move(snapshot),getCoarseGrainCriteria_());
+  }
+
+  void KMC_CoarseGrainSystem::installCoarseGrainResults_(){
+    for(CoarseGrainResult & result : coarse_grain_worker_->collectResults()){
+      queued_seed_sites_.erase(result.seed_site_id);
+      if(!result.success){
+        recordCoarseGrainOutcome_(result.seed_site_id,false);
+        continue;
+      }
+
+      // Drop results for sites that have changed cluster since the copies
+      // were taken, they are out of date
+      bool up_to_date = true;
+      for(const pair<const int,int> & site_and_cluster : result.sites_and_clusters){
+        if(sites_->getClusterIdOfSite(site_and_cluster.first)!=
+            site_and_cluster.second){
+          up_to_date = false;
+          break;
+        }
+      }
+      if(!up_to_date) continue;
+      if(reservoirs_->containsDrain(result.basin_site_ids)){
+        recordCoarseGrainOutcome_(result.seed_site_id,false);
+        continue;
+      }
+
+      auto number_clusters = countUniqueClusters(result.sites_and_clusters);
+      bool success = false;
+      if(result.cluster){
+        vector<KMC_Site> sites;
+        for(const int & siteId : result.basin_site_ids){
+          sites.push_back(sites_->getKMC_Site(siteId));
+        }
+        result.cluster->refreshOccupancy(sites);
+        result.cluster->linkRates(sites);
+        installCluster_(*result.cluster);
+        success = true;
+      }else if(number_clusters!=1){
+        int favored_clusterId = getFavoredClusterId(result.sites_and_clusters);
+        mergeSitesAndClusters_(result.sites_and_clusters,favored_clusterId);
+        success = true;
+      }
+      recordCoarseGrainOutcome_(result.seed_site_id,success);
+    }
+  }
+
+  void KMC_CoarseGrainSystem::updateClusterOfSiteIfRatesChanged_(
+      const int & siteId){
+    if(!sites_->partOfCluster(siteId)) return;
+    int clusterId = sites_->getClusterIdOfSite(siteId);
+    if(clusters_with_changed_rates_.erase(clusterId)){
+      KMC_STATISTICS_TIME(statistics_,cluster_solve);
+      KMC_Cluster & cluster = clusters_->getKMC_Cluster(clusterId);
+      cluster.updateRates();
+      cluster.setResolution(chooseResolution(
+            cluster.getTimeConstant(),
+            getInternalTimeLimit_(cluster.getSiteIdsInCluster()),
+            getCoarseGrainCriteria_()));
+    }
+  }
+
+  void KMC_CoarseGrainSystem::reviewClusters_(){
+    LOG("Reviewing clusters", 1);
+
+    unordered_map<int,int> cluster_visits;
+    vector<int> sites_to_split;
+    for(auto & cluster_and_sites : clusters_->getSiteIdsOfClusters()){
+      const int & clusterId = cluster_and_sites.first;
+      const vector<int> & siteIds = cluster_and_sites.second;
+      KMC_Cluster & cluster = clusters_->getKMC_Cluster(clusterId);
+
+      int visits = 0;
+      for(const int & siteId : siteIds) visits += cluster.getVisitFrequency(siteId);
+
+      // Walkers in the cluster would have to be placed back on the sites
+      auto previous_visits = cluster_visits_at_review_.find(clusterId);
+      if(cluster.isOccupied() || previous_visits==cluster_visits_at_review_.end()){
+        cluster_visits[clusterId] = visits;
+        continue;
+      }
+
+      if(!sitesSatisfyEquilibriumCondition_(siteIds)){
+        dissolveCluster_(clusterId);
+        sites_to_split.insert(sites_to_split.end(),siteIds.begin(),siteIds.end());
+      }else if(visits-previous_visits->second < min_cluster_visits_){
+        dissolveCluster_(clusterId);
+      }else{
+        cluster_visits[clusterId] = visits;
+      }
+    }
+    cluster_visits_at_review_.swap(cluster_visits);
+
+    // Parts of the dissolved clusters may still be worth coarse graining
+    for(const int & siteId : sites_to_split){
+      if(sites_->partOfCluster(siteId)) continue;
+      if(coarse_grain_worker_){
+        queueCoarseGrain_(siteId);
+      }else{
+        coarseGrain_(siteId);
+      }
+    }
+  }
+
+  void KMC_CoarseGrainSystem::dissolveCluster_(const int & clusterId){
+    LOG("Dissolving cluster", 1);
+
+    KMC_Cluster & cluster = clusters_->getKMC_Cluster(clusterId);
+    assert(!cluster.isOccupied() && "Cannot dissolve an occupied cluster");
+    KMC_TRACE(cluster_dissolved,constants::unassignedId,
+        cluster.getSiteIdsInCluster().front(),0.0);
+    for(const int & siteId : cluster.getSiteIdsInCluster()){
+      KMC_Site & site = sites_->getKMC_Site(siteId);
+      site.setVisitFrequency(site.getVisitFrequency()+
+          cluster.getVisitFrequency(siteId));
+      site.setToUnoccupiedStatus();
+      site.setClusterId(constants::unassignedId);
+      topology_features_[siteId] = &site;
+    }
+    clusters_with_changed_rates_.erase(clusterId);
+    clusters_->erase(clusterId);
+  }
+
+  CoarseGrainCriteria KMC_CoarseGrainSystem::getCoarseGrainCriteria_() const {
+    CoarseGrainCriteria criteria;
+    criteria.performance_ratio = performance_ratio_;
+    criteria.time_resolution = time_resolution_;
+    criteria.minimum_coarse_graining_resolution = 
+      minimum_coarse_graining_resolution_;
+    criteria.lazy_sampling = lazySampling_();
+    criteria.event_skipping = cluster_event_skipping_;
+    return criteria;
+  }
+
   bool KMC_CoarseGrainSystem::coarseGrain_(int siteId){
-    BasinExplorer basin_explorer;
-    auto basin_site_ids = basin_explorer.findBasin(*sites_,*clusters_,siteId);
+    KMC_STATISTICS_TIME(statistics_,coarse_grain);
+    KMC_TRACE(coarse_grain,constants::unassignedId,siteId,0.0);
+    vector<int> basin_site_ids;
+    {
+      KMC_STATISTICS_TIME(statistics_,find_basin);
+      BasinExplorer basin_explorer;
+      basin_site_ids = basin_explorer.findBasin(*sites_,*clusters_,siteId);
+    }
+    // Walkers have to be absorbed by the drain, not held by a cluster
+    if(reservoirs_->containsDrain(basin_site_ids)) return false;
 
     double internal_time_limit = getInternalTimeLimit_(basin_site_ids);
 
@@ -297,40 +1936,31 @@ namespace kmccoarsegrain {
     LOG("Creating cluster from vector of sites", 1);
 
     KMC_Cluster cluster;
-    cluster.setConvergenceMethod(KMC_Cluster::Method::converge_by_tolerance);
-    cluster.setConvergenceTolerance(0.001);
     vector<KMC_Site> sites;
     for (auto siteId : siteIds){
       sites.push_back(sites_->getKMC_Site(siteId));
     }
-    cluster.addSites(sites);
-    cluster.updateProbabilitiesAndTimeConstant();
-
-    double cluster_time_const = cluster.getTimeConstant();
-    // Cut the resolution in half from what it would otherwise be otherwise not worth doing
-    double res = cluster_time_const/(2*internal_time_limit);
-    double allowed_resolution = cluster_time_const/time_resolution_;
-    double chosen_resolution = res;
-
-    // The coarser the resolution is the better
-    if(allowed_resolution <  chosen_resolution) chosen_resolution=allowed_resolution;
+    {
+      KMC_STATISTICS_TIME(statistics_,cluster_solve);
+      setUpCluster(cluster,sites,internal_time_limit,getCoarseGrainCriteria_());
+    }
+    return installCluster_(cluster);
+  }
 
-    if(chosen_resolution<2.0) chosen_resolution=2.0;
-   
-    cluster.setResolution(chosen_resolution);
+  int KMC_CoarseGrainSystem::installCluster_(KMC_Cluster & cluster) {
     if (seed_set_) {
       cluster.setRandomSeed(seed_);
       ++seed_;
     }
     clusters_->addKMC_Cluster(cluster);
+    KMC_TRACE(cluster_created,constants::unassignedId,
+        cluster.getSiteIdsInCluster().front(),0.0);
 
-    for(auto siteId : siteIds){
+    for(auto siteId : cluster.getSiteIdsInCluster()){
       sites_->setClusterId(siteId,cluster.getId());  
       topology_features_[siteId] = &(clusters_->getKMC_Cluster(cluster.getId()));
     }
 
-    auto sitesFoundInCluster = cluster.getSiteIdsInCluster();
-
     return cluster.getId();
   }
 
@@ -351,10 +1981,13 @@ namespace kmccoarsegrain {
         sites_->setClusterId(site_and_cluster.first,favoredClusterId);
       }
     }
+    KMC_STATISTICS_TIME(statistics_,cluster_solve);
     clusters_->getKMC_Cluster(favoredClusterId).addSites(isolated_sites);
     clusters_->getKMC_Cluster(favoredClusterId).updateProbabilitiesAndTimeConstant();
     for(auto clusterId : cluster_ids ){
       clusters_->getKMC_Cluster(favoredClusterId).migrateSitesFrom(clusters_->getKMC_Cluster(clusterId));
+      // Migrating the sites solves the favored cluster with the new rates
+      clusters_with_changed_rates_.erase(clusterId);
       clusters_->erase(clusterId);
     }
 
@@ -383,67 +2016,27 @@ namespace kmccoarsegrain {
   }
 
 double KMC_CoarseGrainSystem::getInternalTimeLimit_(vector<int> siteIds ){
-  LOG("Getting the internal time limit of a cluster", 1);
-
-  auto nodes = convertSitesToEmptySharedNodes(siteIds);
-
-  unordered_map<int, weak_ptr<GraphNode<string>>> nodes_weak;
-  for (auto node_iter : nodes) nodes_weak[node_iter.first] = node_iter.second;
-
-  auto edges = convertSitesOutgoingRatesToTimeSharedWeightedEdges<vector<shared_ptr<Edge>>>(
-      *sites_,
-      siteIds);
-
-  list<weak_ptr<Edge>> edges_weak(edges.begin(), edges.end());
-
-  auto graph_ptr =
-      shared_ptr<Graph<string>>(new Graph<string>(edges_weak, nodes_weak));
-
-  unordered_map<pair<int, int>, double,hash_functions::hash> verticesAndtimes =
-      maxMinimumDistanceBetweenEveryVertex<string>(*graph_ptr);
-
-  double maxtime = 0.0;
-  for (auto verticesAndTime : verticesAndtimes) {
-    if (verticesAndTime.second > maxtime) maxtime = verticesAndTime.second;
-  }
-  return maxtime;
+  KMC_STATISTICS_TIME(statistics_,internal_time_limit);
+  return getInternalTimeLimit(*sites_,siteIds);
 }
 
-// Its not worth creating a cluster unless the time is at least cut in half
-// And it is not allowed if the sample time is smaller than than the simulated
-// time of the cluster. The cluster has to be updated at a minimum once between
-// each measurment (time_resolution). If this is not done the noise will not
-// correctly show up in the data.  
-// The number 25 is the ratio needed between hops within the cluster to hops
-// outside of the cluster in order to see performance gains.
 bool KMC_CoarseGrainSystem::sitesSatisfyEquilibriumCondition_(
     vector<int> siteIds, double maxtime) {
+  return sitesSatisfyEquilibriumCondition(
+      *sites_,
+      siteIds,
+      maxtime,
+      getCoarseGrainCriteria_());
+}
 
-  LOG("Checking if sites satisfy equilibrium condition", 1);
-  double timeConstant = getTimeConstantFromSitesToNeighbors_(siteIds);
-  double time_to_traverse_cluster = maxtime*minimum_coarse_graining_resolution_;
-  return timeConstant > time_to_traverse_cluster*performance_ratio_ && time_to_traverse_cluster< time_resolution_;// && ratio>25;
+bool KMC_CoarseGrainSystem::sitesSatisfyEquilibriumCondition_(
+    const vector<int> & siteIds) {
+  return sitesSatisfyEquilibriumCondition_(siteIds,getInternalTimeLimit_(siteIds));
 }
 
 double KMC_CoarseGrainSystem::getTimeConstantFromSitesToNeighbors_(
    const vector<int> & siteIds) const {
-
-  LOG("Get the minimum time constant", 1);
-  set<int> internalSiteIds(siteIds.begin(), siteIds.end());
-
-  double sumRates = 0.0;
-  for (const int & siteId : siteIds) {
-    vector<int> neighborSiteIds = sites_->getSiteIdsOfNeighbors(siteId);
-    for (const int & neighId : neighborSiteIds) {
-      if (!internalSiteIds.count(neighId)) {
-        sumRates+= sites_->getRateToNeighborOfSite(siteId,neighId);
-      }
-    }
-  }
-  if (sumRates == 0.0){
-    return 0.0;
-  }
-  return 1.0/sumRates;
+  return getTimeConstantFromSitesToNeighbors(*sites_,siteIds);
 }
 
 unordered_map<int,vector<int>> KMC_CoarseGrainSystem::getClusters(){
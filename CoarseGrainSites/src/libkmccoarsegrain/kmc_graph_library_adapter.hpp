@@ -11,16 +11,25 @@
 #include "../../../UGLY/include/ugly/graph_node.hpp"
 
 namespace kmccoarsegrain {
+
+  /// Rates off the site, there are none if the site is not in the container
+  inline const std::unordered_map<int,double *> & getOutgoingRates(
+      KMC_Site_Container & site_container,
+      int siteId)
+  {
+    static const std::unordered_map<int,double *> no_rates;
+    if(!site_container.load(siteId)) return no_rates;
+    return site_container.getKMC_Site(siteId).getNeighborsAndRatesConst();
+  }
   
   // Can only take arguments of type container<unique_ptr<Edge>>
   template<typename T> 
   T convertSitesOutgoingRatesToUniqueWeightedEdges(
-      KMC_Site_Container site_container, 
+      KMC_Site_Container & site_container, 
       int siteId)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
-    for ( auto neigh : rate_map[siteId] ){
+    for ( auto neigh : getOutgoingRates(site_container,siteId) ){
       int neigh_id = neigh.first;
       double * rate = neigh.second;
     
@@ -34,12 +43,11 @@ namespace kmccoarsegrain {
   // Can only take arguments of type container<shared_ptr<Edge>>
   template<typename T> 
   T convertSitesOutgoingRatesToSharedWeightedEdges(
-      KMC_Site_Container site_container, 
+      KMC_Site_Container & site_container, 
       int siteId)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
-    for ( auto neigh : rate_map[siteId] ){
+    for ( auto neigh : getOutgoingRates(site_container,siteId) ){
       int neigh_id = neigh.first;
       double * rate = neigh.second;
     
@@ -53,13 +61,12 @@ namespace kmccoarsegrain {
   // Same as the above method but for a vector of integers
   template<typename T> 
   T convertSitesOutgoingRatesToSharedWeightedEdges(
-      KMC_Site_Container site_container, 
+      KMC_Site_Container & site_container, 
       std::vector<int> siteIds)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
     for(auto siteId : siteIds ){
-      for ( auto neigh : rate_map[siteId] ){
+      for ( auto neigh : getOutgoingRates(site_container,siteId) ){
         int neigh_id = neigh.first;
         double * rate = neigh.second;
 
@@ -73,13 +80,12 @@ namespace kmccoarsegrain {
 
   template<typename T> 
   T convertSitesOutgoingRatesToTimeSharedWeightedEdges(
-      KMC_Site_Container site_container, 
+      KMC_Site_Container & site_container, 
       std::vector<int> siteIds)
   {
     T container;
-    Rate_Map rate_map = site_container.getRates();
     for(auto siteId : siteIds ){
-      for ( auto neigh : rate_map[siteId] ){
+      for ( auto neigh : getOutgoingRates(site_container,siteId) ){
         int neigh_id = neigh.first;
         double  time = 1.0/(*neigh.second);
         auto edge_ptr = std::shared_ptr<ugly::EdgeDirectedWeighted>(new ugly::EdgeDirectedWeighted(siteId,neigh_id,time));
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+#include "kmc_hotspot_detector.hpp"
+#include "kmc_checkpoint.hpp"
+#include "kmc_memory.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  /// The back off is capped so a site can still be reported again
+  static const int max_failures = 16;
+
+  /// Odd multipliers used to hash the site ids, one for each row
+  static const uint64_t row_multipliers[] = {
+    0x9E3779B97F4A7C15ULL,
+    0xC2B2AE3D27D4EB4FULL,
+    0x165667B19E3779F9ULL,
+    0xD6E8FEB86659FD93ULL};
+
+  KMC_HotSpotDetector::KMC_HotSpotDetector() :
+    threshold_(20),
+    decay_interval_(100000),
+    hops_since_decay_(0),
+    counts_(depth_*width_,0),
+    failures_(width_,0) {}
+
+  void KMC_HotSpotDetector::setThreshold(int threshold){
+    assert(threshold>0 && "The hot spot threshold must be greater than 0");
+    threshold_ = threshold;
+  }
+
+  void KMC_HotSpotDetector::setDecayInterval(long decay_interval){
+    assert(decay_interval>0 && "The decay interval must be greater than 0");
+    decay_interval_ = decay_interval;
+  }
+
+  bool KMC_HotSpotDetector::recordHop(
+      const int & walker_id,
+      const int & siteId,
+      const int & siteToHopToId){
+
+    auto previous = previous_site_.find(walker_id);
+    bool returning = false;
+    if(previous==previous_site_.end()){
+      previous_site_[walker_id] = siteId;
+    }else{
+      returning = previous->second==siteToHopToId;
+      previous->second = siteId;
+    }
+
+    if(++hops_since_decay_>=decay_interval_) decay_();
+    if(!returning) return false;
+
+    return increment_(siteToHopToId)>=requiredReturns_(siteToHopToId);
+  }
+
+  void KMC_HotSpotDetector::recordIgnoredHop(
+      const int & walker_id,
+      const int & siteId){
+
+    previous_site_[walker_id] = siteId;
+    if(++hops_since_decay_>=decay_interval_) decay_();
+  }
+
+  uint32_t KMC_HotSpotDetector::estimateReturns(const int & siteId) const {
+    uint32_t estimate = numeric_limits<uint32_t>::max();
+    for(size_t row = 0; row < depth_; ++row){
+      estimate = min(estimate,counts_[index_(siteId,row)]);
+    }
+    return estimate;
+  }
+
+  void KMC_HotSpotDetector::recordFailure(const int & siteId){
+    uint8_t & failures = failures_[index_(siteId,0)];
+    if(failures<max_failures) ++failures;
+    forget_(siteId);
+  }
+
+  void KMC_HotSpotDetector::recordSuccess(const int & siteId){
+    failures_[index_(siteId,0)] = 0;
+    forget_(siteId);
+  }
+
+  void KMC_HotSpotDetector::removeWalker(const int & walker_id){
+    previous_site_.erase(walker_id);
+  }
+
+  /****************************************************************************
+   * Private Functions
+   ****************************************************************************/
+
+  size_t KMC_HotSpotDetector::index_(
+      const int & siteId,
+      const size_t & row) const {
+    uint64_t hash = static_cast<uint64_t>(static_cast<uint32_t>(siteId));
+    hash *= row_multipliers[row];
+    // The upper bits are the best mixed
+    return row*width_ + static_cast<size_t>((hash >> 32) & (width_-1));
+  }
+
+  // Conservative update, only the smallest counters are incremented which
+  // reduces the over estimate caused by collisions
+  uint32_t KMC_HotSpotDetector::increment_(const int & siteId){
+    uint32_t estimate = estimateReturns(siteId)+1;
+    for(size_t row = 0; row < depth_; ++row){
+      uint32_t & count = counts_[index_(siteId,row)];
+      if(count<estimate) count = estimate;
+    }
+    return estimate;
+  }
+
+  // The shifted threshold saturates instead of overflowing
+  uint32_t KMC_HotSpotDetector::requiredReturns_(const int & siteId) const {
+    uint64_t required = static_cast<uint64_t>(threshold_) <<
+      failures_[index_(siteId,0)];
+    return static_cast<uint32_t>(min<uint64_t>(required,
+          numeric_limits<uint32_t>::max()));
+  }
+
+  void KMC_HotSpotDetector::forget_(const int & siteId){
+    uint32_t estimate = estimateReturns(siteId);
+    for(size_t row = 0; row < depth_; ++row){
+      counts_[index_(siteId,row)]-=estimate;
+    }
+  }
+
+  size_t KMC_HotSpotDetector::getMemoryUsage() const {
+    return sizeof(KMC_HotSpotDetector) + memory::heapUsage(counts_) +
+      memory::heapUsage(previous_site_) + memory::heapUsage(failures_);
+  }
+
+  void KMC_HotSpotDetector::writeCheckpoint(checkpoint::Writer & writer) const {
+    writer.write(threshold_);
+    writer.write(decay_interval_);
+    writer.write(hops_since_decay_);
+    writer.write(counts_);
+    writer.write(previous_site_);
+    writer.write(failures_);
+  }
+
+  void KMC_HotSpotDetector::readCheckpoint(checkpoint::Reader & reader) {
+    reader.read(threshold_);
+    reader.read(decay_interval_);
+    reader.read(hops_since_decay_);
+    reader.read(counts_);
+    if(counts_.size()!=depth_*width_){
+      throw runtime_error("The checkpoint contains a hot spot detector of a "
+          "different size");
+    }
+    reader.read(previous_site_);
+    reader.read(failures_);
+    if(failures_.size()!=width_){
+      throw runtime_error("The checkpoint contains a hot spot detector of a "
+          "different size");
+    }
+  }
+
+  void KMC_HotSpotDetector::decay_(){
+    for(uint32_t & count : counts_) count >>= 1;
+    hops_since_decay_ = 0;
+  }
+}
@@ -0,0 +1,126 @@
+#ifndef KMCCOARSEGRAIN_KMC_HOTSPOT_DETECTOR_HPP
+#define KMCCOARSEGRAIN_KMC_HOTSPOT_DETECTOR_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+namespace checkpoint {
+class Writer;
+class Reader;
+}
+
+/**
+ * \brief Detects sites where walkers oscillate back and forth
+ *
+ * Each time a walker hops back to the site it just came from the return is
+ * counted against that site. The counts are stored in a small count-min
+ * sketch so the memory used does not grow with the number of sites. When
+ * the estimated number of returns to a site reaches the threshold the site
+ * is reported as a hot spot, which is where coarse graining should be
+ * attempted.
+ *
+ * The counts are halved every decay interval so that only recent
+ * oscillations are considered. If coarse graining a hot spot fails, the
+ * number of returns needed before the site is reported again is doubled.
+ * The failures are kept in a fixed size table hashed like the sketch rows,
+ * sites that share a slot share their back off.
+ **/
+class KMC_HotSpotDetector {
+  public:
+    KMC_HotSpotDetector();
+
+    /**
+     * \brief Number of returns to a site before it is reported
+     **/
+    void setThreshold(int threshold);
+    int getThreshold() const { return threshold_; }
+
+    /**
+     * \brief Number of recorded hops between halving the counts
+     **/
+    void setDecayInterval(long decay_interval);
+    long getDecayInterval() const { return decay_interval_; }
+
+    /**
+     * \brief Record a hop made by a walker
+     *
+     * \param[in] walker_id
+     * \param[in] siteId site the walker is hopping from
+     * \param[in] siteToHopToId site the walker is hopping to
+     *
+     * \return true if the site being hopped to has become a hot spot
+     **/
+    bool recordHop(const int & walker_id, const int & siteId, const int & siteToHopToId);
+
+    /**
+     * \brief Record a hop that can not make a hot spot
+     *
+     * The history of the walker is updated without counting a return, e.g.
+     * for hops between sites of the same cluster.
+     **/
+    void recordIgnoredHop(const int & walker_id, const int & siteId);
+
+    /**
+     * \brief Estimate of the number of returns to the site
+     *
+     * The count-min sketch never underestimates the count.
+     **/
+    uint32_t estimateReturns(const int & siteId) const;
+
+    /**
+     * \brief Coarse graining the hot spot did not succeed
+     *
+     * The returns recorded for the site are forgotten and twice as many
+     * returns will be needed before the site is reported again.
+     **/
+    void recordFailure(const int & siteId);
+
+    /**
+     * \brief Coarse graining the hot spot succeeded
+     **/
+    void recordSuccess(const int & siteId);
+
+    /**
+     * \brief Forget the history of a walker that has left the system
+     **/
+    void removeWalker(const int & walker_id);
+
+    /// Bytes of memory used by the detector
+    size_t getMemoryUsage() const;
+
+    /// Writes and reads the counters and history of the detector
+    void writeCheckpoint(checkpoint::Writer & writer) const;
+    void readCheckpoint(checkpoint::Reader & reader);
+
+  private:
+    /// Number of hash functions, rows in the sketch
+    static const size_t depth_ = 4;
+    /// Number of counters in each row, must be a power of 2
+    static const size_t width_ = 1024;
+
+    int threshold_;
+    long decay_interval_;
+    long hops_since_decay_;
+
+    /// Counters of all the rows stored contiguously
+    std::vector<uint32_t> counts_;
+
+    /// The site each walker was on before the one it currently occupies
+    std::unordered_map<int,int> previous_site_;
+
+    /// Number of times coarse graining a site has failed, one row of width_
+    std::vector<uint8_t> failures_;
+
+    size_t index_(const int & siteId, const size_t & row) const;
+    uint32_t increment_(const int & siteId);
+    uint32_t requiredReturns_(const int & siteId) const;
+    void forget_(const int & siteId);
+    void decay_();
+};
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_HOTSPOT_DETECTOR_HPP
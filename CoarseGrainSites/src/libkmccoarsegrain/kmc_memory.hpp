@@ -0,0 +1,53 @@
+#ifndef KMCCOARSEGRAIN_KMC_MEMORY_HPP
+#define KMCCOARSEGRAIN_KMC_MEMORY_HPP
+
+#include <cstddef>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Estimates of the heap memory held by the standard containers
+ *
+ * The estimates follow the node layout of libstdc++. Hash containers hold an
+ * array of bucket pointers and a node for each element, each node holds a
+ * pointer to the next node, the element and possibly its hash. Ordered
+ * containers hold three pointers and a color in each node. Memory taken up
+ * by the elements themselves, beyond their size, is not included.
+ **/
+namespace memory {
+
+  inline size_t bucketUsage(const size_t bucket_count) {
+    return bucket_count>1 ? bucket_count*sizeof(void *) : 0;
+  }
+
+  template<typename T>
+  size_t heapUsage(const std::vector<T> & values) {
+    return values.capacity()*sizeof(T);
+  }
+
+  template<typename Key, typename Value>
+  size_t heapUsage(const std::unordered_map<Key,Value> & values) {
+    typedef typename std::unordered_map<Key,Value>::value_type Node;
+    return bucketUsage(values.bucket_count()) +
+      values.size()*(sizeof(void *)+sizeof(size_t)+sizeof(Node));
+  }
+
+  template<typename Key>
+  size_t heapUsage(const std::unordered_set<Key> & values) {
+    return bucketUsage(values.bucket_count()) +
+      values.size()*(sizeof(void *)+sizeof(size_t)+sizeof(Key));
+  }
+
+  template<typename Key, typename Value>
+  size_t heapUsage(const std::map<Key,Value> & values) {
+    typedef typename std::map<Key,Value>::value_type Node;
+    return values.size()*(4*sizeof(void *)+sizeof(Node));
+  }
+}
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_MEMORY_HPP
@@ -0,0 +1,37 @@
+#include <sstream>
+
+#include "../../include/kmccoarsegrain/kmc_memory_usage.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_MemoryUsage::KMC_MemoryUsage() :
+    sites(0),
+    clusters(0),
+    topology_features(0),
+    random_engines(0),
+    rate_map(0),
+    rate_cache(0),
+    scratch(0) {}
+
+  size_t KMC_MemoryUsage::total() const {
+    return sites+clusters+topology_features+random_engines+rate_cache+
+      scratch;
+  }
+
+  string KMC_MemoryUsage::toJSON() const {
+    stringstream json;
+    json << "{";
+    json << "\"sites\": " << sites << ", ";
+    json << "\"clusters\": " << clusters << ", ";
+    json << "\"topology_features\": " << topology_features << ", ";
+    json << "\"random_engines\": " << random_engines << ", ";
+    json << "\"rate_map\": " << rate_map << ", ";
+    json << "\"rate_cache\": " << rate_cache << ", ";
+    json << "\"scratch\": " << scratch << ", ";
+    json << "\"total\": " << total();
+    json << "}";
+    return json.str();
+  }
+}
@@ -0,0 +1,35 @@
+#include "../../include/kmccoarsegrain/kmc_observables.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_Observables::KMC_Observables() :
+    displacement(0.0),
+    walker_time(0.0),
+    hops(0) {}
+
+  double KMC_Observables::getVelocity() const {
+    if(walker_time==0.0) return 0.0;
+    return displacement/walker_time;
+  }
+
+  double KMC_Observables::getMeanSquareDisplacement() const {
+    if(walker_displacements.empty()) return 0.0;
+    double sum = 0.0;
+    for(const pair<const int,double> & walker : walker_displacements){
+      sum += walker.second*walker.second;
+    }
+    return sum/static_cast<double>(walker_displacements.size());
+  }
+
+  void KMC_Observables::clear() {
+    displacement = 0.0;
+    walker_time = 0.0;
+    hops = 0;
+    for(long long & crossing : crossings) crossing = 0;
+    for(pair<const int,double> & walker : walker_displacements){
+      walker.second = 0.0;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#include <cassert>
+
+#include "kmc_memory.hpp"
+#include "kmc_rate_cache.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_RateCache::KMC_RateCache(
+      RateSource rate_source,
+      const size_t capacity) :
+    rate_source_(rate_source),
+    capacity_(capacity) {}
+
+  vector<pair<int,double *>> KMC_RateCache::load(const int & siteId) {
+    assert(rates_.count(siteId)==0 && "The site has already been loaded.");
+    vector<double> rates;
+    rate_source_(siteId,neighbors_,rates);
+    Rates_ & site_rates = rates_[siteId];
+    site_rates.rates.swap(rates);
+    recently_used_.push_front(siteId);
+    site_rates.position = recently_used_.begin();
+
+    vector<pair<int,double *>> neigh_rates;
+    neigh_rates.reserve(neighbors_.size());
+    for(size_t index = 0; index < neighbors_.size(); ++index){
+      neigh_rates.push_back(
+          pair<int,double *>(neighbors_[index],&site_rates.rates[index]));
+    }
+    return neigh_rates;
+  }
+
+  void KMC_RateCache::touch(const int & siteId) {
+    auto site_rates = rates_.find(siteId);
+    if(site_rates==rates_.end()) return;
+    recently_used_.splice(
+        recently_used_.begin(),
+        recently_used_,
+        site_rates->second.position);
+  }
+
+  vector<int> KMC_RateCache::evict(const function<bool(const int &)> & canEvict) {
+    vector<int> evicted;
+    // Each site is looked at no more than once
+    size_t remaining = recently_used_.size();
+    while(overCapacity() && remaining>0){
+      --remaining;
+      const int siteId = recently_used_.back();
+      if(!canEvict(siteId)){
+        recently_used_.splice(
+            recently_used_.begin(),
+            recently_used_,
+            prev(recently_used_.end()));
+        continue;
+      }
+      recently_used_.pop_back();
+      rates_.erase(siteId);
+      evicted.push_back(siteId);
+    }
+    return evicted;
+  }
+
+  size_t KMC_RateCache::getMemoryUsage() const {
+    size_t usage = sizeof(KMC_RateCache)+memory::heapUsage(rates_);
+    usage += memory::heapUsage(neighbors_);
+    // Each node of the list holds two pointers and the id
+    usage += recently_used_.size()*(2*sizeof(void *)+sizeof(int));
+    for(const pair<const int,Rates_> & site_rates : rates_){
+      usage += memory::heapUsage(site_rates.second.rates);
+    }
+    return usage;
+  }
+
+}
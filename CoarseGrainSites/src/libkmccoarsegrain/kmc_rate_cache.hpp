@@ -0,0 +1,84 @@
+#ifndef KMCCOARSEGRAIN_KMC_RATE_CACHE_HPP
+#define KMCCOARSEGRAIN_KMC_RATE_CACHE_HPP
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Holds the rates off the sites most recently used
+ *
+ * The rates off a site are worked out by the rate source when the site is
+ * loaded, and are kept until the site is evicted. Sites are evicted least
+ * recently used first, once more sites are loaded than the capacity of the
+ * cache. The rates of a site do not move in memory while it is loaded, so
+ * the site can point to them.
+ **/
+class KMC_RateCache {
+  public:
+    /**
+     * \brief Fills in the neighbors of a site, in order, and the rates to them
+     *
+     * For example KMC_RateProvider::getRatesOffSite or
+     * KMC_CompressedRateTable::getRatesOffSite.
+     **/
+    typedef std::function<void(
+        const int &,
+        std::vector<int> &,
+        std::vector<double> &)> RateSource;
+
+    KMC_RateCache(RateSource rate_source, const size_t capacity);
+
+    /**
+     * \brief Calculate the rates off the site and store them as the most
+     * recently used
+     *
+     * \return the neighbors of the site and pointers to the rates to them
+     **/
+    std::vector<std::pair<int,double *>> load(const int & siteId);
+
+    /// Mark the site as the most recently used, if it is loaded
+    void touch(const int & siteId);
+
+    bool overCapacity() const { return rates_.size()>capacity_; }
+
+    /**
+     * \brief Evict sites until the cache is back within its capacity
+     *
+     * Sites for which canEvict returns false are kept and marked as the most
+     * recently used, so the cache may stay over its capacity if there are
+     * not enough sites that can be evicted.
+     *
+     * \return ids of the sites evicted
+     **/
+    std::vector<int> evict(const std::function<bool(const int &)> & canEvict);
+
+    size_t size() const { return rates_.size(); }
+
+    /// Bytes of memory used by the cache
+    size_t getMemoryUsage() const;
+
+  private:
+    RateSource rate_source_;
+    size_t capacity_;
+
+    /// Site ids, the most recently used first
+    std::list<int> recently_used_;
+
+    struct Rates_ {
+      std::vector<double> rates;
+      std::list<int>::iterator position;
+    };
+    std::unordered_map<int,Rates_> rates_;
+
+    /// Reused to hold the neighbors of the site being loaded
+    std::vector<int> neighbors_;
+};
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_RATE_CACHE_HPP
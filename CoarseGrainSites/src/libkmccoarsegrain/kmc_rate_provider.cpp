@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#include "../../include/kmccoarsegrain/kmc_rate_provider.hpp"
+#include "../../include/kmccoarsegrain/kmc_rate_table.hpp"
+
+#include "kmc_cell_grid.hpp"
+#include "kmc_memory.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_RateProvider::KMC_RateProvider(
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const vector<double> & energies,
+      const double cutoff,
+      RateFunction rate_function,
+      unsigned int threads) :
+    x_(x),
+    y_(y),
+    z_(z),
+    energies_(energies),
+    rate_function_(rate_function) {
+
+    initialize_(cutoff,threads);
+  }
+
+  KMC_RateProvider::KMC_RateProvider(
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const vector<double> & energies,
+      const double cutoff,
+      const KMC_RateModel & model,
+      unsigned int threads) :
+    x_(x),
+    y_(y),
+    z_(z),
+    energies_(energies) {
+
+    rate_function_ = [model](double energy_difference, double dx, double distance){
+      return model.rate(energy_difference,dx,distance);
+    };
+    initialize_(cutoff,threads);
+  }
+
+  KMC_RateProvider::~KMC_RateProvider() {}
+
+  void KMC_RateProvider::initialize_(const double cutoff, unsigned int threads) {
+    const size_t number_of_sites = energies_.size();
+    if(x_.size()!=number_of_sites || y_.size()!=number_of_sites ||
+        z_.size()!=number_of_sites){
+      throw invalid_argument("There must be an x, y and z coordinate and an "
+          "energy for every site.");
+    }
+    if(!(cutoff>0.0)){
+      throw invalid_argument("The cutoff must be greater than 0.");
+    }
+    if(!rate_function_){
+      throw invalid_argument("A rate function must be given.");
+    }
+    if(threads==0) threads = max(1u,thread::hardware_concurrency());
+
+    grid_ = unique_ptr<KMC_CellGrid>(new KMC_CellGrid(
+          buildCellGrid(x_.data(),y_.data(),z_.data(),number_of_sites,cutoff)));
+
+    // Only whether a site has any neighbor matters, the count is not kept
+    vector<size_t> in_reach(number_of_sites,0);
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        grid_->visitNeighbors(siteId,[&](int){ ++in_reach[siteId]; });
+      }
+    });
+    for(const pair<int,int> & link : linkIsolatedSites(*grid_,in_reach)){
+      extra_neighbors_[link.first].push_back(link.second);
+    }
+  }
+
+  void KMC_RateProvider::getRatesOffSite(
+      const int & siteId,
+      vector<int> & neighbors,
+      vector<double> & rates) const {
+
+    if(siteId<0 || static_cast<size_t>(siteId)>=size()){
+      throw invalid_argument("Site "+to_string(siteId)+" is not one of the "
+          "sites of the rate provider.");
+    }
+    neighbors.clear();
+    rates.clear();
+    grid_->visitNeighbors(siteId,[&](const int neighId){
+      neighbors.push_back(neighId);
+    });
+    auto extra = extra_neighbors_.find(siteId);
+    if(extra!=extra_neighbors_.end()){
+      neighbors.insert(neighbors.end(),extra->second.begin(),extra->second.end());
+    }
+    sort(neighbors.begin(),neighbors.end());
+
+    rates.reserve(neighbors.size());
+    for(const int & neighId : neighbors){
+      rates.push_back(rate_function_(
+            energies_[neighId]-energies_[siteId],
+            x_[neighId]-x_[siteId],
+            sqrt(grid_->distanceSquared(siteId,neighId))));
+    }
+  }
+
+  size_t KMC_RateProvider::getMemoryUsage() const {
+    size_t usage = sizeof(KMC_RateProvider)+sizeof(KMC_CellGrid);
+    usage += memory::heapUsage(x_)+memory::heapUsage(y_)+memory::heapUsage(z_);
+    usage += memory::heapUsage(energies_);
+    usage += memory::heapUsage(grid_->begin)+memory::heapUsage(grid_->sites);
+    usage += memory::heapUsage(extra_neighbors_);
+    for(const auto & site_and_neighbors : extra_neighbors_){
+      usage += memory::heapUsage(site_and_neighbors.second);
+    }
+    return usage;
+  }
+
+}
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "../../include/kmccoarsegrain/kmc_rate_table.hpp"
+
+#include "kmc_cell_grid.hpp"
+#include "kmc_memory.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  /****************************************************************************
+   * Local Functions
+   ****************************************************************************/
+
+  /// The rates are calculated in place of the driving energies. There are no
+  /// branches in the loops so the compiler is able to vectorize them.
+  static void marcusKernel_(
+      double * rates,
+      const size_t count,
+      const KMC_RateModel & model){
+
+    const double hbar = 6.582E-16;
+    const double pi = acos(-1.0);
+    const double coefficient = 2.0*pi/hbar*
+      model.transfer_integral*model.transfer_integral/
+      sqrt(4.0*pi*model.reorganization_energy*model.kT);
+    const double scale = -1.0/(4.0*model.reorganization_energy*model.kT);
+    const double smallest = numeric_limits<double>::min();
+    for(size_t index = 0; index < count; ++index){
+      double energy = model.reorganization_energy+rates[index];
+      double rate = coefficient*exp(energy*energy*scale);
+      // Deep traps take the Marcus rate below what a double can hold
+      rates[index] = rate<smallest ? smallest : rate;
+    }
+  }
+
+  static void millerAbrahamsKernel_(
+      double * rates,
+      const double * distances,
+      const size_t count,
+      const KMC_RateModel & model){
+
+    const double distance_scale = -2.0/model.localization_length;
+    const double energy_scale = -1.0/model.kT;
+    const double smallest = numeric_limits<double>::min();
+    for(size_t index = 0; index < count; ++index){
+      // Hops down in energy are not sped up
+      double energy = rates[index]>0.0 ? rates[index] : 0.0;
+      double rate = model.attempt_rate*exp(
+          distances[index]*distance_scale+energy*energy_scale);
+      rates[index] = rate<smallest ? smallest : rate;
+    }
+  }
+
+  static void checkSites_(
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const vector<double> & energies,
+      const double cutoff){
+
+    const size_t number_of_sites = energies.size();
+    if(x.size()!=number_of_sites || y.size()!=number_of_sites ||
+        z.size()!=number_of_sites){
+      throw invalid_argument("There must be an x, y and z coordinate and an "
+          "energy for every site.");
+    }
+    if(!(cutoff>0.0)){
+      throw invalid_argument("The cutoff must be greater than 0.");
+    }
+  }
+
+  /// Fills in the offsets and the neighbors of every site, sorted by id
+  static void findNeighbors_(
+      const KMC_CellGrid & grid,
+      const size_t number_of_sites,
+      const unsigned int threads,
+      vector<size_t> & offsets,
+      vector<int> & neighbors){
+
+    vector<size_t> in_reach(number_of_sites,0);
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        grid.visitNeighbors(siteId,[&](int){ ++in_reach[siteId]; });
+      }
+    });
+
+    // Connect sites that are out of reach of all others to their nearest
+    // site, in both directions
+    const vector<pair<int,int>> extra_rates = linkIsolatedSites(grid,in_reach);
+
+    for(const pair<int,int> & extra_rate : extra_rates){
+      ++in_reach[extra_rate.first];
+    }
+    offsets.assign(number_of_sites+1,0);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      offsets[siteId+1] = offsets[siteId]+in_reach[siteId];
+    }
+
+    neighbors.resize(offsets[number_of_sites]);
+    vector<size_t> filled(offsets.begin(),offsets.end()-1);
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        grid.visitNeighbors(siteId,[&](int neighId){
+          neighbors[filled[siteId]++] = neighId;
+        });
+      }
+    });
+    for(const pair<int,int> & extra_rate : extra_rates){
+      neighbors[filled[extra_rate.first]++] = extra_rate.second;
+    }
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        sort(neighbors.begin()+offsets[siteId],
+            neighbors.begin()+offsets[siteId+1]);
+      }
+    });
+  }
+
+  /// Counts the neighbors with a larger id than each site, the pairs of
+  /// sites are stored with the site with the smaller id
+  static void countPairs_(KMC_CompressedRateTable & table){
+    const size_t number_of_sites = table.offsets.size()-1;
+    table.pair_offsets.assign(number_of_sites+1,0);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      auto last = table.neighbors.begin()+table.offsets[siteId+1];
+      auto first_larger = upper_bound(
+          table.neighbors.begin()+table.offsets[siteId],
+          last,
+          static_cast<int>(siteId));
+      table.pair_offsets[siteId+1] = table.pair_offsets[siteId]+
+        static_cast<size_t>(last-first_larger);
+    }
+    table.prefactors.resize(table.pair_offsets[number_of_sites]);
+  }
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  size_t KMC_RateTable::getMemoryUsage() const {
+    return sizeof(KMC_RateTable)+memory::heapUsage(offsets)+
+      memory::heapUsage(neighbors)+memory::heapUsage(rates);
+  }
+
+  void KMC_CompressedRateTable::getRatesOffSite(
+      const int & siteId,
+      vector<int> & neighIds,
+      vector<double> & rates) const {
+
+    if(siteId<0 || static_cast<size_t>(siteId)>=size()){
+      throw invalid_argument("Site "+to_string(siteId)+" is not one of the "
+          "sites of the compressed rate table.");
+    }
+    const size_t begin = offsets[siteId];
+    const size_t end = offsets[siteId+1];
+    // Index of the first neighbor with a larger id, the pairs with the
+    // neighbors before it are stored with the neighbors
+    const size_t larger = end-(pair_offsets[siteId+1]-pair_offsets[siteId]);
+    neighIds.assign(neighbors.begin()+begin,neighbors.begin()+end);
+    rates.resize(end-begin);
+
+    const double scale = -0.5/kT;
+    const double smallest = numeric_limits<double>::min();
+    for(size_t index = begin; index < end; ++index){
+      const int & neighId = neighbors[index];
+      size_t pair_index;
+      if(index>=larger){
+        pair_index = pair_offsets[siteId]+(index-larger);
+      }else{
+        auto neigh_end = neighbors.begin()+offsets[neighId+1];
+        auto neigh_larger = neigh_end-
+          (pair_offsets[neighId+1]-pair_offsets[neighId]);
+        pair_index = pair_offsets[neighId]+static_cast<size_t>(
+            lower_bound(neigh_larger,neigh_end,siteId)-neigh_larger);
+      }
+      double rate = prefactors[pair_index]*
+        exp((energies[neighId]-energies[siteId])*scale);
+      rates[index-begin] = rate<smallest ? smallest : rate;
+    }
+  }
+
+  size_t KMC_CompressedRateTable::getMemoryUsage() const {
+    return sizeof(KMC_CompressedRateTable)+memory::heapUsage(offsets)+
+      memory::heapUsage(neighbors)+memory::heapUsage(pair_offsets)+
+      memory::heapUsage(prefactors)+memory::heapUsage(energies);
+  }
+
+  KMC_CompressedRateTable compressRateTable(
+      const KMC_RateTable & rate_table,
+      const vector<double> & energies,
+      const double kT,
+      const double tolerance){
+
+    const size_t number_of_sites = rate_table.size();
+    if(energies.size()!=number_of_sites){
+      throw invalid_argument("There must be an energy for every site in the "
+          "rate table.");
+    }
+    if(!(kT>0.0)){
+      throw invalid_argument("kT must be greater than 0.");
+    }
+    const vector<size_t> & offsets = rate_table.offsets;
+    if(offsets.size()>0 && (offsets.front()!=0 ||
+          offsets.back()!=rate_table.neighbors.size())){
+      throw invalid_argument("The offsets of the rate table must run from 0 "
+          "to the number of neighbors.");
+    }
+    if(rate_table.rates.size()!=rate_table.neighbors.size()){
+      throw invalid_argument("The rate table must have a rate for every "
+          "neighbor.");
+    }
+
+    KMC_CompressedRateTable table;
+    table.offsets = rate_table.offsets;
+    table.energies = energies;
+    table.kT = kT;
+    if(number_of_sites==0){
+      table.pair_offsets.assign(1,0);
+      return table;
+    }
+
+    // The rows of the rate table do not have to be sorted
+    table.neighbors.resize(rate_table.neighbors.size());
+    vector<double> rates(rate_table.rates.size());
+    vector<pair<int,double>> row;
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      row.clear();
+      for(size_t index = table.offsets[siteId];
+          index < table.offsets[siteId+1]; ++index){
+        if(rate_table.neighbors[index]<0 ||
+            static_cast<size_t>(rate_table.neighbors[index])>=number_of_sites){
+          throw invalid_argument("Site "+
+              to_string(rate_table.neighbors[index])+" has no row in the rate "
+              "table, drains can not be compressed.");
+        }
+        row.push_back(pair<int,double>(
+              rate_table.neighbors[index],rate_table.rates[index]));
+      }
+      sort(row.begin(),row.end());
+      for(size_t index = 0; index < row.size(); ++index){
+        table.neighbors[table.offsets[siteId]+index] = row[index].first;
+        rates[table.offsets[siteId]+index] = row[index].second;
+      }
+    }
+
+    countPairs_(table);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      for(size_t index = table.offsets[siteId];
+          index < table.offsets[siteId+1]; ++index){
+        const int & neighId = table.neighbors[index];
+        auto neigh_begin = table.neighbors.begin()+table.offsets[neighId];
+        auto neigh_end = table.neighbors.begin()+table.offsets[neighId+1];
+        auto back = lower_bound(neigh_begin,neigh_end,static_cast<int>(siteId));
+        if(back==neigh_end || *back!=static_cast<int>(siteId)){
+          throw invalid_argument("There is a rate from site "+
+              to_string(siteId)+" to site "+to_string(neighId)+" but not "
+              "back.");
+        }
+        if(static_cast<size_t>(neighId)<siteId) continue;
+
+        double rate = rates[index];
+        double rate_back = rates[table.offsets[neighId]+(back-neigh_begin)];
+        double balanced_rate_back =
+          rate*exp((energies[neighId]-energies[siteId])/kT);
+        if(!(fabs(rate_back/balanced_rate_back-1.0)<=tolerance)){
+          throw invalid_argument("The rates between sites "+to_string(siteId)+
+              " and "+to_string(neighId)+" do not obey detailed balance.");
+        }
+        size_t larger = table.offsets[siteId+1]-
+          (table.pair_offsets[siteId+1]-table.pair_offsets[siteId]);
+        table.prefactors[table.pair_offsets[siteId]+(index-larger)] =
+          sqrt(rate)*sqrt(rate_back);
+      }
+    }
+    return table;
+  }
+
+  KMC_RateModel::KMC_RateModel() :
+    type(marcus),
+    kT(0.025),
+    reorganization_energy(0.01),
+    transfer_integral(0.01),
+    attempt_rate(1.0E12),
+    localization_length(0.1),
+    field(0.0) {}
+
+  double KMC_RateModel::rate(
+      double energy_difference,
+      double dx,
+      double distance) const {
+
+    // Moving along the field lowers the energy
+    double rate = energy_difference-field*dx;
+    if(type==miller_abrahams){
+      millerAbrahamsKernel_(&rate,&distance,1,*this);
+    }else{
+      marcusKernel_(&rate,1,*this);
+    }
+    return rate;
+  }
+
+  KMC_RateTable generateRateTable(
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const vector<double> & energies,
+      const double cutoff,
+      const KMC_RateModel & model,
+      unsigned int threads){
+
+    checkSites_(x,y,z,energies,cutoff);
+    const size_t number_of_sites = energies.size();
+    if(threads==0) threads = max(1u,thread::hardware_concurrency());
+
+    KMC_RateTable table;
+    table.offsets.assign(number_of_sites+1,0);
+    if(number_of_sites==0) return table;
+
+    const KMC_CellGrid grid =
+      buildCellGrid(x.data(),y.data(),z.data(),number_of_sites,cutoff);
+    findNeighbors_(grid,number_of_sites,threads,table.offsets,table.neighbors);
+
+    const vector<size_t> & offsets = table.offsets;
+    const size_t number_of_rates = offsets[number_of_sites];
+    table.rates.resize(number_of_rates);
+    // Filled with the driving energies and distances first, the rates are
+    // then calculated over the whole of the arrays at once
+    vector<double> distances(number_of_rates);
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        for(size_t index = offsets[siteId]; index < offsets[siteId+1]; ++index){
+          const int & neighId = table.neighbors[index];
+          double dx = x[neighId]-x[siteId];
+          distances[index] = sqrt(grid.distanceSquared(siteId,neighId));
+          // Moving along the field lowers the energy
+          table.rates[index] = energies[neighId]-energies[siteId]-model.field*dx;
+        }
+      }
+    });
+
+    parallelFor(number_of_rates,threads,[&](size_t begin, size_t end){
+      if(model.type==KMC_RateModel::miller_abrahams){
+        millerAbrahamsKernel_(
+            table.rates.data()+begin,
+            distances.data()+begin,
+            end-begin,
+            model);
+      }else{
+        marcusKernel_(table.rates.data()+begin,end-begin,model);
+      }
+    });
+
+    return table;
+  }
+
+  KMC_CompressedRateTable generateCompressedRateTable(
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const vector<double> & energies,
+      const double cutoff,
+      const KMC_RateModel & model,
+      unsigned int threads){
+
+    checkSites_(x,y,z,energies,cutoff);
+    const size_t number_of_sites = energies.size();
+    if(threads==0) threads = max(1u,thread::hardware_concurrency());
+
+    KMC_CompressedRateTable table;
+    table.kT = model.kT;
+    // Moving along the field lowers the energy
+    table.energies.resize(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      table.energies[siteId] = energies[siteId]-model.field*x[siteId];
+    }
+    table.offsets.assign(number_of_sites+1,0);
+    table.pair_offsets.assign(number_of_sites+1,0);
+    if(number_of_sites==0) return table;
+
+    const KMC_CellGrid grid =
+      buildCellGrid(x.data(),y.data(),z.data(),number_of_sites,cutoff);
+    findNeighbors_(grid,number_of_sites,threads,table.offsets,table.neighbors);
+    countPairs_(table);
+
+    // The prefactor is worked out from the hop down in energy, which is the
+    // faster of the two
+    const double scale = -0.5/model.kT;
+    parallelFor(number_of_sites,threads,[&](size_t begin, size_t end){
+      for(size_t siteId = begin; siteId < end; ++siteId){
+        size_t pair_index = table.pair_offsets[siteId];
+        size_t larger = table.offsets[siteId+1]-
+          (table.pair_offsets[siteId+1]-pair_index);
+        for(size_t index = larger; index < table.offsets[siteId+1]; ++index){
+          const int & neighId = table.neighbors[index];
+          double driving_energy = table.energies[neighId]-table.energies[siteId];
+          double dx = x[neighId]-x[siteId];
+          if(driving_energy>0.0){
+            driving_energy = -driving_energy;
+            dx = -dx;
+          }
+          double distance = sqrt(grid.distanceSquared(siteId,neighId));
+          // The field is already part of the driving energy
+          double rate = model.rate(driving_energy+model.field*dx,dx,distance);
+          table.prefactors[pair_index++] = rate*exp(-driving_energy*scale);
+        }
+      }
+    });
+
+    return table;
+  }
+
+}
@@ -0,0 +1,40 @@
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#include "kmc_rate_tree.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_RateTree::KMC_RateTree() :
+    random_engine_(chrono::system_clock::now().time_since_epoch().count()),
+    random_distribution_(0.0,1.0) {}
+
+  void KMC_RateTree::setRandomSeed(const unsigned long seed){
+    random_engine_ = mt19937(seed);
+  }
+
+  void KMC_RateTree::setRate(const int handle, const double rate){
+    assert(handle>=0);
+    rates_.set(static_cast<size_t>(handle),rate);
+  }
+
+  double KMC_RateTree::drawTimeStep(){
+    assert(rates_.total()>0.0);
+    double number = random_distribution_(random_engine_);
+    return (-1.0)*log(number)/rates_.total();
+  }
+
+  int KMC_RateTree::pickWalker(){
+    assert(rates_.total()>0.0);
+    double sum = random_distribution_(random_engine_)*rates_.total();
+    return static_cast<int>(rates_.find(sum));
+  }
+
+  size_t KMC_RateTree::getMemoryUsage() const {
+    return sizeof(KMC_RateTree)-sizeof(KMC_SumTree)+rates_.getMemoryUsage();
+  }
+
+}
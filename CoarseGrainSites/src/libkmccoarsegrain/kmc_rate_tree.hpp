@@ -0,0 +1,47 @@
+#ifndef KMCCOARSEGRAIN_KMC_RATE_TREE_HPP
+#define KMCCOARSEGRAIN_KMC_RATE_TREE_HPP
+
+#include <random>
+
+#include "../../include/kmccoarsegrain/kmc_sum_tree.hpp"
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Picks the next walker to hop from the rates the walkers escape at
+ *
+ * The rate of each walker is stored in a sum tree indexed by the handle of
+ * the walker. Each event takes a single exponential draw for the time step,
+ * with the total rate of all of the walkers, and a single uniform draw to
+ * pick the walker in proportion to its rate (Bortz, Kalos and Lebowitz).
+ **/
+class KMC_RateTree {
+  public:
+    KMC_RateTree();
+
+    void setRandomSeed(const unsigned long seed);
+
+    /// A walker with a rate of zero is never picked
+    void setRate(const int handle, const double rate);
+    double getRate(const int handle) const { return rates_.get(handle); }
+    double getTotalRate() const { return rates_.total(); }
+
+    /// Time until the next event of any of the walkers
+    double drawTimeStep();
+
+    /// Handle of the walker the next event belongs to
+    int pickWalker();
+
+    /// Bytes of memory used by the tree
+    size_t getMemoryUsage() const;
+
+  private:
+    KMC_SumTree rates_;
+
+    std::mt19937 random_engine_;
+    std::uniform_real_distribution<double> random_distribution_;
+};
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_RATE_TREE_HPP
@@ -0,0 +1,233 @@
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "../../include/kmccoarsegrain/kmc_constants.hpp"
+#include "../../include/kmccoarsegrain/kmc_walker_store.hpp"
+
+#include "topologyfeatures/kmc_site.hpp"
+#include "kmc_memory.hpp"
+#include "kmc_rejection_free.hpp"
+#include "kmc_site_container.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_RejectionFree::KMC_RejectionFree(KMC_Site_Container & sites) :
+    time_(0.0),
+    random_engine_(chrono::system_clock::now().time_since_epoch().count()),
+    random_distribution_(0.0,1.0) {
+
+    for(const int & siteId : sites.getSiteIds()){
+      site_indices_[siteId] = static_cast<int>(sites_.size());
+      sites_.push_back(&sites.getKMC_Site(siteId));
+    }
+    occupants_.resize(sites_.size(),constants::unassignedId);
+
+    vector<size_t> incoming_count(sites_.size()+1,0);
+    neighbor_begin_.push_back(0);
+    for(const KMC_Site * site : sites_){
+      for(const pair<const int,double *> & neigh_and_rate :
+          site->getNeighborsAndRatesConst()){
+        int neighIndex = site_indices_.at(neigh_and_rate.first);
+        neighbors_.push_back(
+            pair<int,const double *>(neighIndex,neigh_and_rate.second));
+        ++incoming_count[neighIndex+1];
+      }
+      neighbor_begin_.push_back(neighbors_.size());
+    }
+
+    incoming_begin_.resize(sites_.size()+1,0);
+    for(size_t index = 0; index < sites_.size(); ++index){
+      incoming_begin_[index+1] = incoming_begin_[index]+incoming_count[index+1];
+    }
+    incoming_.resize(neighbors_.size());
+    vector<size_t> next_incoming(incoming_begin_.begin(),incoming_begin_.end()-1);
+    for(size_t index = 0; index < sites_.size(); ++index){
+      for(size_t neighbor = neighbor_begin_[index];
+          neighbor < neighbor_begin_[index+1]; ++neighbor){
+        const int & neighIndex = neighbors_[neighbor].first;
+        incoming_[next_incoming[neighIndex]++] = pair<int,const double *>(
+            static_cast<int>(index),neighbors_[neighbor].second);
+      }
+    }
+  }
+
+  void KMC_RejectionFree::setRandomSeed(const unsigned long seed){
+    random_engine_ = mt19937(seed);
+  }
+
+  void KMC_RejectionFree::initializeWalkers(KMC_WalkerStore & walkers){
+    walker_sites_.resize(walkers.capacity(),constants::unassignedId);
+    free_rates_.resize(walkers.capacity(),0.0);
+    free_neighbors_.resize(walkers.capacity(),0);
+    arrival_times_.resize(walkers.capacity(),0.0);
+
+    vector<int> handles = walkers.getHandles();
+    // Every walker must be in place before the free neighbors are counted
+    for(const int & handle : handles){
+      auto index = site_indices_.find(walkers.getSite(handle));
+      if(index==site_indices_.end()){
+        throw invalid_argument("Walker "+to_string(handle)+" is not on a "
+            "site known to the system.");
+      }
+      walker_sites_[handle] = index->second;
+      sites_[index->second]->occupy();
+      if(!sites_[index->second]->isDrain()) occupants_[index->second] = handle;
+    }
+    for(const int & handle : handles){
+      arrival_times_[handle] = walkers.getTime(handle);
+      placeWalker_(walkers,handle);
+    }
+  }
+
+  double KMC_RejectionFree::hop(KMC_WalkerStore & walkers, const int handle){
+    assert(free_rates_[handle]>0.0 && "The walker is not able to hop");
+    time_ = walkers.getTime(handle);
+    const int index = walker_sites_[handle];
+
+    double threshold = random_distribution_(random_engine_)*free_rates_[handle];
+    int new_index = constants::unassignedId;
+    for(size_t neighbor = neighbor_begin_[index];
+        neighbor < neighbor_begin_[index+1]; ++neighbor){
+      const int & neighIndex = neighbors_[neighbor].first;
+      if(sites_[neighIndex]->isOccupied()) continue;
+      // Rounding can leave the threshold just above the sum of the rates, in
+      // which case the last free neighbor is picked
+      new_index = neighIndex;
+      threshold -= *neighbors_[neighbor].second;
+      if(threshold<0.0) break;
+    }
+    assert(new_index!=constants::unassignedId);
+
+    vacate_(walkers,index);
+    occupy_(walkers,new_index,handle);
+    walker_sites_[handle] = new_index;
+    walkers.setSite(handle,sites_[new_index]->getId());
+
+    const double dwell_time = time_-arrival_times_[handle];
+    arrival_times_[handle] = time_;
+    placeWalker_(walkers,handle);
+    return dwell_time;
+  }
+
+  void KMC_RejectionFree::removeWalker(
+      KMC_WalkerStore & walkers,
+      const int handle){
+
+    assert(walkers.contains(handle));
+    const int index = walker_sites_[handle];
+    walker_sites_[handle] = constants::unassignedId;
+    free_rates_[handle] = 0.0;
+    free_neighbors_[handle] = 0;
+    vacate_(walkers,index);
+  }
+
+  size_t KMC_RejectionFree::getMemoryUsage() const {
+    return sizeof(KMC_RejectionFree) + memory::heapUsage(sites_) +
+      memory::heapUsage(site_indices_) + memory::heapUsage(neighbor_begin_) +
+      memory::heapUsage(neighbors_) + memory::heapUsage(incoming_begin_) +
+      memory::heapUsage(incoming_) + memory::heapUsage(occupants_) +
+      memory::heapUsage(walker_sites_) + memory::heapUsage(free_rates_) +
+      memory::heapUsage(free_neighbors_) + memory::heapUsage(arrival_times_);
+  }
+
+  /****************************************************************************
+   * Private Functions
+   ****************************************************************************/
+
+  double KMC_RejectionFree::drawDwellTime_(const double & rate){
+    double number = random_distribution_(random_engine_);
+    return (-1.0)*log(number)/rate;
+  }
+
+  void KMC_RejectionFree::placeWalker_(
+      KMC_WalkerStore & walkers,
+      const int handle){
+
+    const int & index = walker_sites_[handle];
+    double rate = 0.0;
+    int free_neighbors = 0;
+    // Walkers are never released by a drain
+    if(!sites_[index]->isDrain()){
+      for(size_t neighbor = neighbor_begin_[index];
+          neighbor < neighbor_begin_[index+1]; ++neighbor){
+        if(sites_[neighbors_[neighbor].first]->isOccupied()) continue;
+        rate += *neighbors_[neighbor].second;
+        ++free_neighbors;
+      }
+    }
+    free_rates_[handle] = rate;
+    free_neighbors_[handle] = free_neighbors;
+
+    double dwell_time = numeric_limits<double>::infinity();
+    if(free_neighbors>0) dwell_time = drawDwellTime_(rate);
+    walkers.setDwellTime(handle,dwell_time);
+    walkers.setTime(handle,arrival_times_[handle]+dwell_time);
+  }
+
+  void KMC_RejectionFree::setFreeRate_(
+      KMC_WalkerStore & walkers,
+      const int handle,
+      const double rate,
+      const int free_neighbors){
+
+    const double old_rate = free_rates_[handle];
+    free_neighbors_[handle] = free_neighbors;
+    // The count avoids rounding leaving a rate when no neighbors are free
+    free_rates_[handle] = free_neighbors>0 ? rate : 0.0;
+
+    double time = walkers.getTime(handle);
+    if(free_neighbors==0){
+      time = numeric_limits<double>::infinity();
+    }else if(old_rate==0.0){
+      time = time_+drawDwellTime_(free_rates_[handle]);
+    }else{
+      time = time_+(time-time_)*old_rate/free_rates_[handle];
+    }
+    walkers.setDwellTime(handle,time-arrival_times_[handle]);
+    walkers.setTime(handle,time);
+  }
+
+  void KMC_RejectionFree::vacate_(KMC_WalkerStore & walkers, const int index){
+    sites_[index]->vacate();
+    // A drain is always free to hop to
+    if(sites_[index]->isDrain()) return;
+    occupants_[index] = constants::unassignedId;
+    for(size_t incoming = incoming_begin_[index];
+        incoming < incoming_begin_[index+1]; ++incoming){
+      const int & neighbor = occupants_[incoming_[incoming].first];
+      if(neighbor==constants::unassignedId) continue;
+      setFreeRate_(
+          walkers,
+          neighbor,
+          free_rates_[neighbor]+*incoming_[incoming].second,
+          free_neighbors_[neighbor]+1);
+    }
+  }
+
+  void KMC_RejectionFree::occupy_(
+      KMC_WalkerStore & walkers,
+      const int index,
+      const int handle){
+
+    sites_[index]->occupy();
+    if(sites_[index]->isDrain()) return;
+    occupants_[index] = handle;
+    for(size_t incoming = incoming_begin_[index];
+        incoming < incoming_begin_[index+1]; ++incoming){
+      const int & neighbor = occupants_[incoming_[incoming].first];
+      if(neighbor==constants::unassignedId) continue;
+      setFreeRate_(
+          walkers,
+          neighbor,
+          free_rates_[neighbor]-*incoming_[incoming].second,
+          free_neighbors_[neighbor]-1);
+    }
+  }
+
+}
@@ -0,0 +1,118 @@
+#ifndef KMCCOARSEGRAIN_KMC_REJECTION_FREE_HPP
+#define KMCCOARSEGRAIN_KMC_REJECTION_FREE_HPP
+
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+class KMC_Site;
+class KMC_Site_Container;
+class KMC_WalkerStore;
+
+/**
+ * \brief Moves walkers without ever attempting a hop onto an occupied site
+ *
+ * The rate each walker leaves its site at is the sum of the rates to the
+ * neighbors that are free, the neighbor is picked from among the free ones
+ * when the walker hops. Hopping changes which neighbors are free for the
+ * walkers around the site that was left and the site that was entered. Only
+ * the rates of those walkers are updated, by adding or taking away the rate
+ * to the site that changed.
+ *
+ * When the rate of a walker changes the time it has left before it hops is
+ * scaled by the ratio of the old rate to the new one. The time left is
+ * exponentially distributed so scaling it gives a time drawn with the new
+ * rate, without drawing another random number. A walker with no free
+ * neighbors is given an infinite time until one of them is freed.
+ *
+ * Rejection free kinetics only makes sense if the time of every walker can be
+ * changed, so the walkers must be held in a KMC_WalkerStore.
+ **/
+class KMC_RejectionFree {
+  public:
+    /**
+     * \brief Indexes the sites and the rates between them
+     *
+     * The rates are read through the pointers held by the sites, so the
+     * sites must not be removed from the container while it is used.
+     **/
+    explicit KMC_RejectionFree(KMC_Site_Container & sites);
+
+    void setRandomSeed(const unsigned long seed);
+
+    /**
+     * \brief Places all of the walkers then draws the time each first hops
+     *
+     * Throws an invalid_argument if a walker is on a site that is not known.
+     **/
+    void initializeWalkers(KMC_WalkerStore & walkers);
+
+    /**
+     * \brief Moves the walker to one of its free neighbors
+     *
+     * The walker must be the one with the earliest time.
+     *
+     * \return the time the walker spent on the site it left
+     **/
+    double hop(KMC_WalkerStore & walkers, const int handle);
+
+    /**
+     * \brief Frees the site of the walker as of the last hop
+     **/
+    void removeWalker(KMC_WalkerStore & walkers, const int handle);
+
+    /// Bytes of memory used to track the walkers
+    size_t getMemoryUsage() const;
+
+  private:
+    /// Sites in the order they are indexed
+    std::vector<KMC_Site *> sites_;
+    std::unordered_map<int,int> site_indices_;
+
+    /// Neighbors of the sites and the rates to them, the neighbors of site
+    /// index run from neighbor_begin_[index] to neighbor_begin_[index+1]
+    std::vector<size_t> neighbor_begin_;
+    std::vector<std::pair<int,const double *>> neighbors_;
+
+    /// Sites with a rate to each site, stored in the same way
+    std::vector<size_t> incoming_begin_;
+    std::vector<std::pair<int,const double *>> incoming_;
+
+    /// Handle of the walker on each site, or constants::unassignedId
+    std::vector<int> occupants_;
+
+    /// Index of the site, rate to free neighbors, number of free neighbors
+    /// and time of arrival of each walker, indexed by handle
+    std::vector<int> walker_sites_;
+    std::vector<double> free_rates_;
+    std::vector<int> free_neighbors_;
+    std::vector<double> arrival_times_;
+
+    /// Time of the last hop
+    double time_;
+
+    std::mt19937 random_engine_;
+    std::uniform_real_distribution<double> random_distribution_;
+
+    double drawDwellTime_(const double & rate);
+
+    /// Sums the rates of the walker to its free neighbors and draws its hop
+    void placeWalker_(KMC_WalkerStore & walkers, const int handle);
+
+    /// Changes the rate of the walker and scales the time it has left
+    void setFreeRate_(
+        KMC_WalkerStore & walkers,
+        const int handle,
+        const double rate,
+        const int free_neighbors);
+
+    void vacate_(KMC_WalkerStore & walkers, const int index);
+    void occupy_(KMC_WalkerStore & walkers, const int index, const int handle);
+};
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_REJECTION_FREE_HPP
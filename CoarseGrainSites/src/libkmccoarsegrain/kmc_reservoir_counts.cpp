@@ -0,0 +1,10 @@
+#include "../../include/kmccoarsegrain/kmc_reservoir_counts.hpp"
+
+namespace kmccoarsegrain {
+
+  KMC_ReservoirCounts::KMC_ReservoirCounts() :
+    injected(0),
+    blocked_injections(0),
+    extracted(0) {}
+
+}
@@ -0,0 +1,99 @@
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+#include "kmc_reservoirs.hpp"
+#include "kmc_checkpoint.hpp"
+#include "kmc_memory.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_Reservoirs::KMC_Reservoirs() :
+    total_rate_(0.0),
+    random_engine_(chrono::system_clock::now().time_since_epoch().count()),
+    random_distribution_(0.0,1.0),
+    injected_(0),
+    blocked_injections_(0) {}
+
+  void KMC_Reservoirs::setRandomSeed(const unsigned long seed){
+    random_engine_ = mt19937(seed);
+  }
+
+  void KMC_Reservoirs::addSource(const int & siteId, const double & rate){
+    assert(rate>0.0 && "The injection rate must be greater than 0");
+    total_rate_ += rate;
+    for(pair<int,double> & source : sources_){
+      if(source.first==siteId){
+        source.second += rate;
+        return;
+      }
+    }
+    sources_.push_back(pair<int,double>(siteId,rate));
+  }
+
+  bool KMC_Reservoirs::isSource(const int & siteId) const {
+    for(const pair<int,double> & source : sources_){
+      if(source.first==siteId) return true;
+    }
+    return false;
+  }
+
+  double KMC_Reservoirs::getInjectionDwellTime(){
+    assert(hasSources());
+    double number = random_distribution_(random_engine_);
+    return (-1.0)*log(number)/total_rate_;
+  }
+
+  int KMC_Reservoirs::pickSourceSiteId(){
+    assert(hasSources());
+    double threshold = random_distribution_(random_engine_)*total_rate_;
+    for(const pair<int,double> & source : sources_){
+      threshold -= source.second;
+      if(threshold<0.0) return source.first;
+    }
+    // Rounding can leave the threshold just above the sum of the rates
+    return sources_.back().first;
+  }
+
+  bool KMC_Reservoirs::containsDrain(const vector<int> & siteIds) const {
+    if(drains_.empty()) return false;
+    for(const int & siteId : siteIds){
+      if(drains_.count(siteId)) return true;
+    }
+    return false;
+  }
+
+  void KMC_Reservoirs::recordInjection(const bool injected){
+    if(injected){
+      ++injected_;
+    }else{
+      ++blocked_injections_;
+    }
+  }
+
+  size_t KMC_Reservoirs::getMemoryUsage() const {
+    return sizeof(KMC_Reservoirs) + memory::heapUsage(sources_) +
+      memory::heapUsage(drains_);
+  }
+
+  void KMC_Reservoirs::writeCheckpoint(checkpoint::Writer & writer) const {
+    writer.write(sources_);
+    writer.write(total_rate_);
+    writer.write(drains_);
+    writer.write(random_engine_);
+    writer.write(injected_);
+    writer.write(blocked_injections_);
+  }
+
+  void KMC_Reservoirs::readCheckpoint(checkpoint::Reader & reader) {
+    reader.read(sources_);
+    reader.read(total_rate_);
+    reader.read(drains_);
+    reader.read(random_engine_);
+    random_distribution_.reset();
+    reader.read(injected_);
+    reader.read(blocked_injections_);
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef KMCCOARSEGRAIN_KMC_RESERVOIRS_HPP
+#define KMCCOARSEGRAIN_KMC_RESERVOIRS_HPP
+
+#include <random>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace kmccoarsegrain {
+
+namespace checkpoint {
+class Writer;
+class Reader;
+}
+
+/**
+ * \brief Keeps track of the sources and drains of walkers
+ *
+ * Injections from all of the sources form a single Poisson process with the
+ * sum of their rates, the source each walker comes from is picked in
+ * proportion to its rate. The absorbing itself is done by the drain sites,
+ * see KMC_Site::setDrain, so hops cost nothing extra.
+ **/
+class KMC_Reservoirs {
+  public:
+    KMC_Reservoirs();
+
+    void setRandomSeed(const unsigned long seed);
+
+    /**
+     * \brief Adds to the rate walkers are injected onto the site
+     **/
+    void addSource(const int & siteId, const double & rate);
+    bool hasSources() const { return !sources_.empty(); }
+    bool isSource(const int & siteId) const;
+
+    /**
+     * \brief Time until the next walker is injected by any of the sources
+     **/
+    double getInjectionDwellTime();
+
+    /**
+     * \brief Site the next walker is injected onto
+     **/
+    int pickSourceSiteId();
+
+    void addDrain(const int & siteId) { drains_.insert(siteId); }
+    bool isDrain(const int & siteId) const { return drains_.count(siteId)!=0; }
+    const std::unordered_set<int> & getDrainIds() const { return drains_; }
+
+    /// Determines if any of the sites are drains
+    bool containsDrain(const std::vector<int> & siteIds) const;
+
+    void recordInjection(const bool injected);
+    long long getInjected() const { return injected_; }
+    long long getBlockedInjections() const { return blocked_injections_; }
+
+    /// Bytes of memory used by the reservoirs
+    size_t getMemoryUsage() const;
+
+    void writeCheckpoint(checkpoint::Writer & writer) const;
+    void readCheckpoint(checkpoint::Reader & reader);
+
+  private:
+    /// Site id and injection rate of each source
+    std::vector<std::pair<int,double>> sources_;
+
+    double total_rate_;
+
+    std::unordered_set<int> drains_;
+
+    std::mt19937 random_engine_;
+    std::uniform_real_distribution<double> random_distribution_;
+
+    long long injected_;
+    long long blocked_injections_;
+};
+
+}
+
+#endif // KMCCOARSEGRAIN_KMC_RESERVOIRS_HPP
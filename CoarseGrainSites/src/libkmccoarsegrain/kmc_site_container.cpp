@@ -1,5 +1,7 @@
 
 #include "kmc_site_container.hpp"
+#include "kmc_checkpoint.hpp"
+#include "kmc_memory.hpp"
 
 using namespace std;
 
@@ -9,7 +11,15 @@ namespace kmccoarsegrain {
     if(sites_.count(site.getId())){
       throw invalid_argument("Cannot add site it has already been added.");
     }
-    sites_[site.getId()] = site;
+    sites_.emplace(site.getId(),site);
+  }
+
+  void KMC_Site_Container::addKMC_Site(KMC_Site&& site){
+    if(sites_.count(site.getId())){
+      throw invalid_argument("Cannot add site it has already been added.");
+    }
+    const int siteId = site.getId();
+    sites_.emplace(siteId,move(site));
   }
 
   void KMC_Site_Container::addKMC_Sites(vector<KMC_Site>& sites){
@@ -19,7 +29,7 @@ namespace kmccoarsegrain {
   }
 
   KMC_Site& KMC_Site_Container::getKMC_Site(const int & siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Site is not stored in the container.");
     }
     return sites_[siteId];
@@ -28,7 +38,7 @@ namespace kmccoarsegrain {
   unordered_map<int,KMC_Site> KMC_Site_Container::getKMC_Sites(vector<int> siteIds){
     unordered_map<int,KMC_Site> sites;
     for( auto siteId : siteIds ){
-      if(sites_.count(siteId)){
+      if(load(siteId)){
         sites[siteId] = sites_[siteId];
       }else{
         throw invalid_argument("Site is not found in the container.");
@@ -42,21 +52,21 @@ namespace kmccoarsegrain {
   } 
 
   void KMC_Site_Container::setClusterId(int siteId, int clusterId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Site is not stored in the container.");
     }
     sites_[siteId].setClusterId(clusterId);
   }
 
   int KMC_Site_Container::getClusterIdOfSite(int siteId) {
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Site is not stored in the container.");
     }
     return sites_[siteId].getClusterId();
   }
 
   bool KMC_Site_Container::partOfCluster(int siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Site is not stored in the container.");
     }
     return sites_[siteId].partOfCluster();
@@ -80,9 +90,25 @@ namespace kmccoarsegrain {
   bool KMC_Site_Container::exist(const int & siteId) const{
     return sites_.count(siteId)!=0;
   }
+
+  void KMC_Site_Container::setSiteLoader(
+      function<void(const int &)> site_loader){
+    site_loader_ = site_loader;
+  }
+
+  void KMC_Site_Container::erase(const int & siteId){
+    sites_.erase(siteId);
+  }
+
+  bool KMC_Site_Container::load(const int & siteId){
+    if(sites_.count(siteId)) return true;
+    if(!site_loader_) return false;
+    site_loader_(siteId);
+    return sites_.count(siteId)!=0;
+  }
   
   bool KMC_Site_Container::isOccupied(const int & siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot determine if site is occupied as it is not"
           " stored in the container");
     }
@@ -90,7 +116,7 @@ namespace kmccoarsegrain {
   }
 
   void KMC_Site_Container::vacate(const int & siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot vacate as site is not stored in the "
           "container.");
     }
@@ -98,7 +124,7 @@ namespace kmccoarsegrain {
   }
 
   void KMC_Site_Container::occupy(const int & siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot occupy site as it is not stored in the "
           "container.");
     }
@@ -142,7 +168,7 @@ namespace kmccoarsegrain {
   }
 */
   double KMC_Site_Container::getDwellTime(int siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot get site dwell time as site is not in the "
           "container.");
     }
@@ -150,7 +176,7 @@ namespace kmccoarsegrain {
   }
 
   double KMC_Site_Container::getTimeConstant(int siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot get site time constant as site is not in "
           "the container.");
     }
@@ -167,7 +193,7 @@ namespace kmccoarsegrain {
   }
 
   double KMC_Site_Container::getFastestRateOffSite(int siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot get fastest rate off site as it is not "
           "stored in the container.");
     }
@@ -175,7 +201,7 @@ namespace kmccoarsegrain {
   }
 
   double KMC_Site_Container::getRateToNeighborOfSite(int siteId, int neighId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot get rate from site to neighbor as site is "
           "not stored in the container");
     }
@@ -183,10 +209,57 @@ namespace kmccoarsegrain {
   }
 
   vector<int> KMC_Site_Container::getSiteIdsOfNeighbors(int siteId){
-    if(sites_.count(siteId)==0){
+    if(!load(siteId)){
       throw invalid_argument("Cannot get neighbor site ids from site as site is "
           "not stored in the container");
     }
     return sites_[siteId].getNeighborSiteIds();
   }
+
+  size_t KMC_Site_Container::getMemoryUsage() const {
+    size_t usage = memory::heapUsage(sites_);
+    for(const pair<const int,KMC_Site> & site : sites_){
+      usage += site.second.getMemoryUsage()-sizeof(KMC_Site);
+    }
+    return usage;
+  }
+
+  size_t KMC_Site_Container::getRateMapMemoryUsage() const {
+    // The maps are assumed to have a bucket for each element
+    typedef unordered_map<int,double>::value_type Rate;
+    typedef unordered_map<int,unordered_map<int,double>>::value_type SiteRates;
+    size_t usage = 0;
+    for(const pair<const int,KMC_Site> & site : sites_){
+      size_t neighbors = site.second.getNeighborsAndRatesConst().size();
+      if(neighbors==0) continue;
+      usage += 2*sizeof(void *)+sizeof(size_t)+sizeof(SiteRates);
+      usage += neighbors*(2*sizeof(void *)+sizeof(size_t)+sizeof(Rate));
+    }
+    return usage;
+  }
+
+  void KMC_Site_Container::writeCheckpoint(checkpoint::Writer & writer) const {
+    writer.writeSize(sites_.size());
+    for(const pair<const int,KMC_Site> & site : sites_){
+      writer.write(site.first);
+      site.second.writeCheckpoint(writer);
+    }
+  }
+
+  void KMC_Site_Container::readCheckpoint(checkpoint::Reader & reader) {
+    size_t number_of_sites = reader.readSize();
+    if(number_of_sites!=sites_.size()){
+      throw runtime_error("The checkpoint has "+to_string(number_of_sites)+
+          " sites, the system was initialized with "+to_string(sites_.size()));
+    }
+    for(size_t index = 0; index < number_of_sites; ++index){
+      int siteId;
+      reader.read(siteId);
+      if(sites_.count(siteId)==0){
+        throw runtime_error("Site "+to_string(siteId)+" in the checkpoint is "
+            "not part of the system");
+      }
+      sites_[siteId].readCheckpoint(reader);
+    }
+  }
 }
@@ -1,6 +1,7 @@
 #ifndef KMCCOARSEGRAIN_KMC_SITE_CONTAINER_HPP
 #define KMCCOARSEGRAIN_KMC_SITE_CONTAINER_HPP
 
+#include <functional>
 #include <unordered_map>
 
 #include "log.hpp"
@@ -18,6 +19,7 @@ class KMC_Site_Container {
     KMC_Site_Container() {};
 
     void addKMC_Site(KMC_Site& site);
+    void addKMC_Site(KMC_Site&& site);
     void addKMC_Sites(std::vector<KMC_Site>& sites);
     KMC_Site& getKMC_Site(const int & siteId);
 
@@ -30,8 +32,24 @@ class KMC_Site_Container {
     bool partOfCluster(int siteId);
     int getSmallestClusterId(std::vector<int> siteIds);
 
+    /// Determines if the site is stored, sites are not loaded
     bool exist(const int & siteId) const;
 
+    /**
+     * \brief Function called with the id of a site that is not stored
+     *
+     * It is called before the container looks up the site, giving it the
+     * chance to add the site with addKMC_Site. If the site is still not
+     * stored the container throws as usual.
+     **/
+    void setSiteLoader(std::function<void(const int &)> site_loader);
+
+    /// Loads the site if it is not stored, false if it still is not
+    bool load(const int & siteId);
+
+    /// Removes the site from the container
+    void erase(const int & siteId);
+
     bool isOccupied(const int & siteId);
     void vacate(const int & siteId);
     void occupy(const int & siteId);
@@ -45,9 +63,22 @@ class KMC_Site_Container {
     double getFastestRateOffSite(int siteId);
     double getRateToNeighborOfSite(int siteId, int neighId);
     std::vector<int> getSiteIdsOfNeighbors(int siteId);
+
+    /// Bytes of memory used by the container and the sites
+    size_t getMemoryUsage() const;
+    /// Estimate of the bytes used by the map holding the rates the sites
+    /// point to
+    size_t getRateMapMemoryUsage() const;
+
+    /// Writes the state of every site
+    void writeCheckpoint(checkpoint::Writer & writer) const;
+    /// Reads the state of every site, the container must hold the same sites
+    void readCheckpoint(checkpoint::Reader & reader);
   private:
     std::unordered_map<int,KMC_Site> sites_;
 
+    std::function<void(const int &)> site_loader_;
+
 };
 
 }
@@ -0,0 +1,73 @@
+#include <sstream>
+
+#include "../../include/kmccoarsegrain/kmc_statistics.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_Statistics::KMC_Statistics() {
+    clear();
+  }
+
+  bool KMC_Statistics::enabled() {
+#ifdef KMCCOARSEGRAIN_STATISTICS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  string KMC_Statistics::getPhaseName(const Phase phase) {
+    switch(phase){
+      case hop:
+        return "hop";
+      case coarse_grain:
+        return "coarse_grain";
+      case find_basin:
+        return "find_basin";
+      case internal_time_limit:
+        return "internal_time_limit";
+      case cluster_solve:
+        return "cluster_solve";
+      default:
+        return "unknown";
+    }
+  }
+
+  void KMC_Statistics::clear() {
+    hops = 0;
+    rejected_hops = 0;
+    cluster_entries = 0;
+    cluster_exits = 0;
+    coarse_grain_attempts = 0;
+    coarse_grain_successes = 0;
+    sites_loaded = 0;
+    for(int phase = 0; phase < number_of_phases; ++phase){
+      phase_calls[phase] = 0;
+      phase_ticks[phase] = 0;
+    }
+  }
+
+  string KMC_Statistics::toJSON() const {
+    stringstream json;
+    json << "{";
+    json << "\"enabled\": " << (enabled() ? "true" : "false") << ", ";
+    json << "\"hops\": " << hops << ", ";
+    json << "\"rejected_hops\": " << rejected_hops << ", ";
+    json << "\"cluster_entries\": " << cluster_entries << ", ";
+    json << "\"cluster_exits\": " << cluster_exits << ", ";
+    json << "\"coarse_grain_attempts\": " << coarse_grain_attempts << ", ";
+    json << "\"coarse_grain_successes\": " << coarse_grain_successes << ", ";
+    json << "\"sites_loaded\": " << sites_loaded << ", ";
+    json << "\"phases\": {";
+    for(int phase = 0; phase < number_of_phases; ++phase){
+      if(phase!=0) json << ", ";
+      json << "\"" << getPhaseName(static_cast<Phase>(phase)) << "\": {";
+      json << "\"calls\": " << phase_calls[phase] << ", ";
+      json << "\"ticks\": " << phase_ticks[phase] << "}";
+    }
+    json << "}}";
+    return json.str();
+  }
+}
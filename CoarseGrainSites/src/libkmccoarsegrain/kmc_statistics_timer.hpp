@@ -0,0 +1,62 @@
+#ifndef KMCCOARSEGRAIN_KMC_STATISTICS_TIMER_HPP
+#define KMCCOARSEGRAIN_KMC_STATISTICS_TIMER_HPP
+
+#include "../../include/kmccoarsegrain/kmc_statistics.hpp"
+
+#ifdef KMCCOARSEGRAIN_STATISTICS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace kmccoarsegrain {
+
+inline unsigned long long readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<unsigned long long>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/**
+ * \brief Adds the ticks spent in the enclosing scope to a phase
+ **/
+class PhaseTimer {
+  public:
+    PhaseTimer(KMC_Statistics & statistics, const KMC_Statistics::Phase phase) :
+      statistics_(statistics),
+      phase_(phase),
+      start_(readTicks()) {}
+
+    ~PhaseTimer() {
+      statistics_.phase_ticks[phase_] += readTicks()-start_;
+      ++statistics_.phase_calls[phase_];
+    }
+
+  private:
+    KMC_Statistics & statistics_;
+    KMC_Statistics::Phase phase_;
+    unsigned long long start_;
+};
+
+}
+
+#define KMC_STATISTICS_CONCAT_(a, b) a##b
+#define KMC_STATISTICS_NAME_(line) KMC_STATISTICS_CONCAT_(phase_timer_, line)
+
+#define KMC_STATISTICS_COUNT(statistics, counter) (++(statistics).counter)
+#define KMC_STATISTICS_TIME(statistics, phase) \
+  PhaseTimer KMC_STATISTICS_NAME_(__LINE__)(statistics, KMC_Statistics::phase)
+
+#else
+
+#define KMC_STATISTICS_COUNT(statistics, counter) ((void)0)
+#define KMC_STATISTICS_TIME(statistics, phase) ((void)0)
+
+#endif  // KMCCOARSEGRAIN_STATISTICS
+
+#endif  // KMCCOARSEGRAIN_KMC_STATISTICS_TIMER_HPP
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "kmc_trace_buffer.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+namespace trace {
+
+  static_assert((capacity & (capacity-1))==0,"The capacity of the trace "
+      "buffers must be a power of 2");
+
+  /// Buffers of every thread that has recorded an event, they are kept after
+  /// the threads finish so they can be read post-mortem
+  static mutex buffers_mutex;
+  static vector<shared_ptr<TraceBuffer>> buffers;
+
+  vector<Record> TraceBuffer::getRecords() const {
+    uint64_t head = head_.load(memory_order_acquire);
+    uint64_t first = max(first_.load(memory_order_acquire),
+        head > capacity ? head-capacity : 0);
+    vector<Record> records;
+    records.reserve(head-first);
+    for(uint64_t index = first; index < head; ++index){
+      const Slot & slot = slots_[index & (capacity-1)];
+      // Records being written or already overwritten are dropped
+      uint64_t sequence = slot.sequence.load(memory_order_acquire);
+      if(sequence!=2*index+2) continue;
+      Record record{
+        slot.event.load(memory_order_relaxed),
+        slot.walker.load(memory_order_relaxed),
+        slot.site.load(memory_order_relaxed),
+        slot.time.load(memory_order_relaxed)};
+      atomic_thread_fence(memory_order_acquire);
+      if(slot.sequence.load(memory_order_relaxed)!=sequence) continue;
+      records.push_back(record);
+    }
+    return records;
+  }
+
+  TraceBuffer & getThreadBuffer() {
+    thread_local shared_ptr<TraceBuffer> buffer;
+    if(!buffer){
+      buffer = make_shared<TraceBuffer>();
+      lock_guard<mutex> lock(buffers_mutex);
+      buffers.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  bool enabled() {
+#ifdef KMCCOARSEGRAIN_TRACING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  vector<Record> collect() {
+    vector<Record> records;
+    lock_guard<mutex> lock(buffers_mutex);
+    for(const shared_ptr<TraceBuffer> & buffer : buffers){
+      vector<Record> thread_records = buffer->getRecords();
+      records.insert(records.end(),thread_records.begin(),thread_records.end());
+    }
+    return records;
+  }
+
+  void dump(ostream & os) {
+    vector<Record> records = collect();
+    uint64_t record_size = sizeof(Record);
+    uint64_t number_of_records = records.size();
+    os.write("KMCTRACE",8);
+    os.write(reinterpret_cast<const char *>(&record_size),sizeof(record_size));
+    os.write(reinterpret_cast<const char *>(&number_of_records),
+        sizeof(number_of_records));
+    if(number_of_records>0){
+      os.write(reinterpret_cast<const char *>(records.data()),
+          static_cast<streamsize>(record_size*number_of_records));
+    }
+  }
+
+  void clear() {
+    lock_guard<mutex> lock(buffers_mutex);
+    for(const shared_ptr<TraceBuffer> & buffer : buffers) buffer->clear();
+  }
+}
+}
@@ -0,0 +1,88 @@
+#ifndef KMCCOARSEGRAIN_KMC_TRACE_BUFFER_HPP
+#define KMCCOARSEGRAIN_KMC_TRACE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../../include/kmccoarsegrain/kmc_trace.hpp"
+
+namespace kmccoarsegrain {
+namespace trace {
+
+/**
+ * \brief Ring buffer of trace records written to by a single thread
+ *
+ * Only the owning thread writes, so the position of the next record is only
+ * published for readers. Each slot carries a sequence number that is odd
+ * while the record in it is being written, readers on other threads drop
+ * records that are written or overwritten while they are copied. Clearing
+ * the buffer only moves the position of the first record returned, so it
+ * does not write to anything the owning thread writes to.
+ **/
+class TraceBuffer {
+  public:
+    TraceBuffer() : slots_(capacity), head_(0), first_(0) {}
+
+    void push(const Record & record) {
+      uint64_t head = head_.load(std::memory_order_relaxed);
+      Slot & slot = slots_[head & (capacity-1)];
+      slot.sequence.store(2*head+1,std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.event.store(record.event,std::memory_order_relaxed);
+      slot.walker.store(record.walker,std::memory_order_relaxed);
+      slot.site.store(record.site,std::memory_order_relaxed);
+      slot.time.store(record.time,std::memory_order_relaxed);
+      slot.sequence.store(2*head+2,std::memory_order_release);
+      head_.store(head+1,std::memory_order_release);
+    }
+
+    /// Records oldest first
+    std::vector<Record> getRecords() const;
+
+    void clear() {
+      first_.store(head_.load(std::memory_order_acquire),
+          std::memory_order_release);
+    }
+
+  private:
+    /// The fields are atomic so a slot can be copied while it is written
+    struct Slot {
+      std::atomic<uint64_t> sequence;
+      std::atomic<uint32_t> event;
+      std::atomic<int32_t> walker;
+      std::atomic<int32_t> site;
+      std::atomic<double> time;
+    };
+
+    std::vector<Slot> slots_;
+    std::atomic<uint64_t> head_;
+    /// Position of the first record after the buffer was last cleared
+    std::atomic<uint64_t> first_;
+};
+
+/**
+ * \brief Buffer of the calling thread, created the first time a thread
+ * records an event
+ **/
+TraceBuffer & getThreadBuffer();
+
+inline void record(
+    const Event event,
+    const int walker,
+    const int site,
+    const double time) {
+  getThreadBuffer().push(Record{event,walker,site,time});
+}
+
+}
+}
+
+#ifdef KMCCOARSEGRAIN_TRACING
+#define KMC_TRACE(event, walker, site, time) \
+  (trace::record(trace::event, walker, site, time))
+#else
+#define KMC_TRACE(event, walker, site, time) ((void)0)
+#endif  // KMCCOARSEGRAIN_TRACING
+
+#endif  // KMCCOARSEGRAIN_KMC_TRACE_BUFFER_HPP
@@ -0,0 +1,94 @@
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "../../include/kmccoarsegrain/kmc_walker_store.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_WalkerStore::KMC_WalkerStore() : size_(0) {}
+
+  int KMC_WalkerStore::add(const int siteId, const double time){
+    int handle;
+    if(free_handles_.empty()){
+      handle = static_cast<int>(in_use_.size());
+      current_site_.push_back(siteId);
+      potential_site_.push_back(constants::unassignedId);
+      dwell_time_.push_back(0.0);
+      time_.push_back(time);
+      in_use_.push_back(true);
+    }else{
+      handle = free_handles_.back();
+      free_handles_.pop_back();
+      current_site_[handle] = siteId;
+      potential_site_[handle] = constants::unassignedId;
+      dwell_time_[handle] = 0.0;
+      time_[handle] = time;
+      in_use_[handle] = true;
+    }
+    ++size_;
+    return handle;
+  }
+
+  void KMC_WalkerStore::remove(const int handle){
+    if(!contains(handle)){
+      throw invalid_argument("Cannot remove walker "+to_string(handle)+
+          " as it is not in the store.");
+    }
+    in_use_[handle] = false;
+    // The slot is never picked as the earliest walker
+    time_[handle] = numeric_limits<double>::infinity();
+    free_handles_.push_back(handle);
+    --size_;
+  }
+
+  void KMC_WalkerStore::reserve(const size_t walkers){
+    current_site_.reserve(walkers);
+    potential_site_.reserve(walkers);
+    dwell_time_.reserve(walkers);
+    time_.reserve(walkers);
+    in_use_.reserve(walkers);
+    free_handles_.reserve(walkers);
+  }
+
+  vector<int> KMC_WalkerStore::getHandles() const {
+    vector<int> handles;
+    handles.reserve(size_);
+    for(size_t handle = 0; handle < in_use_.size(); ++handle){
+      if(in_use_[handle]) handles.push_back(static_cast<int>(handle));
+    }
+    return handles;
+  }
+
+  int KMC_WalkerStore::getEarliest() const {
+    int earliest = constants::unassignedId;
+    double earliest_time = numeric_limits<double>::infinity();
+    for(size_t handle = 0; handle < time_.size(); ++handle){
+      if(time_[handle]<earliest_time){
+        earliest_time = time_[handle];
+        earliest = static_cast<int>(handle);
+      }
+    }
+    return earliest;
+  }
+
+  KMC_Walker KMC_WalkerStore::getWalker(const int handle) const {
+    assert(contains(handle));
+    KMC_Walker walker;
+    walker.occupySite(current_site_[handle]);
+    walker.setPotentialSite(potential_site_[handle]);
+    walker.setDwellTime(dwell_time_[handle]);
+    return walker;
+  }
+
+  void KMC_WalkerStore::setWalker(const int handle, const KMC_Walker & walker){
+    assert(contains(handle));
+    current_site_[handle] = walker.getIdOfSiteCurrentlyOccupying();
+    potential_site_[handle] = walker.getPotentialSite();
+    dwell_time_[handle] = walker.getDwellTime();
+    time_[handle] += dwell_time_[handle];
+  }
+
+}
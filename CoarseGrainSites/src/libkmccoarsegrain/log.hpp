@@ -12,8 +12,14 @@
 
 namespace kmccoarsegrain {
 
-#define LOG(msg, log_level) \
-  (Log(__FILE__, __LINE__, LogData<None>() << msg, log_level))
+// The level is known when compiling, so a disabled message is removed along
+// with the construction of its LogData chain
+#define LOG(msg, log_level)                                           \
+  do {                                                                \
+    if ((log_level) <= LOG_LEVEL) {                                   \
+      Log(__FILE__, __LINE__, LogData<None>() << msg, log_level);     \
+    }                                                                 \
+  } while (0)
 
 // Workaround GCC 4.7.2 not recognizing noinline attribute
 #ifndef NOINLINE_ATTRIBUTE
@@ -1,13 +1,18 @@
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <random>
+#include <stdexcept>
 #include <cassert>
 
 #include "kmc_cluster.hpp"
 #include "kmc_site.hpp"
 #include "../log.hpp"
+#include "../kmc_checkpoint.hpp"
+#include "../kmc_memory.hpp"
+#include "../kmc_site_container.hpp"
 
 using namespace std;
 
@@ -17,8 +22,40 @@ namespace kmccoarsegrain {
  * Constants
  ****************************************************************************/
 
-/// Cluster Id counter is used to ensure that each new cluster has a unique id
-static int clusterIdCounter = 0;
+/// Cluster Id counter is used to ensure that each new cluster has a unique id,
+/// clusters may be created on the coarse graining worker thread
+static atomic<int> clusterIdCounter(0);
+
+/****************************************************************************
+ * Local Functions
+ ****************************************************************************/
+
+/// Ratios e_j/e_(j-1) of the elementary symmetric polynomials of the weights,
+/// for j from 1 to k, the weight at index skip is left out. The polynomials
+/// themselves fall below the smallest double for a hundred or so walkers,
+/// e_k is about 1/k! when the weights are even, while the ratios stay in
+/// range. Adding a weight w turns the ratio r_j into
+/// r_(j-1)(r_j+w)/(r_(j-1)+w), where r_0 is infinite.
+static vector<double> symmetricPolynomialRatios_(
+    const vector<double> & weights,
+    const size_t skip,
+    const int k){
+
+  vector<double> ratios(k+1,0.0);
+  // Orders above the number of weights added so far are still 0
+  int added = 0;
+  for(size_t index = 0; index < weights.size(); ++index){
+    const double & weight = weights[index];
+    if(index==skip || !(weight>0.0)) continue;
+    for(int order = min(k,added+1); order > 1; --order){
+      ratios[order] = ratios[order-1]*(ratios[order]+weight)/
+        (ratios[order-1]+weight);
+    }
+    if(k>0) ratios[1] += weight;
+    ++added;
+  }
+  return ratios;
+}
 
 /****************************************************************************
  * Public Facing Functions
@@ -29,19 +66,36 @@ void occupyCluster_(KMC_TopologyFeature* feature, const int& siteId){
   KMC_Site & site = cluster->sitesInCluster_[siteId];
   assert(cluster->site_visits_.count(siteId));
   ++cluster->total_visit_freq_; 
-  site.setToOccupiedStatus(); 
+  ++cluster->occupied_;
+  cluster->rescaleRemainingDwellTimes_(cluster->occupied_-1);
+  // When skipping events walkers are only counted, they are not tied to a site
+  if(!cluster->event_skipping_) site.setToOccupiedStatus(); 
 }
 
 bool isOccupiedCluster_(KMC_TopologyFeature* feature,const int& siteId){
   auto cluster = static_cast<KMC_Cluster *>(feature);
   assert(cluster->sitesInCluster_.count(siteId));
+  if(cluster->event_skipping_){
+    // Walkers exclude each other, with more than one walker in the cluster
+    // the site is occupied with the probability of the k-walker state
+    if(cluster->occupied_>1){
+      double number = cluster->random_distribution_(cluster->random_engine_);
+      return number < cluster->getOccupancyState_(cluster->occupied_)
+        .probabilityOccupied.at(siteId);
+    }
+    for(int walker = 0; walker < cluster->occupied_; ++walker){
+      if(cluster->samplePositionInCluster()==siteId) return true;
+    }
+    return false;
+  }
   return cluster->sitesInCluster_[siteId].isOccupied();
 }
 
 void vacateCluster_(KMC_TopologyFeature* feature,const int& siteId){
   auto cluster = static_cast<KMC_Cluster *>(feature);
-  cluster->sitesInCluster_[siteId].vacate();
+  if(!cluster->event_skipping_) cluster->sitesInCluster_[siteId].vacate();
   cluster->vacate();
+  cluster->rescaleRemainingDwellTimes_(cluster->occupied_+1);
 }
 
 void removeWalkerCluster_(KMC_TopologyFeature * feature,const int & walker_id){
@@ -50,18 +104,19 @@ void removeWalkerCluster_(KMC_TopologyFeature * feature,const int & walker_id){
 }
 
 KMC_Cluster::KMC_Cluster() : KMC_TopologyFeature() {
-  setId(clusterIdCounter);
-  clusterIdCounter++;
+  setId(clusterIdCounter++);
   iterations_ = 3;
   resolution_ = 20.0;
   total_visit_freq_ = 0;
   prev_total_visit_freq_ = 0;
   convergenceTolerance_ = 0.01;
   convergence_method_ = converge_by_iterations_per_site;
+  event_skipping_ = false;
 
   occupy_siteId_ptr_ = occupyCluster_;
   vacate_siteId_ptr_ = vacateCluster_;
   isOccupied_siteId_ptr_ = isOccupiedCluster_;
+  remove_ptr_ = removeWalkerCluster_;
 
 }
 
@@ -70,20 +125,63 @@ void KMC_Cluster::addSite(KMC_Site& newSite) {
       "added to the cluster");
   newSite.setClusterId(this->getId());
   sitesInCluster_[newSite.getId()] = newSite;
-
+  if(newSite.isOccupied()){
+    ++occupied_;
+    if(event_skipping_) sitesInCluster_[newSite.getId()].setToUnoccupiedStatus();
+  }
 }
 
 void KMC_Cluster::addSites(vector<KMC_Site>& newSites) {
-    for (KMC_Site & site : newSites) {
-    assert(sitesInCluster_.count(site.getId())==0 && "Site has already been "
-        "added to the cluster");
-    site.setClusterId(this->getId());
-    sitesInCluster_[site.getId()] = site;
+  for (KMC_Site & site : newSites) {
+    addSite(site);
+  }
+}
+
+void KMC_Cluster::refreshOccupancy(vector<KMC_Site>& sites) {
+  occupied_ = 0;
+  for (KMC_Site & site : sites) {
+    assert(sitesInCluster_.count(site.getId()) && "Site is not in the cluster");
+    KMC_Site & site_in_cluster = sitesInCluster_[site.getId()];
+    if(site.isOccupied()){
+      ++occupied_;
+      if(!event_skipping_){
+        site_in_cluster.setToOccupiedStatus();
+        continue;
+      }
+    }
+    site_in_cluster.setToUnoccupiedStatus();
+  }
+}
+
+void KMC_Cluster::linkRates(vector<KMC_Site>& sites) {
+  for (KMC_Site & site : sites) {
+    assert(sitesInCluster_.count(site.getId()) && "Site is not in the cluster");
+    KMC_Site & site_in_cluster = sitesInCluster_[site.getId()];
+    vector<pair<int,double*>> neigh_rates;
+    for (const pair<const int,double*> & neigh_rate :
+        site.getNeighborsAndRatesConst()) {
+      assert(site_in_cluster.getRateToNeighbor(neigh_rate.first)==
+          *neigh_rate.second && "The rates have changed since the copies "
+          "were taken");
+      neigh_rates.push_back(neigh_rate);
+    }
+    site_in_cluster.setRatesToNeighbors(neigh_rates);
+  }
+}
+
+void KMC_Cluster::setEventSkipping(const bool event_skipping){
+  event_skipping_ = event_skipping;
+  if(event_skipping_){
+    for(auto & site : sitesInCluster_) site.second.setToUnoccupiedStatus();
   }
 }
 
 void KMC_Cluster::updateProbabilitiesAndTimeConstant() {
 
+  // The rates may have been changed through the sites stored outside of the
+  // cluster, they point to the same values
+  for (auto & site : sitesInCluster_) site.second.updateProbabilitiesAndTimeConstant();
+
   unordered_map<int,int> temporary_visit_frequencies = getVisitFrequencies_();
 
   solveMasterEquation_();
@@ -105,6 +203,19 @@ void KMC_Cluster::updateProbabilitiesAndTimeConstant() {
 
 }
 
+void KMC_Cluster::updateRates() {
+  const double old_time_constant =
+    occupied_>0 && escape_time_constant_!=constants::unassigned_value ?
+    getEscapeTimeConstant_(occupied_) : constants::unassigned_value;
+  updateProbabilitiesAndTimeConstant();
+  if(old_time_constant==constants::unassigned_value ||
+      escape_time_constant_==constants::unassigned_value) return;
+  const double ratio = getEscapeTimeConstant_(occupied_)/old_time_constant;
+  for(pair<const int,double> & walker_time : remaining_walker_dwell_times_){
+    walker_time.second *= ratio;
+  }
+}
+
 unordered_map<int,int> KMC_Cluster::getVisitFrequencies_(){
   unordered_map<int,int> frequencies;
 
@@ -139,6 +250,17 @@ double KMC_Cluster::getProbabilityOfOccupyingInternalSite(const int siteId) {
   return probabilityOnSite_[siteId];
 }
 
+double KMC_Cluster::getProbabilityOfOccupyingInternalSite(
+    const int siteId,
+    const int walkers) {
+  assert(sitesInCluster_.count(siteId) && "the provided site is not in the cluster");
+  return getOccupancyState_(walkers).probabilityOccupied.at(siteId);
+}
+
+double KMC_Cluster::getTimeConstantWithWalkers(const int walkers) {
+  return getOccupancyState_(walkers).escape_time_constant;
+}
+
 void KMC_Cluster::migrateSitesFrom(KMC_Cluster& cluster) {
 
   unordered_map<int,int> visits;
@@ -151,6 +273,11 @@ void KMC_Cluster::migrateSitesFrom(KMC_Cluster& cluster) {
       cluster.sitesInCluster_.end(),
       inserter(this->sitesInCluster_,this->sitesInCluster_.end()));
 
+  // Walkers in the cluster move with the sites
+  occupied_ += cluster.occupied_;
+  cluster.occupied_ = 0;
+  if(event_skipping_) setEventSkipping(event_skipping_);
+
   // Change the cluster so that it will not be used unless sites are added 
   cluster.sitesInCluster_.clear();
   cluster.probabilityOnSite_.clear();
@@ -159,6 +286,8 @@ void KMC_Cluster::migrateSitesFrom(KMC_Cluster& cluster) {
   cluster.internal_dwell_time_.clear();
   cluster.probabilityHopToNeighbor_.clear();
   cluster.cumulitive_probabilityHopToNeighbor_.clear();
+  cluster.cumulitive_probabilityOnSite_.clear();
+  cluster.occupancy_states_.clear();
   cluster.escape_time_constant_ = constants::unassigned_value;
   cluster.internal_time_constant_ = constants::unassigned_value;
 
@@ -172,7 +301,9 @@ void KMC_Cluster::migrateSitesFrom(KMC_Cluster& cluster) {
 }
 
 int KMC_Cluster::pickNewSiteId(const int & walker_id) {
-  if (hopWithinCluster_(walker_id)) {
+  // Walkers that have used up their escape time are no longer tracked
+  if (remaining_walker_dwell_times_.count(walker_id) &&
+      hopWithinCluster_(walker_id)) {
     return pickInternalSite_();
   }
   return pickClusterNeighbor_(walker_id);
@@ -192,6 +323,19 @@ double KMC_Cluster::getProbabilityOfHoppingToNeighborOfCluster(
   return it->second;
 }
 
+double KMC_Cluster::getProbabilityOfHoppingToNeighborOfCluster(
+    const int neighId,
+    const int walkers) {
+
+  const OccupancyState & state = getOccupancyState_(walkers);
+  auto it = state.probabilityHopToNeighbor.find(neighId);
+  assert(it!=state.probabilityHopToNeighbor.end() &&
+    "Cannot get probability of hopping to neighbor, the site is not a "
+    "neighbor of the cluster.");
+
+  return it->second;
+}
+
 void KMC_Cluster::setConvergenceTolerance(double tolerance) {
   assert(tolerance >= 0.0 && "tolerance must be a positive value");
   convergenceTolerance_ = tolerance;
@@ -206,9 +350,20 @@ double KMC_Cluster::getDwellTime(const int & walker_id) {
   assert(escape_time_constant_!=constants::unassigned_value && "Cannot get "
       "dwell time of the cluster as the escape_time_constant is not defined.");
   if(remaining_walker_dwell_times_.count(walker_id)==0){
-    remaining_walker_dwell_times_[walker_id]=KMC_TopologyFeature::getDwellTime(walker_id);
+    double escape_time = KMC_TopologyFeature::getDwellTime(walker_id);
+    // The walker has already been counted as occupying the cluster
+    if(occupied_>1){
+      escape_time *= getEscapeTimeConstant_(occupied_)/escape_time_constant_;
+    }
+    remaining_walker_dwell_times_[walker_id]=escape_time;
   }
   auto dwell_time = remaining_walker_dwell_times_[walker_id];
+
+  if(event_skipping_){
+    // The whole of the escape time is used up in a single hop
+    remaining_walker_dwell_times_[walker_id] = 0.0;
+    return dwell_time;
+  }
   remaining_walker_dwell_times_[walker_id]-=time_increment_;
 
   if(dwell_time>time_increment_){
@@ -220,6 +375,12 @@ double KMC_Cluster::getDwellTime(const int & walker_id) {
   return dwell_time;
 }
 
+double KMC_Cluster::getEscapeTimeConstant() {
+  assert(escape_time_constant_!=constants::unassigned_value && "Cannot get "
+      "the escape time constant of the cluster as it is not defined.");
+  return getEscapeTimeConstant_(occupied_);
+}
+
 void KMC_Cluster::setVisitFrequency(int frequency,const int & siteId){
   assert(site_visits_.count(siteId) && "Be sure to call occupy site to register"
       " a visit");
@@ -242,11 +403,14 @@ int KMC_Cluster::getVisitFrequency(const int & siteId){
 
   if(total_visit_freq_!=prev_total_visit_freq_){
     double difference = total_visit_freq_ - prev_total_visit_freq_; 
+    // Without event skipping each visit to the cluster is composed of
+    // approximately resolution_ hops
+    double hops_per_visit = event_skipping_ ? 1.0 : resolution_;
     for(auto site_visit : site_visits_){
       double visits = static_cast<double>(difference)*probabilityOnSite_[site_visit.first]*sitesInCluster_.at(site_visit.first).getTimeConstant();
       visits = visits/internal_dwell_time_.at(site_visit.first);
       visits = escape_time_constant_*visits;
-      visits = visits/resolution_;
+      visits = visits/hops_per_visit;
       site_visits_[site_visit.first] += round(visits);
     }
     prev_total_visit_freq_ = total_visit_freq_;
@@ -256,6 +420,126 @@ int KMC_Cluster::getVisitFrequency(const int & siteId){
   return static_cast<int>(round(visit_count)); 
 }
 
+size_t KMC_Cluster::getMemoryUsage() const {
+  size_t usage = sizeof(KMC_Cluster);
+  usage += memory::heapUsage(remaining_walker_dwell_times_);
+  usage += memory::heapUsage(probabilityHopToNeighbor_);
+  usage += memory::heapUsage(cumulitive_probabilityHopToNeighbor_);
+  usage += memory::heapUsage(internal_dwell_time_);
+  usage += memory::heapUsage(site_visits_);
+  usage += memory::heapUsage(sumOfEscapeRateFromSiteToNeighbor_);
+  usage += memory::heapUsage(sumOfEscapeRateFromSiteToInternalSite_);
+  usage += memory::heapUsage(sitesInCluster_);
+  for(const pair<const int,KMC_Site> & site : sitesInCluster_){
+    // The size of the site is already included in the map
+    usage += site.second.getMemoryUsage()-sizeof(KMC_Site);
+  }
+  usage += memory::heapUsage(probabilityHopOffInternalSite_);
+  usage += memory::heapUsage(probabilityHopBetweenInternalSite_);
+  usage += memory::heapUsage(probabilityOnSite_);
+  usage += memory::heapUsage(cumulitive_probabilityOnSite_);
+  usage += memory::heapUsage(probabilityHopToInternalSite_);
+  usage += memory::heapUsage(cumulitive_probabilityHopToInternalSite_);
+  usage += memory::heapUsage(occupancy_states_);
+  for(const pair<const int,OccupancyState> & state : occupancy_states_){
+    usage += memory::heapUsage(state.second.probabilityOccupied);
+    usage += memory::heapUsage(state.second.cumulitive_probabilityOnSite);
+    usage += memory::heapUsage(state.second.probabilityHopToNeighbor);
+    usage += memory::heapUsage(state.second.cumulitive_probabilityHopToNeighbor);
+  }
+  return usage;
+}
+
+void KMC_Cluster::writeCheckpoint(checkpoint::Writer & writer) const {
+  writer.write(getId());
+  writeFeatureState_(writer);
+  writer.write(prev_total_visit_freq_);
+  writer.write(resolution_);
+  writer.write(iterations_);
+  writer.write(convergenceTolerance_);
+  writer.write(convergence_method_);
+  writer.write(time_increment_);
+  writer.write(event_skipping_);
+  writer.write(internal_time_constant_);
+  writer.writeSize(sitesInCluster_.bucket_count());
+  writer.writeSize(sitesInCluster_.size());
+  for(const pair<const int,KMC_Site> & site : sitesInCluster_){
+    writer.write(site.first);
+    site.second.writeCheckpoint(writer);
+  }
+  writer.write(remaining_walker_dwell_times_);
+  writer.write(probabilityHopToNeighbor_);
+  writer.write(cumulitive_probabilityHopToNeighbor_);
+  writer.write(internal_dwell_time_);
+  writer.write(site_visits_);
+  writer.write(sumOfEscapeRateFromSiteToNeighbor_);
+  writer.write(sumOfEscapeRateFromSiteToInternalSite_);
+  writer.write(probabilityHopOffInternalSite_);
+  writer.write(probabilityHopBetweenInternalSite_);
+  writer.write(probabilityOnSite_);
+  writer.write(cumulitive_probabilityOnSite_);
+  writer.write(probabilityHopToInternalSite_);
+  writer.write(cumulitive_probabilityHopToInternalSite_);
+  // The occupancy states are not written, they are worked out again from the
+  // probabilities when they are next needed
+}
+
+void KMC_Cluster::readCheckpoint(
+    checkpoint::Reader & reader,
+    KMC_Site_Container & sites) {
+
+  int id;
+  reader.read(id);
+  setId(id);
+  readFeatureState_(reader);
+  reader.read(prev_total_visit_freq_);
+  reader.read(resolution_);
+  reader.read(iterations_);
+  reader.read(convergenceTolerance_);
+  reader.read(convergence_method_);
+  reader.read(time_increment_);
+  reader.read(event_skipping_);
+  reader.read(internal_time_constant_);
+  size_t bucket_count = reader.readSize();
+  vector<pair<int,KMC_Site>> sitesInCluster(reader.readSize());
+  for(pair<int,KMC_Site> & site : sitesInCluster){
+    reader.read(site.first);
+    if(!sites.exist(site.first)){
+      throw runtime_error("Cluster "+to_string(id)+" in the checkpoint "
+          "contains site "+to_string(site.first)+" which is not part of the "
+          "system");
+    }
+    site.second = sites.getKMC_Site(site.first);
+    site.second.readCheckpoint(reader);
+  }
+  checkpoint::Reader::rebuild(sitesInCluster_,bucket_count,sitesInCluster);
+  reader.read(remaining_walker_dwell_times_);
+  reader.read(probabilityHopToNeighbor_);
+  reader.read(cumulitive_probabilityHopToNeighbor_);
+  reader.read(internal_dwell_time_);
+  reader.read(site_visits_);
+  reader.read(sumOfEscapeRateFromSiteToNeighbor_);
+  reader.read(sumOfEscapeRateFromSiteToInternalSite_);
+  reader.read(probabilityHopOffInternalSite_);
+  reader.read(probabilityHopBetweenInternalSite_);
+  reader.read(probabilityOnSite_);
+  reader.read(cumulitive_probabilityOnSite_);
+  reader.read(probabilityHopToInternalSite_);
+  reader.read(cumulitive_probabilityHopToInternalSite_);
+  occupancy_states_.clear();
+  reserveClusterIds(id+1);
+}
+
+int KMC_Cluster::getNextClusterId() {
+  return clusterIdCounter.load();
+}
+
+void KMC_Cluster::reserveClusterIds(const int next_id) {
+  int current = clusterIdCounter.load();
+  while(current<next_id &&
+      !clusterIdCounter.compare_exchange_weak(current,next_id)){}
+}
+
 std::ostream& operator<<(std::ostream& os,
                          const kmccoarsegrain::KMC_Cluster& cluster) {
 
@@ -373,6 +657,7 @@ void KMC_Cluster::iterate_() {
 
 void KMC_Cluster::solveMasterEquation_() {
 
+  occupancy_states_.clear();
   initializeProbabilityOnSites_();
 
   if (convergence_method_ == converge_by_iterations_per_cluster) {
@@ -403,6 +688,7 @@ void KMC_Cluster::solveMasterEquation_() {
   }
   calculateProbabilityHopToInternalSite_();
   calculateProbabilityHopToNeighbors_();
+  calculateCumulitiveProbabilityOnSite_();
   calculateInternalDwellTimes_();
 }
 
@@ -435,6 +721,14 @@ int KMC_Cluster::pickClusterNeighbor_(const int & walker_id) {
   remaining_walker_dwell_times_.erase(walker_id);
 
   double number = random_distribution_(random_engine_);
+  if(occupied_>1){
+    for (const pair<int,double> & pval :
+        getOccupancyState_(occupied_).cumulitive_probabilityHopToNeighbor) {
+      if (number < pval.second) return pval.first;
+    }
+    return getOccupancyState_(occupied_).cumulitive_probabilityHopToNeighbor
+      .back().first;
+  }
   for (const pair<int,double> & pval : cumulitive_probabilityHopToNeighbor_) {
     if (number < pval.second) return pval.first;
   }
@@ -456,6 +750,29 @@ int KMC_Cluster::pickInternalSite_() {
   return -1;
 }
 
+int KMC_Cluster::samplePositionInCluster() {
+
+  double number = random_distribution_(random_engine_);
+  if(occupied_>1){
+    auto & cumulitive_probabilityOnSite =
+      getOccupancyState_(occupied_).cumulitive_probabilityOnSite;
+    for (const pair<int,double> & pval : cumulitive_probabilityOnSite) {
+      if (number < pval.second) {
+        return pval.first;
+      }
+    }
+    return cumulitive_probabilityOnSite.back().first;
+  }
+  for (const pair<int,double> & pval : cumulitive_probabilityOnSite_) {
+    if (number < pval.second) {
+      return pval.first;
+    }
+  }
+  assert("cumulitive probability of occupying the sites in the cluster "
+    "is flawed or random number is greater than 1");
+  return cumulitive_probabilityOnSite_.back().first;
+}
+
 void KMC_Cluster::calculateProbabilityHopOffInternalSite_() {
  
   probabilityHopOffInternalSite_.clear();
@@ -608,6 +925,7 @@ void KMC_Cluster::calculateProbabilityHopToInternalSite_() {
       });
 
   total = 0.0;
+  cumulitive_probabilityHopToInternalSite_.clear();
   for(pair<int,double> site_and_prob : probabilityHopToInternalSite_){
     site_and_prob.second+=total;
     total = site_and_prob.second;
@@ -615,6 +933,27 @@ void KMC_Cluster::calculateProbabilityHopToInternalSite_() {
   }
 }
 
+// requires master equation convergence as it uses probabilityOnSite_
+void KMC_Cluster::calculateCumulitiveProbabilityOnSite_() {
+
+  cumulitive_probabilityOnSite_.clear();
+  copy(probabilityOnSite_.begin(),
+      probabilityOnSite_.end(),
+      back_inserter(cumulitive_probabilityOnSite_));
+
+  sort(cumulitive_probabilityOnSite_.begin(),
+      cumulitive_probabilityOnSite_.end(),
+      [](const pair<int,double>& x,const pair<int,double>&y)->bool{
+        return x.second>y.second;
+      });
+
+  double total = 0.0;
+  for(pair<int,double> & site_and_prob : cumulitive_probabilityOnSite_){
+    site_and_prob.second+=total;
+    total = site_and_prob.second;
+  }
+}
+
 // requires master equation convergence as it uses probabilityOnSite_
 void KMC_Cluster::calculateProbabilityHopToNeighbors_() {
 
@@ -660,6 +999,7 @@ void KMC_Cluster::calculateProbabilityHopToNeighbors_() {
       });
 
   total = 0.0;
+  cumulitive_probabilityHopToNeighbor_.clear();
   for(pair<int,double>  site_and_prob : probabilityHopToNeighbor_){
     site_and_prob.second+=total;
     total = site_and_prob.second;
@@ -667,6 +1007,109 @@ void KMC_Cluster::calculateProbabilityHopToNeighbors_() {
   }
 }
 
+// requires master equation convergence as it uses probabilityOnSite_ and the
+// escape time constant
+const KMC_Cluster::OccupancyState & KMC_Cluster::getOccupancyState_(
+    const int walkers) {
+
+  assert(walkers>0 && "There must be at least one walker in the cluster");
+  assert(walkers<=static_cast<int>(sitesInCluster_.size()) && "There are "
+      "more walkers than sites in the cluster");
+
+  auto state_it = occupancy_states_.find(walkers);
+  if(state_it!=occupancy_states_.end()) return state_it->second;
+
+  vector<int> siteIds;
+  vector<double> weights;
+  for(auto site_prob : probabilityOnSite_){
+    siteIds.push_back(site_prob.first);
+    weights.push_back(site_prob.second);
+  }
+
+  OccupancyState & state = occupancy_states_[walkers];
+  const vector<double> ratios = symmetricPolynomialRatios_(
+      weights,
+      weights.size(),
+      walkers);
+
+  for(size_t index = 0; index < siteIds.size(); ++index){
+    // w_i e_(k-1) without site i, over e_k, taken one ratio at a time
+    double probability = 1.0;
+    if(walkers<static_cast<int>(siteIds.size())){
+      const vector<double> ratios_without_site = symmetricPolynomialRatios_(
+          weights,
+          index,
+          walkers-1);
+      probability = weights.at(index)/ratios.at(walkers);
+      for(int order = 1; order < walkers; ++order){
+        probability *= ratios_without_site.at(order)/ratios.at(order);
+      }
+    }
+    state.probabilityOccupied[siteIds.at(index)] = min(probability,1.0);
+  }
+
+  // Rate at which any one of the walkers escapes, compared with the rate of
+  // a single walker
+  double single_rate_off = 0.0;
+  double rate_off = 0.0;
+  for(auto site_rate : sumOfEscapeRateFromSiteToNeighbor_){
+    single_rate_off += probabilityOnSite_[site_rate.first]*site_rate.second;
+    rate_off += state.probabilityOccupied[site_rate.first]*site_rate.second;
+  }
+  rate_off /= static_cast<double>(walkers);
+  state.escape_time_constant = escape_time_constant_;
+  if(rate_off>0.0){
+    state.escape_time_constant *= single_rate_off/rate_off;
+  }
+
+  double total = 0.0;
+  for(auto site_prob : state.probabilityOccupied){
+    total += site_prob.second/static_cast<double>(walkers);
+    state.cumulitive_probabilityOnSite.push_back(
+        pair<int,double>(site_prob.first,total));
+  }
+
+  // Same weighting as calculateProbabilityHopToNeighbors_ with the occupancy
+  // in place of the single walker probability, so both agree for one walker
+  total = 0.0;
+  for (auto & site : sitesInCluster_) {
+    for (auto neighsite : site.second.getNeighborSiteIds()) {
+      if (!siteIsInCluster(neighsite)) {
+        double probability =
+          site.second.getProbabilityOfHoppingToNeighboringSite(neighsite)*
+          state.probabilityOccupied[site.first];
+        state.probabilityHopToNeighbor[neighsite] += probability;
+        total += probability;
+      }
+    }
+  }
+  double cumulitive = 0.0;
+  for(auto & neigh_prob : state.probabilityHopToNeighbor){
+    neigh_prob.second /= total;
+    cumulitive += neigh_prob.second;
+    state.cumulitive_probabilityHopToNeighbor.push_back(
+        pair<int,double>(neigh_prob.first,cumulitive));
+  }
+  return state;
+}
+
+double KMC_Cluster::getEscapeTimeConstant_(const int walkers) {
+  if(walkers>1) return getOccupancyState_(walkers).escape_time_constant;
+  return escape_time_constant_;
+}
+
+void KMC_Cluster::rescaleRemainingDwellTimes_(const int previous_walkers) {
+  // Only walkers that have drawn an escape time are tracked, so the escape
+  // time constant is known whenever there is something to scale
+  if(remaining_walker_dwell_times_.empty() || occupied_<1) return;
+  if(previous_walkers<1 || previous_walkers==occupied_) return;
+  const double ratio = getEscapeTimeConstant_(occupied_)/
+    getEscapeTimeConstant_(previous_walkers);
+  for(pair<const int,double> & walker_time : remaining_walker_dwell_times_){
+    walker_time.second *= ratio;
+  }
+}
+
 void KMC_Cluster::calculateInternalDwellTimes_(){
   auto internal_rates = getRatesBetweenInternalSites_();
 
@@ -13,6 +13,8 @@
 
 namespace kmccoarsegrain {
 
+class KMC_Site_Container;
+
 /**
  * \brief Coarse graining of sites is handled by the Cluster class
  *
@@ -99,6 +101,28 @@ class KMC_Cluster : public KMC_TopologyFeature {
   void addSite(KMC_Site& site);
   void addSites(std::vector<KMC_Site>& sites);
 
+  /**
+   * \brief Updates which sites in the cluster are occupied
+   *
+   * Used when the cluster was built from copies of the sites taken some time
+   * ago, the walkers may have moved since. Each of the sites must already be
+   * part of the cluster.
+   *
+   * \param[in] sites the current state of the sites
+   **/
+  void refreshOccupancy(std::vector<KMC_Site>& sites);
+
+  /**
+   * \brief Points the sites in the cluster at the rates of the sites
+   *
+   * Used when the cluster was built from copies of the rates, the rates must
+   * have the same values. Each of the sites must already be part of the
+   * cluster.
+   *
+   * \param[in] sites sites pointing to the rates the cluster should use
+   **/
+  void linkRates(std::vector<KMC_Site>& sites);
+
   /**
    * \brief will update the probabilities and time constant stored in the
    * cluster
@@ -111,6 +135,26 @@ class KMC_Cluster : public KMC_TopologyFeature {
    **/
   void updateProbabilitiesAndTimeConstant();
 
+  /**
+   * \brief Solve the cluster again after the rates of its sites changed
+   *
+   * As updateProbabilitiesAndTimeConstant, but the escape times the walkers
+   * in the cluster have left are scaled by the change in the escape time
+   * constant, so they leave at the new rates.
+   **/
+  void updateRates();
+
+  /**
+   * \brief Determines if the walker has escape time left in the cluster
+   *
+   * Walkers are no longer tracked once they are sent to a neighbor of the
+   * cluster, and walkers that were on the sites when the cluster was created
+   * are not tracked until they next hop.
+   **/
+  bool hasEscapeTime(const int & walker_id) const {
+    return remaining_walker_dwell_times_.count(walker_id);
+  }
+
   /**
    * \brief Determines if a site is the cluster
    *
@@ -150,6 +194,33 @@ class KMC_Cluster : public KMC_TopologyFeature {
    **/
   double getProbabilityOfOccupyingInternalSite(const int siteId);
 
+  /**
+   * \brief Probability of the site being occupied when there are a number
+   * of walkers in the cluster
+   *
+   * Walkers exclude each other, so no two walkers can be on the same site.
+   * The stationary state of k walkers is taken to be the product of the
+   * single walker probabilities, restricted to configurations where the
+   * walkers are on k different sites. This is exact when the rates within
+   * the cluster satisfy detailed balance. The result for each number of
+   * walkers is stored the first time it is needed, and it is calculated
+   * again whenever the master equation is solved.
+   *
+   * \param[in] siteId id of a site in the cluster
+   * \param[in] walkers number of walkers in the cluster
+   **/
+  double getProbabilityOfOccupyingInternalSite(const int siteId, const int walkers);
+
+  /**
+   * \brief Escape time constant of a single walker when there are a number
+   * of walkers in the cluster
+   *
+   * With a single walker this is the same as getTimeConstant. With more
+   * walkers each one is found on the sites that it can escape from with
+   * a different probability. The escape time is scaled to match.
+   **/
+  double getTimeConstantWithWalkers(const int walkers);
+
   /**
    * \brief Move the sites in one cluster to another
    *
@@ -189,6 +260,36 @@ class KMC_Cluster : public KMC_TopologyFeature {
   double getTimeIncrement() const {
     return time_increment_;
   }
+
+  /**
+   * \brief Turn event skipping on or off
+   *
+   * When event skipping is on a walker entering the cluster is handed the
+   * full escape time as a single dwell time and the next site picked for it
+   * is always a neighbor of the cluster, a visit therefore costs a single
+   * event regardless of the resolution. Walkers inside the cluster are no
+   * longer tied to an internal site, the cluster only keeps count of them.
+   * Their positions are drawn from the probability of occupying each
+   * internal site when they are needed, i.e. when another walker attempts
+   * to hop onto a site of the cluster or when samplePositionInCluster is
+   * called.
+   *
+   * \param[in] event_skipping true to turn event skipping on
+   **/
+  void setEventSkipping(const bool event_skipping);
+  bool getEventSkipping() const { return event_skipping_; }
+
+  /**
+   * \brief Draw the position of a walker within the cluster
+   *
+   * The site is drawn using the probability of occupying each of the
+   * internal sites, which is found from solving the master equation.
+   * When there is more than one walker in the cluster the probabilities of
+   * the stationary state with that many walkers are used instead.
+   *
+   * \return the id of a site within the cluster
+   **/
+  int samplePositionInCluster();
   /**
    * \brief Pick the next site a particle will hop too
    *
@@ -196,6 +297,9 @@ class KMC_Cluster : public KMC_TopologyFeature {
    * neighboring the cluster based on the calculated probabilities and
    * return the site id.
    *
+   * Walkers that have used up the escape time they drew from the cluster,
+   * or never drew one, are sent to a neighbor of the cluster.
+   *
    * \return site id generated to reproduce the probability of a particle
    * moving to it
    **/
@@ -253,17 +357,82 @@ class KMC_Cluster : public KMC_TopologyFeature {
    **/
   double getProbabilityOfHoppingToNeighborOfCluster(const int neighId);
 
+  /**
+   * \brief Returns a probability of a particle moving to a neighbor when
+   * there are a number of walkers in the cluster
+   *
+   * The exits are weighted in the same way as for a single walker, by the
+   * probability of hopping from a site to the neighbor and the probability
+   * that the site is occupied. With a single walker this is the same as
+   * getProbabilityOfHoppingToNeighborOfCluster(neighId).
+   *
+   * \param[in] neighId the site id of the neighbor
+   * \param[in] walkers number of walkers in the cluster
+   *
+   * \return a probability
+   **/
+  double getProbabilityOfHoppingToNeighborOfCluster(
+      const int neighId,
+      const int walkers);
+
   /**
    * \brief Returns the dwell time, each call will return a different value
+   *
+   * The escape time of a walker is drawn for the number of walkers in the
+   * cluster when it arrives. Whenever a walker enters or leaves, the time
+   * left to the walkers already in the cluster is scaled by the ratio of the
+   * new to the old escape time constant.
    **/
   double getDwellTime(const int & walker_id);
   //double getDwellTime();
 
+  /**
+   * \brief Mean time a walker spends in the cluster before it escapes
+   *
+   * Takes into account the walkers already occupying the cluster.
+   **/
+  double getEscapeTimeConstant();
+
   double getFastestRateOffCluster();
 
   void setVisitFrequency(int frequency,const int & siteId);
   int getVisitFrequency(const int & siteId);
 
+  /**
+   * \brief Bytes of memory used by the cluster
+   *
+   * Includes the copies of the sites held by the cluster and the random
+   * engines of the cluster and of the copies.
+   **/
+  size_t getMemoryUsage() const;
+
+  /**
+   * \brief Writes the state of the cluster and of the sites in it
+   **/
+  void writeCheckpoint(checkpoint::Writer & writer) const;
+
+  /**
+   * \brief Reads the state written by writeCheckpoint
+   *
+   * The sites of the cluster are copied from the container, so they point to
+   * the same rates, and their state is then overwritten with the checkpoint.
+   *
+   * \param[in] sites container holding every site of the system
+   **/
+  void readCheckpoint(checkpoint::Reader & reader, KMC_Site_Container & sites);
+
+  /**
+   * \brief The id the next cluster that is created will be given
+   **/
+  static int getNextClusterId();
+
+  /**
+   * \brief Clusters created from now on are given an id of at least next_id
+   *
+   * Used when clusters are restored so new clusters do not reuse their ids.
+   **/
+  static void reserveClusterIds(const int next_id);
+
   /**
    * \brief Prints the contents of the cluster
    **/
@@ -292,6 +461,9 @@ class KMC_Cluster : public KMC_TopologyFeature {
   /// Time increment of the cluster
   double time_increment_;
 
+  /// Walkers are handed the full escape time in a single dwell time
+  bool event_skipping_;
+
   double internal_time_constant_;
   /**
    * \brief Stores the particle and its total dwell time on the cluster
@@ -355,10 +527,29 @@ class KMC_Cluster : public KMC_TopologyFeature {
    * Master Eqaution.
    **/
   std::unordered_map<int, double> probabilityOnSite_;
+  std::vector<std::pair<int,double>> cumulitive_probabilityOnSite_;
 
   std::vector<std::pair<int,double>> probabilityHopToInternalSite_;
   std::vector<std::pair<int,double>> cumulitive_probabilityHopToInternalSite_;
 
+  /**
+   * \brief Stationary state of the cluster when it holds several walkers
+   **/
+  struct OccupancyState {
+    /// Probability that each site is occupied
+    std::unordered_map<int,double> probabilityOccupied;
+    /// Escape time constant of any one of the walkers
+    double escape_time_constant;
+    /// Probability of a single walker being on each site
+    std::vector<std::pair<int,double>> cumulitive_probabilityOnSite;
+    /// Probability of the escaping walker hopping to each neighbor
+    std::unordered_map<int,double> probabilityHopToNeighbor;
+    std::vector<std::pair<int,double>> cumulitive_probabilityHopToNeighbor;
+  };
+
+  /// Stationary states, the int is the number of walkers
+  std::unordered_map<int,OccupancyState> occupancy_states_;
+
   /************************************************************************
    * Local Cluster Functions
    ************************************************************************/
@@ -437,6 +628,7 @@ class KMC_Cluster : public KMC_TopologyFeature {
 
     void calculateProbabilityHopToNeighbors_();
     void calculateProbabilityHopToInternalSite_();
+    void calculateCumulitiveProbabilityOnSite_();
     void calculateProbabilityHopOffInternalSite_();
     void calculateProbabilityHopBetweenInternalSite_();
     void calculateInternalDwellTimes_();
@@ -445,6 +637,15 @@ class KMC_Cluster : public KMC_TopologyFeature {
 
     void initializeProbabilityOnSites_();
 
+    const OccupancyState & getOccupancyState_(const int walkers);
+
+    /// Escape time constant of a walker when the cluster holds walkers
+    double getEscapeTimeConstant_(const int walkers);
+
+    /// Scales the time left to each walker after the number of walkers in
+    /// the cluster changed from previous_walkers to occupied_
+    void rescaleRemainingDwellTimes_(const int previous_walkers);
+
     /**
      * \brief Will grab all the internal rates going to each site in the
      * cluster
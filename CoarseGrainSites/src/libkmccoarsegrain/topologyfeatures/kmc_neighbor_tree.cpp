@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cassert>
+
+#include "kmc_neighbor_tree.hpp"
+#include "../kmc_memory.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+
+  KMC_NeighborTree::KMC_NeighborTree(const KMC_NeighborTree & tree) {
+    if(tree.tree_) tree_ = unique_ptr<Tree>(new Tree(*tree.tree_));
+  }
+
+  KMC_NeighborTree & KMC_NeighborTree::operator=(const KMC_NeighborTree & tree) {
+    if(this==&tree) return *this;
+    if(tree.tree_){
+      tree_ = unique_ptr<Tree>(new Tree(*tree.tree_));
+    }else{
+      tree_.reset();
+    }
+    return *this;
+  }
+
+  void KMC_NeighborTree::build(const unordered_map<int,double *> & neighRates) {
+    tree_ = unique_ptr<Tree>(new Tree);
+    for(const pair<const int,double *> & neighAndRate : neighRates){
+      tree_->neighbor_ids.push_back(neighAndRate.first);
+    }
+    sort(tree_->neighbor_ids.begin(),tree_->neighbor_ids.end());
+    tree_->positions.reserve(neighRates.size());
+    for(size_t position = 0; position < tree_->neighbor_ids.size(); ++position){
+      const int & neighSiteId = tree_->neighbor_ids[position];
+      tree_->positions[neighSiteId] = position;
+      tree_->rates.set(position,*(neighRates.at(neighSiteId)));
+    }
+  }
+
+  void KMC_NeighborTree::update(const int & neighSiteId, const double & rate) {
+    assert(contains(neighSiteId) && "The site is not a neighbor in the tree");
+    tree_->rates.set(tree_->positions.at(neighSiteId),rate);
+  }
+
+  double KMC_NeighborTree::getRate(const int & neighSiteId) const {
+    assert(contains(neighSiteId) && "The site is not a neighbor in the tree");
+    return tree_->rates.get(tree_->positions.at(neighSiteId));
+  }
+
+  vector<pair<int,double>> KMC_NeighborTree::getProbabilities() const {
+    vector<pair<int,double>> probabilities;
+    const double sum = total();
+    for(size_t position = 0; position < tree_->neighbor_ids.size(); ++position){
+      probabilities.push_back(pair<int,double>(
+            tree_->neighbor_ids[position],tree_->rates.get(position)/sum));
+    }
+    return probabilities;
+  }
+
+  size_t KMC_NeighborTree::getMemoryUsage() const {
+    if(!tree_) return 0;
+    return sizeof(Tree)-sizeof(KMC_SumTree)+tree_->rates.getMemoryUsage()+
+      memory::heapUsage(tree_->neighbor_ids)+
+      memory::heapUsage(tree_->positions);
+  }
+
+}
@@ -0,0 +1,76 @@
+#ifndef KMCCOARSEGRAIN_KMC_NEIGHBOR_TREE_HPP
+#define KMCCOARSEGRAIN_KMC_NEIGHBOR_TREE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_sum_tree.hpp"
+
+namespace kmccoarsegrain {
+
+/**
+ * \brief Rates to the neighbors of a site kept in a sum tree
+ *
+ * Picking a neighbor in proportion to its rate and changing the rate to a
+ * single neighbor both take O(log k) of the number of neighbors k, where a
+ * list of probabilities takes O(k). The neighbors are stored in order of
+ * their ids, the same order as the probabilities of a site, so the same
+ * random number picks the same neighbor either way.
+ *
+ * Nothing is allocated until the tree is built, so sites with few neighbors
+ * only pay for a pointer. Copying a tree copies all of it.
+ **/
+class KMC_NeighborTree {
+ public:
+  KMC_NeighborTree() {}
+  KMC_NeighborTree(const KMC_NeighborTree & tree);
+  KMC_NeighborTree & operator=(const KMC_NeighborTree & tree);
+
+  bool built() const { return static_cast<bool>(tree_); }
+
+  /// Stores the current value of each of the rates
+  void build(const std::unordered_map<int,double *> & neighRates);
+  void clear() { tree_.reset(); }
+
+  /// The neighbor must already be in the tree
+  void update(const int & neighSiteId, const double & rate);
+
+  bool contains(const int & neighSiteId) const {
+    return tree_->positions.count(neighSiteId)!=0;
+  }
+
+  double getRate(const int & neighSiteId) const;
+
+  /// Sum of the rates to all of the neighbors
+  double total() const { return tree_->rates.total(); }
+
+  /**
+   * \brief Neighbor picked in proportion to its rate
+   *
+   * \param[in] number uniform random number between 0 and 1
+   **/
+  int pick(const double & number) const {
+    return tree_->neighbor_ids[tree_->rates.find(number*tree_->rates.total())];
+  }
+
+  /// Probability of hopping to each neighbor, in the order they are stored
+  std::vector<std::pair<int,double>> getProbabilities() const;
+
+  /// Bytes of heap memory held by the tree
+  size_t getMemoryUsage() const;
+
+ private:
+  struct Tree {
+    KMC_SumTree rates;
+    std::vector<int> neighbor_ids;
+    std::unordered_map<int,size_t> positions;
+  };
+  std::unique_ptr<Tree> tree_;
+};
+
+}
+
+#endif  // KMCCOARSEGRAIN_KMC_NEIGHBOR_TREE_HPP
@@ -1,11 +1,15 @@
 
 #include <algorithm>
 #include <chrono>
+#include <limits>
 #include <set>
+#include <stdexcept>
 #include <utility>
 #include <cassert>
 
 #include "kmc_site.hpp"
+#include "../kmc_checkpoint.hpp"
+#include "../kmc_memory.hpp"
 #include "../../../include/kmccoarsegrain/kmc_constants.hpp"
 
 using namespace std;
@@ -27,6 +31,28 @@ namespace kmccoarsegrain {
       }
   };
 
+/*********************************************************************
+ * Drain Functions
+ *********************************************************************/
+
+// A drain only counts the walkers that arrive, it never holds them
+
+void occupyDrain_(KMC_TopologyFeature* feature) {
+  ++(static_cast<KMC_Site *>(feature)->total_visit_freq_);
+}
+
+void occupyDrain_(KMC_TopologyFeature* feature,const int&) {
+  ++(static_cast<KMC_Site *>(feature)->total_visit_freq_);
+}
+
+static void vacateDrain_(KMC_TopologyFeature*) {}
+
+static void vacateDrain_(KMC_TopologyFeature*,const int&) {}
+
+static bool isOccupiedDrain_(KMC_TopologyFeature*) { return false; }
+
+static bool isOccupiedDrain_(KMC_TopologyFeature*,const int&) { return false; }
+
 /*********************************************************************
  * Public Facing Functions
  *********************************************************************/
@@ -35,9 +61,15 @@ KMC_Site::KMC_Site()
     : KMC_TopologyFeature() {
 
   cluster_id_ = constants::unassignedId;
+  drain_ = false;
 }
 
-KMC_Site::~KMC_Site() {}
+KMC_Site::KMC_Site(const unsigned long seed)
+    : KMC_TopologyFeature(seed) {
+
+  cluster_id_ = constants::unassignedId;
+  drain_ = false;
+}
 
 void KMC_Site::setRatesToNeighbors(unordered_map<int, double>& neighRates) {
   assert(neighRates.size()!=0 && "Sites must have at least one rate to a "
@@ -51,6 +83,20 @@ void KMC_Site::setRatesToNeighbors(unordered_map<int, double>& neighRates) {
   calculateProbabilityHopToNeighbors_();
 }
 
+void KMC_Site::setRatesToNeighbors(
+    const vector<pair<int, double*>>& neighRates) {
+  assert(neighRates.size()!=0 && "Sites must have at least one rate to a "
+    "neighbor. Cannot set rates to neighbors with an empty list.");
+  neighRates_.reserve(neighRates_.size()+neighRates.size());
+  for (const pair<int, double*>& neighAndRate : neighRates) {
+    assert(*neighAndRate.second!=0 && "One of the rates is 0.0. You cannot "
+        "set a rate to a value of 0.0 as it is meaningless.");
+    neighRates_[neighAndRate.first] = neighAndRate.second;
+  }
+  calculateDwellTimeConstant_();
+  calculateProbabilityHopToNeighbors_();
+}
+
 void KMC_Site::addNeighRate(const pair<int, double*> neighRate) {
 
   assert(neighRates_.count(neighRate.first)==0 && "That neighbor has already been added.");
@@ -61,10 +107,84 @@ void KMC_Site::addNeighRate(const pair<int, double*> neighRate) {
 
 void KMC_Site::resetNeighRate(const pair<int, double*> neighRate) {
   neighRates_[neighRate.first] = neighRate.second;
+  if (neighbor_tree_.built() && neighbor_tree_.contains(neighRate.first)) {
+    neighbor_tree_.update(neighRate.first,*(neighRate.second));
+    escape_time_constant_ = 1.0 / neighbor_tree_.total();
+    return;
+  }
+  calculateDwellTimeConstant_();
+  calculateProbabilityHopToNeighbors_();
+}
+
+void KMC_Site::updateRatesToNeighbors(const unordered_map<int, double>& neighRates) {
+  for (const pair<const int,double> & neighAndRate : neighRates) {
+    assert(neighRates_.count(neighAndRate.first) && "Cannot update the rate "
+        "as the site is not a neighbor.");
+    assert(neighAndRate.second!=0 && "One of the rates is 0.0. You cannot "
+        "set a rate to a value of 0.0 as it is meaningless.");
+    *(neighRates_[neighAndRate.first]) = neighAndRate.second;
+  }
+  if (neighbor_tree_.built()) {
+    for (const pair<const int,double> & neighAndRate : neighRates) {
+      neighbor_tree_.update(neighAndRate.first,neighAndRate.second);
+    }
+    escape_time_constant_ = 1.0 / neighbor_tree_.total();
+    return;
+  }
+  updateProbabilitiesAndTimeConstant();
+}
+
+void KMC_Site::updateRateToNeighbor(const int & neighSiteId, const double & rate) {
+  assert(neighRates_.count(neighSiteId) && "Cannot update the rate as the "
+      "site is not a neighbor.");
+  assert(rate!=0 && "You cannot set a rate to a value of 0.0 as it is "
+      "meaningless.");
+  *(neighRates_[neighSiteId]) = rate;
+  if (drain_) return;
+  if (neighbor_tree_.built()) {
+    neighbor_tree_.update(neighSiteId,rate);
+    escape_time_constant_ = 1.0 / neighbor_tree_.total();
+    return;
+  }
+  updateProbabilitiesAndTimeConstant();
+}
+
+void KMC_Site::setNeighborTree(const bool neighbor_tree) {
+  if (neighbor_tree==neighbor_tree_.built()) return;
+  if (neighbor_tree) {
+    neighbor_tree_.build(neighRates_);
+  } else {
+    neighbor_tree_.clear();
+  }
+  // The rates off of a drain are never used
+  if (!drain_) calculateProbabilityHopToNeighbors_();
+}
+
+void KMC_Site::updateProbabilitiesAndTimeConstant() {
+  // The rates off of a drain are never used
+  if (drain_) return;
   calculateDwellTimeConstant_();
   calculateProbabilityHopToNeighbors_();
 }
 
+void KMC_Site::setDrain() {
+  drain_ = true;
+  neighbor_tree_.clear();
+  // Walkers that try to leave hop back onto the drain, which they can never
+  // do as their dwell time is infinite
+  escape_time_constant_ = numeric_limits<double>::infinity();
+  probabilityHopToNeighbor_.clear();
+  probabilityHopToNeighbor_.push_back(pair<int,double>(getId(),1.0));
+
+  occupy_ptr_ = &occupyDrain_;
+  occupy_siteId_ptr_ = &occupyDrain_;
+  vacate_ptr_ = &vacateDrain_;
+  vacate_siteId_ptr_ = &vacateDrain_;
+  isOccupied_ptr_ = &isOccupiedDrain_;
+  isOccupied_siteId_ptr_ = &isOccupiedDrain_;
+  occupied_ = 0;
+}
+
 vector<double> KMC_Site::getRateToNeighbors() const {
   vector<double> rates;
   for (auto & rate : neighRates_) rates.push_back(*(rate.second));
@@ -96,6 +216,7 @@ int KMC_Site::pickNewSiteId(const int &) {
 
 int KMC_Site::pickNewSiteId() {
   double number = random_distribution_(random_engine_);
+  if (neighbor_tree_.built()) return neighbor_tree_.pick(number);
   double threshold = 0.0;
   for (pair<int,double> & pval : probabilityHopToNeighbor_) {
     threshold += pval.second;
@@ -120,6 +241,9 @@ double KMC_Site::getProbabilityOfHoppingToNeighboringSite(
 {
   assert(neighRates_.count(neighSiteId) != 0 && "Error site "
       " is not a neighbor ");
+  if (neighbor_tree_.built()) {
+    return neighbor_tree_.getRate(neighSiteId) / neighbor_tree_.total();
+  }
 
   auto it = find_if(
       probabilityHopToNeighbor_.begin(),
@@ -131,9 +255,55 @@ double KMC_Site::getProbabilityOfHoppingToNeighboringSite(
 }
 
 vector<pair<int, double>> KMC_Site::getProbabilitiesAndIdsOfNeighbors() const {
+  if (neighbor_tree_.built()) return neighbor_tree_.getProbabilities();
   return probabilityHopToNeighbor_;
 }
 
+size_t KMC_Site::getMemoryUsage() const {
+  return sizeof(KMC_Site) + memory::heapUsage(neighRates_) +
+    memory::heapUsage(probabilityHopToNeighbor_) +
+    neighbor_tree_.getMemoryUsage();
+}
+
+void KMC_Site::writeCheckpoint(checkpoint::Writer & writer) const {
+  writer.write(drain_);
+  writeFeatureState_(writer);
+  writer.write(cluster_id_);
+  writer.write(probabilityHopToNeighbor_);
+  writer.writeSize(neighRates_.size());
+  for (const pair<const int,double *> & neighAndRate : neighRates_) {
+    writer.write(neighAndRate.first);
+    writer.write(*(neighAndRate.second));
+  }
+}
+
+void KMC_Site::readCheckpoint(checkpoint::Reader & reader) {
+  bool drain;
+  reader.read(drain);
+  if (drain) setDrain();
+  readFeatureState_(reader);
+  reader.read(cluster_id_);
+  reader.read(probabilityHopToNeighbor_);
+  size_t number_of_neighbors = reader.readSize();
+  if (number_of_neighbors != neighRates_.size()) {
+    throw runtime_error("The neighbors of site "+to_string(getId())+" in the "
+        "checkpoint do not match the rates the system was initialized with");
+  }
+  for (size_t index = 0; index < number_of_neighbors; ++index) {
+    int neighSiteId;
+    double rate;
+    reader.read(neighSiteId);
+    reader.read(rate);
+    if (neighRates_.count(neighSiteId)==0) {
+      throw runtime_error("The neighbors of site "+to_string(getId())+" in "
+          "the checkpoint do not match the rates the system was initialized "
+          "with");
+    }
+    *(neighRates_[neighSiteId]) = rate;
+  }
+  if (neighbor_tree_.built()) neighbor_tree_.build(neighRates_);
+}
+
 std::ostream& operator<<(std::ostream& os,
                          const kmccoarsegrain::KMC_Site& site) {
   os << "Site Id: " << site.getId() << endl;
@@ -145,7 +315,7 @@ std::ostream& operator<<(std::ostream& os,
     os << "\t" << rate_ptr.first << ":" << *(rate_ptr.second) << endl;
   }
   os << "Neighbors:Probability hop to them" << endl;
-  for (auto probability : site.probabilityHopToNeighbor_) {
+  for (auto probability : site.getProbabilitiesAndIdsOfNeighbors()) {
     os << "\t" << probability.first << ":" << probability.second << endl;
   }
   return os;
@@ -155,6 +325,12 @@ std::ostream& operator<<(std::ostream& os,
  * Private Internal Functions
  *********************************************************************/
 void KMC_Site::calculateProbabilityHopToNeighbors_() {
+  if (neighbor_tree_.built()) {
+    // The probabilities are worked out from the tree when needed
+    probabilityHopToNeighbor_ = vector<pair<int,double>>();
+    neighbor_tree_.build(neighRates_);
+    return;
+  }
   double sumRates = getSumOfRates_();
   set<pair<int,double>,CustomComparitor> neigh_and_prob;
   for (auto rateToNeigh : neighRates_) {
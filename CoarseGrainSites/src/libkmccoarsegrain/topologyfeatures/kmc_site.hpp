@@ -7,6 +7,7 @@
 #include <random>
 #include <vector>
 
+#include "kmc_neighbor_tree.hpp"
 #include "kmc_topology_feature.hpp"
 
 namespace kmccoarsegrain {
@@ -23,8 +24,9 @@ namespace kmccoarsegrain {
 class KMC_Site : public KMC_TopologyFeature {
  public:
   KMC_Site();
+  /// Seeds the random number generator with seed rather than the time
+  explicit KMC_Site(const unsigned long seed);
 
-  ~KMC_Site();
   /**
    * \brief Sets the rates to sites neighboring this site
    *
@@ -37,6 +39,14 @@ class KMC_Site : public KMC_TopologyFeature {
    **/
   void setRatesToNeighbors(std::unordered_map<int, double>& neighRates);
 
+  /**
+   * \brief Sets the rates to neighboring sites from rates stored elsewhere
+   *
+   * \param[in] neighRates the first int is the site id of the neighbor, the
+   * double pointer points to the rate to it.
+   **/
+  void setRatesToNeighbors(const std::vector<std::pair<int, double*>>& neighRates);
+
   /**
    * \brief Add a rate to a neighboring site
    *
@@ -60,6 +70,47 @@ class KMC_Site : public KMC_TopologyFeature {
    **/
   void resetNeighRate(const std::pair<int, double*> neighRate);
 
+  /**
+   * \brief Change the values of the rates to neighboring sites
+   *
+   * The new values are written to the rates the site points to, so any other
+   * copies of the site will also see them. Each of the neighbors must already
+   * have a rate stored. The time constant and probabilities are recalculated
+   * once all of the rates have been written.
+   *
+   * \param[in] neighRates the first int is the id of the neighboring site,
+   * the double is the new rate.
+   **/
+  void updateRatesToNeighbors(const std::unordered_map<int, double>& neighRates);
+
+  /**
+   * \brief Change the value of the rate to a single neighbor
+   *
+   * Takes O(log k) of the number of neighbors if the site has a neighbor
+   * tree, otherwise the probabilities are all recalculated.
+   **/
+  void updateRateToNeighbor(const int & neighSiteId, const double & rate);
+
+  /**
+   * \brief Keep the rates to the neighbors in a sum tree
+   *
+   * Picking a neighbor and changing the rate to a single neighbor then take
+   * O(log k) of the number of neighbors k rather than O(k). Worthwhile for
+   * sites with many neighbors, such as those with long range hopping. The
+   * probabilities of hopping to the neighbors are no longer stored, they are
+   * worked out from the rates when asked for.
+   **/
+  void setNeighborTree(const bool neighbor_tree);
+  bool hasNeighborTree() const { return neighbor_tree_.built(); }
+
+  /**
+   * \brief Recalculate the time constant and the hop probabilities
+   *
+   * Needed by copies of a site if the rates were changed through another
+   * copy.
+   **/
+  void updateProbabilitiesAndTimeConstant();
+
   /**
    * \brief Is the site a neighbor
    *
@@ -121,6 +172,18 @@ class KMC_Site : public KMC_TopologyFeature {
   int pickNewSiteId(const int & ) override;
   int pickNewSiteId() override;
 
+  /**
+   * \brief Turns the site into a drain
+   *
+   * A walker hopping onto a drain is absorbed. The drain is never occupied so
+   * it never blocks a hop, each walker absorbed is counted as a visit. The
+   * walker is given an infinite dwell time so it never leaves. The rates off
+   * of the drain are kept but are no longer used.
+   **/
+  void setDrain();
+
+  bool isDrain() const { return drain_; }
+
   /**
    * \brief Return the id of the cluster the site is attached too
    *
@@ -160,6 +223,25 @@ class KMC_Site : public KMC_TopologyFeature {
    **/
   std::vector<std::pair<int, double>> getProbabilitiesAndIdsOfNeighbors() const;
 
+  /**
+   * \brief Bytes of memory used by the site, including its random engine
+   **/
+  size_t getMemoryUsage() const;
+
+  /**
+   * \brief Writes the state of the site, including the values of its rates
+   **/
+  void writeCheckpoint(checkpoint::Writer & writer) const;
+
+  /**
+   * \brief Reads the state written by writeCheckpoint
+   *
+   * The site must already point to rates for the same neighbors, the values
+   * read are written to those rates. Throws a runtime_error if the neighbors
+   * do not match.
+   **/
+  void readCheckpoint(checkpoint::Reader & reader);
+
   /**
    * \brief Prints the output of the site
    **/
@@ -177,11 +259,21 @@ class KMC_Site : public KMC_TopologyFeature {
    **/
   std::unordered_map<int, double*> neighRates_;
 
+  /**
+   * \brief Rates to the neighbors, only built for sites with many neighbors
+   **/
+  KMC_NeighborTree neighbor_tree_;
+
   /**
    * \brief Stores the id of the cluster the site is a part of
    **/
   int cluster_id_;
 
+  /**
+   * \brief Walkers arriving at the site are absorbed
+   **/
+  bool drain_;
+
   /**
    * \brief Distribution to be used when picking random numbers
    **/
@@ -202,6 +294,9 @@ class KMC_Site : public KMC_TopologyFeature {
 
   double getSumOfRates_();
 
+  friend void occupyDrain_(KMC_TopologyFeature*);
+  friend void occupyDrain_(KMC_TopologyFeature*,const int&);
+
 };
 
 }
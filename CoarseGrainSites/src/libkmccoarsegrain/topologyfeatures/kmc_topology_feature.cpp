@@ -2,6 +2,7 @@
 #include <chrono>
 
 #include "kmc_topology_feature.hpp"
+#include "../kmc_checkpoint.hpp"
 
 using namespace std;
 
@@ -37,9 +38,12 @@ namespace kmccoarsegrain {
     return;
   }
 
-  KMC_TopologyFeature::KMC_TopologyFeature(){
-    auto seed = chrono::system_clock::now().time_since_epoch().count();
-    random_engine_ = mt19937(seed);
+  KMC_TopologyFeature::KMC_TopologyFeature()
+    : KMC_TopologyFeature(
+        chrono::system_clock::now().time_since_epoch().count()) {}
+
+  KMC_TopologyFeature::KMC_TopologyFeature(const unsigned long seed)
+    : random_engine_(seed) {
     random_distribution_ = uniform_real_distribution<double>(0.0, 1.0);
     occupied_ = 0;
     escape_time_constant_ = 0.0;
@@ -58,7 +62,7 @@ namespace kmccoarsegrain {
   }
 
   void KMC_TopologyFeature::setRandomSeed(const unsigned long seed){
-    random_engine_ = mt19937(seed);
+    random_engine_.seed(seed);
   }
 
   double KMC_TopologyFeature::getDwellTime(const int & ){
@@ -66,5 +70,20 @@ namespace kmccoarsegrain {
     return (-1.0)*log(number) * escape_time_constant_;
   }
 
+  void KMC_TopologyFeature::writeFeatureState_(checkpoint::Writer & writer) const {
+    writer.write(total_visit_freq_);
+    writer.write(occupied_);
+    writer.write(escape_time_constant_);
+    writer.write(random_engine_);
+  }
+
+  void KMC_TopologyFeature::readFeatureState_(checkpoint::Reader & reader) {
+    reader.read(total_visit_freq_);
+    reader.read(occupied_);
+    reader.read(escape_time_constant_);
+    reader.read(random_engine_);
+    random_distribution_.reset();
+  }
+
 }
 
@@ -13,6 +13,11 @@
 
 namespace kmccoarsegrain {
 
+namespace checkpoint {
+class Writer;
+class Reader;
+}
+
 /**
  * \brief TopologyFeature Class
  *
@@ -84,8 +89,14 @@ class KMC_TopologyFeature : public virtual Identity {
 
   friend void removeWalker_(KMC_TopologyFeature*,const int&);
 
+  /// Writes and reads the state shared by sites and clusters
+  void writeFeatureState_(checkpoint::Writer & writer) const;
+  void readFeatureState_(checkpoint::Reader & reader);
+
  public:
   KMC_TopologyFeature();
+  /// Seeds the random number generator with seed rather than the time
+  explicit KMC_TopologyFeature(const unsigned long seed);
 
   virtual ~KMC_TopologyFeature() {};
   /**
@@ -0,0 +1,610 @@
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_rate_provider.hpp"
+#include "../../../include/kmccoarsegrain/kmc_rate_table.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker_store.hpp"
+#include "../../libkmccoarsegrain/kmc_basin_explorer.hpp"
+#include "../../libkmccoarsegrain/kmc_cluster_container.hpp"
+#include "../../libkmccoarsegrain/kmc_coarsegrain_analysis.hpp"
+#include "../../libkmccoarsegrain/kmc_site_container.hpp"
+#include "../../libkmccoarsegrain/topologyfeatures/kmc_cluster.hpp"
+#include "../../libkmccoarsegrain/topologyfeatures/kmc_site.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+// All of the benchmarks use fixed seeds so that repeated runs carry out the
+// same work
+
+typedef unordered_map<int,unordered_map<int,double>> Rates;
+
+/**
+ * \brief Square lattice with Gaussian disorder in the site energies and
+ * Miller-Abrahams rates between nearest neighbors
+ *
+ * Sites are numbered from 0 row by row.
+ **/
+Rates createLattice(const int length, const double disorder){
+  mt19937 random_engine(1);
+  normal_distribution<double> energy_distribution(0.0,disorder);
+  vector<double> energies;
+  for(int siteId = 0; siteId < length*length; ++siteId){
+    energies.push_back(energy_distribution(random_engine));
+  }
+
+  double attempt_rate = 1.0E3;
+  double kT = 0.025;
+  Rates rates;
+  for(int row = 0; row < length; ++row){
+    for(int col = 0; col < length; ++col){
+      int siteId = row*length+col;
+      vector<int> neighIds;
+      if(col>0) neighIds.push_back(siteId-1);
+      if(col<length-1) neighIds.push_back(siteId+1);
+      if(row>0) neighIds.push_back(siteId-length);
+      if(row<length-1) neighIds.push_back(siteId+length);
+      for(const int & neighId : neighIds){
+        double energy_difference = energies.at(neighId)-energies.at(siteId);
+        double rate = attempt_rate;
+        if(energy_difference>0.0) rate *= exp(-energy_difference/kT);
+        rates[siteId][neighId] = rate;
+      }
+    }
+  }
+  return rates;
+}
+
+/**
+ * \brief Sites spread at random through a cube with Gaussian disorder in
+ * their energies
+ *
+ * There are 4 sites per unit volume, so a cutoff of 1.2 gives each site
+ * about 29 neighbors.
+ **/
+struct Morphology {
+  vector<double> x;
+  vector<double> y;
+  vector<double> z;
+  vector<double> energies;
+};
+
+Morphology createMorphology(const int number_of_sites, const double disorder){
+  mt19937 random_engine(1);
+  uniform_real_distribution<double> distribution(
+      0.0,cbrt(number_of_sites/4.0));
+  normal_distribution<double> energy_distribution(0.0,disorder);
+  Morphology morphology;
+  for(int siteId = 0; siteId < number_of_sites; ++siteId){
+    morphology.x.push_back(distribution(random_engine));
+    morphology.y.push_back(distribution(random_engine));
+    morphology.z.push_back(distribution(random_engine));
+    morphology.energies.push_back(energy_distribution(random_engine));
+  }
+  return morphology;
+}
+
+/**
+ * \brief Chain of sites 0 to size+1, the sites from 1 to size are joined by
+ * fast rates and make up a cluster
+ **/
+Rates createChain(const int size){
+  Rates rates;
+  for(int siteId = 0; siteId <= size; ++siteId){
+    double rate = (siteId==0 || siteId==size) ? 1.0 : 1000.0;
+    rates[siteId][siteId+1] = rate;
+    rates[siteId+1][siteId] = rate;
+  }
+  return rates;
+}
+
+KMC_Cluster createCluster(
+    Rates & rates,
+    const int size,
+    const KMC_Cluster::Method method){
+
+  KMC_Cluster cluster;
+  cluster.setRandomSeed(1);
+  cluster.setConvergenceMethod(method);
+  cluster.setConvergenceTolerance(0.001);
+  vector<KMC_Site> sites;
+  for(int siteId = 1; siteId <= size; ++siteId){
+    KMC_Site site;
+    site.setId(siteId);
+    site.setRatesToNeighbors(rates[siteId]);
+    sites.push_back(site);
+  }
+  cluster.addSites(sites);
+  cluster.updateProbabilitiesAndTimeConstant();
+  return cluster;
+}
+
+KMC_Site_Container createSiteContainer(Rates & rates){
+  KMC_Site_Container sites;
+  for(auto & site_and_rates : rates){
+    KMC_Site site;
+    site.setId(site_and_rates.first);
+    site.setRatesToNeighbors(site_and_rates.second);
+    sites.addKMC_Site(site);
+  }
+  return sites;
+}
+
+static void BM_SitePickNewSiteId(benchmark::State& state){
+  int neighbors = static_cast<int>(state.range(0));
+  unordered_map<int,double> rates;
+  for(int neighId = 1; neighId <= neighbors; ++neighId){
+    rates[neighId] = static_cast<double>(neighId);
+  }
+  KMC_Site site;
+  site.setId(0);
+  site.setRandomSeed(1);
+  site.setRatesToNeighbors(rates);
+  for(auto _ : state){
+    benchmark::DoNotOptimize(site.pickNewSiteId(1));
+  }
+}
+BENCHMARK(BM_SitePickNewSiteId)->Arg(2)->Arg(6)->Arg(26)->Arg(124);
+
+/// Same as BM_SitePickNewSiteId but with a neighbor tree
+static void BM_SitePickNewSiteIdTree(benchmark::State& state){
+  int neighbors = static_cast<int>(state.range(0));
+  unordered_map<int,double> rates;
+  for(int neighId = 1; neighId <= neighbors; ++neighId){
+    rates[neighId] = static_cast<double>(neighId);
+  }
+  KMC_Site site;
+  site.setId(0);
+  site.setRandomSeed(1);
+  site.setRatesToNeighbors(rates);
+  site.setNeighborTree(true);
+  for(auto _ : state){
+    benchmark::DoNotOptimize(site.pickNewSiteId(1));
+  }
+}
+BENCHMARK(BM_SitePickNewSiteIdTree)->Arg(6)->Arg(26)->Arg(124)->Arg(1000);
+
+/// Changing a single rate, the first argument turns the neighbor tree on
+static void BM_SiteUpdateRateToNeighbor(benchmark::State& state){
+  bool neighbor_tree = state.range(0)==1;
+  int neighbors = static_cast<int>(state.range(1));
+  unordered_map<int,double> rates;
+  for(int neighId = 1; neighId <= neighbors; ++neighId){
+    rates[neighId] = static_cast<double>(neighId);
+  }
+  KMC_Site site;
+  site.setId(0);
+  site.setRatesToNeighbors(rates);
+  site.setNeighborTree(neighbor_tree);
+  int neighId = 1;
+  for(auto _ : state){
+    site.updateRateToNeighbor(neighId,static_cast<double>(neighId+1));
+    neighId = neighId%neighbors+1;
+  }
+}
+BENCHMARK(BM_SiteUpdateRateToNeighbor)->ArgsProduct({{0, 1}, {26, 124, 1000}});
+
+static void BM_ClusterPickNewSiteId(benchmark::State& state){
+  int size = static_cast<int>(state.range(0));
+  Rates rates = createChain(size);
+  KMC_Cluster cluster = createCluster(
+      rates,
+      size,
+      KMC_Cluster::Method::converge_by_tolerance);
+  cluster.setResolution(20);
+  const int walker_id = 1;
+  for(auto _ : state){
+    // A dwell time is needed before each pick
+    benchmark::DoNotOptimize(cluster.getDwellTime(walker_id));
+    benchmark::DoNotOptimize(cluster.pickNewSiteId(walker_id));
+  }
+}
+BENCHMARK(BM_ClusterPickNewSiteId)->RangeMultiplier(4)->Range(4,256);
+
+static void BM_ClusterGetDwellTime(benchmark::State& state){
+  int size = static_cast<int>(state.range(0));
+  Rates rates = createChain(size);
+  KMC_Cluster cluster = createCluster(
+      rates,
+      size,
+      KMC_Cluster::Method::converge_by_tolerance);
+  // The whole escape time is drawn on each call
+  cluster.setEventSkipping(true);
+  const int walker_id = 1;
+  for(auto _ : state){
+    benchmark::DoNotOptimize(cluster.getDwellTime(walker_id));
+    // Always a neighbor of the cluster, releases the walker
+    benchmark::DoNotOptimize(cluster.pickNewSiteId(walker_id));
+  }
+}
+BENCHMARK(BM_ClusterGetDwellTime)->RangeMultiplier(4)->Range(4,256);
+
+static void BM_ClusterSolveMasterEquation(benchmark::State& state){
+  auto method = static_cast<KMC_Cluster::Method>(state.range(0));
+  int size = static_cast<int>(state.range(1));
+  Rates rates = createChain(size);
+  KMC_Cluster cluster = createCluster(rates,size,method);
+  for(auto _ : state){
+    cluster.updateProbabilitiesAndTimeConstant();
+  }
+}
+BENCHMARK(BM_ClusterSolveMasterEquation)
+  ->ArgsProduct({
+      {KMC_Cluster::Method::converge_by_iterations_per_cluster,
+       KMC_Cluster::Method::converge_by_iterations_per_site,
+       KMC_Cluster::Method::converge_by_tolerance},
+      {4, 16, 64}});
+
+static void BM_FindBasin(benchmark::State& state){
+  int length = static_cast<int>(state.range(0));
+  Rates rates = createLattice(length,0.1);
+  KMC_Site_Container sites = createSiteContainer(rates);
+  KMC_Cluster_Container clusters;
+  BasinExplorer basin_explorer;
+  int seedId = 0;
+  for(auto _ : state){
+    benchmark::DoNotOptimize(basin_explorer.findBasin(sites,clusters,seedId));
+    seedId = (seedId+1)%(length*length);
+  }
+}
+BENCHMARK(BM_FindBasin)->Arg(8)->Arg(32);
+
+static void BM_GetInternalTimeLimit(benchmark::State& state){
+  int size = static_cast<int>(state.range(0));
+  Rates rates = createChain(size);
+  KMC_Site_Container sites = createSiteContainer(rates);
+  vector<int> siteIds;
+  for(int siteId = 1; siteId <= size; ++siteId) siteIds.push_back(siteId);
+  for(auto _ : state){
+    benchmark::DoNotOptimize(getInternalTimeLimit(sites,siteIds));
+  }
+  state.SetComplexityN(size);
+}
+BENCHMARK(BM_GetInternalTimeLimit)->RangeMultiplier(2)->Range(2,32)->Complexity();
+
+static void BM_InitializeSystem(benchmark::State& state){
+  int length = static_cast<int>(state.range(0));
+  Rates rates = createLattice(length,0.1);
+  for(auto _ : state){
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.initializeSystem(rates);
+  }
+  state.SetComplexityN(length*length);
+}
+BENCHMARK(BM_InitializeSystem)
+  ->RangeMultiplier(2)
+  ->Range(8,128)
+  ->Unit(benchmark::kMillisecond)
+  ->Complexity();
+
+/// Hops of a single walker, the argument turns coarse graining on or off
+static void BM_Hop(benchmark::State& state){
+  bool coarse_grain = state.range(0)==1;
+  Rates rates = createLattice(32,0.1);
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0E6);
+  if(coarse_grain){
+    CGsystem.setMinCoarseGrainIterationThreshold(1000);
+  }else{
+    CGsystem.setMinCoarseGrainIterationThreshold(constants::inf_iterations);
+  }
+  CGsystem.initializeSystem(rates);
+
+  KMC_Walker walker;
+  walker.occupySite(0);
+  vector<pair<int,KMC_Walker>> walkers;
+  walkers.push_back(pair<int,KMC_Walker>(1,walker));
+  CGsystem.initializeWalkers(walkers);
+
+  for(auto _ : state){
+    CGsystem.hop(walkers.at(0).first,walkers.at(0).second);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Hop)->Arg(0)->Arg(1);
+
+/**
+ * \brief Hops of a single walker through a fresh lattice with coarse
+ * graining carried out on the hopping thread or on the background worker
+ *
+ * The first argument is 0 for synchronous and 1 for asynchronous coarse
+ * graining, the second is the disorder of the lattice in meV. Each
+ * iteration starts from a system without clusters, which is when most of
+ * the coarse graining is done. The time is the CPU time of the hopping
+ * thread, the worker is meant to run on a core of its own.
+ **/
+static void BM_HopCoarseGrain(benchmark::State& state){
+  bool asynchronous = state.range(0)==1;
+  double disorder = static_cast<double>(state.range(1))/1000.0;
+  Rates rates = createLattice(32,disorder);
+  const int hops = 20000;
+  for(auto _ : state){
+    state.PauseTiming();
+    unique_ptr<KMC_CoarseGrainSystem> CGsystem(new KMC_CoarseGrainSystem);
+    CGsystem->setRandomSeed(1);
+    CGsystem->setTimeResolution(1.0E6);
+    CGsystem->setMinCoarseGrainIterationThreshold(10);
+    CGsystem->setAsynchronousCoarseGraining(asynchronous);
+    CGsystem->initializeSystem(rates);
+
+    KMC_Walker walker;
+    walker.occupySite(0);
+    vector<pair<int,KMC_Walker>> walkers;
+    walkers.push_back(pair<int,KMC_Walker>(1,walker));
+    CGsystem->initializeWalkers(walkers);
+    state.ResumeTiming();
+
+    for(int hop = 0; hop < hops; ++hop){
+      CGsystem->hop(walkers.at(0).first,walkers.at(0).second);
+    }
+
+    state.PauseTiming();
+    CGsystem.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations()*hops);
+}
+BENCHMARK(BM_HopCoarseGrain)
+  ->ArgsProduct({{0, 1}, {50, 100, 200}})
+  ->Unit(benchmark::kMillisecond);
+
+/**
+ * \brief Hops of many walkers with and without rejections
+ *
+ * The first argument is the kinetics: 0 exact, where hops onto occupied
+ * sites are rejected, and 1 rejection free. The second is the percentage of
+ * the sites occupied. The walker with the earliest time hops next. Rejected
+ * hops cost time without moving a walker, so compare the rate of moves and
+ * the simulated time covered per second rather than the time per hop.
+ **/
+static void BM_HopAtOccupancy(benchmark::State& state){
+  bool rejection_free = state.range(0)==1;
+  int occupancy = static_cast<int>(state.range(1));
+  int length = 32;
+  Rates rates = createLattice(length,0.1);
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0E6);
+  if(rejection_free){
+    CGsystem.setKinetics(KMC_CoarseGrainSystem::rejection_free);
+  }else{
+    CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+  }
+  CGsystem.initializeSystem(rates);
+
+  vector<int> siteIds;
+  for(int siteId = 0; siteId < length*length; ++siteId){
+    siteIds.push_back(siteId);
+  }
+  mt19937 random_engine(1);
+  shuffle(siteIds.begin(),siteIds.end(),random_engine);
+  KMC_WalkerStore walkers;
+  for(int walker = 0; walker < length*length*occupancy/100; ++walker){
+    walkers.add(siteIds.at(walker));
+  }
+  CGsystem.initializeWalkers(walkers);
+
+  double moves = 0.0;
+  double start_time = walkers.getTime(walkers.getEarliest());
+  double time = start_time;
+  for(auto _ : state){
+    int handle = walkers.getEarliest();
+    int siteId = walkers.getSite(handle);
+    time = walkers.getTime(handle);
+    CGsystem.hop(walkers,handle);
+    if(walkers.getSite(handle)!=siteId) moves += 1.0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["moves"] = benchmark::Counter(
+      moves,benchmark::Counter::kIsRate);
+  state.counters["simulated_time"] = benchmark::Counter(
+      time-start_time,benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_HopAtOccupancy)->ArgsProduct({{0, 1}, {1, 10, 30}});
+
+/**
+ * \brief Hops of many walkers picked by each event selection
+ *
+ * The first argument is the event selection: 0 first reaction, where the
+ * store is searched for the walker with the earliest time, and 1 the rate
+ * tree. The second is the number of walkers on a 64 by 64 lattice.
+ **/
+static void BM_HopNext(benchmark::State& state){
+  bool rate_tree = state.range(0)==1;
+  int number_of_walkers = static_cast<int>(state.range(1));
+  int length = 64;
+  Rates rates = createLattice(length,0.1);
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0E6);
+  CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+  if(rate_tree) CGsystem.setEventSelection(KMC_CoarseGrainSystem::rate_tree);
+  CGsystem.initializeSystem(rates);
+
+  vector<int> siteIds;
+  for(int siteId = 0; siteId < length*length; ++siteId){
+    siteIds.push_back(siteId);
+  }
+  mt19937 random_engine(1);
+  shuffle(siteIds.begin(),siteIds.end(),random_engine);
+  KMC_WalkerStore walkers;
+  for(int walker = 0; walker < number_of_walkers; ++walker){
+    walkers.add(siteIds.at(walker));
+  }
+  CGsystem.initializeWalkers(walkers);
+
+  for(auto _ : state){
+    benchmark::DoNotOptimize(CGsystem.hopNext(walkers));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HopNext)->ArgsProduct({{0, 1}, {10, 100, 1000}});
+
+/**
+ * \brief Bytes used per site by each storage mode
+ *
+ * The first argument is the length of the lattice, the second is the mode:
+ * 0 exact kinetics, 1 coarse grained and 2 coarse grained with cluster event
+ * skipping. The walker hops first so the coarse grained systems hold
+ * clusters.
+ **/
+static void BM_MemoryUsage(benchmark::State& state){
+  int length = static_cast<int>(state.range(0));
+  int mode = static_cast<int>(state.range(1));
+  Rates rates = createLattice(length,0.1);
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0E6);
+  CGsystem.setMinCoarseGrainIterationThreshold(1000);
+  if(mode==0) CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+  if(mode==2) CGsystem.setClusterEventSkipping(true);
+  CGsystem.initializeSystem(rates);
+
+  KMC_Walker walker;
+  walker.occupySite(0);
+  vector<pair<int,KMC_Walker>> walkers;
+  walkers.push_back(pair<int,KMC_Walker>(1,walker));
+  CGsystem.initializeWalkers(walkers);
+  for(int hop = 0; hop < 100000; ++hop){
+    CGsystem.hop(walkers.at(0).first,walkers.at(0).second);
+  }
+
+  KMC_MemoryUsage usage;
+  for(auto _ : state){
+    usage = CGsystem.getMemoryUsage();
+    benchmark::DoNotOptimize(usage);
+  }
+  double sites = static_cast<double>(length*length);
+  state.counters["sites_B"] = usage.sites/sites;
+  state.counters["clusters_B"] = usage.clusters/sites;
+  state.counters["features_B"] = usage.topology_features/sites;
+  state.counters["engines_B"] = usage.random_engines/sites;
+  state.counters["rate_map_B"] = usage.rate_map/sites;
+  state.counters["rate_cache_B"] = usage.rate_cache/sites;
+  state.counters["scratch_B"] = usage.scratch/sites;
+  state.counters["total_B"] = usage.total()/sites;
+}
+BENCHMARK(BM_MemoryUsage)->ArgsProduct({{16, 64}, {0, 1, 2}});
+
+/**
+ * \brief Hops of a single walker with the rates stored in each direction or
+ * once per pair of sites
+ *
+ * The first argument is the storage: 0 a KMC_RateTable holding the rates in
+ * both directions, 1 a KMC_CompressedRateTable with a rate cache that holds
+ * every site, 2 a KMC_CompressedRateTable with a rate cache that holds a
+ * sixteenth of the sites, and 3 a KMC_RateProvider, which stores no rates,
+ * with the same cache as 2. The second is the number of sites. The counters
+ * give the bytes per site of the stored rates, of the rate cache and of the
+ * system, the system includes the rate cache but not the stored rates, and
+ * total_B of the system together with the stored rates.
+ *
+ * The cache keeps only the rates of a site, not its neighbors, so it is a
+ * small part of the total, which is set by the sites that are loaded, each
+ * with its own random engine. 1 with every site loaded is no smaller than 0,
+ * 2 and 3 loading a sixteenth of the sites are about a tenth of it. What 2
+ * and 3 lose in hops per second goes into seeding the engine of each site
+ * they load.
+ **/
+static void BM_HopRateStorage(benchmark::State& state){
+  int storage = static_cast<int>(state.range(0));
+  int number_of_sites = static_cast<int>(state.range(1));
+  Morphology morphology = createMorphology(number_of_sites,0.05);
+  KMC_RateModel model;
+
+  KMC_RateTable table;
+  KMC_CompressedRateTable compressed_table;
+  unique_ptr<KMC_RateProvider> provider;
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0E6);
+  CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+  if(storage==0){
+    table = generateRateTable(morphology.x,morphology.y,morphology.z,
+        morphology.energies,1.2,model,1);
+    CGsystem.initializeSystem(table);
+  }else if(storage==3){
+    provider = unique_ptr<KMC_RateProvider>(new KMC_RateProvider(
+          morphology.x,morphology.y,morphology.z,morphology.energies,1.2,
+          model,1));
+    CGsystem.setRateCacheCapacity(number_of_sites/16);
+    CGsystem.initializeSystem(*provider);
+  }else{
+    compressed_table = generateCompressedRateTable(morphology.x,morphology.y,
+        morphology.z,morphology.energies,1.2,model,1);
+    size_t capacity = number_of_sites;
+    if(storage==2) capacity = number_of_sites/16;
+    CGsystem.setRateCacheCapacity(capacity);
+    CGsystem.initializeSystem(compressed_table);
+  }
+
+  KMC_Walker walker;
+  walker.occupySite(0);
+  vector<pair<int,KMC_Walker>> walkers;
+  walkers.push_back(pair<int,KMC_Walker>(1,walker));
+  CGsystem.initializeWalkers(walkers);
+
+  for(auto _ : state){
+    CGsystem.hop(walkers.at(0).first,walkers.at(0).second);
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  KMC_MemoryUsage usage = CGsystem.getMemoryUsage();
+  double sites = static_cast<double>(number_of_sites);
+  state.counters["rates_B"] = usage.rate_map/sites;
+  state.counters["cache_B"] = usage.rate_cache/sites;
+  state.counters["system_B"] = usage.total()/sites;
+  state.counters["total_B"] = (usage.total()+usage.rate_map)/sites;
+}
+BENCHMARK(BM_HopRateStorage)->ArgsProduct({{0, 1, 2, 3}, {4096, 32768}});
+
+/**
+ * \brief Rates off a site read from each storage
+ *
+ * The argument is the storage: 0 a KMC_RateTable, where the rates are read
+ * straight from the row, and 1 a KMC_CompressedRateTable, where they are
+ * rebuilt from the prefactors and energies.
+ **/
+static void BM_RatesOffSite(benchmark::State& state){
+  bool compressed = state.range(0)==1;
+  const int number_of_sites = 32768;
+  Morphology morphology = createMorphology(number_of_sites,0.05);
+  KMC_RateModel model;
+  KMC_RateTable table = generateRateTable(morphology.x,morphology.y,
+      morphology.z,morphology.energies,1.2,model,1);
+  KMC_CompressedRateTable compressed_table = generateCompressedRateTable(
+      morphology.x,morphology.y,morphology.z,morphology.energies,1.2,model,1);
+
+  mt19937 random_engine(1);
+  uniform_int_distribution<int> distribution(0,number_of_sites-1);
+  vector<int> neighIds;
+  vector<double> rates;
+  for(auto _ : state){
+    int siteId = distribution(random_engine);
+    if(compressed){
+      compressed_table.getRatesOffSite(siteId,neighIds,rates);
+    }else{
+      neighIds.assign(table.neighbors.begin()+table.offsets[siteId],
+          table.neighbors.begin()+table.offsets[siteId+1]);
+      rates.assign(table.rates.begin()+table.offsets[siteId],
+          table.rates.begin()+table.offsets[siteId+1]);
+    }
+    benchmark::DoNotOptimize(rates.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RatesOffSite)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "morphology_generator.hpp"
+
+using namespace std;
+
+namespace kmccoarsegrain {
+namespace morphology {
+
+  /****************************************************************************
+   * Local Functions
+   ****************************************************************************/
+
+  /// Turns lists of neighbors into rate data, the rates are calculated from
+  /// the energies and the positions of the sites
+  static RateData createRateData_(
+      const vector<vector<int>> & neighbors,
+      const vector<double> & energies,
+      const vector<double> & x,
+      const vector<double> & y,
+      const vector<double> & z,
+      const RateModel & model){
+
+    RateData rate_data;
+    rate_data.offsets.reserve(neighbors.size()+1);
+    rate_data.offsets.push_back(0);
+    for(size_t siteId = 0; siteId < neighbors.size(); ++siteId){
+      for(const int & neighId : neighbors.at(siteId)){
+        double dx = x.at(neighId)-x.at(siteId);
+        double dy = y.at(neighId)-y.at(siteId);
+        double dz = z.at(neighId)-z.at(siteId);
+        double distance = sqrt(dx*dx+dy*dy+dz*dz);
+        rate_data.neighbors.push_back(neighId);
+        rate_data.rates.push_back(model.rate(
+              energies.at(neighId)-energies.at(siteId),
+              dx,
+              distance));
+      }
+      rate_data.offsets.push_back(rate_data.neighbors.size());
+    }
+    return rate_data;
+  }
+
+  /// Smooths the values along one axis of a cubic lattice
+  static void smoothAlongAxis_(
+      vector<double> & values,
+      const int length,
+      const size_t stride,
+      const vector<double> & kernel){
+
+    int reach = static_cast<int>(kernel.size())-1;
+    vector<double> line(length);
+    size_t number_of_sites = values.size();
+    for(size_t start = 0; start < number_of_sites; ++start){
+      // Only start from the first site of each line
+      if((start/stride)%length!=0) continue;
+      for(int index = 0; index < length; ++index){
+        line.at(index) = values.at(start+index*stride);
+      }
+      for(int index = 0; index < length; ++index){
+        double sum = 0.0;
+        for(int shift = -reach; shift <= reach; ++shift){
+          int neighbor = index+shift;
+          if(neighbor<0 || neighbor>=length) continue;
+          sum += kernel.at(abs(shift))*line.at(neighbor);
+        }
+        values.at(start+index*stride) = sum;
+      }
+    }
+  }
+
+  /****************************************************************************
+   * Public Facing Functions
+   ****************************************************************************/
+
+  unordered_map<int,unordered_map<int,double>> RateData::toRateMap() const {
+    unordered_map<int,unordered_map<int,double>> rate_map;
+    rate_map.reserve(size());
+    for(size_t siteId = 0; siteId < size(); ++siteId){
+      unordered_map<int,double> & site_rates = rate_map[static_cast<int>(siteId)];
+      for(size_t index = offsets.at(siteId); index < offsets.at(siteId+1); ++index){
+        site_rates[neighbors.at(index)] = rates.at(index);
+      }
+    }
+    return rate_map;
+  }
+
+  vector<double> gaussianEnergies(
+      size_t number_of_sites,
+      double sigma,
+      unsigned long seed){
+
+    mt19937 random_engine(seed);
+    normal_distribution<double> distribution(0.0,sigma);
+    vector<double> energies(number_of_sites);
+    for(double & energy : energies) energy = distribution(random_engine);
+    return energies;
+  }
+
+  vector<double> correlatedEnergies(
+      int length,
+      double sigma,
+      double correlation_length,
+      unsigned long seed){
+
+    size_t number_of_sites = static_cast<size_t>(length)*length*length;
+    vector<double> energies = gaussianEnergies(number_of_sites,1.0,seed);
+    if(correlation_length<=0.0){
+      for(double & energy : energies) energy *= sigma;
+      return energies;
+    }
+
+    // The Gaussian kernel can be applied one axis at a time
+    int reach = static_cast<int>(ceil(3.0*correlation_length));
+    vector<double> kernel;
+    for(int shift = 0; shift <= reach; ++shift){
+      kernel.push_back(exp(-0.5*pow(shift/correlation_length,2.0)));
+    }
+    size_t stride = 1;
+    for(int axis = 0; axis < 3; ++axis){
+      smoothAlongAxis_(energies,length,stride,kernel);
+      stride *= static_cast<size_t>(length);
+    }
+
+    // Scale back to the width of the density of states
+    double mean = 0.0;
+    for(const double & energy : energies) mean += energy;
+    mean /= static_cast<double>(number_of_sites);
+    double variance = 0.0;
+    for(const double & energy : energies) variance += pow(energy-mean,2.0);
+    variance /= static_cast<double>(number_of_sites);
+    double scale = variance>0.0 ? sigma/sqrt(variance) : 0.0;
+    for(double & energy : energies) energy = (energy-mean)*scale;
+    return energies;
+  }
+
+  void addTraps(
+      vector<double> & energies,
+      double fraction,
+      double depth,
+      unsigned long seed){
+
+    assert(fraction>=0.0 && fraction<=1.0);
+    mt19937 random_engine(seed);
+    uniform_real_distribution<double> distribution(0.0,1.0);
+    for(double & energy : energies){
+      if(distribution(random_engine)<fraction) energy -= depth;
+    }
+  }
+
+  RateData chain(const vector<double> & energies, const RateModel & model){
+    int length = static_cast<int>(energies.size());
+    assert(length>1 && "A chain needs at least two sites");
+    vector<vector<int>> neighbors(length);
+    vector<double> x(length);
+    vector<double> zeros(length,0.0);
+    for(int siteId = 0; siteId < length; ++siteId){
+      x.at(siteId) = static_cast<double>(siteId);
+      if(siteId>0) neighbors.at(siteId).push_back(siteId-1);
+      if(siteId<length-1) neighbors.at(siteId).push_back(siteId+1);
+    }
+    return createRateData_(neighbors,energies,x,zeros,zeros,model);
+  }
+
+  RateData cubicLattice(
+      int length,
+      const vector<double> & energies,
+      const RateModel & model,
+      bool diagonals){
+
+    size_t number_of_sites = static_cast<size_t>(length)*length*length;
+    assert(energies.size()==number_of_sites && "There must be an energy for "
+        "each site of the lattice");
+
+    RateData rate_data;
+    size_t neighbors_per_site = diagonals ? 26 : 6;
+    rate_data.offsets.reserve(number_of_sites+1);
+    rate_data.neighbors.reserve(number_of_sites*neighbors_per_site);
+    rate_data.rates.reserve(number_of_sites*neighbors_per_site);
+    rate_data.offsets.push_back(0);
+
+    // Built directly rather than through lists of neighbors so that large
+    // lattices do not need the extra memory
+    for(int z = 0; z < length; ++z){
+      for(int y = 0; y < length; ++y){
+        for(int x = 0; x < length; ++x){
+          int siteId = x+y*length+z*length*length;
+          for(int dz = -1; dz <= 1; ++dz){
+            for(int dy = -1; dy <= 1; ++dy){
+              for(int dx = -1; dx <= 1; ++dx){
+                int steps = abs(dx)+abs(dy)+abs(dz);
+                if(steps==0 || (!diagonals && steps!=1)) continue;
+                if(x+dx<0 || x+dx>=length) continue;
+                if(y+dy<0 || y+dy>=length) continue;
+                if(z+dz<0 || z+dz>=length) continue;
+                int neighId = siteId+dx+dy*length+dz*length*length;
+                rate_data.neighbors.push_back(neighId);
+                rate_data.rates.push_back(model.rate(
+                      energies.at(neighId)-energies.at(siteId),
+                      static_cast<double>(dx),
+                      sqrt(static_cast<double>(dx*dx+dy*dy+dz*dz))));
+              }
+            }
+          }
+          rate_data.offsets.push_back(rate_data.neighbors.size());
+        }
+      }
+    }
+    return rate_data;
+  }
+
+  RateData randomGeometricGraph(
+      const vector<double> & energies,
+      double density,
+      double cutoff,
+      const RateModel & model,
+      unsigned long seed){
+
+    assert(density>0.0 && cutoff>0.0);
+    size_t number_of_sites = energies.size();
+    assert(number_of_sites>1 && "A graph needs at least two sites");
+    double side = cbrt(static_cast<double>(number_of_sites)/density);
+
+    mt19937 random_engine(seed);
+    uniform_real_distribution<double> distribution(0.0,side);
+    vector<double> x(number_of_sites);
+    vector<double> y(number_of_sites);
+    vector<double> z(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      x.at(siteId) = distribution(random_engine);
+      y.at(siteId) = distribution(random_engine);
+      z.at(siteId) = distribution(random_engine);
+    }
+
+    RateData rate_data;
+    static_cast<KMC_RateTable &>(rate_data) =
+      generateRateTable(x,y,z,energies,cutoff,model);
+    return rate_data;
+  }
+}
+}
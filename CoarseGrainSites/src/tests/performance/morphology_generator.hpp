@@ -0,0 +1,103 @@
+#ifndef KMCCOARSEGRAIN_MORPHOLOGY_GENERATOR_HPP
+#define KMCCOARSEGRAIN_MORPHOLOGY_GENERATOR_HPP
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_rate_table.hpp"
+
+namespace kmccoarsegrain {
+/**
+ * \brief Synthetic morphologies used to test the performance of the library
+ *
+ * Sites are numbered from 0. The energies of the sites are generated first
+ * and then turned into rates by one of the generators, so the same disorder
+ * can be placed on different topologies.
+ **/
+namespace morphology {
+
+/**
+ * \brief Rates off each site stored in compressed sparse rows
+ *
+ * The table can be passed straight to
+ * KMC_CoarseGrainSystem::initializeSystem, so systems of 10^7 sites can be
+ * set up without building nested maps.
+ **/
+struct RateData : public KMC_RateTable {
+  /// Nested maps in the form taken by KMC_CoarseGrainSystem::initializeSystem
+  std::unordered_map<int,std::unordered_map<int,double>> toRateMap() const;
+};
+
+/// Determines the rate between two sites, the default values are the ones
+/// used by the performance drivers
+typedef KMC_RateModel RateModel;
+
+/**
+ * \brief Energies drawn from a Gaussian density of states centered at 0
+ **/
+std::vector<double> gaussianEnergies(
+    size_t number_of_sites,
+    double sigma,
+    unsigned long seed);
+
+/**
+ * \brief Energies of a cubic lattice that are correlated over a distance
+ *
+ * Gaussian energies are smoothed with a Gaussian kernel of width
+ * correlation_length, given in lattice spacings, and then scaled back so
+ * the density of states has a width of sigma.
+ **/
+std::vector<double> correlatedEnergies(
+    int length,
+    double sigma,
+    double correlation_length,
+    unsigned long seed);
+
+/**
+ * \brief Lowers the energy of a fraction of the sites by the trap depth
+ **/
+void addTraps(
+    std::vector<double> & energies,
+    double fraction,
+    double depth,
+    unsigned long seed);
+
+/**
+ * \brief One dimensional chain with rates between nearest neighbors
+ **/
+RateData chain(const std::vector<double> & energies, const RateModel & model);
+
+/**
+ * \brief Cubic lattice with sides of length sites
+ *
+ * Site (x,y,z) has the id x + y*length + z*length*length. Each site is
+ * connected to its 6 nearest neighbors, or to all 26 sites surrounding it
+ * if diagonals is true.
+ **/
+RateData cubicLattice(
+    int length,
+    const std::vector<double> & energies,
+    const RateModel & model,
+    bool diagonals);
+
+/**
+ * \brief Sites placed at random in a cube, connected to every site within
+ * the cutoff
+ *
+ * The sites are placed with the given number of sites per unit volume.
+ * The neighbors and rates are built by generateRateTable, so sites
+ * without a site in reach of the cutoff are connected to their nearest
+ * site and every site has a rate off of it.
+ **/
+RateData randomGeometricGraph(
+    const std::vector<double> & energies,
+    double density,
+    double cutoff,
+    const RateModel & model,
+    unsigned long seed);
+
+}
+}
+
+#endif  // KMCCOARSEGRAIN_MORPHOLOGY_GENERATOR_HPP
@@ -0,0 +1,204 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "morphology_generator.hpp"
+
+using namespace std;
+using namespace std::chrono;
+using namespace kmccoarsegrain;
+
+/// Splits a comma separated list of values
+template<typename T>
+vector<T> parseList(const string & list){
+  vector<T> values;
+  stringstream ss(list);
+  string value;
+  while(getline(ss,value,',')){
+    stringstream value_stream(value);
+    T parsed;
+    value_stream >> parsed;
+    values.push_back(parsed);
+  }
+  return values;
+}
+
+/// Resident memory of the process in MB, read from /proc on linux
+double residentMemory(){
+  ifstream statm("/proc/self/statm");
+  long pages_total = 0;
+  long pages_resident = 0;
+  if(!(statm >> pages_total >> pages_resident)) return 0.0;
+  return static_cast<double>(pages_resident)*sysconf(_SC_PAGESIZE)/1.0E6;
+}
+
+morphology::RateData createMorphology(
+    const string & morphology_type,
+    int length,
+    double sigma,
+    unsigned long seed){
+
+  morphology::RateModel model;
+  if(morphology_type=="chain"){
+    auto energies = morphology::gaussianEnergies(length,sigma,seed);
+    return morphology::chain(energies,model);
+  }
+  size_t number_of_sites = static_cast<size_t>(length)*length*length;
+  if(morphology_type=="graph"){
+    auto energies = morphology::gaussianEnergies(number_of_sites,sigma,seed);
+    model.type = morphology::RateModel::miller_abrahams;
+    return morphology::randomGeometricGraph(energies,1.0,1.5,model,seed);
+  }
+  vector<double> energies;
+  if(morphology_type=="correlated"){
+    energies = morphology::correlatedEnergies(length,sigma,2.0,seed);
+  }else{
+    energies = morphology::gaussianEnergies(number_of_sites,sigma,seed);
+  }
+  if(morphology_type=="traps"){
+    morphology::addTraps(energies,0.01,5.0*sigma,seed+1);
+  }
+  return morphology::cubicLattice(length,energies,model,false);
+}
+
+struct RunResult {
+  double events_per_second;
+  double simulated_time;
+  double simulated_time_per_second;
+};
+
+/// Hops the walkers, always moving the one with the earliest time next
+RunResult run(
+    KMC_RateTable & rates,
+    const vector<int> & starting_sites,
+    long hops,
+    bool coarse_grain){
+
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(1);
+  CGsystem.setTimeResolution(1.0);
+  CGsystem.setMinCoarseGrainIterationThreshold(1000);
+  if(!coarse_grain) CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+  CGsystem.initializeSystem(rates);
+
+  vector<pair<int,KMC_Walker>> walkers;
+  for(size_t index = 0; index < starting_sites.size(); ++index){
+    KMC_Walker walker;
+    walker.occupySite(starting_sites.at(index));
+    walkers.push_back(pair<int,KMC_Walker>(static_cast<int>(index),walker));
+  }
+  CGsystem.initializeWalkers(walkers);
+
+  typedef pair<double,size_t> TimeAndWalker;
+  priority_queue<TimeAndWalker,vector<TimeAndWalker>,greater<TimeAndWalker>> queue;
+  for(size_t index = 0; index < walkers.size(); ++index){
+    queue.push(TimeAndWalker(walkers.at(index).second.getDwellTime(),index));
+  }
+
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  double time = 0.0;
+  for(long hop = 0; hop < hops; ++hop){
+    TimeAndWalker next = queue.top();
+    queue.pop();
+    time = next.first;
+    pair<int,KMC_Walker> & walker = walkers.at(next.second);
+    CGsystem.hop(walker.first,walker.second);
+    queue.push(TimeAndWalker(time+walker.second.getDwellTime(),next.second));
+  }
+  high_resolution_clock::time_point end = high_resolution_clock::now();
+  double seconds = duration_cast<duration<double>>(end-start).count();
+
+  RunResult result;
+  result.events_per_second = static_cast<double>(hops)/seconds;
+  result.simulated_time = time;
+  result.simulated_time_per_second = time/seconds;
+  return result;
+}
+
+int main(int argc, char* argv[]){
+
+  if(argc!=6){
+    cerr << "To run the program correctly you must provide the " << endl;
+    cerr << "following parameters: " << endl;
+    cerr << endl;
+    cerr << "morphology - one of cubic, correlated, traps, chain or graph" << endl;
+    cerr << "lengths    - comma separated list of integers, the number of" << endl;
+    cerr << "             sites along each side of the system. " << endl;
+    cerr << "walkers    - comma separated list of the number of walkers" << endl;
+    cerr << "sigmas     - comma separated list of the widths of the" << endl;
+    cerr << "             density of states." << endl;
+    cerr << "hops       - integer, the number of hops in each run." << endl;
+    cerr << endl;
+    cerr << "To run:" << endl;
+    cerr << endl;
+    cerr << "./performance_test_scaling cubic 10,20,40 1,10 0.05,0.1 100000" << endl;
+    cerr << endl;
+    return -1;
+  }
+
+  string morphology_type = argv[1];
+  vector<int> lengths = parseList<int>(argv[2]);
+  vector<int> walker_counts = parseList<int>(argv[3]);
+  vector<double> sigmas = parseList<double>(argv[4]);
+  long hops = stol(string(argv[5]));
+
+  cout << "morphology,sites,walkers,sigma,generation_s,rate_data_MB,rss_MB,"
+    "crude_events_per_s,coarse_grained_events_per_s,"
+    "crude_sim_time_per_s,coarse_grained_sim_time_per_s,speedup" << endl;
+
+  unsigned long seed = 1;
+  for(const int & length : lengths){
+    for(const double & sigma : sigmas){
+      high_resolution_clock::time_point start = high_resolution_clock::now();
+      morphology::RateData rate_data = createMorphology(
+          morphology_type,
+          length,
+          sigma,
+          seed);
+      high_resolution_clock::time_point end = high_resolution_clock::now();
+      double generation_time = duration_cast<duration<double>>(end-start).count();
+      double rate_data_memory = static_cast<double>(rate_data.getMemoryUsage())/1.0E6;
+
+      double memory = residentMemory();
+
+      for(const int & walker_count : walker_counts){
+        if(static_cast<size_t>(walker_count)>rate_data.size()) continue;
+
+        // Walkers start on different sites
+        mt19937 random_engine(seed);
+        uniform_int_distribution<int> distribution(0,static_cast<int>(rate_data.size())-1);
+        set<int> occupied;
+        while(occupied.size()<static_cast<size_t>(walker_count)){
+          occupied.insert(distribution(random_engine));
+        }
+        vector<int> starting_sites(occupied.begin(),occupied.end());
+
+        RunResult crude = run(rate_data,starting_sites,hops,false);
+        RunResult coarse_grained = run(rate_data,starting_sites,hops,true);
+
+        cout << morphology_type << "," << rate_data.size() << ",";
+        cout << walker_count << "," << sigma << ",";
+        cout << generation_time << "," << rate_data_memory << "," << memory << ",";
+        cout << crude.events_per_second << ",";
+        cout << coarse_grained.events_per_second << ",";
+        cout << crude.simulated_time_per_second << ",";
+        cout << coarse_grained.simulated_time_per_second << ",";
+        cout << coarse_grained.simulated_time_per_second/
+          crude.simulated_time_per_second << endl;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "../performance/morphology_generator.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+// Crude and coarse grained kinetics are run over the same system with many
+// seeds. The observables of the two are compared with statistical tests at a
+// significance level of 0.001, so the test only fails when the kinetics
+// differ, not because of noise. A statistical test alone passes whenever the
+// samples are too small to tell the kinetics apart, so the mobilities must
+// also agree within a relative tolerance and the runs must be long enough to
+// resolve a difference of that size.
+
+/// Standard normal quantile and Kolmogorov-Smirnov coefficient at 0.001
+static const double z_critical = 3.29;
+static const double ks_coefficient = 1.95;
+
+/**
+ * \brief Everything recorded during the runs of one kind of kinetics
+ **/
+struct Observables {
+  /// Time for each walker to cross the system after leaving the first plane
+  vector<double> transit_times;
+  /// Every dwell time spent on a site, stored by site
+  unordered_map<int,vector<double>> dwell_times;
+  /// Visits to each site in each of the runs
+  vector<unordered_map<int,double>> visits;
+  /// Sites that were part of a cluster in any of the runs
+  unordered_set<int> cluster_sites;
+};
+
+/**
+ * \brief Runs a time of flight simulation
+ *
+ * Walkers start on the x=0 plane and are removed once they reach the last
+ * plane. The lattice is numbered so x is the id modulo the length. The
+ * transit is timed from when a walker first leaves the x=0 plane, a walker
+ * that starts on a deep site waits there for longer than the rest of the
+ * transit and that wait is the same with both kinetics.
+ **/
+void timeOfFlight(
+    unordered_map<int,unordered_map<int,double>> & rates,
+    int length,
+    int walkers,
+    unsigned long seed,
+    unsigned long kinetics_seed,
+    int threshold,
+    double time_resolution,
+    KMC_CoarseGrainSystem::Kinetics kinetics,
+    Observables & observables){
+
+  KMC_CoarseGrainSystem CGsystem;
+  CGsystem.setRandomSeed(kinetics_seed);
+  CGsystem.setTimeResolution(time_resolution);
+  CGsystem.setMinCoarseGrainIterationThreshold(threshold);
+  CGsystem.setKinetics(kinetics);
+  CGsystem.initializeSystem(rates);
+
+  // The starting sites depend only on the seed, the two kinetics are given
+  // different kinetics seeds so their runs are independent
+  mt19937 random_engine(seed);
+  uniform_int_distribution<int> distribution(0,length-1);
+  set<int> starting_sites;
+  while(starting_sites.size()<static_cast<size_t>(walkers)){
+    int y = distribution(random_engine);
+    int z = distribution(random_engine);
+    starting_sites.insert(y*length+z*length*length);
+  }
+
+  vector<pair<int,KMC_Walker>> electrons;
+  for(const int & siteId : starting_sites){
+    KMC_Walker electron;
+    electron.occupySite(siteId);
+    electrons.push_back(pair<int,KMC_Walker>(
+          static_cast<int>(electrons.size()),electron));
+  }
+  CGsystem.initializeWalkers(electrons);
+
+  vector<double> entry_times(electrons.size(),-1.0);
+  typedef pair<double,size_t> TimeAndWalker;
+  priority_queue<TimeAndWalker,vector<TimeAndWalker>,greater<TimeAndWalker>> queue;
+  for(size_t index = 0; index < electrons.size(); ++index){
+    queue.push(TimeAndWalker(electrons.at(index).second.getDwellTime(),index));
+  }
+
+  while(!queue.empty()){
+    TimeAndWalker next = queue.top();
+    queue.pop();
+    KMC_Walker & electron = electrons.at(next.second).second;
+    observables.dwell_times[electron.getIdOfSiteCurrentlyOccupying()]
+      .push_back(electron.getDwellTime());
+    CGsystem.hop(electrons.at(next.second).first,electron);
+    double & entry_time = entry_times.at(next.second);
+    if(entry_time<0.0 && electron.getIdOfSiteCurrentlyOccupying()%length!=0){
+      entry_time = next.first;
+    }
+    if(electron.getIdOfSiteCurrentlyOccupying()%length==length-1){
+      observables.transit_times.push_back(next.first-entry_time);
+      CGsystem.removeWalkerFromSystem(electrons.at(next.second).first,electron);
+      continue;
+    }
+    queue.push(TimeAndWalker(next.first+electron.getDwellTime(),next.second));
+  }
+
+  for(const auto & cluster : CGsystem.getClusters()){
+    observables.cluster_sites.insert(cluster.second.begin(),cluster.second.end());
+  }
+  unordered_map<int,double> visits;
+  for(const auto & site_and_rates : rates){
+    const int & siteId = site_and_rates.first;
+    visits[siteId] = CGsystem.getVisitFrequencyOfSite(siteId);
+  }
+  observables.visits.push_back(visits);
+}
+
+double mean(const vector<double> & values){
+  double sum = 0.0;
+  for(const double & value : values) sum += value;
+  return sum/static_cast<double>(values.size());
+}
+
+double variance(const vector<double> & values){
+  double average = mean(values);
+  double sum = 0.0;
+  for(const double & value : values) sum += pow(value-average,2.0);
+  return sum/static_cast<double>(values.size()-1);
+}
+
+/// Welch's t statistic between the means of two samples
+double welchStatistic(const vector<double> & a, const vector<double> & b){
+  double error = sqrt(variance(a)/a.size()+variance(b)/b.size());
+  return (mean(a)-mean(b))/error;
+}
+
+/// Largest difference between the empirical distributions of two samples
+double kolmogorovSmirnovStatistic(vector<double> a, vector<double> b){
+  sort(a.begin(),a.end());
+  sort(b.begin(),b.end());
+  size_t index_a = 0;
+  size_t index_b = 0;
+  double largest_difference = 0.0;
+  while(index_a<a.size() && index_b<b.size()){
+    double value = min(a.at(index_a),b.at(index_b));
+    while(index_a<a.size() && a.at(index_a)<=value) ++index_a;
+    while(index_b<b.size() && b.at(index_b)<=value) ++index_b;
+    double difference = abs(static_cast<double>(index_a)/a.size()-
+        static_cast<double>(index_b)/b.size());
+    largest_difference = max(largest_difference,difference);
+  }
+  return largest_difference;
+}
+
+double kolmogorovSmirnovCritical(size_t n, size_t m){
+  return ks_coefficient*sqrt(static_cast<double>(n+m)/
+      (static_cast<double>(n)*static_cast<double>(m)));
+}
+
+int main(int argc, char* argv[]){
+
+  if(argc!=9){
+    cerr << "To run the program correctly you must provide the " << endl;
+    cerr << "following parameters: " << endl;
+    cerr << endl;
+    cerr << "length     - integer, number of sites along each side of the" << endl;
+    cerr << "             cubic lattice." << endl;
+    cerr << "sigma      - width of the density of states." << endl;
+    cerr << "field      - energy gained per site moved along x." << endl;
+    cerr << "seeds      - integer, the number of runs with each kinetics." << endl;
+    cerr << "walkers    - integer, the number of walkers in each system." << endl;
+    cerr << "threshold  - integer, minimum coarse graining threshold." << endl;
+    cerr << "resolution - time resolution of the coarse grained system." << endl;
+    cerr << "tolerance  - largest relative difference allowed between the" << endl;
+    cerr << "             mobilities." << endl;
+    cerr << endl;
+    cerr << "To run:" << endl;
+    cerr << endl;
+    cerr << "./regression_test_equivalence length sigma field seeds walkers ";
+    cerr << "threshold resolution tolerance" << endl;
+    cerr << endl;
+    return -1;
+  }
+
+  int length = stoi(string(argv[1]));
+  double sigma = stod(string(argv[2]));
+  double field = stod(string(argv[3]));
+  int seeds = stoi(string(argv[4]));
+  int walkers = stoi(string(argv[5]));
+  int threshold = stoi(string(argv[6]));
+  double time_resolution = stod(string(argv[7]));
+  double tolerance = stod(string(argv[8]));
+
+  // The same system is used for every run, only the seed of the kinetics
+  // changes
+  morphology::RateModel model;
+  model.field = field;
+  vector<double> energies = morphology::gaussianEnergies(
+      static_cast<size_t>(length)*length*length,
+      sigma,
+      1);
+  morphology::RateData rate_data = morphology::cubicLattice(
+      length,
+      energies,
+      model,
+      false);
+  auto rates = rate_data.toRateMap();
+
+  Observables crude;
+  Observables coarse_grained;
+  for(int seed = 1; seed <= seeds; ++seed){
+    timeOfFlight(
+        rates,
+        length,
+        walkers,
+        seed,
+        seed,
+        threshold,
+        time_resolution,
+        KMC_CoarseGrainSystem::exact,
+        crude);
+    timeOfFlight(
+        rates,
+        length,
+        walkers,
+        seed,
+        seed+seeds,
+        threshold,
+        time_resolution,
+        KMC_CoarseGrainSystem::coarse_grained,
+        coarse_grained);
+  }
+
+  bool pass = true;
+  const unordered_set<int> & cluster_sites = coarse_grained.cluster_sites;
+  cout << "Sites in clusters " << cluster_sites.size() << endl;
+  if(cluster_sites.empty()){
+    cout << "FAIL no clusters were formed, nothing is being compared" << endl;
+    pass = false;
+  }
+
+  // Mobility is inversely proportional to the mean transit time, the walkers
+  // are timed over length-1 planes
+  double crude_mobility = (length-1)/(field*mean(crude.transit_times));
+  double coarse_grained_mobility =
+    (length-1)/(field*mean(coarse_grained.transit_times));
+  double t = welchStatistic(crude.transit_times,coarse_grained.transit_times);
+  cout << "Mobility crude " << crude_mobility << " coarse grained ";
+  cout << coarse_grained_mobility << " t " << t << endl;
+  if(abs(t)>z_critical){
+    cout << "FAIL mobility differs" << endl;
+    pass = false;
+  }
+  // Relative difference of the mobilities and its standard error, from the
+  // errors of the two mean transit times
+  double relative_difference = coarse_grained_mobility/crude_mobility-1.0;
+  double relative_error = sqrt(
+      variance(crude.transit_times)/crude.transit_times.size()/
+      pow(mean(crude.transit_times),2.0)+
+      variance(coarse_grained.transit_times)/coarse_grained.transit_times.size()/
+      pow(mean(coarse_grained.transit_times),2.0));
+  cout << "Mobility relative difference " << relative_difference;
+  cout << " standard error " << relative_error << endl;
+  if(z_critical*relative_error>tolerance){
+    cout << "FAIL too few transits to resolve a relative difference of ";
+    cout << tolerance << endl;
+    pass = false;
+  }
+  if(abs(relative_difference)>tolerance){
+    cout << "FAIL mobility differs by more than " << tolerance << endl;
+    pass = false;
+  }
+
+  // The time of flight current transient is the distribution of arrival
+  // times
+  double ks = kolmogorovSmirnovStatistic(
+      crude.transit_times,
+      coarse_grained.transit_times);
+  double ks_critical = kolmogorovSmirnovCritical(
+      crude.transit_times.size(),
+      coarse_grained.transit_times.size());
+  cout << "Current transient KS " << ks << " critical " << ks_critical << endl;
+  if(ks>ks_critical){
+    cout << "FAIL current transient differs" << endl;
+    pass = false;
+  }
+
+  // Only the sites outside of the clusters behave the same with both
+  // kinetics. Each run is an independent sample of the visits to a site.
+  vector<int> siteIds;
+  for(const auto & site_and_rates : rates){
+    if(cluster_sites.count(site_and_rates.first)==0){
+      siteIds.push_back(site_and_rates.first);
+    }
+  }
+  sort(siteIds.begin(),siteIds.end());
+
+  int sites_compared = 0;
+  int visits_differing = 0;
+  for(const int & siteId : siteIds){
+    vector<double> a;
+    vector<double> b;
+    for(auto & visits : crude.visits) a.push_back(visits[siteId]);
+    for(auto & visits : coarse_grained.visits) b.push_back(visits[siteId]);
+    if(variance(a)==0.0 && variance(b)==0.0){
+      if(mean(a)!=mean(b)) ++visits_differing;
+      continue;
+    }
+    ++sites_compared;
+    if(abs(welchStatistic(a,b))>z_critical) ++visits_differing;
+  }
+  cout << "Site visit frequencies differing " << visits_differing;
+  cout << " of " << sites_compared << endl;
+  // At a significance of 0.001 at most a few sites should differ by chance
+  if(visits_differing>1+sites_compared/100){
+    cout << "FAIL site visit frequencies differ" << endl;
+    pass = false;
+  }
+
+  int dwell_sites_compared = 0;
+  int dwell_times_differing = 0;
+  for(const int & siteId : siteIds){
+    const vector<double> & a = crude.dwell_times[siteId];
+    const vector<double> & b = coarse_grained.dwell_times[siteId];
+    if(a.size()<50 || b.size()<50) continue;
+    ++dwell_sites_compared;
+    if(kolmogorovSmirnovStatistic(a,b)>kolmogorovSmirnovCritical(a.size(),b.size())){
+      ++dwell_times_differing;
+    }
+  }
+  cout << "Dwell time distributions differing " << dwell_times_differing;
+  cout << " of " << dwell_sites_compared << endl;
+  if(dwell_times_differing>1+dwell_sites_compared/100){
+    cout << "FAIL dwell time distributions differ" << endl;
+    pass = false;
+  }
+
+  if(!pass) return 1;
+  cout << "PASS" << endl;
+  return 0;
+}
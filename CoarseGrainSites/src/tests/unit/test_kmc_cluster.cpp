@@ -508,5 +508,267 @@ int main(void){
     assert(visit_prob.at(2) > baseline_visit_prob.at(2)*0.8);
   }
 
+  cout << "Testing: event skipping" << endl;
+  {
+    // 
+    // neigh5 <- site1 <-> site2 <-> site3 -> neigh4
+    //
+    KMC_Site site;
+    site.setId(1);
+    double rate = 1;
+    double rate6 = 0.001;
+    site.addNeighRate(pair<int, double *>(2,&rate));
+    site.addNeighRate(pair<int, double *>(5,&rate6));
+ 
+    KMC_Site site2;
+    site2.setId(2);
+    double rate2 = 1;
+    double rate3 = 1;
+    site2.addNeighRate(pair<int, double *>(1,&rate2));
+    site2.addNeighRate(pair<int , double *>(3,&rate3));
+  
+    KMC_Site site3;
+    site3.setId(3);
+    double rate4 = 1;
+    site3.addNeighRate(pair<int , double *>(2,&rate4));
+    double rate5 = 0.001;
+    site3.addNeighRate(pair<int , double *>(4,&rate5));
+
+    KMC_Cluster cluster;
+    cluster.setConvergenceIterations(50);
+    cluster.setResolution(2);
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.addSite(site3);
+    cluster.updateProbabilitiesAndTimeConstant();
+    cluster.setEventSkipping(true);
+    assert(cluster.getEventSkipping());
+    cluster.setRandomSeed(1);
+
+    int walker_id = 1;
+    int total = 100000;
+    double time_on_cluster = 0.0;
+    for(int count=0; count < total; ++count){
+      cluster.occupy(2);
+      time_on_cluster+=cluster.getDwellTime(walker_id);
+      // The walker should always leave the cluster in a single hop
+      int chosen_site = cluster.pickNewSiteId(walker_id);
+      assert(chosen_site==4 || chosen_site==5);
+      cluster.vacate(2);
+    }
+    double mean_time = time_on_cluster/static_cast<double>(total);
+    cout << "Mean escape time " << mean_time << " time constant ";
+    cout << cluster.getTimeConstant() << endl;
+    assert(mean_time<cluster.getTimeConstant()*1.05);
+    assert(mean_time>cluster.getTimeConstant()*0.95);
+
+    // Walkers are drawn from the probability of occupying each site
+    vector<int> positions(3,0);
+    for(int count=0; count < total; ++count){
+      int siteId = cluster.samplePositionInCluster();
+      assert(cluster.siteIsInCluster(siteId));
+      ++positions.at(siteId-1);
+    }
+    for(int siteId = 1; siteId<=3; ++siteId){
+      double prob = static_cast<double>(positions.at(siteId-1))/static_cast<double>(total);
+      double expected = cluster.getProbabilityOfOccupyingInternalSite(siteId);
+      cout << "Site " << siteId << " sampled " << prob << " expected ";
+      cout << expected << endl;
+      assert(prob<expected*1.05 && prob>expected*0.95);
+    }
+
+    // An empty cluster has no occupied sites, with a walker in the cluster a
+    // site is only occupied when the walker is placed there
+    assert(cluster.isOccupied(1)==false);
+    cluster.occupy(2);
+    int occupied_count = 0;
+    for(int count=0; count < total; ++count){
+      if(cluster.isOccupied(1)) ++occupied_count;
+    }
+    double prob = static_cast<double>(occupied_count)/static_cast<double>(total);
+    double expected = cluster.getProbabilityOfOccupyingInternalSite(1);
+    assert(prob<expected*1.05 && prob>expected*0.95);
+    cluster.vacate(2);
+    assert(cluster.isOccupied(1)==false);
+  }
+
+  cout << "Testing: multiple walkers" << endl;
+  {
+    //
+    // neigh5 <- site1 <-> site2 <-> site3 -> neigh4
+    //
+    // The internal rates are not symmetric so the sites are not equally
+    // likely to be occupied
+    KMC_Site site;
+    site.setId(1);
+    double rate = 1;
+    double rate6 = 0.1;
+    site.addNeighRate(pair<int, double *>(2,&rate));
+    site.addNeighRate(pair<int, double *>(5,&rate6));
+
+    KMC_Site site2;
+    site2.setId(2);
+    double rate2 = 2;
+    double rate3 = 1;
+    site2.addNeighRate(pair<int, double *>(1,&rate2));
+    site2.addNeighRate(pair<int , double *>(3,&rate3));
+
+    KMC_Site site3;
+    site3.setId(3);
+    double rate4 = 2;
+    site3.addNeighRate(pair<int , double *>(2,&rate4));
+    double rate5 = 0.1;
+    site3.addNeighRate(pair<int , double *>(4,&rate5));
+
+    KMC_Cluster cluster;
+    cluster.setConvergenceMethod(KMC_Cluster::Method::converge_by_tolerance);
+    cluster.setConvergenceTolerance(0.00001);
+    cluster.addSite(site);
+    cluster.addSite(site2);
+    cluster.addSite(site3);
+    cluster.updateProbabilitiesAndTimeConstant();
+
+    double prob1 = cluster.getProbabilityOfOccupyingInternalSite(1);
+    double prob2 = cluster.getProbabilityOfOccupyingInternalSite(2);
+    double prob3 = cluster.getProbabilityOfOccupyingInternalSite(3);
+
+    // A single walker is unchanged
+    assert(abs(cluster.getProbabilityOfOccupyingInternalSite(1,1)-prob1)<1E-9);
+    assert(abs(cluster.getProbabilityOfOccupyingInternalSite(3,1)-prob3)<1E-9);
+    assert(abs(cluster.getTimeConstantWithWalkers(1)-cluster.getTimeConstant())<1E-9);
+    for(int neighId = 4; neighId <= 5; ++neighId){
+      assert(abs(cluster.getProbabilityOfHoppingToNeighborOfCluster(neighId,1)-
+            cluster.getProbabilityOfHoppingToNeighborOfCluster(neighId))<1E-9);
+    }
+    assert(abs(cluster.getProbabilityOfHoppingToNeighborOfCluster(4,2)+
+          cluster.getProbabilityOfHoppingToNeighborOfCluster(5,2)-1.0)<1E-9);
+
+    // Two walkers can not share a site
+    double occupied1 = cluster.getProbabilityOfOccupyingInternalSite(1,2);
+    double occupied2 = cluster.getProbabilityOfOccupyingInternalSite(2,2);
+    double occupied3 = cluster.getProbabilityOfOccupyingInternalSite(3,2);
+    assert(abs(occupied1+occupied2+occupied3-2.0)<1E-9);
+    double normalization = prob1*prob2+prob1*prob3+prob2*prob3;
+    assert(abs(occupied1-prob1*(prob2+prob3)/normalization)<1E-9);
+
+    // Every site is taken by three walkers, each is equally likely to be on
+    // site1 or site3 where it can escape
+    for(int siteId = 1; siteId <= 3; ++siteId){
+      assert(cluster.getProbabilityOfOccupyingInternalSite(siteId,3)==1.0);
+    }
+    double ratio = cluster.getTimeConstantWithWalkers(3)/cluster.getTimeConstant();
+    double expected_ratio = ((prob1+prob3)*0.1)/(0.2/3.0);
+    assert(abs(ratio-expected_ratio)<1E-9);
+
+    cluster.setEventSkipping(true);
+    cluster.setRandomSeed(1);
+    cluster.occupy(1);
+    cluster.occupy(2);
+    cluster.occupy(3);
+    for(int count = 0; count < 100; ++count){
+      assert(cluster.isOccupied(3));
+    }
+    cluster.vacate(3);
+    int occupied_count = 0;
+    int total = 100000;
+    for(int count = 0; count < total; ++count){
+      if(cluster.isOccupied(3)) ++occupied_count;
+    }
+    double fraction = static_cast<double>(occupied_count)/static_cast<double>(total);
+    assert(abs(fraction-occupied3)<0.01);
+  }
+
+  cout << "Testing: remaining dwell time follows the number of walkers" << endl;
+  {
+    // Same cluster as above, walker 1 draws its escape time alone and
+    // walker 2 enters after the first increment
+    double rate = 1;
+    double rate2 = 2;
+    double rate3 = 1;
+    double rate4 = 2;
+    double rate5 = 0.1;
+    double rate6 = 0.1;
+    vector<KMC_Cluster> clusters(2);
+    for(KMC_Cluster & cluster : clusters){
+      KMC_Site site;
+      site.setId(1);
+      site.addNeighRate(pair<int, double *>(2,&rate));
+      site.addNeighRate(pair<int, double *>(5,&rate6));
+      KMC_Site site2;
+      site2.setId(2);
+      site2.addNeighRate(pair<int, double *>(1,&rate2));
+      site2.addNeighRate(pair<int , double *>(3,&rate3));
+      KMC_Site site3;
+      site3.setId(3);
+      site3.addNeighRate(pair<int , double *>(2,&rate4));
+      site3.addNeighRate(pair<int , double *>(4,&rate5));
+      cluster.setConvergenceMethod(KMC_Cluster::Method::converge_by_tolerance);
+      cluster.setConvergenceTolerance(0.00001);
+      cluster.addSite(site);
+      cluster.addSite(site2);
+      cluster.addSite(site3);
+      cluster.updateProbabilitiesAndTimeConstant();
+      cluster.setRandomSeed(3);
+      cluster.occupy(1);
+    }
+
+    double increment = clusters.at(0).getTimeConstant()/
+      clusters.at(0).getResolution();
+    vector<double> escape_times(2,0.0);
+    for(size_t index = 0; index < clusters.size(); ++index){
+      double dwell_time = clusters.at(index).getDwellTime(1);
+      assert(abs(dwell_time-increment)<1E-12*increment);
+      escape_times.at(index) += dwell_time;
+      if(index==1) clusters.at(index).occupy(2);
+      do {
+        dwell_time = clusters.at(index).getDwellTime(1);
+        escape_times.at(index) += dwell_time;
+      } while(dwell_time>=increment);
+    }
+    double ratio = clusters.at(0).getTimeConstantWithWalkers(2)/
+      clusters.at(0).getTimeConstant();
+    assert(abs(ratio-1.0)>1E-3);
+    double expected = increment+(escape_times.at(0)-increment)*ratio;
+    assert(abs(escape_times.at(1)-expected)<1E-9*expected);
+  }
+
+  cout << "Testing: many walkers" << endl;
+  {
+    // Ring of 300 sites with a slow escape from site 0. The sites are close to
+    // equally likely to be occupied, e_200 of the probabilities is far below
+    // the smallest double
+    const int number_of_sites = 300;
+    vector<double> rates(2*number_of_sites,1.0);
+    double escape_rate = 0.01;
+    KMC_Cluster cluster;
+    cluster.setConvergenceMethod(KMC_Cluster::Method::converge_by_tolerance);
+    cluster.setConvergenceTolerance(0.00001);
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      KMC_Site site;
+      site.setId(siteId);
+      site.addNeighRate(pair<int,double *>(
+            (siteId+1)%number_of_sites,&rates.at(2*siteId)));
+      site.addNeighRate(pair<int,double *>(
+            (siteId+number_of_sites-1)%number_of_sites,&rates.at(2*siteId+1)));
+      if(siteId==0) site.addNeighRate(pair<int,double *>(-1,&escape_rate));
+      cluster.addSite(site);
+    }
+    cluster.updateProbabilitiesAndTimeConstant();
+
+    const int walkers = 200;
+    double total = 0.0;
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      double occupied = cluster.getProbabilityOfOccupyingInternalSite(
+          siteId,walkers);
+      assert(occupied>0.0 && occupied<=1.0);
+      total += occupied;
+    }
+    assert(abs(total-walkers)<1E-6);
+    // Site 0 is as likely to hold any one walker as with a single walker
+    double ratio = cluster.getTimeConstantWithWalkers(walkers)/
+      cluster.getTimeConstant();
+    assert(abs(ratio-1.0)<0.05);
+  }
+
 	return 0;
 }
@@ -1,15 +1,72 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <cassert>
 #include <vector>
 #include <memory>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
 
 #include "../../../include/kmccoarsegrain/kmc_constants.hpp"
 #include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_rate_provider.hpp"
+#include "../../../include/kmccoarsegrain/kmc_rate_table.hpp"
 #include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker_store.hpp"
 
 using namespace std;
 using namespace kmccoarsegrain;
 
+/**
+ * \brief 16 site grid with a single walker on site 1
+ *
+ * site1 - site2 - site3 - site4
+ *   |       |       |       |
+ * site5 - site6 - site7 - site8
+ *   |       |       |       |
+ * site9 - site10- site11- site12
+ *   |       |       |       |
+ * site13- site14- site15- site16
+ *
+ * The rates between 6 and 10 and between 7 and 11 are fast, between 6 and 7
+ * and between 10 and 11 they are moderate, so sites 6, 7, 10 and 11 form a
+ * cluster. All of the other rates are slow.
+ **/
+struct ClusterGrid {
+  double rate_fast;
+  double rate_moderate;
+  double rate_slow;
+  unordered_map<int,unordered_map<int,double>> rates;
+  vector<pair<int,KMC_Walker>> electrons;
+
+  ClusterGrid() : rate_fast(10000), rate_moderate(100), rate_slow(1) {
+    for(int row = 0; row < 4; ++row){
+      for(int col = 0; col < 4; ++col){
+        int siteId = row*4+col+1;
+        if(col>0) rates[siteId][siteId-1] = rate_slow;
+        if(col<3) rates[siteId][siteId+1] = rate_slow;
+        if(row>0) rates[siteId][siteId-4] = rate_slow;
+        if(row<3) rates[siteId][siteId+4] = rate_slow;
+      }
+    }
+    rates[6][10] = rate_fast;
+    rates[10][6] = rate_fast;
+    rates[7][11] = rate_fast;
+    rates[11][7] = rate_fast;
+    rates[6][7] = rate_moderate;
+    rates[7][6] = rate_moderate;
+    rates[10][11] = rate_moderate;
+    rates[11][10] = rate_moderate;
+
+    KMC_Walker electron;
+    electron.occupySite(1);
+    electrons.push_back(pair<int,KMC_Walker>(1,electron));
+  }
+};
+
 int main(void){
 
   cout << "Testing: mergeCluster" << endl;
@@ -273,5 +330,1588 @@ int main(void){
   }
 
 
+  cout << "Testing: cluster event skipping" << endl;
+  {
+    // Sites 6, 7, 10 and 11 of the grid should form a cluster
+    double time_limit = 1000;
+    vector<int> hop_counts;
+    for( bool event_skipping : {false, true}){
+      ClusterGrid grid;
+      auto & ratesToNeighbors = grid.rates;
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(time_limit/10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(500);
+      CGsystem.setClusterEventSkipping(event_skipping);
+      assert(CGsystem.getClusterEventSkipping()==event_skipping);
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      // Can only be changed before the system is initialized
+      bool fail = false;
+      try {
+        CGsystem.setClusterEventSkipping(event_skipping);
+      }catch(...){
+        fail = true;
+      }
+      assert(fail);
+
+      vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+      CGsystem.initializeWalkers(electrons);
+
+      KMC_Walker& electron1 = electrons.at(0).second;
+      int id = electrons.at(0).first;
+      double time = 0.0;
+      int hop_count = 0;
+      while(time<time_limit){
+        // Only walkers that hop onto an existing cluster are moved by it, the
+        // cluster must also not have changed during the hop
+        int targetId = electron1.getPotentialSite();
+        int clusterId = CGsystem.getClusterIdOfSite(targetId);
+        auto clusters_before = CGsystem.getClusters();
+        CGsystem.hop(id,electron1);
+        time += electron1.getDwellTime();
+        ++hop_count;
+
+        if(event_skipping && clusterId!=constants::unassignedId &&
+            clusters_before==CGsystem.getClusters()){
+          // The next hop takes the walker straight out of the cluster
+          int potentialId = electron1.getPotentialSite(); 
+          assert(CGsystem.getClusterIdOfSite(potentialId)!=clusterId);
+          // Drawing the position keeps the walker within the cluster
+          int sampledId = CGsystem.samplePositionOfWalker(electron1);
+          assert(CGsystem.getClusterIdOfSite(sampledId)==clusterId);
+          assert(electron1.getIdOfSiteCurrentlyOccupying()==sampledId);
+        }
+      }
+      hop_counts.push_back(hop_count);
+
+      unordered_map<int,vector<int>> clusters = CGsystem.getClusters();
+      assert(clusters.size()==1);
+      assert(clusters.begin()->second.size()==4);
+    }
+    // Crossing the cluster in a single hop should take fewer hops 
+    assert(hop_counts.at(1)<hop_counts.at(0));
+  }
+
+  cout << "Testing: cluster event skipping with walkers sharing a cluster" << endl;
+  {
+    // Chain 0 - 1 - 2 - 3 - 4 - 5 - 6 where sites 2 and 3 form a cluster,
+    // the walkers are more likely to be on site 3 which they leave faster
+    unordered_map<int,unordered_map<int,double>> chainRates;
+    for(int siteId = 0; siteId < 6; ++siteId){
+      chainRates[siteId][siteId+1] = 1.0;
+      chainRates[siteId+1][siteId] = 1.0;
+    }
+    chainRates[2][3] = 1000.0;
+    chainRates[3][2] = 500.0;
+    chainRates[3][4] = 10.0;
+    chainRates[4][3] = 10.0;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(50);
+    CGsystem.setClusterEventSkipping(true);
+    CGsystem.initializeSystem(chainRates);
+
+    // Walkers sharing a cluster can only be rescaled in a store
+    vector<pair<int,KMC_Walker>> electrons(2);
+    electrons.at(0).first = 0;
+    electrons.at(0).second.occupySite(0);
+    electrons.at(1).first = 1;
+    electrons.at(1).second.occupySite(6);
+    bool throws = false;
+    try{
+      CGsystem.initializeWalkers(electrons);
+    }catch(const runtime_error &){
+      throws = true;
+    }
+    assert(throws);
+
+    KMC_WalkerStore walkers;
+    walkers.add(0);
+    walkers.add(6);
+    CGsystem.initializeWalkers(walkers);
+    auto inCluster = [&CGsystem](int siteId){
+      return CGsystem.getClusterIdOfSite(siteId)!=constants::unassignedId;
+    };
+
+    // Walker A is in the cluster and walker B hops onto it, and is due to
+    // leave before A. The hop is rejected if A is drawn to be on the site B
+    // hops to
+    int handleA = constants::unassignedId;
+    int handleB = constants::unassignedId;
+    double timeA = 0.0;
+    double timeB = 0.0;
+    for(int hop = 0; hop < 100000; ++hop){
+      CGsystem.hopNext(walkers);
+      for(int handle : {0, 1}){
+        int other = 1-handle;
+        if(inCluster(walkers.getSite(handle)) &&
+            !inCluster(walkers.getSite(other)) &&
+            inCluster(walkers.getPotentialSite(other))){
+          handleA = handle;
+          handleB = other;
+        }
+      }
+      if(handleA==constants::unassignedId) continue;
+      timeA = walkers.getTime(handleA);
+      timeB = walkers.getTime(handleB);
+      CGsystem.hop(walkers,handleB);
+      if(inCluster(walkers.getSite(handleB)) &&
+          walkers.getTime(handleB)<walkers.getTime(handleA)) break;
+      handleA = constants::unassignedId;
+    }
+    assert(handleA!=constants::unassignedId);
+
+    // The exit time of A is scaled when B enters, and scaled back when B
+    // leaves
+    double ratio = (walkers.getTime(handleA)-timeB)/(timeA-timeB);
+    assert(fabs(ratio-1.0)>1E-6);
+
+    timeA = walkers.getTime(handleA);
+    timeB = walkers.getTime(handleB);
+    CGsystem.hop(walkers,handleB);
+    assert(!inCluster(walkers.getSite(handleB)));
+    assert(fabs((walkers.getTime(handleA)-timeB)/(timeA-timeB)-1.0/ratio)<1E-9);
+  }
+
+  cout << "Testing: hot spot trigger" << endl;
+  {
+    // On the grid the walker oscillating between 6 and 10 or 7 and 11 should
+    // trigger the formation of a cluster
+    ClusterGrid grid;
+    auto & ratesToNeighbors = grid.rates;
+
+    double time_limit = 1000;
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(time_limit/10.0);
+    assert(CGsystem.getCoarseGrainTrigger()==
+        KMC_CoarseGrainSystem::iteration_threshold);
+    CGsystem.setCoarseGrainTrigger(KMC_CoarseGrainSystem::hot_spot);
+    assert(CGsystem.getCoarseGrainTrigger()==KMC_CoarseGrainSystem::hot_spot);
+
+    bool fail = false;
+    try {
+      CGsystem.setHotSpotThreshold(0);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+    CGsystem.setHotSpotThreshold(50);
+    assert(CGsystem.getHotSpotThreshold()==50);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+    CGsystem.initializeWalkers(electrons);
+
+    KMC_Walker& electron1 = electrons.at(0).second;
+    int id = electrons.at(0).first;
+    double time = 0.0;
+    while(time<time_limit){
+      CGsystem.hop(id,electron1);
+      time += electron1.getDwellTime();
+    }
+
+    unordered_map<int,vector<int>> clusters = CGsystem.getClusters();
+    assert(clusters.size()==1);
+    assert(clusters.begin()->second.size()==4);
+    int clusterId = CGsystem.getClusterIdOfSite(6);
+    assert(clusterId!=constants::unassignedId);
+    assert(CGsystem.getClusterIdOfSite(7)==clusterId);
+    assert(CGsystem.getClusterIdOfSite(10)==clusterId);
+    assert(CGsystem.getClusterIdOfSite(11)==clusterId);
+  }
+
+  cout << "Testing: asynchronous coarse graining" << endl;
+  {
+    // The cluster of the grid is found by the worker
+    double time_limit = 1000;
+    for( auto trigger : {KMC_CoarseGrainSystem::iteration_threshold,
+        KMC_CoarseGrainSystem::hot_spot}){
+      ClusterGrid grid;
+      auto & ratesToNeighbors = grid.rates;
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(time_limit/10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(500);
+      CGsystem.setCoarseGrainTrigger(trigger);
+      assert(CGsystem.getAsynchronousCoarseGraining()==false);
+      CGsystem.setAsynchronousCoarseGraining(true);
+      assert(CGsystem.getAsynchronousCoarseGraining());
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      bool fail = false;
+      try {
+        CGsystem.setAsynchronousCoarseGraining(false);
+      }catch(...){
+        fail = true;
+      }
+      assert(fail);
+
+      vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+      CGsystem.initializeWalkers(electrons);
+
+      KMC_Walker& electron1 = electrons.at(0).second;
+      int id = electrons.at(0).first;
+      double time = 0.0;
+      while(time<time_limit){
+        CGsystem.hop(id,electron1);
+        time += electron1.getDwellTime();
+      }
+      CGsystem.synchronizeCoarseGraining();
+
+      unordered_map<int,vector<int>> clusters = CGsystem.getClusters();
+      assert(clusters.size()==1);
+      assert(clusters.begin()->second.size()==4);
+      int clusterId = CGsystem.getClusterIdOfSite(6);
+      assert(clusterId!=constants::unassignedId);
+      assert(CGsystem.getClusterIdOfSite(7)==clusterId);
+      assert(CGsystem.getClusterIdOfSite(10)==clusterId);
+      assert(CGsystem.getClusterIdOfSite(11)==clusterId);
+    }
+  }
+
+  cout << "Testing: cluster review" << endl;
+  {
+    // Once the cluster of sites 6, 7, 10 and 11 of the grid is formed it is
+    // dissolved either because the rates have changed so the sites are no
+    // longer in equilibrium or because it is not visited enough
+    for( bool change_rates : {true, false}){
+      ClusterGrid grid;
+      auto & ratesToNeighbors = grid.rates;
+
+      double time_limit = 1000;
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(time_limit/10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(500);
+      assert(CGsystem.getClusterReviewInterval()==constants::inf_iterations);
+      assert(CGsystem.getMinClusterVisits()==10);
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+      CGsystem.initializeWalkers(electrons);
+
+      KMC_Walker& electron1 = electrons.at(0).second;
+      int id = electrons.at(0).first;
+      double time = 0.0;
+      while(time<time_limit){
+        CGsystem.hop(id,electron1);
+        time += electron1.getDwellTime();
+      }
+      assert(CGsystem.getClusters().size()==1);
+      int visits_before = CGsystem.getVisitFrequencyOfSite(6);
+
+      if(change_rates){
+        ratesToNeighbors[6][10] = grid.rate_slow;
+        ratesToNeighbors[10][6] = grid.rate_slow;
+        ratesToNeighbors[7][11] = grid.rate_slow;
+        ratesToNeighbors[11][7] = grid.rate_slow;
+        ratesToNeighbors[6][7] = grid.rate_slow;
+        ratesToNeighbors[7][6] = grid.rate_slow;
+        ratesToNeighbors[10][11] = grid.rate_slow;
+        ratesToNeighbors[11][10] = grid.rate_slow;
+      }else{
+        // Do not form any new clusters
+        CGsystem.setMinCoarseGrainIterationThreshold(constants::inf_iterations);
+        CGsystem.setMinClusterVisits(1000000);
+      }
+      CGsystem.setClusterReviewInterval(100);
+      assert(CGsystem.getClusterReviewInterval()==100);
+
+      time = 0.0;
+      while(time<time_limit){
+        CGsystem.hop(id,electron1);
+        time += electron1.getDwellTime();
+      }
+      assert(CGsystem.getClusters().size()==0);
+      assert(CGsystem.getClusterIdOfSite(6)==constants::unassignedId);
+      assert(CGsystem.getClusterIdOfSite(11)==constants::unassignedId);
+      // Visits are kept when the cluster is dissolved
+      assert(CGsystem.getVisitFrequencyOfSite(6)>=visits_before);
+    }
+  }
+
+  cout << "Testing: updateRates" << endl;
+  {
+    // Once the cluster of sites 6, 7, 10 and 11 of the grid is formed the
+    // rates off of it are halved
+    ClusterGrid grid;
+    auto & ratesToNeighbors = grid.rates;
+
+    double time_limit = 1000;
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(time_limit/10.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(500);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+    CGsystem.initializeWalkers(electrons);
+
+    KMC_Walker& electron1 = electrons.at(0).second;
+    int id = electrons.at(0).first;
+    double time = 0.0;
+    while(time<time_limit){
+      CGsystem.hop(id,electron1);
+      time += electron1.getDwellTime();
+    }
+    assert(CGsystem.getClusters().size()==1);
+    double time_increment = CGsystem.getTimeIncrementOfClusters().begin()->second;
+
+    // Invalid updates
+    unordered_map< int,unordered_map< int,double>> invalid_rates;
+    invalid_rates[6][16] = 1.0;
+    bool fail = false;
+    try {
+      CGsystem.updateRates(invalid_rates);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+    invalid_rates.clear();
+    invalid_rates[6][2] = -1.0;
+    fail = false;
+    try {
+      CGsystem.updateRates(invalid_rates);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+    assert(ratesToNeighbors[6][2]==grid.rate_slow);
+
+    unordered_map< int,unordered_map< int,double>> new_rates;
+    vector<int> cluster_sites = {6, 7, 10, 11};
+    for( int siteId : cluster_sites){
+      for( auto & neigh_and_rate : ratesToNeighbors[siteId]){
+        if(find(cluster_sites.begin(),cluster_sites.end(),
+              neigh_and_rate.first)==cluster_sites.end()){
+          new_rates[siteId][neigh_and_rate.first] = 0.5*grid.rate_slow;
+        }
+      }
+    }
+    CGsystem.updateRates(new_rates);
+    assert(ratesToNeighbors[6][2]==0.5*grid.rate_slow);
+
+    // The cluster is only solved again once a walker hops onto or off of it
+    auto inCluster = [&CGsystem](int siteId){
+      return CGsystem.getClusterIdOfSite(siteId)!=constants::unassignedId;
+    };
+    while(!inCluster(electron1.getIdOfSiteCurrentlyOccupying()) &&
+        !inCluster(electron1.getPotentialSite())){
+      CGsystem.hop(id,electron1);
+      assert(CGsystem.getTimeIncrementOfClusters().begin()->second==time_increment);
+    }
+    CGsystem.hop(id,electron1);
+    // Halving the rates off the cluster doubles the escape time
+    double new_time_increment = CGsystem.getTimeIncrementOfClusters().begin()->second;
+    assert(abs(new_time_increment/time_increment-2.0)<0.01);
+  }
+
+  cout << "Testing: updateRates with walkers" << endl;
+  {
+    // site0 - site1 - site2
+    unordered_map<int,unordered_map<int,double>> ratesToNeighbors;
+    ratesToNeighbors[0][1] = 1.0;
+    ratesToNeighbors[1][0] = 1.0;
+    ratesToNeighbors[1][2] = 1.0;
+    ratesToNeighbors[2][1] = 1.0;
+    unordered_map<int,unordered_map<int,double>> new_rates;
+    new_rates[0][1] = 4.0;
+
+    // The dwell time of a walker on a site whose rates are quadrupled is
+    // quartered, the walker on site 2 is left as it was
+    {
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.initializeSystem(ratesToNeighbors);
+      vector<pair<int,KMC_Walker>> walkers(2);
+      walkers.at(0).first = 0;
+      walkers.at(0).second.occupySite(0);
+      walkers.at(1).first = 1;
+      walkers.at(1).second.occupySite(2);
+      CGsystem.initializeWalkers(walkers);
+      double dwell_time0 = walkers.at(0).second.getDwellTime();
+      double dwell_time1 = walkers.at(1).second.getDwellTime();
+      CGsystem.updateRates(new_rates,walkers);
+      assert(ratesToNeighbors[0][1]==4.0);
+      assert(abs(walkers.at(0).second.getDwellTime()-0.25*dwell_time0)<1E-12);
+      assert(walkers.at(0).second.getPotentialSite()==1);
+      assert(walkers.at(1).second.getDwellTime()==dwell_time1);
+    }
+    ratesToNeighbors[0][1] = 1.0;
+
+    // The time left before the walker hops is measured from the last hop
+    {
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.initializeSystem(ratesToNeighbors);
+      KMC_WalkerStore walkers;
+      int handle0 = walkers.add(0,0.0);
+      int handle1 = walkers.add(2,0.0);
+      CGsystem.initializeWalkers(walkers);
+      double time0 = walkers.getTime(handle0);
+      double time1 = walkers.getTime(handle1);
+      CGsystem.updateRates(new_rates,walkers);
+      assert(abs(walkers.getTime(handle0)-0.25*time0)<1E-12);
+      assert(abs(walkers.getDwellTime(handle0)-0.25*time0)<1E-12);
+      assert(walkers.getTime(handle1)==time1);
+      CGsystem.hopNext(walkers);
+      assert(CGsystem.getTime()==min(0.25*time0,time1));
+    }
+    ratesToNeighbors[0][1] = 1.0;
+
+    // Walkers picked from the rate tree escape at the new rates
+    {
+      unordered_map<int,unordered_map<int,double>> ringRates;
+      for(int siteId = 0; siteId < 4; ++siteId){
+        ringRates[siteId][(siteId+1)%4] = 1.0;
+        ringRates[siteId][(siteId+3)%4] = 1.0;
+      }
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+      CGsystem.setEventSelection(KMC_CoarseGrainSystem::rate_tree);
+      CGsystem.initializeSystem(ringRates);
+      KMC_WalkerStore walkers;
+      walkers.add(0);
+      CGsystem.initializeWalkers(walkers);
+
+      unordered_map<int,unordered_map<int,double>> faster_rates;
+      for(int siteId = 0; siteId < 4; ++siteId){
+        faster_rates[siteId][(siteId+1)%4] = 3.0;
+        faster_rates[siteId][(siteId+3)%4] = 3.0;
+      }
+      bool throws = false;
+      try{
+        CGsystem.updateRates(faster_rates);
+      }catch(const runtime_error &){
+        throws = true;
+      }
+      assert(throws);
+      CGsystem.updateRates(faster_rates,walkers);
+
+      const int total_hops = 20000;
+      for(int hop = 0; hop < total_hops; ++hop) CGsystem.hopNext(walkers);
+      double hop_rate = static_cast<double>(total_hops)/CGsystem.getTime();
+      assert(fabs(hop_rate-6.0)<0.05*6.0);
+    }
+
+    // The time a walker has left in a cluster is scaled by the change in the
+    // escape time constant of the cluster
+    {
+      ClusterGrid grid;
+      double time_limit = 1000;
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(time_limit/10.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(500);
+      CGsystem.initializeSystem(grid.rates);
+
+      vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+      CGsystem.initializeWalkers(electrons);
+      KMC_Walker & electron1 = electrons.at(0).second;
+      int id = electrons.at(0).first;
+      double time = 0.0;
+      while(time<time_limit){
+        CGsystem.hop(id,electron1);
+        time += electron1.getDwellTime();
+      }
+      assert(CGsystem.getClusters().size()==1);
+
+      // The walker has to have hopped onto the cluster to draw its escape time
+      auto inCluster = [&CGsystem](int siteId){
+        return CGsystem.getClusterIdOfSite(siteId)!=constants::unassignedId;
+      };
+      while(inCluster(electron1.getIdOfSiteCurrentlyOccupying())){
+        CGsystem.hop(id,electron1);
+      }
+      while(!inCluster(electron1.getIdOfSiteCurrentlyOccupying())){
+        CGsystem.hop(id,electron1);
+      }
+      auto escapeTimeConstant = [&CGsystem](){
+        return CGsystem.getTimeIncrementOfClusters().begin()->second*
+          CGsystem.getResolutionOfClusters().begin()->second;
+      };
+      double time_constant = escapeTimeConstant();
+      double dwell_time = electron1.getDwellTime();
+
+      vector<int> cluster_sites = {6, 7, 10, 11};
+      unordered_map<int,unordered_map<int,double>> slower_rates;
+      for( int siteId : cluster_sites){
+        for( auto & neigh_and_rate : grid.rates[siteId]){
+          if(find(cluster_sites.begin(),cluster_sites.end(),
+                neigh_and_rate.first)==cluster_sites.end()){
+            slower_rates[siteId][neigh_and_rate.first] = 0.5*grid.rate_slow;
+          }
+        }
+      }
+      CGsystem.updateRates(slower_rates,electrons);
+      // The cluster is solved straight away as it is occupied
+      double new_time_constant = escapeTimeConstant();
+      assert(abs(new_time_constant/time_constant-2.0)<0.01);
+      assert(abs(electron1.getDwellTime()/dwell_time-
+            new_time_constant/time_constant)<1E-9);
+    }
+  }
+
+  cout << "Testing: setRateParameter" << endl;
+  {
+    // On the grid at parameter 0 the rates between sites 6, 7, 10 and 11 are
+    // fast at parameter 1 all of the rates are slow
+    ClusterGrid grid;
+    auto & ratesToNeighbors = grid.rates;
+    auto rate_family = [&](const int & siteId, const int & neighId, const double & parameter){
+      if(parameter!=0.0) return grid.rate_slow;
+      pair<int,int> edge(min(siteId,neighId),max(siteId,neighId));
+      if(edge==pair<int,int>(6,10) || edge==pair<int,int>(7,11)) return grid.rate_fast;
+      if(edge==pair<int,int>(6,7) || edge==pair<int,int>(10,11)) return grid.rate_moderate;
+      return grid.rate_slow;
+    };
+
+    double time_limit = 1000;
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(time_limit/10.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(500);
+
+    bool fail = false;
+    try {
+      CGsystem.getRateParameter();
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    // No rate family yet
+    fail = false;
+    try {
+      CGsystem.setRateParameter(0.0);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.setRateFamily(rate_family);
+    CGsystem.setRateParameter(0.0);
+    assert(CGsystem.getRateParameter()==0.0);
+
+    vector<pair<int,KMC_Walker>> & electrons = grid.electrons;
+    CGsystem.initializeWalkers(electrons);
+
+    KMC_Walker& electron1 = electrons.at(0).second;
+    int id = electrons.at(0).first;
+    double time = 0.0;
+    while(time<time_limit){
+      CGsystem.hop(id,electron1);
+      time += electron1.getDwellTime();
+    }
+    assert(CGsystem.getClusters().size()==1);
+
+    auto inCluster = [&CGsystem](int siteId){
+      return CGsystem.getClusterIdOfSite(siteId)!=constants::unassignedId;
+    };
+    while(inCluster(electron1.getIdOfSiteCurrentlyOccupying())){
+      CGsystem.hop(id,electron1);
+    }
+
+    // The cluster is no longer valid once the rates are all the same
+    CGsystem.setRateParameter(1.0);
+    assert(ratesToNeighbors[6][10]==grid.rate_slow);
+    assert(CGsystem.getClusters().size()==0);
+    for(int siteId = 1; siteId <= 16; ++siteId){
+      assert(!inCluster(siteId));
+    }
+
+    // The cluster is taken from the catalog without any further hops
+    CGsystem.setRateParameter(0.0);
+    assert(ratesToNeighbors[6][10]==grid.rate_fast);
+    auto clusters = CGsystem.getClusters();
+    assert(clusters.size()==1);
+    vector<int> cluster_sites = clusters.begin()->second;
+    sort(cluster_sites.begin(),cluster_sites.end());
+    assert(cluster_sites==vector<int>({6, 7, 10, 11}));
+
+    time = 0.0;
+    while(time<time_limit){
+      CGsystem.hop(id,electron1);
+      time += electron1.getDwellTime();
+    }
+    assert(CGsystem.getClusters().size()==1);
+
+    // Only the sites whose rates depend on the parameter are evaluated
+    int evaluations = 0;
+    auto counted_family = [&](const int & siteId, const int & neighId, const double & parameter){
+      ++evaluations;
+      return rate_family(siteId,neighId,parameter);
+    };
+    vector<int> dependent_sites = {6, 7, 10, 11};
+    CGsystem.setRateFamily(counted_family,dependent_sites);
+    while(inCluster(electron1.getIdOfSiteCurrentlyOccupying())){
+      CGsystem.hop(id,electron1);
+    }
+    CGsystem.setRateParameter(1.0);
+    assert(evaluations==16);
+    assert(ratesToNeighbors[6][10]==grid.rate_slow);
+    assert(CGsystem.getClusters().size()==0);
+
+    // The cluster in the catalog is not created around a walker
+    while(find(dependent_sites.begin(),dependent_sites.end(),
+          electron1.getIdOfSiteCurrentlyOccupying())==dependent_sites.end()){
+      CGsystem.hop(id,electron1);
+    }
+    CGsystem.setRateParameter(0.0);
+    assert(ratesToNeighbors[6][10]==grid.rate_fast);
+    assert(CGsystem.getClusters().size()==0);
+  }
+
+  cout << "Testing: lazy sampling" << endl;
+  {
+    // site3 - site1 - site2 - site4
+    //
+    // Sites 1 and 2 are connected by fast rates and will form a cluster. The
+    // time resolution is set much smaller than the time it takes to cross the
+    // cluster, so without lazy sampling the cluster could not be formed. 
+    //
+    // The walker should be found on sites 1 and 2 with probability 10/22 and
+    // on sites 3 and 4 with probability 1/22
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 1000;
+    ratesToNeighbors[2][1] = 1000;
+    ratesToNeighbors[1][3] = 1;
+    ratesToNeighbors[2][4] = 1;
+    ratesToNeighbors[3][1] = 10;
+    ratesToNeighbors[4][2] = 10;
+
+    double time_limit = 1000;
+    double sampling_interval = 0.05;
+    vector<double> sampling_times;
+    for(double sample_time = 0.0; sample_time < time_limit; 
+        sample_time+=sampling_interval){
+      sampling_times.push_back(sample_time);
+    }
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(0.0001);
+    CGsystem.setMinCoarseGrainIterationThreshold(1000);
+
+    // Sampling times must be in order
+    bool fail = false;
+    try {
+      CGsystem.setSamplingTimes({1.0, 0.5});
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.setSamplingTimes(sampling_times);
+    unordered_map<int,int> samples_on_site;
+    double last_sample_time = -1.0;
+    int sample_count = 0;
+    CGsystem.setSampleObserver(
+        [&](double sample_time, int walker_id, int siteId){
+          assert(walker_id==1);
+          assert(sample_time>last_sample_time);
+          last_sample_time = sample_time;
+          ++samples_on_site[siteId];
+          ++sample_count;
+        });
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    KMC_Walker electron;
+    electron.occupySite(3);
+    vector<pair<int,KMC_Walker>> electrons;
+    electrons.push_back(pair<int,KMC_Walker>(1,electron));
+    CGsystem.initializeWalkers(electrons);
+
+    KMC_Walker& electron1 = electrons.at(0).second;
+    int id = electrons.at(0).first;
+    // Samples are reported once the walker has hopped past them
+    double time = 0.0;
+    while(sample_count<static_cast<int>(sampling_times.size())){
+      time += electron1.getDwellTime();
+      CGsystem.hop(id,electron1);
+    }
+    assert(time>sampling_times.back());
+    assert(CGsystem.getClusterIdOfSite(1)!=constants::unassignedId);
+    assert(CGsystem.getClusterIdOfSite(1)==CGsystem.getClusterIdOfSite(2));
+
+    double prob1 = static_cast<double>(samples_on_site[1])/sample_count;
+    double prob2 = static_cast<double>(samples_on_site[2])/sample_count;
+    double prob3 = static_cast<double>(samples_on_site[3])/sample_count;
+    double prob4 = static_cast<double>(samples_on_site[4])/sample_count;
+    assert(abs(prob1+prob2-20.0/22.0)<0.03);
+    assert(abs(prob1-prob2)<0.05);
+    assert(abs(prob3-prob4)<0.03);
+  }
+
+  cout << "Testing: exact kinetics" << endl;
+  {
+    // site3 - site1 - site2 - site4
+    //
+    // Sites 1 and 2 would be coarse grained, with exact kinetics every hop
+    // between them is simulated. The walker should spend 20/22 of its time
+    // on sites 1 and 2.
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 1000;
+    ratesToNeighbors[2][1] = 1000;
+    ratesToNeighbors[1][3] = 1;
+    ratesToNeighbors[2][4] = 1;
+    ratesToNeighbors[3][1] = 10;
+    ratesToNeighbors[4][2] = 10;
+
+    KMC_CoarseGrainSystem CGsystem;
+    assert(CGsystem.getKinetics()==KMC_CoarseGrainSystem::coarse_grained);
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(10);
+    CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+    assert(CGsystem.getKinetics()==KMC_CoarseGrainSystem::exact);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    // Cannot be changed once the system exists
+    bool fail = false;
+    try {
+      CGsystem.setKinetics(KMC_CoarseGrainSystem::coarse_grained);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+
+    KMC_Walker electron;
+    electron.occupySite(3);
+    vector<pair<int,KMC_Walker>> electrons;
+    electrons.push_back(pair<int,KMC_Walker>(1,electron));
+    CGsystem.initializeWalkers(electrons);
+
+    KMC_Walker& electron1 = electrons.at(0).second;
+    int id = electrons.at(0).first;
+    unordered_map<int,double> time_on_site;
+    double time = 0.0;
+    for(int hop = 0; hop < 200000; ++hop){
+      time_on_site[electron1.getIdOfSiteCurrentlyOccupying()] += 
+        electron1.getDwellTime();
+      time += electron1.getDwellTime();
+      CGsystem.hop(id,electron1);
+    }
+    assert(CGsystem.getClusters().size()==0);
+    assert(CGsystem.getClusterIdOfSite(1)==constants::unassignedId);
+
+    double prob12 = (time_on_site[1]+time_on_site[2])/time;
+    assert(abs(prob12-20.0/22.0)<0.03);
+  }
+
+  cout << "Testing: getMemoryUsage" << endl;
+  {
+    // site3 - site1 - site2 - site4
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 1000;
+    ratesToNeighbors[2][1] = 1000;
+    ratesToNeighbors[1][3] = 1;
+    ratesToNeighbors[2][4] = 1;
+    ratesToNeighbors[3][1] = 10;
+    ratesToNeighbors[4][2] = 10;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(100);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    KMC_MemoryUsage before = CGsystem.getMemoryUsage();
+    assert(before.sites>0);
+    assert(before.clusters==0);
+    assert(before.topology_features>0);
+    assert(before.random_engines==4*sizeof(mt19937));
+    assert(before.rate_map>0);
+    assert(before.rate_cache==0);
+    assert(before.scratch>=sizeof(KMC_CoarseGrainSystem));
+    assert(before.total()==before.sites+before.topology_features+
+        before.random_engines+before.rate_cache+before.scratch);
+
+    KMC_Walker electron;
+    electron.occupySite(3);
+    vector<pair<int,KMC_Walker>> electrons;
+    electrons.push_back(pair<int,KMC_Walker>(1,electron));
+    CGsystem.initializeWalkers(electrons);
+    for(int hop = 0; hop < 5000; ++hop){
+      CGsystem.hop(electrons.at(0).first,electrons.at(0).second);
+    }
+    assert(CGsystem.getClusters().size()==1);
+
+    // The cluster and its copies of sites 1 and 2 each have an engine
+    KMC_MemoryUsage after = CGsystem.getMemoryUsage();
+    assert(after.clusters>0);
+    assert(after.random_engines==7*sizeof(mt19937));
+    assert(after.rate_map==before.rate_map);
+    assert(after.total()>before.total());
+    assert(after.toJSON().find("\"total\": ")!=string::npos);
+  }
+
+  cout << "Testing: observables" << endl;
+  {
+    // site1 - site2 - site3 - site4
+    //
+    // Sites 2 and 3 are joined by fast rates and form a cluster. The sites
+    // are placed at coordinates 0, 1, 2 and 3.
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[2][3] = 1000;
+    ratesToNeighbors[3][2] = 1000;
+    ratesToNeighbors[2][1] = 1;
+    ratesToNeighbors[3][4] = 1;
+    ratesToNeighbors[1][2] = 10;
+    ratesToNeighbors[4][3] = 10;
+
+    unordered_map<int,double> coordinates;
+    coordinates[1] = 0.0;
+    coordinates[2] = 1.0;
+    coordinates[3] = 2.0;
+    coordinates[4] = 3.0;
+
+    for(int kinetics = 0; kinetics < 2; ++kinetics){
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(100);
+      if(kinetics==0) CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+
+      // Coordinates can only be given to sites that exist
+      bool fail = false;
+      try {
+        CGsystem.setSiteCoordinates(coordinates);
+      }catch(...){
+        fail = true;
+      }
+      assert(fail);
+
+      CGsystem.initializeSystem(ratesToNeighbors);
+      fail = false;
+      try {
+        CGsystem.setSiteCoordinates({{1, 0.0}});
+      }catch(...){
+        fail = true;
+      }
+      assert(fail);
+
+      CGsystem.setSiteCoordinates(coordinates);
+      CGsystem.setCrossingPlanes({1.5});
+
+      KMC_Walker electron;
+      electron.occupySite(1);
+      vector<pair<int,KMC_Walker>> electrons;
+      electrons.push_back(pair<int,KMC_Walker>(1,electron));
+      CGsystem.initializeWalkers(electrons);
+
+      KMC_Walker& electron1 = electrons.at(0).second;
+      int id = electrons.at(0).first;
+      double time = 0.0;
+      int hops = 0;
+      while(hops<10000 || electron1.getIdOfSiteCurrentlyOccupying()!=4){
+        time += electron1.getDwellTime();
+        CGsystem.hop(id,electron1);
+        ++hops;
+      }
+      // The walker has left the cluster so its displacement is exact
+      const KMC_Observables & observables = CGsystem.getObservables();
+      assert(observables.hops==hops);
+      assert(abs(observables.walker_time-time)<1E-9*time);
+      assert(abs(observables.displacement-3.0)<1E-9);
+      assert(abs(observables.walker_displacements.at(1)-3.0)<1E-9);
+      assert(abs(observables.getMeanSquareDisplacement()-9.0)<1E-9);
+      assert(abs(observables.getVelocity()-3.0/time)<1E-9/time);
+      assert(observables.crossings.at(0)==1);
+      if(kinetics==1) assert(CGsystem.getClusters().size()==1);
+
+      // Within the cluster the walker sits at its mean coordinate
+      if(kinetics==1){
+        while(!(CGsystem.getClusterIdOfSite(
+                electron1.getIdOfSiteCurrentlyOccupying())!=
+              constants::unassignedId)){
+          CGsystem.hop(id,electron1);
+        }
+        double displacement = 
+          CGsystem.getObservables().walker_displacements.at(1);
+        assert(displacement>0.0 && displacement<3.0);
+        assert(abs(displacement-1.5)<0.1);
+      }
+
+      CGsystem.clearObservables();
+      assert(CGsystem.getObservables().hops==0);
+      assert(CGsystem.getObservables().displacement==0.0);
+      assert(CGsystem.getObservables().crossings.at(0)==0);
+    }
+  }
+
+  cout << "Testing: checkpoint" << endl;
+  {
+    // Ring of sites, every fourth pair is joined by fast rates so clusters
+    // form
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    mt19937 random_engine(3);
+    uniform_real_distribution<double> distribution(1.0,10.0);
+    int number_of_sites = 40;
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      int neighId = (siteId+1)%number_of_sites;
+      double rate = distribution(random_engine);
+      if(siteId%4==0) rate *= 1000.0;
+      ratesToNeighbors[siteId][neighId] = rate;
+      ratesToNeighbors[neighId][siteId] = rate;
+    }
+    unordered_map< int,unordered_map< int,double>> ratesToRestore = 
+      ratesToNeighbors;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(50);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    vector<pair<int,KMC_Walker>> electrons;
+    for(int walker_id = 0; walker_id < 3; ++walker_id){
+      KMC_Walker electron;
+      electron.occupySite(walker_id*10);
+      electrons.push_back(pair<int,KMC_Walker>(walker_id,electron));
+    }
+    CGsystem.initializeWalkers(electrons);
+
+    int hops = 5000;
+    for(int hop = 0; hop < hops; ++hop){
+      pair<int,KMC_Walker> & electron = electrons.at(hop%electrons.size());
+      CGsystem.hop(electron.first,electron.second);
+    }
+    size_t clusters = CGsystem.getClusters().size();
+    assert(clusters>0);
+
+    stringstream checkpoint;
+    CGsystem.writeCheckpoint(checkpoint,electrons);
+    string saved = checkpoint.str();
+
+    // Records the site and dwell time after each of the hops
+    auto run = [&hops](
+        KMC_CoarseGrainSystem & system,
+        vector<pair<int,KMC_Walker>> & walkers){
+      vector<pair<int,double>> trajectory;
+      for(int hop = 0; hop < hops; ++hop){
+        pair<int,KMC_Walker> & walker = walkers.at(hop%walkers.size());
+        system.hop(walker.first,walker.second);
+        trajectory.push_back(pair<int,double>(
+              walker.second.getIdOfSiteCurrentlyOccupying(),
+              walker.second.getDwellTime()));
+      }
+      return trajectory;
+    };
+    vector<pair<int,double>> original = run(CGsystem,electrons);
+
+    KMC_CoarseGrainSystem CGsystem2;
+    CGsystem2.setTimeResolution(1.0);
+    CGsystem2.initializeSystem(ratesToRestore);
+    vector<pair<int,KMC_Walker>> electrons2;
+    CGsystem2.readCheckpoint(checkpoint,electrons2);
+    assert(electrons2.size()==electrons.size());
+    assert(CGsystem2.getClusters().size()==clusters);
+
+    // Continuing the restored system is bit for bit the same
+    vector<pair<int,double>> restored = run(CGsystem2,electrons2);
+    assert(restored==original);
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      assert(CGsystem.getVisitFrequencyOfSite(siteId)==
+          CGsystem2.getVisitFrequencyOfSite(siteId));
+    }
+
+    // A system can only be restored before it is coarse grained
+    bool fail = false;
+    try {
+      stringstream again(saved);
+      CGsystem2.readCheckpoint(again,electrons2);
+    }catch(...){
+      fail = true;
+    }
+    assert(fail);
+
+    // A truncated checkpoint is detected
+    KMC_CoarseGrainSystem CGsystem3;
+    CGsystem3.setTimeResolution(1.0);
+    CGsystem3.initializeSystem(ratesToRestore);
+    fail = false;
+    try {
+      stringstream truncated(saved.substr(0,saved.size()/2));
+      vector<pair<int,KMC_Walker>> electrons3;
+      CGsystem3.readCheckpoint(truncated,electrons3);
+    }catch(runtime_error &){
+      fail = true;
+    }
+    assert(fail);
+  }
+
+  cout << "Testing: reservoirs" << endl;
+  {
+    // Chain from the source at 1 to the drain at 6, sites 2 and 3 form a
+    // cluster and the drain is reached through a fast rate
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 10;
+    ratesToNeighbors[2][1] = 1;
+    ratesToNeighbors[2][3] = 1000;
+    ratesToNeighbors[3][2] = 1000;
+    ratesToNeighbors[3][4] = 1;
+    ratesToNeighbors[4][3] = 1;
+    ratesToNeighbors[4][5] = 10;
+    ratesToNeighbors[5][4] = 1;
+    ratesToNeighbors[5][6] = 1000;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(50);
+
+    bool fail = false;
+    try {
+      CGsystem.addSource(1,1.0);
+    }catch(runtime_error &){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    fail = false;
+    try {
+      CGsystem.getInjectionDwellTime();
+    }catch(runtime_error &){
+      fail = true;
+    }
+    assert(fail);
+    // Site 6 has no rates off of it so it is already a drain
+    fail = false;
+    try {
+      CGsystem.addSource(6,1.0);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+    fail = false;
+    try {
+      CGsystem.addSource(1,0.0);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.addSource(1,0.5);
+    fail = false;
+    try {
+      CGsystem.addDrain(1);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // Walkers are always hopped in the order of their times, absorbed
+    // walkers have an infinite time so are left until they are reused
+    vector<pair<int,KMC_Walker>> electrons;
+    vector<double> times;
+    double time = 0.0;
+    double next_injection = CGsystem.getInjectionDwellTime();
+    long long injected = 0;
+    long long absorbed = 0;
+    for(int event = 0; event < 20000; ++event){
+      size_t next = electrons.size();
+      for(size_t index = 0; index < electrons.size(); ++index){
+        if(times.at(index)<next_injection &&
+            (next==electrons.size() || times.at(index)<times.at(next))){
+          next = index;
+        }
+      }
+      if(next==electrons.size()){
+        time = next_injection;
+        next_injection = time + CGsystem.getInjectionDwellTime();
+        size_t slot = 0;
+        while(slot<electrons.size() && !electrons.at(slot).second.isAbsorbed()){
+          ++slot;
+        }
+        if(slot==electrons.size()){
+          electrons.push_back(pair<int,KMC_Walker>(
+                static_cast<int>(slot),KMC_Walker()));
+          times.push_back(0.0);
+        }
+        KMC_Walker & electron = electrons.at(slot).second;
+        if(CGsystem.injectWalker(electrons.at(slot).first,electron)){
+          ++injected;
+          assert(electron.getIdOfSiteCurrentlyOccupying()==1);
+          times.at(slot) = time+electron.getDwellTime();
+        }else if(slot==electrons.size()-1 && !electron.isAbsorbed()){
+          // The new walker was never placed in the system
+          electrons.pop_back();
+          times.pop_back();
+        }
+        continue;
+      }
+      time = times.at(next);
+      KMC_Walker & electron = electrons.at(next).second;
+      CGsystem.hop(electrons.at(next).first,electron);
+      times.at(next) = time+electron.getDwellTime();
+      if(electron.isAbsorbed()){
+        assert(electron.getIdOfSiteCurrentlyOccupying()==6);
+        ++absorbed;
+      }
+    }
+
+    KMC_ReservoirCounts counts = CGsystem.getReservoirCounts();
+    assert(injected>0);
+    assert(absorbed>0);
+    assert(counts.injected==injected);
+    assert(counts.blocked_injections>0);
+    assert(counts.extracted==absorbed);
+    assert(counts.extracted_at_drain.at(6)==absorbed);
+    // Every walker injected is either absorbed or still in the system
+    long long in_system = 0;
+    for(const pair<int,KMC_Walker> & electron : electrons){
+      if(!electron.second.isAbsorbed()) ++in_system;
+    }
+    assert(injected==absorbed+in_system);
+
+    // The drain is never made part of a cluster
+    auto clusters = CGsystem.getClusters();
+    assert(clusters.size()>0);
+    for(const auto & cluster : clusters){
+      for(const int & siteId : cluster.second) assert(siteId!=6);
+    }
+
+    // A site with rates off of it can be made a drain
+    KMC_CoarseGrainSystem CGsystem2;
+    CGsystem2.setRandomSeed(1);
+    CGsystem2.setTimeResolution(1.0);
+    CGsystem2.initializeSystem(ratesToNeighbors);
+    CGsystem2.addDrain(4);
+    KMC_Walker electron;
+    electron.occupySite(3);
+    vector<pair<int,KMC_Walker>> electrons2;
+    electrons2.push_back(pair<int,KMC_Walker>(0,electron));
+    CGsystem2.initializeWalkers(electrons2);
+    while(!electrons2.at(0).second.isAbsorbed()){
+      CGsystem2.hop(electrons2.at(0).first,electrons2.at(0).second);
+    }
+    assert(electrons2.at(0).second.getIdOfSiteCurrentlyOccupying()==4);
+    assert(CGsystem2.getReservoirCounts().extracted_at_drain.at(4)==1);
+    assert(CGsystem2.getReservoirCounts().extracted==1);
+  }
+
+  cout << "Testing: walker store" << endl;
+  {
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    mt19937 random_engine(5);
+    uniform_real_distribution<double> distribution(1.0,10.0);
+    int number_of_sites = 20;
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      int neighId = (siteId+1)%number_of_sites;
+      double rate = distribution(random_engine);
+      if(siteId%5==0) rate *= 1000.0;
+      ratesToNeighbors[siteId][neighId] = rate;
+      ratesToNeighbors[neighId][siteId] = rate;
+    }
+
+    // Hopping walkers held in a store gives the same trajectory as hopping
+    // the same walkers held in a vector
+    vector<int> sites_vector;
+    vector<int> sites_store;
+    for(int use_store = 0; use_store < 2; ++use_store){
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.setMinCoarseGrainIterationThreshold(50);
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      if(use_store){
+        KMC_WalkerStore walkers;
+        for(int walker = 0; walker < 3; ++walker) walkers.add(walker*7);
+        CGsystem.initializeWalkers(walkers);
+        for(int hop = 0; hop < 3000; ++hop){
+          int handle = walkers.getEarliest();
+          double time = walkers.getTime(handle);
+          CGsystem.hop(walkers,handle);
+          assert(walkers.getTime(handle)==time+walkers.getDwellTime(handle));
+          sites_store.push_back(walkers.getSite(handle));
+        }
+        CGsystem.removeWalkerFromSystem(walkers,0);
+        assert(walkers.size()==2);
+        assert(!walkers.contains(0));
+      }else{
+        vector<pair<int,KMC_Walker>> electrons;
+        vector<double> times;
+        for(int walker = 0; walker < 3; ++walker){
+          KMC_Walker electron;
+          electron.occupySite(walker*7);
+          electrons.push_back(pair<int,KMC_Walker>(walker,electron));
+        }
+        CGsystem.initializeWalkers(electrons);
+        for(const pair<int,KMC_Walker> & electron : electrons){
+          times.push_back(electron.second.getDwellTime());
+        }
+        for(int hop = 0; hop < 3000; ++hop){
+          size_t next = 0;
+          for(size_t index = 1; index < times.size(); ++index){
+            if(times.at(index)<times.at(next)) next = index;
+          }
+          CGsystem.hop(electrons.at(next).first,electrons.at(next).second);
+          times.at(next) += electrons.at(next).second.getDwellTime();
+          sites_vector.push_back(
+              electrons.at(next).second.getIdOfSiteCurrentlyOccupying());
+        }
+      }
+    }
+    assert(sites_store==sites_vector);
+  }
+
+  cout << "Testing: rejection free kinetics" << endl;
+  {
+    // Ring of 4 sites holding 2 walkers, every rate is 1. Every arrangement
+    // of the walkers is equally likely. In the 4 arrangements where the
+    // walkers are next to each other each has one free neighbor, in the 2
+    // where they are opposite each has two, so walkers move at an average
+    // rate of (4*2+2*4)/6 = 8/3.
+    unordered_map<int,unordered_map<int,double>> ratesToNeighbors;
+    for(int siteId = 0; siteId < 4; ++siteId){
+      ratesToNeighbors[siteId][(siteId+1)%4] = 1.0;
+      ratesToNeighbors[siteId][(siteId+3)%4] = 1.0;
+    }
+
+    const int total_hops = 200000;
+    for(int rejection_free = 0; rejection_free < 2; ++rejection_free){
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      if(rejection_free){
+        CGsystem.setKinetics(KMC_CoarseGrainSystem::rejection_free);
+      }else{
+        CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+      }
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      KMC_WalkerStore walkers;
+      walkers.add(0);
+      walkers.add(1);
+      CGsystem.initializeWalkers(walkers);
+
+      int moves = 0;
+      double time = 0.0;
+      for(int hop = 0; hop < total_hops; ++hop){
+        int handle = walkers.getEarliest();
+        int siteId = walkers.getSite(handle);
+        time = walkers.getTime(handle);
+        CGsystem.hop(walkers,handle);
+        if(walkers.getSite(handle)!=siteId) ++moves;
+        assert(walkers.getSite(0)!=walkers.getSite(1));
+      }
+      if(rejection_free) assert(moves==total_hops);
+      double move_rate = static_cast<double>(moves)/time;
+      assert(fabs(move_rate-8.0/3.0)<0.05*8.0/3.0);
+    }
+
+    // Two sites each holding a walker, neither walker can hop until the
+    // other is removed
+    unordered_map<int,unordered_map<int,double>> pairRates;
+    pairRates[0][1] = 1.0;
+    pairRates[1][0] = 1.0;
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setKinetics(KMC_CoarseGrainSystem::rejection_free);
+    CGsystem.initializeSystem(pairRates);
+    KMC_WalkerStore walkers;
+    walkers.add(0);
+    walkers.add(1);
+    CGsystem.initializeWalkers(walkers);
+    assert(walkers.getEarliest()==constants::unassignedId);
+    CGsystem.removeWalkerFromSystem(walkers,0);
+    assert(walkers.getEarliest()==1);
+    assert(walkers.getTime(1)<numeric_limits<double>::infinity());
+    CGsystem.hop(walkers,1);
+    assert(walkers.getSite(1)==0);
+
+    // Walkers not held in a store can not be hopped
+    KMC_Walker walker;
+    walker.occupySite(1);
+    int walker_id = 2;
+    bool throws = false;
+    try{
+      CGsystem.hop(walker_id,walker);
+    }catch(const runtime_error &){
+      throws = true;
+    }
+    assert(throws);
+    throws = false;
+    try{
+      CGsystem.updateRates(pairRates);
+    }catch(const runtime_error &){
+      throws = true;
+    }
+    assert(throws);
+  }
+
+  cout << "Testing: rate tree event selection" << endl;
+  {
+    // Same ring of 4 sites holding 2 walkers as for rejection free kinetics,
+    // walkers picked from the rate tree move at the same average rate
+    unordered_map<int,unordered_map<int,double>> ratesToNeighbors;
+    for(int siteId = 0; siteId < 4; ++siteId){
+      ratesToNeighbors[siteId][(siteId+1)%4] = 1.0;
+      ratesToNeighbors[siteId][(siteId+3)%4] = 1.0;
+    }
+
+    const int total_hops = 200000;
+    for(int rate_tree = 0; rate_tree < 2; ++rate_tree){
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+      if(rate_tree){
+        CGsystem.setEventSelection(KMC_CoarseGrainSystem::rate_tree);
+      }
+      CGsystem.initializeSystem(ratesToNeighbors);
+
+      KMC_WalkerStore walkers;
+      walkers.add(0);
+      walkers.add(1);
+      CGsystem.initializeWalkers(walkers);
+
+      int moves = 0;
+      double time = 0.0;
+      for(int hop = 0; hop < total_hops; ++hop){
+        int siteId0 = walkers.getSite(0);
+        int siteId1 = walkers.getSite(1);
+        int handle = CGsystem.hopNext(walkers);
+        assert(CGsystem.getTime()>=time);
+        time = CGsystem.getTime();
+        // With the rate tree the time of a walker is that of its last event
+        if(rate_tree) assert(walkers.getTime(handle)==time);
+        if(walkers.getSite(0)!=siteId0 || walkers.getSite(1)!=siteId1){
+          ++moves;
+        }
+        assert(walkers.getSite(0)!=walkers.getSite(1));
+      }
+      double move_rate = static_cast<double>(moves)/time;
+      assert(fabs(move_rate-8.0/3.0)<0.05*8.0/3.0);
+
+      if(rate_tree){
+        KMC_Walker walker;
+        walker.occupySite(2);
+        int walker_id = 2;
+        bool throws = false;
+        try{
+          CGsystem.hop(walker_id,walker);
+        }catch(const runtime_error &){
+          throws = true;
+        }
+        assert(throws);
+      }
+    }
+
+    // Coarse grained kinetics needs cluster event skipping
+    unordered_map<int,unordered_map<int,double>> chainRates;
+    for(int siteId = 0; siteId < 6; ++siteId){
+      double rate = (siteId==2) ? 1000.0 : 1.0;
+      chainRates[siteId][siteId+1] = rate;
+      chainRates[siteId+1][siteId] = rate;
+    }
+    {
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setTimeResolution(1.0);
+      CGsystem.setEventSelection(KMC_CoarseGrainSystem::rate_tree);
+      bool throws = false;
+      try{
+        CGsystem.initializeSystem(chainRates);
+      }catch(const runtime_error &){
+        throws = true;
+      }
+      assert(throws);
+    }
+
+    // Walkers leave the cluster formed on the fast pair at the effective
+    // rate of the cluster
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(50);
+    CGsystem.setClusterEventSkipping(true);
+    CGsystem.setEventSelection(KMC_CoarseGrainSystem::rate_tree);
+    CGsystem.initializeSystem(chainRates);
+    KMC_WalkerStore walkers;
+    walkers.add(2);
+    walkers.add(5);
+    CGsystem.initializeWalkers(walkers);
+    for(int hop = 0; hop < 5000; ++hop){
+      int handle = CGsystem.hopNext(walkers);
+      assert(walkers.contains(handle));
+    }
+    assert(CGsystem.getClusters().size()==1);
+    assert(CGsystem.getTime()>0.0);
+    assert(CGsystem.getTime()<numeric_limits<double>::infinity());
+    CGsystem.removeWalkerFromSystem(walkers,0);
+    for(int hop = 0; hop < 100; ++hop){
+      assert(CGsystem.hopNext(walkers)==1);
+    }
+  }
+
+
+  cout << "Testing: rate table" << endl;
+  {
+    // Chain 0 - 1 - 2 that ends in site 3, which has no row so is a drain
+    KMC_RateTable table;
+    table.offsets = { 0, 1, 3, 5 };
+    table.neighbors = { 1, 0, 2, 1, 3 };
+    table.rates = { 1.0, 1.0, 1.0, 1.0, 100.0 };
+
+    KMC_RateTable broken = table;
+    broken.rates.pop_back();
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(1.0);
+    bool fail = false;
+    try {
+      CGsystem.initializeSystem(broken);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+    broken = table;
+    broken.offsets = { 0, 1, 1, 5 };
+    fail = false;
+    try {
+      CGsystem.initializeSystem(broken);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    CGsystem.initializeSystem(table);
+    // The table is owned by the caller, no rates are held by the system
+    assert(CGsystem.getMemoryUsage().rate_map==table.getMemoryUsage());
+    assert(CGsystem.getMemoryUsage().rate_cache==0);
+    fail = false;
+    try {
+      CGsystem.addSource(3,1.0);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // The system points at the rates held in the table
+    unordered_map<int,unordered_map<int,double>> new_rates;
+    new_rates[0][1] = 2.0;
+    CGsystem.updateRates(new_rates);
+    assert(table.rates.at(0)==2.0);
+
+    KMC_WalkerStore walkers;
+    walkers.add(0);
+    CGsystem.initializeWalkers(walkers);
+    int handle = walkers.getEarliest();
+    int hops = 0;
+    while(walkers.getSite(handle)!=3 && hops<1000){
+      CGsystem.hop(walkers,handle);
+      ++hops;
+    }
+    assert(walkers.getSite(handle)==3);
+  }
+
+  cout << "Testing: rate provider and compressed rate table" << endl;
+  {
+    const int number_of_sites = 400;
+    mt19937 random_engine(3);
+    uniform_real_distribution<double> distribution(0.0,6.0);
+    normal_distribution<double> energy_distribution(0.0,0.1);
+    vector<double> x(number_of_sites);
+    vector<double> y(number_of_sites);
+    vector<double> z(number_of_sites);
+    vector<double> energies(number_of_sites);
+    for(int siteId = 0; siteId < number_of_sites; ++siteId){
+      x.at(siteId) = distribution(random_engine);
+      y.at(siteId) = distribution(random_engine);
+      z.at(siteId) = distribution(random_engine);
+      energies.at(siteId) = energy_distribution(random_engine);
+    }
+    KMC_RateModel model;
+    KMC_RateProvider provider(x,y,z,energies,1.2,model,1);
+    KMC_RateTable table = generateRateTable(x,y,z,energies,1.2,model,1);
+    KMC_CompressedRateTable compressed_table =
+      generateCompressedRateTable(x,y,z,energies,1.2,model,1);
+
+    const size_t capacity = 20;
+    for(int mode = 0; mode < 4; ++mode){
+      bool coarse_grained = mode%2==1;
+      bool compressed = mode>=2;
+      KMC_CoarseGrainSystem CGsystem;
+      CGsystem.setRandomSeed(1);
+      CGsystem.setTimeResolution(1.0);
+      if(coarse_grained){
+        CGsystem.setKinetics(KMC_CoarseGrainSystem::coarse_grained);
+      }else{
+        CGsystem.setKinetics(KMC_CoarseGrainSystem::exact);
+      }
+      bool fail = false;
+      try {
+        CGsystem.setRateCacheCapacity(0);
+      }catch(invalid_argument &){
+        fail = true;
+      }
+      assert(fail);
+      CGsystem.setRateCacheCapacity(capacity);
+      assert(CGsystem.getRateCacheCapacity()==capacity);
+      if(compressed){
+        CGsystem.initializeSystem(compressed_table);
+      }else{
+        CGsystem.initializeSystem(provider);
+      }
+
+      fail = false;
+      try {
+        unordered_map<int,unordered_map<int,double>> new_rates;
+        new_rates[0][1] = 2.0;
+        CGsystem.updateRates(new_rates);
+      }catch(runtime_error &){
+        fail = true;
+      }
+      assert(fail);
+
+      KMC_WalkerStore walkers;
+      walkers.add(0);
+      CGsystem.initializeWalkers(walkers);
+      int handle = walkers.getEarliest();
+      set<int> visited;
+      for(int hop = 0; hop < 5000; ++hop){
+        int siteId = walkers.getSite(handle);
+        CGsystem.hop(walkers,handle);
+        int newSiteId = walkers.getSite(handle);
+        visited.insert(newSiteId);
+        assert(newSiteId>=0 && newSiteId<number_of_sites);
+        if(!coarse_grained && newSiteId!=siteId){
+          // Without clusters walkers only move to a neighbor in the table
+          assert(binary_search(
+                table.neighbors.begin()+table.offsets.at(siteId),
+                table.neighbors.begin()+table.offsets.at(siteId+1),
+                newSiteId));
+        }
+      }
+      // Sites were evicted and loaded again along the way
+      assert(visited.size()>capacity);
+      KMC_MemoryUsage usage = CGsystem.getMemoryUsage();
+      if(compressed){
+        assert(usage.rate_map==compressed_table.getMemoryUsage());
+      }else{
+        assert(usage.rate_map==provider.getMemoryUsage());
+      }
+      // The cache is held by the system and counted in its total
+      assert(usage.rate_cache>0);
+      assert(usage.rate_cache<table.getMemoryUsage());
+      assert(usage.total()>=usage.rate_cache+usage.sites);
+    }
+  }
+
 	return 0;
 }
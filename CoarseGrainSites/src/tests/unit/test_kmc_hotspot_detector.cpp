@@ -0,0 +1,138 @@
+
+#include <iostream>
+#include <cassert>
+#include <limits>
+
+#include "../../libkmccoarsegrain/kmc_hotspot_detector.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void){
+  cout << "Testing: Constructor" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    assert(detector.getThreshold()==20);
+    assert(detector.estimateReturns(1)==0);
+  }
+
+  cout << "Testing: setThreshold" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setThreshold(5);
+    assert(detector.getThreshold()==5);
+  }
+
+  cout << "Testing: recordHop" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setThreshold(3);
+
+    // Walker moving in a straight line never returns
+    for(int siteId = 1; siteId < 100; ++siteId){
+      assert(detector.recordHop(1,siteId,siteId+1)==false);
+    }
+    assert(detector.estimateReturns(1)==0);
+
+    // Walker 2 oscillates between site 200 and 201, the first hop 200->201
+    // is not a return
+    assert(detector.recordHop(2,200,201)==false);
+    assert(detector.recordHop(2,201,200)==false);
+    assert(detector.estimateReturns(200)==1);
+    assert(detector.recordHop(2,200,201)==false);
+    assert(detector.estimateReturns(201)==1);
+    assert(detector.recordHop(2,201,200)==false);
+    assert(detector.recordHop(2,200,201)==false);
+    // Third return to 200
+    assert(detector.recordHop(2,201,200)==true);
+    assert(detector.estimateReturns(200)==3);
+
+    // Walkers are tracked separately, walker 3 has not been to 201 before
+    assert(detector.recordHop(3,202,201)==false);
+    assert(detector.estimateReturns(201)==2);
+  }
+
+  cout << "Testing: recordFailure" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setThreshold(2);
+    detector.recordHop(1,1,2);
+    detector.recordHop(1,2,1);
+    assert(detector.recordHop(1,1,2)==false);
+    assert(detector.recordHop(1,2,1)==true);
+    detector.recordFailure(1);
+    assert(detector.estimateReturns(1)==0);
+
+    // Now 4 returns are needed
+    int returns = 0;
+    bool hot_spot = false;
+    while(!hot_spot){
+      detector.recordHop(1,1,2);
+      hot_spot = detector.recordHop(1,2,1);
+      ++returns;
+    }
+    assert(returns==4);
+
+    detector.recordSuccess(1);
+    assert(detector.estimateReturns(1)==0);
+    detector.recordHop(1,1,2);
+    detector.recordHop(1,2,1);
+    detector.recordHop(1,1,2);
+    assert(detector.recordHop(1,2,1)==true);
+  }
+
+  cout << "Testing: recordFailure saturates" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setThreshold(numeric_limits<int>::max());
+    size_t memory = detector.getMemoryUsage();
+    for(int siteId = 0; siteId < 10000; ++siteId){
+      for(int failure = 0; failure < 20; ++failure){
+        detector.recordFailure(siteId);
+      }
+    }
+    // The back off does not grow with the number of failed sites
+    assert(detector.getMemoryUsage()==memory);
+    // Had the shifted threshold overflowed to 0 this would be a hot spot
+    assert(detector.recordHop(1,1,2)==false);
+    assert(detector.recordHop(1,2,1)==false);
+  }
+
+  cout << "Testing: recordIgnoredHop" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setThreshold(1);
+    detector.recordHop(1,1,2);
+    detector.recordIgnoredHop(1,2);
+    // The walker came from 2 not 1, hopping to 1 is not a return
+    assert(detector.recordHop(1,3,1)==false);
+    assert(detector.estimateReturns(1)==0);
+    assert(detector.recordHop(1,1,3)==true);
+  }
+
+  cout << "Testing: setDecayInterval" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.setDecayInterval(4);
+    assert(detector.getDecayInterval()==4);
+    detector.recordHop(1,1,2);
+    detector.recordHop(1,2,1);
+    detector.recordHop(1,1,2);
+    assert(detector.estimateReturns(1)==1);
+    assert(detector.estimateReturns(2)==1);
+    // Fourth hop halves the counts
+    detector.recordHop(1,2,1);
+    assert(detector.estimateReturns(1)==1);
+    assert(detector.estimateReturns(2)==0);
+  }
+
+  cout << "Testing: removeWalker" << endl;
+  {
+    KMC_HotSpotDetector detector;
+    detector.recordHop(1,1,2);
+    detector.removeWalker(1);
+    detector.recordHop(1,2,1);
+    assert(detector.estimateReturns(1)==0);
+  }
+  return 0;
+}
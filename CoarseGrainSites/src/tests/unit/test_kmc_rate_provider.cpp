@@ -0,0 +1,101 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_rate_provider.hpp"
+#include "../../../include/kmccoarsegrain/kmc_rate_table.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void) {
+
+  cout << "Testing: KMC_RateProvider" << endl;
+  {
+    // Sites 0 to 2 are in reach of each other, site 3 is only connected to
+    // its nearest site 2
+    vector<double> x = { 0.0, 1.0, 2.0, 10.0 };
+    vector<double> y(4,0.0);
+    vector<double> z(4,0.0);
+    vector<double> energies = { 0.0, 0.1, -0.1, 0.05 };
+    KMC_RateProvider provider(x,y,z,energies,1.5,
+        [](double energy_difference, double dx, double distance){
+          return 1.0+energy_difference+10.0*dx+100.0*distance;
+        });
+    assert(provider.size()==4);
+
+    vector<int> neighbors;
+    vector<double> rates;
+    provider.getRatesOffSite(2,neighbors,rates);
+    vector<int> expected_neighbors = { 1, 3 };
+    assert(neighbors==expected_neighbors);
+    assert(fabs(rates.at(0)-(1.0+0.2-10.0+100.0))<1E-12);
+    assert(fabs(rates.at(1)-(1.0+0.15+80.0+800.0))<1E-12);
+    provider.getRatesOffSite(3,neighbors,rates);
+    expected_neighbors = { 2 };
+    assert(neighbors==expected_neighbors);
+    assert(provider.getMemoryUsage()>4*4*sizeof(double));
+
+    bool fail = false;
+    try {
+      provider.getRatesOffSite(4,neighbors,rates);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+    fail = false;
+    try {
+      KMC_RateModel model;
+      KMC_RateProvider broken(x,y,z,vector<double>(3,0.0),1.5,model);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+  }
+
+  cout << "Testing: KMC_RateProvider matches generateRateTable" << endl;
+  {
+    const size_t number_of_sites = 1000;
+    const double side = 8.0;
+    const double cutoff = 1.3;
+    mt19937 random_engine(5);
+    uniform_real_distribution<double> distribution(0.0,side);
+    normal_distribution<double> energy_distribution(0.0,0.05);
+    vector<double> x(number_of_sites);
+    vector<double> y(number_of_sites);
+    vector<double> z(number_of_sites);
+    vector<double> energies(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      x.at(siteId) = distribution(random_engine);
+      y.at(siteId) = distribution(random_engine);
+      z.at(siteId) = distribution(random_engine);
+      energies.at(siteId) = energy_distribution(random_engine);
+    }
+    KMC_RateModel model;
+    model.field = 0.01;
+
+    KMC_RateTable table = generateRateTable(x,y,z,energies,cutoff,model,2);
+    KMC_RateProvider provider(x,y,z,energies,cutoff,model,2);
+
+    vector<int> neighbors;
+    vector<double> rates;
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      provider.getRatesOffSite(static_cast<int>(siteId),neighbors,rates);
+      vector<int> expected(
+          table.neighbors.begin()+table.offsets.at(siteId),
+          table.neighbors.begin()+table.offsets.at(siteId+1));
+      assert(neighbors==expected);
+      for(size_t index = 0; index < neighbors.size(); ++index){
+        double expected_rate = table.rates.at(table.offsets.at(siteId)+index);
+        assert(fabs(rates.at(index)-expected_rate)<=1E-12*expected_rate);
+      }
+    }
+    // Only the sites are stored, not the rates
+    assert(provider.getMemoryUsage()<table.getMemoryUsage());
+  }
+
+  return 0;
+}
@@ -0,0 +1,263 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_rate_table.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void) {
+
+  cout << "Testing: KMC_RateModel" << endl;
+  {
+    KMC_RateModel model;
+    assert(model.type==KMC_RateModel::marcus);
+    // Marcus rates are largest when the energy given up matches the
+    // reorganization energy
+    double peak = model.rate(-model.reorganization_energy,0.0,1.0);
+    assert(peak>model.rate(0.0,0.0,1.0));
+    assert(peak>model.rate(-0.1,0.0,1.0));
+    // Rates too small for a double are kept above 0.0
+    assert(model.rate(10.0,0.0,1.0)==numeric_limits<double>::min());
+
+    model.type = KMC_RateModel::miller_abrahams;
+    double down = model.attempt_rate*exp(-2.0*1.0/model.localization_length);
+    assert(fabs(model.rate(-0.1,0.0,1.0)-down)<1E-9*down);
+    double up = down*exp(-0.1/model.kT);
+    assert(fabs(model.rate(0.1,0.0,1.0)-up)<1E-9*up);
+
+    // Moving along the field lowers the energy
+    model.field = 0.1;
+    assert(fabs(model.rate(0.1,1.0,1.0)-down)<1E-9*down);
+  }
+
+  cout << "Testing: generateRateTable" << endl;
+  {
+    // Sites 0 to 2 are in reach of each other, site 3 is only connected to
+    // its nearest site 2
+    vector<double> x = { 0.0, 1.0, 2.0, 10.0 };
+    vector<double> y(4,0.0);
+    vector<double> z(4,0.0);
+    vector<double> energies = { 0.0, 0.1, -0.1, 0.05 };
+    KMC_RateModel model;
+    KMC_RateTable table = generateRateTable(x,y,z,energies,1.5,model);
+
+    assert(table.size()==4);
+    vector<size_t> offsets = { 0, 1, 3, 5, 6 };
+    vector<int> neighbors = { 1, 0, 2, 1, 3, 2 };
+    assert(table.offsets==offsets);
+    assert(table.neighbors==neighbors);
+    assert(table.rates.size()==neighbors.size());
+    for(size_t siteId = 0; siteId < table.size(); ++siteId){
+      for(size_t index = table.offsets.at(siteId);
+          index < table.offsets.at(siteId+1); ++index){
+        int neighId = table.neighbors.at(index);
+        double dx = x.at(neighId)-x.at(siteId);
+        double expected = model.rate(
+            energies.at(neighId)-energies.at(siteId),dx,fabs(dx));
+        assert(fabs(table.rates.at(index)-expected)<1E-12*expected);
+      }
+    }
+    assert(table.getMemoryUsage()>=sizeof(KMC_RateTable)+
+        6*(sizeof(int)+sizeof(double)));
+
+    bool fail = false;
+    try {
+      generateRateTable(x,y,z,vector<double>(3,0.0),1.5,model);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+    fail = false;
+    try {
+      generateRateTable(x,y,z,energies,0.0,model);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+  }
+
+  cout << "Testing: generateRateTable random sites" << endl;
+  {
+    // Every pair within the cutoff is found, whatever the number of threads
+    const size_t number_of_sites = 2000;
+    const double side = 10.0;
+    const double cutoff = 1.2;
+    mt19937 random_engine(3);
+    uniform_real_distribution<double> distribution(0.0,side);
+    normal_distribution<double> energy_distribution(0.0,0.05);
+    vector<double> x(number_of_sites);
+    vector<double> y(number_of_sites);
+    vector<double> z(number_of_sites);
+    vector<double> energies(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      x.at(siteId) = distribution(random_engine);
+      y.at(siteId) = distribution(random_engine);
+      z.at(siteId) = distribution(random_engine);
+      energies.at(siteId) = energy_distribution(random_engine);
+    }
+    KMC_RateModel model;
+    model.type = KMC_RateModel::miller_abrahams;
+
+    KMC_RateTable serial = generateRateTable(x,y,z,energies,cutoff,model,1);
+    KMC_RateTable parallel = generateRateTable(x,y,z,energies,cutoff,model,4);
+    assert(serial.offsets==parallel.offsets);
+    assert(serial.neighbors==parallel.neighbors);
+    assert(serial.rates==parallel.rates);
+
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      vector<int> expected;
+      for(size_t neighId = 0; neighId < number_of_sites; ++neighId){
+        if(neighId==siteId) continue;
+        double distance = sqrt(pow(x.at(neighId)-x.at(siteId),2.0)+
+            pow(y.at(neighId)-y.at(siteId),2.0)+
+            pow(z.at(neighId)-z.at(siteId),2.0));
+        if(distance<=cutoff) expected.push_back(static_cast<int>(neighId));
+      }
+      // Isolated sites are connected to their nearest site instead
+      if(expected.empty()) continue;
+      vector<int> found(
+          serial.neighbors.begin()+serial.offsets.at(siteId),
+          serial.neighbors.begin()+serial.offsets.at(siteId+1));
+      assert(found==expected);
+    }
+  }
+
+  cout << "Testing: compressRateTable" << endl;
+  {
+    // Ring of 3 sites with rates that obey detailed balance, the rows are
+    // not sorted
+    const double kT = 0.025;
+    vector<double> energies = { 0.0, 0.05, -0.02 };
+    KMC_RateTable table;
+    table.offsets = { 0, 2, 4, 6 };
+    table.neighbors = { 2, 1, 0, 2, 1, 0 };
+    // Rate back from neighId to siteId
+    auto balanced = [&](int siteId, int neighId, double rate){
+      return rate*exp(-(energies.at(siteId)-energies.at(neighId))/kT);
+    };
+    table.rates = {
+      balanced(2,0,3.0), 1.0,
+      balanced(0,1,1.0), 2.0,
+      balanced(1,2,2.0), 3.0 };
+
+    KMC_CompressedRateTable compressed = compressRateTable(table,energies,kT);
+    assert(compressed.size()==3);
+    assert(compressed.prefactors.size()==3);
+    vector<int> neighIds;
+    vector<double> rates;
+    for(int siteId = 0; siteId < 3; ++siteId){
+      compressed.getRatesOffSite(siteId,neighIds,rates);
+      assert(neighIds.size()==2);
+      assert(neighIds.at(0)<neighIds.at(1));
+      for(size_t index = 0; index < neighIds.size(); ++index){
+        for(size_t row = table.offsets.at(siteId);
+            row < table.offsets.at(siteId+1); ++row){
+          if(table.neighbors.at(row)!=neighIds.at(index)) continue;
+          assert(fabs(rates.at(index)/table.rates.at(row)-1.0)<1E-12);
+        }
+      }
+    }
+
+    bool fail = false;
+    try {
+      compressed.getRatesOffSite(3,neighIds,rates);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // Rates out of balance
+    KMC_RateTable broken = table;
+    broken.rates.at(0) *= 2.0;
+    fail = false;
+    try {
+      compressRateTable(broken,energies,kT);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // A rate with no rate back
+    broken = table;
+    broken.offsets = { 0, 2, 4, 5 };
+    broken.neighbors.pop_back();
+    broken.rates.pop_back();
+    fail = false;
+    try {
+      compressRateTable(broken,energies,kT);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // A drain
+    broken = table;
+    broken.neighbors.at(1) = 3;
+    fail = false;
+    try {
+      compressRateTable(broken,energies,kT);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+  }
+
+  cout << "Testing: generateCompressedRateTable" << endl;
+  {
+    const size_t number_of_sites = 2000;
+    const double side = 10.0;
+    const double cutoff = 1.2;
+    mt19937 random_engine(7);
+    uniform_real_distribution<double> distribution(0.0,side);
+    normal_distribution<double> energy_distribution(0.0,0.05);
+    vector<double> x(number_of_sites);
+    vector<double> y(number_of_sites);
+    vector<double> z(number_of_sites);
+    vector<double> energies(number_of_sites);
+    for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+      x.at(siteId) = distribution(random_engine);
+      y.at(siteId) = distribution(random_engine);
+      z.at(siteId) = distribution(random_engine);
+      energies.at(siteId) = energy_distribution(random_engine);
+    }
+    for(int type = 0; type < 2; ++type){
+      KMC_RateModel model;
+      if(type==1) model.type = KMC_RateModel::miller_abrahams;
+      model.field = 0.01;
+
+      KMC_RateTable table = generateRateTable(x,y,z,energies,cutoff,model,2);
+      KMC_CompressedRateTable compressed =
+        generateCompressedRateTable(x,y,z,energies,cutoff,model,2);
+      assert(compressed.offsets==table.offsets);
+      assert(compressed.neighbors==table.neighbors);
+      assert(2*compressed.prefactors.size()==table.rates.size());
+
+      vector<int> neighIds;
+      vector<double> rates;
+      for(size_t siteId = 0; siteId < number_of_sites; ++siteId){
+        compressed.getRatesOffSite(static_cast<int>(siteId),neighIds,rates);
+        for(size_t index = 0; index < neighIds.size(); ++index){
+          double expected = table.rates.at(table.offsets.at(siteId)+index);
+          assert(fabs(rates.at(index)/expected-1.0)<1E-9);
+        }
+      }
+      assert(compressed.getMemoryUsage()<table.getMemoryUsage());
+
+      // Compressing the full table gives the same rates
+      KMC_CompressedRateTable recompressed =
+        compressRateTable(table,compressed.energies,model.kT);
+      for(size_t index = 0; index < compressed.prefactors.size(); ++index){
+        assert(fabs(recompressed.prefactors.at(index)/
+              compressed.prefactors.at(index)-1.0)<1E-9);
+      }
+    }
+  }
+
+  return 0;
+}
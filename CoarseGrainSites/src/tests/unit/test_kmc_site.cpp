@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iostream>
 #include <cassert>
 #include <vector>
@@ -139,6 +140,33 @@ int main(void){
     assert(value==1);
   }
 
+  cout << "Testing: updateRatesToNeighbors" << endl;
+  {
+    unordered_map<int,double> neighRates;
+    neighRates[1] = 1.0;
+    neighRates[2] = 3.0;
+
+    KMC_Site site;
+    site.setRatesToNeighbors(neighRates);
+    assert(site.getTimeConstant()==0.25);
+
+    KMC_Site site_copy = site;
+
+    unordered_map<int,double> newRates;
+    newRates[2] = 1.0;
+    site.updateRatesToNeighbors(newRates);
+    // The rates are written to the values pointed to
+    assert(neighRates[2]==1.0);
+    assert(site.getRateToNeighbor(2)==1.0);
+    assert(site.getTimeConstant()==0.5);
+
+    // The copy sees the new rates but must be told to recalculate
+    assert(site_copy.getRateToNeighbor(2)==1.0);
+    assert(site_copy.getTimeConstant()==0.25);
+    site_copy.updateProbabilitiesAndTimeConstant();
+    assert(site_copy.getTimeConstant()==0.5);
+  }
+
   cout << "Testing: isNeighbor" << endl;
   {
     double rate1 = 400;
@@ -263,5 +291,70 @@ int main(void){
 
   }
 
+  cout << "Testing: neighbor tree" << endl;
+  {
+    unordered_map< int, double > neighRates;
+    for(int neighId = 1; neighId <= 100; ++neighId){
+      neighRates[neighId] = static_cast<double>(neighId);
+    }
+
+    KMC_Site site;
+    site.setId(0);
+    site.setRandomSeed(1);
+    site.setRatesToNeighbors(neighRates);
+    vector<pair<int,double>> probabilities =
+      site.getProbabilitiesAndIdsOfNeighbors();
+    double time_constant = site.getTimeConstant();
+
+    site.setNeighborTree(true);
+    assert(site.hasNeighborTree());
+    assert(fabs(site.getTimeConstant()-time_constant)<1E-12);
+    // The probabilities are in the same order with or without the tree
+    vector<pair<int,double>> tree_probabilities =
+      site.getProbabilitiesAndIdsOfNeighbors();
+    assert(tree_probabilities.size()==probabilities.size());
+    for(size_t index = 0; index < probabilities.size(); ++index){
+      assert(tree_probabilities.at(index).first==probabilities.at(index).first);
+      assert(fabs(tree_probabilities.at(index).second-
+            probabilities.at(index).second)<1E-12);
+    }
+    assert(fabs(site.getProbabilityOfHoppingToNeighboringSite(100)-
+          100.0/5050.0)<1E-12);
+
+    // Neighbors are picked in proportion to their rates
+    vector<int> picks(101,0);
+    const int samples = 200000;
+    for(int sample = 0; sample < samples; ++sample){
+      ++picks.at(site.pickNewSiteId());
+    }
+    int low = 0;
+    for(int neighId = 1; neighId <= 50; ++neighId) low += picks.at(neighId);
+    assert(fabs(static_cast<double>(low)/samples-1275.0/5050.0)<0.01);
+
+    // A single rate is changed without rebuilding the tree
+    site.updateRateToNeighbor(1,4951.0);
+    assert(neighRates[1]==4951.0);
+    assert(fabs(site.getTimeConstant()-1.0/10000.0)<1E-12);
+    assert(fabs(site.getProbabilityOfHoppingToNeighboringSite(1)-0.4951)<1E-12);
+    unordered_map<int,double> newRates;
+    newRates[2] = 2.0;
+    site.updateRatesToNeighbors(newRates);
+    assert(fabs(site.getTimeConstant()-1.0/10000.0)<1E-12);
+    picks.assign(101,0);
+    for(int sample = 0; sample < samples; ++sample){
+      ++picks.at(site.pickNewSiteId());
+    }
+    assert(fabs(static_cast<double>(picks.at(1))/samples-0.4951)<0.01);
+
+    // Copies of the site have their own tree
+    KMC_Site copy = site;
+    assert(copy.hasNeighborTree());
+    copy.setNeighborTree(false);
+    assert(!copy.hasNeighborTree());
+    assert(site.hasNeighborTree());
+    assert(fabs(copy.getProbabilityOfHoppingToNeighboringSite(1)-0.4951)<1E-12);
+    assert(fabs(copy.getTimeConstant()-1.0/10000.0)<1E-12);
+  }
+
 	return 0;
 }
@@ -0,0 +1,101 @@
+
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_statistics.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void){
+  cout << "Testing: Constructor" << endl;
+  {
+    KMC_Statistics statistics;
+    assert(statistics.hops==0);
+    assert(statistics.rejected_hops==0);
+    assert(statistics.coarse_grain_attempts==0);
+    for(int phase = 0; phase < KMC_Statistics::number_of_phases; ++phase){
+      assert(statistics.phase_calls[phase]==0);
+      assert(statistics.phase_ticks[phase]==0);
+    }
+  }
+
+  cout << "Testing: clear" << endl;
+  {
+    KMC_Statistics statistics;
+    statistics.hops = 10;
+    statistics.cluster_exits = 3;
+    statistics.phase_calls[KMC_Statistics::hop] = 10;
+    statistics.clear();
+    assert(statistics.hops==0);
+    assert(statistics.cluster_exits==0);
+    assert(statistics.phase_calls[KMC_Statistics::hop]==0);
+  }
+
+  cout << "Testing: toJSON" << endl;
+  {
+    KMC_Statistics statistics;
+    statistics.hops = 12;
+    statistics.phase_calls[KMC_Statistics::find_basin] = 2;
+    string json = statistics.toJSON();
+    assert(json.front()=='{');
+    assert(json.back()=='}');
+    assert(json.find("\"hops\": 12")!=string::npos);
+    assert(json.find("\"find_basin\": {\"calls\": 2")!=string::npos);
+    assert(json.find("\"cluster_solve\"")!=string::npos);
+  }
+
+  cout << "Testing: getStatistics" << endl;
+  {
+    // site1 <-> site2 <-> site3 <-> site4, sites 2 and 3 are connected by
+    // fast rates
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 1;
+    ratesToNeighbors[2][1] = 1;
+    ratesToNeighbors[2][3] = 1000;
+    ratesToNeighbors[3][2] = 1000;
+    ratesToNeighbors[3][4] = 1;
+    ratesToNeighbors[4][3] = 1;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(100.0);
+    CGsystem.setMinCoarseGrainIterationThreshold(100);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    KMC_Walker electron;
+    electron.occupySite(1);
+    vector<pair<int,KMC_Walker>> electrons;
+    electrons.push_back(pair<int,KMC_Walker>(1,electron));
+    CGsystem.initializeWalkers(electrons);
+
+    int total_hops = 1000;
+    for(int hop = 0; hop < total_hops; ++hop){
+      CGsystem.hop(electrons.at(0).first,electrons.at(0).second);
+    }
+
+    const KMC_Statistics & statistics = CGsystem.getStatistics();
+    if(KMC_Statistics::enabled()){
+      assert(statistics.hops==total_hops);
+      assert(statistics.phase_calls[KMC_Statistics::hop]==total_hops);
+      assert(statistics.coarse_grain_attempts>0);
+      assert(statistics.coarse_grain_successes>0);
+      assert(statistics.cluster_entries>0);
+      assert(statistics.cluster_entries-statistics.cluster_exits<=1);
+      assert(statistics.phase_calls[KMC_Statistics::find_basin]==
+          statistics.coarse_grain_attempts);
+    }else{
+      assert(statistics.hops==0);
+      assert(statistics.phase_calls[KMC_Statistics::hop]==0);
+    }
+
+    CGsystem.clearStatistics();
+    assert(CGsystem.getStatistics().hops==0);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_sum_tree.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void) {
+
+  cout << "Testing: KMC_SumTree constructor" << endl;
+  {
+    KMC_SumTree tree;
+    assert(tree.total()==0.0);
+    assert(tree.get(0)==0.0);
+    assert(tree.get(10)==0.0);
+  }
+
+  cout << "Testing: KMC_SumTree set" << endl;
+  {
+    KMC_SumTree tree;
+    tree.set(0,1.0);
+    tree.set(2,3.0);
+    assert(tree.capacity()>=3);
+    assert(tree.get(0)==1.0);
+    assert(tree.get(1)==0.0);
+    assert(tree.get(2)==3.0);
+    assert(tree.total()==4.0);
+
+    // Growing keeps the values already set
+    tree.set(9,0.5);
+    assert(tree.capacity()>=10);
+    assert(tree.get(0)==1.0);
+    assert(tree.get(2)==3.0);
+    assert(tree.total()==4.5);
+
+    tree.set(2,0.0);
+    assert(tree.total()==1.5);
+    tree.clear();
+    assert(tree.total()==0.0);
+    assert(tree.get(9)==0.0);
+  }
+
+  cout << "Testing: KMC_SumTree find" << endl;
+  {
+    KMC_SumTree tree;
+    tree.set(0,1.0);
+    tree.set(1,0.0);
+    tree.set(2,2.0);
+    tree.set(3,1.0);
+    assert(tree.find(0.0)==0);
+    assert(tree.find(0.5)==0);
+    assert(tree.find(1.0)==2);
+    assert(tree.find(2.9)==2);
+    assert(tree.find(3.0)==3);
+    // A sum at or past the total lands on the last value that is not zero
+    assert(tree.find(4.0)==3);
+    assert(tree.find(10.0)==3);
+  }
+
+  cout << "Testing: KMC_SumTree sampling" << endl;
+  {
+    // Indices are picked in proportion to their values
+    KMC_SumTree tree;
+    vector<double> values = { 1.0, 0.0, 4.0, 2.0, 3.0 };
+    for(size_t index = 0; index < values.size(); ++index){
+      tree.set(index,values.at(index));
+    }
+    mt19937 random_engine(1);
+    uniform_real_distribution<double> distribution(0.0,1.0);
+    vector<int> picks(values.size(),0);
+    const int samples = 100000;
+    for(int sample = 0; sample < samples; ++sample){
+      ++picks.at(tree.find(distribution(random_engine)*tree.total()));
+    }
+    assert(picks.at(1)==0);
+    for(size_t index = 0; index < values.size(); ++index){
+      double expected = values.at(index)/10.0;
+      double found = static_cast<double>(picks.at(index))/samples;
+      assert(fabs(found-expected)<0.01);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+
+#include <iostream>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../include/kmccoarsegrain/kmc_coarsegrainsystem.hpp"
+#include "../../../include/kmccoarsegrain/kmc_trace.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker.hpp"
+#include "../../libkmccoarsegrain/kmc_trace_buffer.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void){
+  cout << "Testing: TraceBuffer" << endl;
+  {
+    trace::TraceBuffer buffer;
+    assert(buffer.getRecords().size()==0);
+    buffer.push(trace::Record{trace::hop,1,2,0.5});
+    buffer.push(trace::Record{trace::rejected_hop,1,3,0.25});
+    auto records = buffer.getRecords();
+    assert(records.size()==2);
+    assert(records.at(0).event==trace::hop);
+    assert(records.at(0).site==2);
+    assert(records.at(1).event==trace::rejected_hop);
+    assert(records.at(1).time==0.25);
+
+    // Oldest records are overwritten once the buffer is full
+    for(int index = 0; index < static_cast<int>(trace::capacity); ++index){
+      buffer.push(trace::Record{trace::hop,1,index,0.0});
+    }
+    records = buffer.getRecords();
+    assert(records.size()==trace::capacity);
+    assert(records.front().site==0);
+    assert(records.back().site==static_cast<int>(trace::capacity)-1);
+
+    buffer.clear();
+    assert(buffer.getRecords().size()==0);
+  }
+
+  cout << "Testing: TraceBuffer read while written" << endl;
+  {
+    // Every record written has the same walker, site and time, so a record
+    // that was torn by the writer would show up
+    trace::TraceBuffer buffer;
+    const int total_records = 1 << 20;
+    std::thread writer([&buffer,total_records]{
+      for(int index = 0; index < total_records; ++index){
+        buffer.push(trace::Record{trace::hop,index,index,
+            static_cast<double>(index)});
+      }
+    });
+    for(int read = 0; read < 200; ++read){
+      auto records = buffer.getRecords();
+      for(size_t index = 0; index < records.size(); ++index){
+        assert(records.at(index).walker==records.at(index).site);
+        assert(records.at(index).time==records.at(index).site);
+        if(index>0) assert(records.at(index).site>records.at(index-1).site);
+      }
+      if(read%10==0) buffer.clear();
+    }
+    writer.join();
+    buffer.clear();
+    assert(buffer.getRecords().size()==0);
+    buffer.push(trace::Record{trace::hop,1,2,0.5});
+    assert(buffer.getRecords().size()==1);
+  }
+
+  cout << "Testing: record" << endl;
+  {
+    trace::clear();
+    trace::record(trace::hop,1,2,0.5);
+    std::thread worker([]{ trace::record(trace::coarse_grain,-1,7,0.0); });
+    worker.join();
+
+    // The records of the finished thread are kept
+    auto records = trace::collect();
+    assert(records.size()==2);
+    int coarse_grain_records = 0;
+    for(auto & record : records){
+      if(record.event==trace::coarse_grain){
+        assert(record.site==7);
+        ++coarse_grain_records;
+      }
+    }
+    assert(coarse_grain_records==1);
+  }
+
+  cout << "Testing: dump" << endl;
+  {
+    trace::clear();
+    trace::record(trace::cluster_created,-1,4,0.0);
+    stringstream ss;
+    trace::dump(ss);
+    string output = ss.str();
+    assert(output.size()==8+2*sizeof(uint64_t)+sizeof(trace::Record));
+    assert(output.substr(0,8)=="KMCTRACE");
+    uint64_t number_of_records = 0;
+    memcpy(&number_of_records,output.data()+8+sizeof(uint64_t),sizeof(uint64_t));
+    assert(number_of_records==1);
+    trace::Record record;
+    memcpy(&record,output.data()+8+2*sizeof(uint64_t),sizeof(trace::Record));
+    assert(record.event==trace::cluster_created);
+    assert(record.site==4);
+  }
+
+  cout << "Testing: clear" << endl;
+  {
+    trace::record(trace::hop,1,2,0.5);
+    trace::clear();
+    assert(trace::collect().size()==0);
+  }
+
+  cout << "Testing: tracing the system" << endl;
+  {
+    // site1 <-> site2
+    unordered_map< int,unordered_map< int,double>> ratesToNeighbors;
+    ratesToNeighbors[1][2] = 1;
+    ratesToNeighbors[2][1] = 1;
+
+    KMC_CoarseGrainSystem CGsystem;
+    CGsystem.setRandomSeed(1);
+    CGsystem.setTimeResolution(100.0);
+    CGsystem.initializeSystem(ratesToNeighbors);
+
+    KMC_Walker electron;
+    electron.occupySite(1);
+    vector<pair<int,KMC_Walker>> electrons;
+    electrons.push_back(pair<int,KMC_Walker>(3,electron));
+    CGsystem.initializeWalkers(electrons);
+
+    trace::clear();
+    int total_hops = 10;
+    for(int hop = 0; hop < total_hops; ++hop){
+      CGsystem.hop(electrons.at(0).first,electrons.at(0).second);
+    }
+    auto records = trace::collect();
+    if(trace::enabled()){
+      assert(records.size()==static_cast<size_t>(total_hops));
+      for(auto & record : records){
+        assert(record.event==trace::hop);
+        assert(record.walker==3);
+        assert(record.time>0.0);
+      }
+    }else{
+      assert(records.size()==0);
+    }
+  }
+  return 0;
+}
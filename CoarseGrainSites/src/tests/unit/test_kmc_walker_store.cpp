@@ -0,0 +1,119 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "../../../include/kmccoarsegrain/kmc_constants.hpp"
+#include "../../../include/kmccoarsegrain/kmc_walker_store.hpp"
+
+using namespace std;
+using namespace kmccoarsegrain;
+
+int main(void) {
+
+  cout << "Testing: WalkerStore constructor" << endl;
+  {
+    KMC_WalkerStore walkers;
+    assert(walkers.size()==0);
+    assert(walkers.getEarliest()==constants::unassignedId);
+  }
+
+  cout << "Testing: WalkerStore add" << endl;
+  {
+    KMC_WalkerStore walkers;
+    int first = walkers.add(4);
+    int second = walkers.add(7,2.5);
+    assert(first==0);
+    assert(second==1);
+    assert(walkers.size()==2);
+    assert(walkers.contains(first));
+    assert(walkers.contains(second));
+    assert(!walkers.contains(2));
+    assert(!walkers.contains(-1));
+    assert(walkers.getSite(first)==4);
+    assert(walkers.getSite(second)==7);
+    assert(walkers.getTime(first)==0.0);
+    assert(walkers.getTime(second)==2.5);
+    assert(walkers.getPotentialSite(second)==constants::unassignedId);
+  }
+
+  cout << "Testing: WalkerStore remove" << endl;
+  {
+    KMC_WalkerStore walkers;
+    walkers.add(1);
+    int middle = walkers.add(2);
+    int last = walkers.add(3);
+    walkers.remove(middle);
+    assert(walkers.size()==2);
+    assert(!walkers.contains(middle));
+    assert(walkers.getSite(last)==3);
+    assert(walkers.getTimes().at(middle)==numeric_limits<double>::infinity());
+
+    bool fail = false;
+    try {
+      walkers.remove(middle);
+    }catch(invalid_argument &){
+      fail = true;
+    }
+    assert(fail);
+
+    // The handle is reused without growing the store
+    int reused = walkers.add(5);
+    assert(reused==middle);
+    assert(walkers.capacity()==3);
+    assert(walkers.getSite(reused)==5);
+
+    vector<int> handles = walkers.getHandles();
+    assert(handles.size()==3);
+    assert(handles.at(0)==0);
+    assert(handles.at(1)==1);
+    assert(handles.at(2)==2);
+  }
+
+  cout << "Testing: WalkerStore getWalker and setWalker" << endl;
+  {
+    KMC_WalkerStore walkers;
+    int handle = walkers.add(1,1.0);
+    KMC_Walker walker = walkers.getWalker(handle);
+    assert(walker.getIdOfSiteCurrentlyOccupying()==1);
+    walker.occupySite(2);
+    walker.setPotentialSite(3);
+    walker.setDwellTime(0.5);
+    walkers.setWalker(handle,walker);
+    assert(walkers.getSite(handle)==2);
+    assert(walkers.getPotentialSite(handle)==3);
+    assert(walkers.getDwellTime(handle)==0.5);
+    // The dwell time is added to the time of the walker
+    assert(walkers.getTime(handle)==1.5);
+  }
+
+  cout << "Testing: WalkerStore getEarliest" << endl;
+  {
+    KMC_WalkerStore walkers;
+    int first = walkers.add(1,3.0);
+    int second = walkers.add(2,1.0);
+    walkers.add(3,2.0);
+    assert(walkers.getEarliest()==second);
+    walkers.setTime(second,numeric_limits<double>::infinity());
+    assert(walkers.getEarliest()==2);
+    walkers.remove(2);
+    assert(walkers.getEarliest()==first);
+  }
+
+  cout << "Testing: WalkerPayload" << endl;
+  {
+    KMC_WalkerStore walkers;
+    KMC_WalkerPayload<string> names;
+    int first = walkers.add(1);
+    int second = walkers.add(2);
+    names[second] = "hole";
+    names[first] = "electron";
+    assert(names.size()==2);
+    assert(names.at(first)=="electron");
+    assert(names.at(second)=="hole");
+  }
+
+  return 0;
+}